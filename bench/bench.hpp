@@ -0,0 +1,136 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace bench {
+
+/*
+ * Prevent the compiler from optimizing away a computed value.
+ */
+template <typename T>
+inline void do_not_optimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/*
+ * Run the function once and return the average cost of a single operation in nanoseconds.
+ * `ops` is the number of operations the function performs.
+ */
+template <typename F>
+double measure(size_t ops, F&& function) {
+    auto begin = std::chrono::steady_clock::now();
+    function();
+    auto end = std::chrono::steady_clock::now();
+
+    auto elapsed = std::chrono::duration<double, std::nano>(end - begin).count();
+    return elapsed / static_cast<double>(ops);
+}
+
+/*
+ * Print a single benchmark result line.
+ */
+inline void report(std::string_view name, size_t size, double ns_per_op) {
+    std::printf("%-32.*s %10zu %12.2f ns/op\n", static_cast<int>(name.size()), name.data(), size, ns_per_op);
+}
+
+/*
+ * Results of a benchmark suite, printed as text lines or as a single JSON document.
+ * Every result has a name, the parameters it ran with and the metrics it measured.
+ */
+class Results {
+   public:
+    struct Metric {
+        std::string name;
+        double value;
+        std::string unit;
+    };
+
+    struct Result {
+        std::string name;
+        std::vector<std::pair<std::string, double>> params;
+        std::vector<Metric> metrics;
+
+        Result& param(std::string key, double value) {
+            params.emplace_back(std::move(key), value);
+            return *this;
+        }
+
+        Result& metric(std::string key, double value, std::string unit) {
+            metrics.push_back({std::move(key), value, std::move(unit)});
+            return *this;
+        }
+    };
+
+   private:
+    std::vector<Result> results_;
+
+   public:
+    /*
+     * Add a result to fill in with parameters and metrics.
+     * The reference is valid until the next call.
+     */
+    Result& add(std::string name) {
+        return results_.emplace_back(Result{std::move(name), {}, {}});
+    }
+
+    /*
+     * Print the results, one line per metric.
+     */
+    void print_text() const {
+        for (const auto& result : results_) {
+            std::string label = result.name;
+            for (const auto& [key, value] : result.params) {
+                label += "/" + key + "=" + format(value);
+            }
+            for (const auto& metric : result.metrics) {
+                std::printf("%-48s %-20s %14.2f %s\n", label.c_str(), metric.name.c_str(), metric.value,
+                            metric.unit.c_str());
+            }
+        }
+    }
+
+    /*
+     * Print the results as a JSON document, tagged with the backend they ran on.
+     */
+    void print_json(std::string_view backend) const {
+        std::printf("{\n  \"backend\": \"%.*s\",\n  \"results\": [", static_cast<int>(backend.size()), backend.data());
+        for (size_t i = 0; i < results_.size(); ++i) {
+            const Result& result = results_[i];
+            std::printf("%s\n    {\"name\": \"%s\", \"params\": {", i == 0 ? "" : ",", result.name.c_str());
+            for (size_t j = 0; j < result.params.size(); ++j) {
+                std::printf("%s\"%s\": %s", j == 0 ? "" : ", ", result.params[j].first.c_str(),
+                            format(result.params[j].second).c_str());
+            }
+            std::printf("}, \"metrics\": {");
+            for (size_t j = 0; j < result.metrics.size(); ++j) {
+                const Metric& metric = result.metrics[j];
+                std::printf("%s\"%s\": {\"value\": %s, \"unit\": \"%s\"}", j == 0 ? "" : ", ", metric.name.c_str(),
+                            format(metric.value).c_str(), metric.unit.c_str());
+            }
+            std::printf("}}");
+        }
+        std::printf("\n  ]\n}\n");
+    }
+
+   private:
+    /*
+     * Format a number for both outputs, integers without a fraction.
+     */
+    static std::string format(double value) {
+        char buffer[32];
+        if (value == static_cast<double>(static_cast<long long>(value))) {
+            std::snprintf(buffer, sizeof(buffer), "%lld", static_cast<long long>(value));
+        } else {
+            std::snprintf(buffer, sizeof(buffer), "%.3f", value);
+        }
+        return buffer;
+    }
+};
+
+}  // namespace bench
@@ -0,0 +1,132 @@
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <unordered_set>
+#include <vector>
+
+#include "bench.hpp"
+#include "client.hpp"
+#include "loopp/event_loop.hpp"
+#include "slab_pool.hpp"
+#include "socket.hpp"
+
+/*
+ * Connections opened and closed per run, and how many are open at a time.
+ */
+static constexpr size_t CHURN_CONNECTIONS = 100'000;
+static constexpr size_t LIVE_CONNECTIONS = 256;
+
+static size_t allocations = 0;
+
+void* operator new(size_t size) {
+    ++allocations;
+    if (void* pointer = std::malloc(size == 0 ? 1 : size)) return pointer;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t /*size*/) noexcept {
+    std::free(pointer);
+}
+
+/*
+ * Client storage previously used by the echo server, kept for comparison.
+ */
+class SharedClients {
+   private:
+    loopp::EventLoop& loop_;
+    std::unordered_set<std::shared_ptr<Client>> clients_;
+    std::vector<std::shared_ptr<Client>> order_;
+
+   public:
+    explicit SharedClients(loopp::EventLoop& loop) : loop_(loop) {}
+
+    void connect(int fd) {
+        order_.push_back(make(fd));
+    }
+
+    void replace(size_t index, int fd) {
+        clients_.erase(order_[index]);
+        order_[index].reset();
+        order_[index] = make(fd);
+    }
+
+   private:
+    std::shared_ptr<Client> make(int fd) {
+        auto client = std::make_shared<Client>(ClientHandle{}, Socket(fd), loop_);
+        clients_.insert(client);
+        return client;
+    }
+};
+
+/*
+ * Pooled client storage of the echo server.
+ */
+class PooledClients {
+   private:
+    loopp::EventLoop& loop_;
+    SlabPool<Client> clients_;
+    std::vector<SlabPool<Client>::Handle> order_;
+
+   public:
+    explicit PooledClients(loopp::EventLoop& loop) : loop_(loop) {}
+
+    void connect(int fd) {
+        order_.push_back(emplace(fd));
+    }
+
+    void replace(size_t index, int fd) {
+        clients_.release(order_[index]);
+        order_[index] = emplace(fd);
+    }
+
+   private:
+    SlabPool<Client>::Handle emplace(int fd) {
+        auto slot = clients_.next_handle();
+        return clients_.emplace(ClientHandle{0, slot.index, slot.generation}, Socket(fd), loop_);
+    }
+};
+
+/*
+ * Open `LIVE_CONNECTIONS` clients, then replace the oldest one per connection of the churn.
+ * Sockets are duplicates of one end of a socket pair, they're never registered with the loop.
+ */
+template <typename Clients>
+static void run(const char* name, loopp::EventLoop& loop, int fd) {
+    Clients clients(loop);
+    for (size_t i = 0; i < LIVE_CONNECTIONS; ++i) {
+        clients.connect(::dup(fd));
+    }
+
+    size_t allocations_before = allocations;
+    double churn = bench::measure(CHURN_CONNECTIONS, [&] {
+        for (size_t i = 0; i < CHURN_CONNECTIONS; ++i) {
+            clients.replace(i % LIVE_CONNECTIONS, ::dup(fd));
+        }
+    });
+    double allocations_per_connection = static_cast<double>(allocations - allocations_before) / CHURN_CONNECTIONS;
+
+    std::printf("%-32s %10zu %12.2f ns/op %8.2f allocs/op\n", name, LIVE_CONNECTIONS, churn, allocations_per_connection);
+}
+
+int main() {
+    auto loop = loopp::EventLoop::create();
+
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) return EXIT_FAILURE;
+
+    run<SharedClients>("shared_ptr/churn", *loop, fds[0]);
+    run<PooledClients>("slab_pool/churn", *loop, fds[0]);
+
+    ::close(fds[0]);
+    ::close(fds[1]);
+    return EXIT_SUCCESS;
+}
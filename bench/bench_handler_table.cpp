@@ -0,0 +1,108 @@
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "bench.hpp"
+#include "loopp/detail/handler_table.hpp"
+#include "loopp/event_loop.hpp"
+
+/*
+ * Number of ready events handled per simulated loop iteration.
+ */
+static constexpr size_t BATCH_SIZE = 1024;
+
+/*
+ * Number of simulated loop iterations in the dispatch benchmark.
+ */
+static constexpr size_t BATCH_COUNT = 2048;
+
+/*
+ * Handler storage previously used by the backends, kept for comparison.
+ */
+class NestedMapTable {
+   private:
+    std::unordered_map<int, std::unordered_map<loopp::EventType, loopp::EventCallback>> callbacks_;
+
+   public:
+    void insert(int fd, loopp::EventType type, const loopp::EventCallback& callback) {
+        callbacks_[fd][type] = callback;
+    }
+
+    bool erase(int fd, loopp::EventType type) {
+        if (!callbacks_.contains(fd) || !callbacks_[fd].contains(type)) return false;
+        callbacks_[fd].erase(type);
+        if (callbacks_[fd].empty()) callbacks_.erase(fd);
+        return true;
+    }
+
+    const loopp::EventCallback* find(int fd, loopp::EventType type) {
+        if (!callbacks_.contains(fd) || !callbacks_[fd].contains(type)) return nullptr;
+        return &callbacks_[fd][type];
+    }
+};
+
+/*
+ * Measure add, dispatch and remove for the given table type with `size` descriptors.
+ */
+template <typename Table>
+static void run(const char* name, size_t size) {
+    Table table;
+    uint64_t counter = 0;
+    loopp::EventCallback callback = [&counter](int fd, loopp::EventType) { counter += static_cast<uint64_t>(fd); };
+
+    int fd_count = static_cast<int>(size);
+    char label[64];
+
+    // Register READ and WRITE for every descriptor
+    double add = bench::measure(size * 2, [&] {
+        for (int fd = 0; fd < fd_count; ++fd) {
+            table.insert(fd, loopp::EventType::READ, callback);
+            table.insert(fd, loopp::EventType::WRITE, callback);
+        }
+    });
+    std::snprintf(label, sizeof(label), "%s/add", name);
+    bench::report(label, size, add);
+
+    // Random ready descriptors, as epoll_wait would report them
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> dist(0, fd_count - 1);
+    std::vector<std::array<int, BATCH_SIZE>> batches(BATCH_COUNT);
+    for (auto& batch : batches) {
+        std::ranges::generate(batch, [&] { return dist(rng); });
+    }
+
+    double dispatch = bench::measure(BATCH_COUNT * BATCH_SIZE, [&] {
+        for (const auto& batch : batches) {
+            for (int fd : batch) {
+                if (const auto* handler = table.find(fd, loopp::EventType::READ)) {
+                    (*handler)(fd, loopp::EventType::READ);
+                }
+            }
+        }
+    });
+    bench::do_not_optimize(counter);
+    std::snprintf(label, sizeof(label), "%s/dispatch", name);
+    bench::report(label, size, dispatch);
+
+    double remove = bench::measure(size * 2, [&] {
+        for (int fd = 0; fd < fd_count; ++fd) {
+            table.erase(fd, loopp::EventType::WRITE);
+            table.erase(fd, loopp::EventType::READ);
+        }
+    });
+    std::snprintf(label, sizeof(label), "%s/remove", name);
+    bench::report(label, size, remove);
+}
+
+int main() {
+    for (size_t size : {size_t{10'000}, size_t{100'000}}) {
+        run<loopp::detail::HandlerTable>("handler_table", size);
+        run<NestedMapTable>("nested_map", size);
+    }
+    return 0;
+}
@@ -0,0 +1,71 @@
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "bench.hpp"
+#include "loopp/event_loop.hpp"
+#include "loopp/detail/timer_wheel.hpp"
+
+/*
+ * Number of concurrently armed timers, e.g. one idle timeout per connection.
+ */
+static constexpr size_t TIMER_COUNT = 1'000'000;
+
+/*
+ * Longest delay in ticks, idle timeouts of up to a minute with 1 ms ticks.
+ */
+static constexpr uint64_t MAX_DELAY = 60'000;
+
+int main() {
+    loopp::detail::TimerWheel wheel;
+    std::vector<loopp::TimerId> ids(TIMER_COUNT);
+    uint64_t counter = 0;
+    loopp::TimerCallback callback = [&counter]() { ++counter; };
+
+    std::mt19937_64 rng(42);
+    std::uniform_int_distribution<uint64_t> dist(1, MAX_DELAY);
+    std::vector<uint64_t> delays(TIMER_COUNT);
+    for (auto& delay : delays) delay = dist(rng);
+
+    double arm = bench::measure(TIMER_COUNT, [&] {
+        for (size_t i = 0; i < TIMER_COUNT; ++i) ids[i] = wheel.add(delays[i], callback);
+    });
+    bench::report("timer_wheel/arm", TIMER_COUNT, arm);
+
+    // Activity on every connection pushes its timeout back
+    double rearm = bench::measure(TIMER_COUNT, [&] {
+        for (size_t i = 0; i < TIMER_COUNT; ++i) wheel.reset(ids[i], delays[TIMER_COUNT - 1 - i]);
+    });
+    bench::report("timer_wheel/rearm", TIMER_COUNT, rearm);
+
+    double cancel = bench::measure(TIMER_COUNT, [&] {
+        for (size_t i = 0; i < TIMER_COUNT; ++i) wheel.cancel(ids[i]);
+    });
+    bench::report("timer_wheel/cancel", TIMER_COUNT, cancel);
+
+    // Arm/cancel churn on recycled nodes
+    double churn = bench::measure(TIMER_COUNT, [&] {
+        for (size_t i = 0; i < TIMER_COUNT; ++i) wheel.cancel(wheel.add(delays[i], callback));
+    });
+    bench::report("timer_wheel/arm_cancel_churn", TIMER_COUNT, churn);
+
+    // Let every timer expire, one loop iteration per tick
+    for (size_t i = 0; i < TIMER_COUNT; ++i) ids[i] = wheel.add(delays[i], callback);
+    std::vector<uint32_t> expired;
+    double expire = bench::measure(TIMER_COUNT, [&] {
+        for (uint64_t tick = 0; tick <= MAX_DELAY; ++tick) {
+            wheel.advance(tick, expired);
+            for (uint32_t index : expired) {
+                if (const auto* timer_callback = wheel.begin_fire(index)) {
+                    (*timer_callback)();
+                    wheel.end_fire(index);
+                }
+            }
+            expired.clear();
+        }
+    });
+    bench::do_not_optimize(counter);
+    bench::report("timer_wheel/expire", TIMER_COUNT, expire);
+    return 0;
+}
@@ -0,0 +1,177 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <string_view>
+#include <system_error>
+
+#include "bench.hpp"
+#include "datagram_socket.hpp"
+#include "socket.hpp"
+
+/*
+ * Size of the datagrams, and how many are sent per run of the send benchmarks.
+ */
+static constexpr size_t DATAGRAM_SIZE = 64;
+static constexpr size_t SEND_DATAGRAMS = 200'000;
+
+/*
+ * Datagrams queued up per round of the receive benchmarks, they have to fit the receive buffer,
+ * and the number of rounds.
+ */
+static constexpr size_t ROUND_DATAGRAMS = 512;
+static constexpr size_t RECEIVE_ROUNDS = 200;
+
+/*
+ * Receive buffer requested for the receiving socket.
+ */
+static constexpr int RECEIVE_BUFFER_SIZE = 8 << 20;
+
+static const std::array<char, DATAGRAM_SIZE> payload{};
+
+/*
+ * Throw the errno of a failed setup call, benchmarks have no way to recover from them.
+ */
+static void check(bool is_ok, const char* what) {
+    if (!is_ok) throw std::system_error(errno, std::system_category(), what);
+}
+
+/*
+ * Print a result line with the rate, in million datagrams per second.
+ */
+static void report(const char* name, size_t datagrams, double ns) {
+    double ns_per_datagram = ns / static_cast<double>(datagrams);
+    std::printf("%-32s %10zu %12.2f ns/op %10.2f Mpps\n", name, datagrams, ns_per_datagram, 1e3 / ns_per_datagram);
+}
+
+/*
+ * Create a UDP socket bound to an ephemeral loopback port, storing its address.
+ */
+static Socket make_socket(sockaddr_in& addr) {
+    Socket socket = Socket::create_udp_socket();
+    addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    check(socket.bind(addr), "bind");
+    socklen_t size = sizeof(addr);
+    check(getsockname(socket.fd(), reinterpret_cast<sockaddr*>(&addr), &size) == 0, "getsockname");
+
+    // Forced past rmem_max where permitted
+    if (setsockopt(socket.fd(), SOL_SOCKET, SO_RCVBUFFORCE, &RECEIVE_BUFFER_SIZE, sizeof(RECEIVE_BUFFER_SIZE)) == -1) {
+        setsockopt(socket.fd(), SOL_SOCKET, SO_RCVBUF, &RECEIVE_BUFFER_SIZE, sizeof(RECEIVE_BUFFER_SIZE));
+    }
+    return socket;
+}
+
+static double elapsed_ns(std::chrono::steady_clock::time_point begin) {
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+}
+
+/*
+ * Per datagram sending, a sendto() each. The receiver isn't drained, datagrams beyond its buffer are dropped.
+ */
+static void bench_sendto(int fd, const sockaddr_in& to) {
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < SEND_DATAGRAMS; ++i) {
+        ::sendto(fd, payload.data(), payload.size(), 0, reinterpret_cast<const sockaddr*>(&to), sizeof(to));
+    }
+    report("udp/send/sendto", SEND_DATAGRAMS, elapsed_ns(begin));
+}
+
+/*
+ * Batched sending, a sendmmsg() per batch, with datagrams coalesced by GSO if enabled.
+ */
+static void bench_sendmmsg(const char* name, DatagramSocket& socket, const sockaddr_in& to) {
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < SEND_DATAGRAMS; ++i) {
+        if (!socket.send(std::string_view(payload.data(), payload.size()), to)) check(socket.flush(), "sendmmsg");
+    }
+    socket.flush();
+    report(name, SEND_DATAGRAMS, elapsed_ns(begin));
+}
+
+/*
+ * Fill the receiver with a round of datagrams, sent in batches, coalesced by GSO if enabled.
+ */
+static void queue_round(DatagramSocket& sender, const sockaddr_in& to) {
+    for (size_t i = 0; i < ROUND_DATAGRAMS; ++i) {
+        check(sender.send(std::string_view(payload.data(), payload.size()), to), "send");
+    }
+    check(sender.flush(), "flush");
+}
+
+/*
+ * Per datagram receiving, a recvfrom() each until the socket is drained.
+ */
+static void bench_recvfrom(DatagramSocket& sender, int fd, const sockaddr_in& to) {
+    size_t received = 0;
+    double ns = 0;
+    std::array<char, DatagramSocket::DEFAULT_DATAGRAM_SIZE> buffer{};
+    for (size_t round = 0; round < RECEIVE_ROUNDS; ++round) {
+        queue_round(sender, to);
+        auto begin = std::chrono::steady_clock::now();
+        while (true) {
+            sockaddr_in from{};
+            socklen_t size = sizeof(from);
+            ssize_t result = ::recvfrom(fd, buffer.data(), buffer.size(), MSG_DONTWAIT, reinterpret_cast<sockaddr*>(&from), &size);
+            if (result < 0) break;
+            bench::do_not_optimize(result);
+            ++received;
+        }
+        ns += elapsed_ns(begin);
+    }
+    report("udp/receive/recvfrom", received, ns);
+}
+
+/*
+ * Batched receiving, a recvmmsg() per batch, with datagrams coalesced by GRO if enabled.
+ */
+static void bench_recvmmsg(const char* name, DatagramSocket& sender, DatagramSocket& receiver, const sockaddr_in& to) {
+    size_t received = 0;
+    double ns = 0;
+    for (size_t round = 0; round < RECEIVE_ROUNDS; ++round) {
+        queue_round(sender, to);
+        auto begin = std::chrono::steady_clock::now();
+        while (receiver.receive([&](std::string_view data, const sockaddr_in&) {
+            bench::do_not_optimize(data.size());
+            ++received;
+        }, 0) > 0) {
+        }
+        ns += elapsed_ns(begin);
+    }
+    report(name, received, ns);
+}
+
+int main() {
+    sockaddr_in receiver_addr{};
+    sockaddr_in sender_addr{};
+    DatagramSocket receiver(make_socket(receiver_addr));
+    DatagramSocket sender(make_socket(sender_addr));
+
+    std::printf("%-32s %10s %15s %15s\n", "benchmark", "datagrams", "cost", "rate");
+    bench_sendto(sender.fd(), receiver_addr);
+    bench_sendmmsg("udp/send/sendmmsg", sender, receiver_addr);
+
+    // Drain what the send benchmarks left behind
+    receiver.receive([](std::string_view, const sockaddr_in&) {}, 0);
+    bench_recvfrom(sender, receiver.fd(), receiver_addr);
+    bench_recvmmsg("udp/receive/recvmmsg", sender, receiver, receiver_addr);
+
+    // GSO on the sender and GRO on the receiver, loopback hands coalesced datagrams over as they are
+    DatagramSocket gso_sender(make_socket(sender_addr));
+    if (!gso_sender.enable_gso() || !receiver.enable_gro()) {
+        std::perror("GSO/GRO unavailable, skipping");
+        return EXIT_SUCCESS;
+    }
+    bench_sendmmsg("udp/send/sendmmsg_gso", gso_sender, receiver_addr);
+    receiver.receive([](std::string_view, const sockaddr_in&) {}, 0);
+    bench_recvmmsg("udp/receive/recvmmsg_gro", gso_sender, receiver, receiver_addr);
+    return EXIT_SUCCESS;
+}
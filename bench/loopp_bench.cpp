@@ -0,0 +1,466 @@
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "bench.hpp"
+#include "loopp/event_loop.hpp"
+#include "loopp/native_event_loop.hpp"
+#include "loopp/stats.hpp"
+
+#ifndef LOOPP_BENCH_BACKEND
+#define LOOPP_BENCH_BACKEND "unknown"
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/*
+ * Ready callbacks dispatched per socket pair in the dispatch benchmark.
+ */
+constexpr size_t DISPATCH_ROUNDS = 2'000;
+
+/*
+ * Registrations added and removed in the churn benchmark.
+ */
+constexpr size_t CHURN_OPS = 200'000;
+
+/*
+ * Samples taken per wakeup latency benchmark.
+ */
+constexpr size_t LATENCY_SAMPLES = 2'000;
+
+/*
+ * Size of a request of the echo benchmark, and how long the load generator runs.
+ */
+constexpr size_t ECHO_MESSAGE_SIZE = 64;
+constexpr auto ECHO_DURATION = std::chrono::seconds(1);
+
+/*
+ * Throw the errno of a failed setup call, benchmarks have no way to recover from them.
+ */
+void check(bool is_ok, const char* what) {
+    if (!is_ok) throw std::system_error(errno, std::system_category(), what);
+}
+
+/*
+ * Get the nanoseconds elapsed between two points in time.
+ */
+double elapsed_ns(Clock::time_point begin, Clock::time_point end) {
+    return std::chrono::duration<double, std::nano>(end - begin).count();
+}
+
+/*
+ * Add the percentiles of a latency histogram to a result.
+ */
+void add_latency(bench::Results::Result& result, const loopp::Histogram& histogram) {
+    result.metric("p50", static_cast<double>(histogram.percentile(50)), "ns")
+        .metric("p99", static_cast<double>(histogram.percentile(99)), "ns")
+        .metric("p99.9", static_cast<double>(histogram.percentile(99.9)), "ns")
+        .metric("max", static_cast<double>(histogram.max()), "ns");
+}
+
+/*
+ * Run the loop on its own thread until the guard goes out of scope.
+ */
+class LoopRunner {
+   private:
+    loopp::EventLoop& loop_;
+    std::thread thread_;
+
+   public:
+    explicit LoopRunner(loopp::EventLoop& loop) : loop_(loop), thread_([&loop]() { loop.start(); }) {
+        while (!loop_.is_running()) {
+            std::this_thread::yield();
+        }
+    }
+
+    ~LoopRunner() noexcept {
+        loop_.stop();
+        thread_.join();
+    }
+
+    LoopRunner(const LoopRunner&) = delete;
+    LoopRunner& operator=(const LoopRunner&) = delete;
+    LoopRunner(LoopRunner&&) = delete;
+    LoopRunner& operator=(LoopRunner&&) = delete;
+};
+
+/*
+ * Dispatch throughput: every socket pair stays readable, so each iteration invokes a callback per pair.
+ */
+void bench_dispatch(bench::Results& results, size_t pairs) {
+    auto loop = loopp::EventLoop::create();
+
+    std::vector<std::array<int, 2>> sockets(pairs);
+    for (auto& pair : sockets) {
+        check(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, pair.data()) == 0, "socketpair");
+        check(write(pair[1], "x", 1) == 1, "write");
+    }
+
+    size_t target = pairs * DISPATCH_ROUNDS;
+    size_t calls = 0;
+    for (const auto& pair : sockets) {
+        check(loop->add_fd(pair[0], loopp::EventType::READ,
+                           [&](int, loopp::EventType) {
+                               if (++calls == target) loop->stop();
+                           }),
+              "add_fd");
+    }
+
+    auto begin = Clock::now();
+    loop->start();
+    auto end = Clock::now();
+
+    double ns = elapsed_ns(begin, end);
+    results.add("dispatch")
+        .param("pairs", static_cast<double>(pairs))
+        .metric("callbacks_per_sec", static_cast<double>(calls) / ns * 1e9, "1/s")
+        .metric("ns_per_callback", ns / static_cast<double>(calls), "ns");
+
+    for (const auto& pair : sockets) {
+        close(pair[0]);
+        close(pair[1]);
+    }
+}
+
+/*
+ * Registration churn: add and remove a callback from the loop thread, as connections come and go.
+ * Runs through the virtual interface, or statically dispatched through NativeEventLoop.
+ */
+template <typename Loop>
+void bench_churn(bench::Results& results, size_t fds, std::unique_ptr<Loop> loop) {
+
+    std::vector<std::array<int, 2>> pipes(fds);
+    for (auto& pipe_fds : pipes) {
+        check(pipe2(pipe_fds.data(), O_NONBLOCK | O_CLOEXEC) == 0, "pipe2");
+    }
+
+    double ns = 0;
+    check(loop->post([&]() {
+        auto begin = Clock::now();
+        for (size_t i = 0; i < CHURN_OPS; ++i) {
+            int fd = pipes[i % fds][0];
+            loop->add_fd(fd, loopp::EventType::READ, [](int, loopp::EventType) {});
+            loop->remove_fd(fd, loopp::EventType::READ);
+        }
+        ns = elapsed_ns(begin, Clock::now());
+        loop->stop();
+    }),
+          "post");
+    loop->start();
+
+    results.add("add_remove_churn")
+        .param("fds", static_cast<double>(fds))
+        .param("native", std::is_same_v<Loop, loopp::NativeEventLoop> ? 1 : 0)
+        .metric("ns_per_add_remove", ns / static_cast<double>(CHURN_OPS), "ns");
+
+    for (const auto& pipe_fds : pipes) {
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+    }
+}
+
+/*
+ * Registration churn from several threads at once, each on its own pipes, while the loop keeps dispatching.
+ */
+void bench_churn_threads(bench::Results& results, size_t threads) {
+    auto loop = loopp::EventLoop::create();
+
+    // An always readable pipe keeps the loop collecting and dispatching
+    std::array<int, 2> busy_fds{};
+    check(pipe2(busy_fds.data(), O_NONBLOCK | O_CLOEXEC) == 0, "pipe2");
+    check(write(busy_fds[1], "x", 1) == 1, "write");
+    check(loop->add_fd(busy_fds[0], loopp::EventType::READ, [](int, loopp::EventType) {}), "add_fd");
+
+    std::vector<std::array<int, 2>> pipes(threads);
+    for (auto& pipe_fds : pipes) {
+        check(pipe2(pipe_fds.data(), O_NONBLOCK | O_CLOEXEC) == 0, "pipe2");
+    }
+
+    double ns = 0;
+    {
+        LoopRunner runner(*loop);
+        std::vector<std::thread> workers;
+        auto begin = Clock::now();
+        for (size_t t = 0; t < threads; ++t) {
+            workers.emplace_back([&, fd = pipes[t][0]]() {
+                for (size_t i = 0; i < CHURN_OPS / threads; ++i) {
+                    loop->add_fd(fd, loopp::EventType::READ, [](int, loopp::EventType) {});
+                    loop->remove_fd(fd, loopp::EventType::READ);
+                }
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        ns = elapsed_ns(begin, Clock::now());
+    }
+
+    results.add("add_remove_churn/threads")
+        .param("threads", static_cast<double>(threads))
+        .metric("ns_per_add_remove", ns / static_cast<double>(CHURN_OPS / threads * threads), "ns");
+
+    close(busy_fds[0]);
+    close(busy_fds[1]);
+    for (const auto& pipe_fds : pipes) {
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+    }
+}
+
+/*
+ * Cross-thread wakeup latency of a task posted to a blocked loop.
+ */
+void bench_post_latency(bench::Results& results) {
+    auto loop = loopp::EventLoop::create();
+    LoopRunner runner(*loop);
+
+    loopp::Histogram histogram;
+    for (size_t i = 0; i < LATENCY_SAMPLES; ++i) {
+        // Give the loop time to block again
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+
+        std::atomic<int64_t> woken_ns{0};
+        auto begin = Clock::now();
+        check(loop->post([&]() { woken_ns.store(std::max<int64_t>((Clock::now() - begin).count(), 1), std::memory_order_release); }), "post");
+        while (woken_ns.load(std::memory_order_acquire) == 0) {
+            std::this_thread::yield();
+        }
+        histogram.record(static_cast<uint64_t>(woken_ns.load()));
+    }
+
+    add_latency(results.add("wakeup_latency/post"), histogram);
+}
+
+/*
+ * Cross-thread wakeup latency of a ready file descriptor registered from another thread.
+ */
+void bench_add_fd_latency(bench::Results& results) {
+    auto loop = loopp::EventLoop::create();
+    LoopRunner runner(*loop);
+
+    std::array<int, 2> fds{};
+    check(pipe2(fds.data(), O_NONBLOCK | O_CLOEXEC) == 0, "pipe2");
+    check(write(fds[1], "x", 1) == 1, "write");
+
+    loopp::Histogram histogram;
+    for (size_t i = 0; i < LATENCY_SAMPLES; ++i) {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+
+        std::atomic<int64_t> woken_ns{0};
+        auto begin = Clock::now();
+        check(loop->add_fd(fds[0], loopp::EventType::READ,
+                           [&](int fd, loopp::EventType type) {
+                               loop->remove_fd(fd, type);
+                               woken_ns.store(std::max<int64_t>((Clock::now() - begin).count(), 1), std::memory_order_release);
+                           }),
+              "add_fd");
+        while (woken_ns.load(std::memory_order_acquire) == 0) {
+            std::this_thread::yield();
+        }
+        histogram.record(static_cast<uint64_t>(woken_ns.load()));
+    }
+
+    add_latency(results.add("wakeup_latency/add_fd"), histogram);
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+/*
+ * Cross-thread latency of stopping a blocked loop, until start() returns.
+ */
+void bench_stop_latency(bench::Results& results) {
+    auto loop = loopp::EventLoop::create();
+
+    loopp::Histogram histogram;
+    for (size_t i = 0; i < LATENCY_SAMPLES / 10; ++i) {
+        Clock::time_point begin;
+        Clock::time_point end;
+        std::thread thread([&]() {
+            loop->start();
+            end = Clock::now();
+        });
+        while (!loop->is_running()) {
+            std::this_thread::yield();
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+
+        begin = Clock::now();
+        check(loop->stop(), "stop");
+        thread.join();
+        histogram.record(static_cast<uint64_t>((end - begin).count()));
+    }
+
+    add_latency(results.add("wakeup_latency/stop"), histogram);
+}
+
+/*
+ * Create a non-blocking TCP socket listening on an ephemeral loopback port.
+ * Returns the socket and the port.
+ */
+std::pair<int, uint16_t> listen_loopback() {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    check(fd != -1, "socket");
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    check(bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0, "bind");
+    check(listen(fd, SOMAXCONN) == 0, "listen");
+
+    socklen_t length = sizeof(address);
+    check(getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length) == 0, "getsockname");
+    return {fd, ntohs(address.sin_port)};
+}
+
+/*
+ * Echo requests per second, with a server loop and a load generator loop on separate threads.
+ * Every connection keeps a single request in flight.
+ */
+void bench_echo(bench::Results& results, size_t connections) {
+    auto server = loopp::EventLoop::create();
+    auto [listen_fd, port] = listen_loopback();
+
+    // Echo everything back, messages are small enough to never fill the socket buffer
+    auto on_readable = [&server](int fd, loopp::EventType type) {
+        std::array<char, 4096> buffer;
+        ssize_t size = read(fd, buffer.data(), buffer.size());
+        if (size > 0) {
+            if (write(fd, buffer.data(), static_cast<size_t>(size)) == size) return;
+        } else if (size == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        server->remove_fd(fd, type);
+        close(fd);
+    };
+    check(server->add_fd(listen_fd, loopp::EventType::READ,
+                         [&](int fd, loopp::EventType) {
+                             int client = accept4(fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                             if (client != -1) server->add_fd(client, loopp::EventType::READ, on_readable);
+                         }),
+          "add_fd");
+    LoopRunner runner(*server);
+
+    // Connect every client, then send the first request of each
+    auto client = loopp::EventLoop::create();
+    std::vector<int> sockets(connections);
+    std::vector<size_t> received(connections);
+    for (int& fd : sockets) {
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        check(fd != -1, "socket");
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(port);
+        check(connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0, "connect");
+        check(fcntl(fd, F_SETFL, O_NONBLOCK) == 0, "fcntl");
+    }
+
+    std::array<char, ECHO_MESSAGE_SIZE> message{};
+    uint64_t requests = 0;
+    for (size_t i = 0; i < connections; ++i) {
+        check(client->add_fd(sockets[i], loopp::EventType::READ,
+                             [&, i](int fd, loopp::EventType type) {
+                                 std::array<char, ECHO_MESSAGE_SIZE> buffer;
+                                 ssize_t size = read(fd, buffer.data(), buffer.size());
+                                 if (size <= 0) return;
+
+                                 // A full response completes the request, send the next one
+                                 received[i] += static_cast<size_t>(size);
+                                 if (received[i] < ECHO_MESSAGE_SIZE) return;
+                                 received[i] = 0;
+                                 ++requests;
+                                 if (write(fd, message.data(), message.size()) == -1) client->remove_fd(fd, type);
+                             }),
+              "add_fd");
+        check(write(sockets[i], message.data(), message.size()) == static_cast<ssize_t>(message.size()), "write");
+    }
+
+    check(client->add_timer(ECHO_DURATION, [&]() { client->stop(); }) != 0, "add_timer");
+    auto begin = Clock::now();
+    client->start();
+    double ns = elapsed_ns(begin, Clock::now());
+
+    results.add("echo")
+        .param("connections", static_cast<double>(connections))
+        .param("message_size", static_cast<double>(ECHO_MESSAGE_SIZE))
+        .metric("requests_per_sec", static_cast<double>(requests) / ns * 1e9, "1/s");
+
+    for (int fd : sockets) close(fd);
+    server->remove_fd(listen_fd, loopp::EventType::READ);
+    close(listen_fd);
+}
+
+/*
+ * Print the usage of the benchmark suite.
+ */
+void usage(const char* program) {
+    std::fprintf(stderr, "Usage: %s [--json] [--filter NAME]\n", program);
+    std::fprintf(stderr, "Benchmarks: dispatch, add_remove_churn, wakeup_latency, echo\n");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    bool is_json = false;
+    std::string_view filter;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        if (arg == "--json") {
+            is_json = true;
+        } else if (arg == "--filter" && i + 1 < argc) {
+            filter = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    auto is_selected = [&](std::string_view name) { return filter.empty() || name.find(filter) != std::string_view::npos; };
+
+    bench::Results results;
+    if (is_selected("dispatch")) {
+        for (size_t pairs : {size_t{1}, size_t{64}, size_t{256}}) bench_dispatch(results, pairs);
+    }
+    if (is_selected("add_remove_churn")) {
+        for (size_t fds : {size_t{1}, size_t{256}}) {
+            bench_churn(results, fds, loopp::EventLoop::create());
+            bench_churn(results, fds, std::make_unique<loopp::NativeEventLoop>());
+        }
+        for (size_t threads : {size_t{1}, size_t{4}}) bench_churn_threads(results, threads);
+    }
+    if (is_selected("wakeup_latency")) {
+        bench_post_latency(results);
+        bench_add_fd_latency(results);
+        bench_stop_latency(results);
+    }
+    if (is_selected("echo")) {
+        for (size_t connections : {size_t{1}, size_t{64}}) bench_echo(results, connections);
+    }
+
+    if (is_json) {
+        results.print_json(LOOPP_BENCH_BACKEND);
+    } else {
+        results.print_text();
+    }
+    return 0;
+}
@@ -6,36 +6,58 @@
 #include <cstddef>
 #include <memory>
 #include <string>
-#include <system_error>
+#include <string_view>
 #include <utility>
 
 #include "loopp/event_loop.hpp"
 #include "socket.hpp"
 
-constexpr size_t BUFFER_SIZE = 1024;
+Client::Client(ClientHandle handle, Socket&& socket, loopp::EventLoop& loop) : handle_(handle), socket_(std::move(socket)), loop_(loop) {}
 
-Client::Client(Socket&& socket, std::shared_ptr<loopp::EventLoop> loop) : socket_(std::move(socket)), loop_(std::move(loop)) {
-    if (!socket_.set_nonblocking()) {
-        throw std::system_error(errno, std::system_category(), "Failed to set client socket to non-blocking");
-    }
+ClientHandle Client::handle() const noexcept {
+    return handle_;
 }
 
 bool Client::start() {
-    return loop_->add_fd(socket_.fd(), loopp::EventType::READ,
-                         [this](int, loopp::EventType) { handle_read(); });
+    return loop_.add_fd(socket_.fd(), loopp::READY_READ, this, nullptr);
+}
+
+loopp::HandlerRegistration Client::registration() noexcept {
+    return {socket_.fd(), loopp::READY_READ, this, nullptr};
 }
 
 void Client::on_read(const ClientReadCallback& callback) {
     read_callback_ = callback;
 }
 
-bool Client::write(const std::string& data) {
-    write_buffer_.append(data);
-    return loop_->add_fd(socket_.fd(), loopp::EventType::WRITE,
-                         [this](int, loopp::EventType) { handle_write(); });
+bool Client::write(std::string_view data) {
+    write_queue_.append(data);
+    return flush_unless_dispatching();
+}
+
+bool Client::write(const char* data) {
+    return write(std::string_view(data));
+}
+
+bool Client::write(std::string&& data) {
+    write_queue_.append(std::move(data));
+    return flush_unless_dispatching();
+}
+
+bool Client::write(std::shared_ptr<const std::string> data) {
+    write_queue_.append(std::move(data));
+    return flush_unless_dispatching();
+}
+
+bool Client::write_borrowed(std::string_view data) {
+    write_queue_.append_borrowed(data);
+    return flush_unless_dispatching();
 }
 
 bool Client::disconnect() {
+    if (is_disconnected_) return true;
+    is_disconnected_ = true;
+
     bool success = close();
     handle_disconnect();
     return success;
@@ -46,59 +68,108 @@ void Client::on_disconnect(const ClientDisconnectCallback& callback) {
 }
 
 bool Client::close() {
-    if (!loop_->remove_fd(socket_.fd(), loopp::EventType::READ)) {
+    if (!loop_.remove_fd(socket_.fd(), loopp::EventType::READ)) {
         return false;
     }
-    if (!loop_->remove_fd(socket_.fd(), loopp::EventType::WRITE)) {
+    if (!loop_.remove_fd(socket_.fd(), loopp::EventType::WRITE)) {
         return false;
     }
     return true;
 }
 
-void Client::handle_read() {
-    char buffer[BUFFER_SIZE];
-    ssize_t bytes_read = socket_.read(buffer, sizeof(buffer));
-
-    // We received data
-    if (bytes_read > 0 && read_callback_) {
-        read_callback_(shared_from_this(), std::string(buffer, static_cast<size_t>(bytes_read)));
+void Client::on_ready(int /*fd*/, loopp::ReadyMask ready, void* /*user_data*/) {
+    // The connection is gone, nothing left to read or write
+    if ((ready & (loopp::READY_ERROR | loopp::READY_HANGUP)) != 0) {
+        disconnect();
+        return;
     }
 
-    // No data, client disconnected
-    if (bytes_read == 0) {
-        disconnect();
+    // Gather what the read callback writes, it's sent with a single flush below
+    is_dispatching_ = true;
+    bool is_peer_done = (ready & loopp::READY_READ_HANGUP) != 0;
+    if ((ready & loopp::READY_READ) != 0 && !handle_read(is_peer_done)) {
+        return;
     }
+    is_dispatching_ = false;
 
-    // An error occurred
-    if (bytes_read < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
-        disconnect();
+    if (!write_queue_.empty() || is_write_armed_) {
+        flush();
     }
 }
 
-void Client::handle_write() {
-    ssize_t bytes_written = socket_.write(write_buffer_.data(), write_buffer_.size());
+bool Client::handle_read(bool is_peer_done) {
+    size_t total_read = 0;
+    while (total_read < MAX_READ_PER_EVENT) {
+        ssize_t bytes_read = socket_.read(read_buffer_.data(), read_buffer_.size());
+
+        // No data, client disconnected
+        if (bytes_read == 0) {
+            disconnect();
+            return false;
+        }
+
+        // Nothing left to read, or an error occurred
+        if (bytes_read < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                disconnect();
+                return false;
+            }
+            break;
+        }
+
+        // We received data
+        auto size = static_cast<size_t>(bytes_read);
+        bool is_drained = size < read_buffer_.size();
+        if (read_callback_) {
+            read_callback_(*this, std::string_view(read_buffer_.data(), size));
+            if (is_disconnected_) return false;
+        }
+        read_buffer_.record(size);
+        total_read += size;
+
+        // A short read means the socket is drained for now
+        if (is_drained) break;
+    }
 
-    // We sent data
-    if (bytes_written > 0) {
-        write_buffer_.erase(0, static_cast<size_t>(bytes_written));
+    // The peer is done sending and nothing is left, client disconnected
+    if (is_peer_done && total_read < MAX_READ_PER_EVENT) {
+        // Best effort at sending the replies, the peer may still be reading
+        write_queue_.write_to(socket_);
+        disconnect();
+        return false;
     }
+    return true;
+}
+
+bool Client::flush() {
+    ssize_t bytes_written = write_queue_.write_to(socket_);
 
     // An error occurred
     if (bytes_written < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
         disconnect();
+        return false;
     }
 
-    // We finished writing all data
-    if (write_buffer_.empty()) {
-        if (!loop_->remove_fd(socket_.fd(), loopp::EventType::WRITE)) {
-            // If remove fails, disconnect
-            disconnect();
-        }
+    // Wait for the socket to be writable while data is left, only for reads once it's all sent
+    bool needs_write = !write_queue_.empty();
+    if (needs_write == is_write_armed_) return true;
+
+    loopp::ReadyMask interest = needs_write ? loopp::READY_READ | loopp::READY_WRITE : loopp::READY_READ;
+    if (!loop_.add_fd(socket_.fd(), interest, this, nullptr)) {
+        // If changing the interest fails, disconnect
+        disconnect();
+        return false;
     }
+    is_write_armed_ = needs_write;
+    return true;
+}
+
+bool Client::flush_unless_dispatching() {
+    return is_dispatching_ || flush();
 }
 
 void Client::handle_disconnect() {
     if (disconnect_callback_) {
-        disconnect_callback_(shared_from_this());
+        disconnect_callback_(*this);
     }
 }
@@ -1,28 +1,51 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <string>
+#include <string_view>
 
 #include "loopp/event_loop.hpp"
+#include "read_buffer.hpp"
 #include "socket.hpp"
+#include "write_queue.hpp"
+
+/*
+ * Identifies a client served by a TcpServer, see TcpServer::find_client().
+ * Goes stale once the client is gone, even if its slot is reused by another one.
+ */
+struct ClientHandle {
+    uint32_t worker{0};
+    uint32_t index{UINT32_MAX};
+    uint32_t generation{0};
+
+    bool operator==(const ClientHandle&) const noexcept = default;
+};
 
 /*
  * Callback type for data read from the client socket.
+ * The data points into the client's read buffer and is only valid during the call.
  */
-using ClientReadCallback = std::function<void(std::shared_ptr<class Client> client, const std::string& data)>;
+using ClientReadCallback = std::function<void(class Client& client, std::string_view data)>;
 
 /*
  * Callback type for client disconnection.
  */
-using ClientDisconnectCallback = std::function<void(std::shared_ptr<class Client> client)>;
+using ClientDisconnectCallback = std::function<void(class Client& client)>;
 
 /*
  * Manages read and write operations on the client socket.
- * Must be used with a shared_ptr to ensure proper lifetime management.
+ * Registered as a single handler for both directions of the socket.
+ * Owned by whoever created it, e.g. the pool of a TcpServer, which must keep it alive
+ * until the loop is done with the current ready event once it disconnected.
+ * Code outliving a callback should keep its handle rather than a reference.
  */
-class Client : public std::enable_shared_from_this<Client> {
+class Client : public loopp::FdHandler {
    private:
+    ClientHandle handle_;
+
     /*
      * The client's socket for communication.
      */
@@ -32,7 +55,7 @@ class Client : public std::enable_shared_from_this<Client> {
      * The event loop for handling asynchronous events.
      * Owned by the server that created this client.
      */
-    std::shared_ptr<loopp::EventLoop> loop_;
+    loopp::EventLoop& loop_;
 
     /*
      * The callback to be called when data is read from the client socket.
@@ -45,41 +68,95 @@ class Client : public std::enable_shared_from_this<Client> {
     ClientDisconnectCallback disconnect_callback_;
 
     /*
-     * Buffer for data to be written to the client socket.
-     * Data is appended to this buffer and sent when the socket is writable.
+     * Buffer data is read into from the client socket, handed to the read callback in place.
+     */
+    ReadBuffer read_buffer_{};
+
+    /*
+     * Data waiting to be written to the client socket.
+     * Sent right away when possible, the rest once the socket is writable.
+     */
+    WriteQueue write_queue_{};
+
+    /*
+     * Whether the WRITE interest is registered with the loop.
+     */
+    bool is_write_armed_{false};
+
+    /*
+     * Whether a ready event is being handled, writes are then flushed once it's done.
      */
-    std::string write_buffer_{};
+    bool is_dispatching_{false};
+
+    /*
+     * Whether the client got disconnected, it's then only waiting to be destroyed.
+     */
+    bool is_disconnected_{false};
 
    public:
-    Client(Socket&& socket, std::shared_ptr<loopp::EventLoop> loop);
-    ~Client() = default;
+    /*
+     * Maximum number of bytes read per readiness event, so busy clients can't starve the others.
+     * Whatever is left is reported again on the next iteration.
+     */
+    static constexpr size_t MAX_READ_PER_EVENT = 262144;
+
+    /*
+     * Serve a connected socket, which must be non-blocking already, e.g. accepted with Socket::accept().
+     */
+    Client(ClientHandle handle, Socket&& socket, loopp::EventLoop& loop);
+    ~Client() noexcept override = default;
 
     Client(const Client&) = delete;
     Client& operator=(const Client&) = delete;
     Client(Client&&) = delete;
     Client& operator=(Client&&) = delete;
 
+    /*
+     * Get the handle identifying the client.
+     */
+    [[nodiscard]] ClientHandle handle() const noexcept;
+
     /*
      * Start polling for events on the client socket.
      * Returns true on success, false on failure (check errno for details).
      */
     bool start();
 
+    /*
+     * Get the registration start() makes, to start several clients with a single EventLoop::add_fds().
+     */
+    [[nodiscard]] loopp::HandlerRegistration registration() noexcept;
+
     /*
      * Set a callback to be called when data is read from the client socket.
      */
     void on_read(const ClientReadCallback& callback);
 
     /*
-     * Append data to the client's write buffer.
-     * Data will be sent to the client socket when the socket is writable.
-     * Returns true on success, false on failure (check errno for details).
+     * Queue a copy of the data and try to send it right away.
+     * What the socket doesn't take is sent once it's writable.
+     * Returns false if the client got disconnected.
+     * Within a read callback, data is gathered and sent once the callback returns.
+     */
+    bool write(std::string_view data);
+    bool write(const char* data);
+
+    /*
+     * Queue a buffer without copying it and try to send it right away, see write().
      */
-    bool write(const std::string& data);
+    bool write(std::string&& data);
+    bool write(std::shared_ptr<const std::string> data);
+
+    /*
+     * Queue data borrowed from the caller without copying it, e.g. a string literal.
+     * It must stay valid until sent, see write().
+     */
+    bool write_borrowed(std::string_view data);
 
     /*
      * Disconnect the client.
      * Returns true on success, false on failure (check errno for details).
+     * If the client is already disconnected, it's a no-op and returns true.
      */
     bool disconnect();
 
@@ -96,16 +173,30 @@ class Client : public std::enable_shared_from_this<Client> {
      */
     bool close();
 
+    /*
+     * Called when the socket is ready, dispatches to the read and write handlers.
+     */
+    void on_ready(int fd, loopp::ReadyMask ready, void* user_data) override;
+
    private:
     /*
-     * Called when socket is readable.
+     * Called when socket is readable, reads until it's drained or `MAX_READ_PER_EVENT` is reached.
+     * Once the peer is done sending, disconnects as soon as the data left is read.
+     * Returns false if the client got disconnected.
+     */
+    bool handle_read(bool is_peer_done);
+
+    /*
+     * Send as much queued data as the socket takes.
+     * Registers the WRITE interest if some is left, and drops it once everything is sent.
+     * Returns false if the client got disconnected.
      */
-    void handle_read();
+    bool flush();
 
     /*
-     * Called when socket is writable.
+     * Flush queued data unless a ready event is being handled, which flushes when done.
      */
-    void handle_write();
+    bool flush_unless_dispatching();
 
     /*
      * Called when the client gets disconnected.
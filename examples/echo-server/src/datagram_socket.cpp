@@ -0,0 +1,259 @@
+#include "datagram_socket.hpp"
+
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string_view>
+#include <utility>
+
+#include "socket.hpp"
+
+namespace {
+
+/*
+ * Round a size up to whole cache lines, so neighbouring buffers don't share one.
+ */
+constexpr size_t round_to_cache_lines(size_t size) noexcept {
+    return (size + DatagramSocket::CACHE_LINE_SIZE - 1) / DatagramSocket::CACHE_LINE_SIZE * DatagramSocket::CACHE_LINE_SIZE;
+}
+
+/*
+ * Allocate zeroed storage for `count` elements starting on a cache line.
+ * Throws `std::bad_alloc` on allocation failure.
+ */
+template <typename T>
+T* allocate_aligned(size_t count) {
+    void* storage = ::operator new[](count * sizeof(T), std::align_val_t{DatagramSocket::CACHE_LINE_SIZE});
+    std::memset(storage, 0, count * sizeof(T));
+    return static_cast<T*>(storage);
+}
+
+/*
+ * Get the GRO segment size reported with a received message, 0 if it holds a single datagram.
+ */
+size_t gro_segment_size([[maybe_unused]] msghdr& message) noexcept {
+#ifdef UDP_GRO
+    for (cmsghdr* control = CMSG_FIRSTHDR(&message); control != nullptr; control = CMSG_NXTHDR(&message, control)) {
+        if (control->cmsg_level == SOL_UDP && control->cmsg_type == UDP_GRO) {
+            int size = 0;
+            std::memcpy(&size, CMSG_DATA(control), sizeof(size));
+            return size > 0 ? static_cast<size_t>(size) : 0;
+        }
+    }
+#endif
+    return 0;
+}
+
+}  // namespace
+
+void DatagramSocket::AlignedDelete::operator()(void* pointer) const noexcept {
+    ::operator delete[](pointer, std::align_val_t{CACHE_LINE_SIZE});
+}
+
+DatagramSocket::DatagramSocket(Socket&& socket, size_t batch_size, size_t datagram_size)
+    : socket_(std::move(socket)), batch_size_(batch_size), datagram_size_(datagram_size) {
+    receive_ = make_batch(datagram_size_);
+    send_ = make_batch(datagram_size_);
+}
+
+int DatagramSocket::fd() const noexcept {
+    return socket_.fd();
+}
+
+bool DatagramSocket::enable_gro() {
+#ifdef UDP_GRO
+    int value = 1;
+    if (setsockopt(socket_.fd(), SOL_UDP, UDP_GRO, &value, sizeof(value)) == -1) return false;
+    receive_ = make_batch(MAX_COALESCED_SIZE);
+    is_gro_ = true;
+    for (size_t i = 0; i < batch_size_; ++i) {
+        reset_received(i);
+    }
+    return true;
+#else
+    errno = ENOTSUP;
+    return false;
+#endif
+}
+
+bool DatagramSocket::enable_gso() {
+#ifdef UDP_SEGMENT
+    if (queued_messages_ != 0) {
+        errno = EBUSY;
+        return false;
+    }
+
+    // Probe for support, the segment size itself is handed over with every coalesced message
+    int value = 0;
+    if (setsockopt(socket_.fd(), SOL_UDP, UDP_SEGMENT, &value, sizeof(value)) == -1) return false;
+    send_ = make_batch(MAX_COALESCED_SIZE);
+    is_gso_ = true;
+    return true;
+#else
+    errno = ENOTSUP;
+    return false;
+#endif
+}
+
+ssize_t DatagramSocket::receive(const DatagramCallback& callback, size_t max_batches) {
+    size_t received = 0;
+    for (size_t batch = 0; max_batches == 0 || batch < max_batches; ++batch) {
+        int count = ::recvmmsg(socket_.fd(), receive_.headers.get(), static_cast<unsigned>(batch_size_), MSG_DONTWAIT, nullptr);
+        if (count == -1) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK || received > 0) break;
+            return -1;
+        }
+
+        for (size_t i = 0; i < static_cast<size_t>(count); ++i) {
+            const Entry& entry = receive_.entries[i];
+            std::string_view data(static_cast<const char*>(entry.segment.iov_base), receive_.headers[i].msg_len);
+            size_t segment_size = is_gro_ ? gro_segment_size(receive_.headers[i].msg_hdr) : 0;
+            if (segment_size == 0) segment_size = data.size();
+
+            // Ready for the next batch even if a callback throws
+            reset_received(i);
+
+            // Split coalesced datagrams back up, only the last one may be shorter
+            do {
+                std::string_view datagram = data.substr(0, segment_size);
+                data.remove_prefix(datagram.size());
+                ++received;
+                callback(datagram, entry.address);
+            } while (!data.empty());
+        }
+
+        // A partial batch drained the socket
+        if (static_cast<size_t>(count) < batch_size_) break;
+    }
+    return static_cast<ssize_t>(received);
+}
+
+bool DatagramSocket::send(std::string_view data, const sockaddr_in& to) noexcept {
+    if (data.size() > datagram_size_) {
+        errno = EMSGSIZE;
+        return false;
+    }
+
+    // Append to the last message if GSO can split them again
+    if (is_gso_ && queued_messages_ > first_unsent_) {
+        Entry& entry = send_.entries[queued_messages_ - 1];
+        if (can_coalesce(entry, data.size(), to)) {
+            std::memcpy(static_cast<char*>(entry.segment.iov_base) + entry.segment.iov_len, data.data(), data.size());
+            entry.segment.iov_len += data.size();
+            ++entry.segments;
+            ++queued_datagrams_;
+
+#ifdef UDP_SEGMENT
+            // The segment size is only handed over once the message holds more than one datagram
+            msghdr& message = send_.headers[queued_messages_ - 1].msg_hdr;
+            if (entry.segments == 2) {
+                message.msg_control = entry.control.data();
+                message.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+                cmsghdr* control = CMSG_FIRSTHDR(&message);
+                control->cmsg_level = SOL_UDP;
+                control->cmsg_type = UDP_SEGMENT;
+                control->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+                std::memcpy(CMSG_DATA(control), &entry.segment_size, sizeof(uint16_t));
+            }
+#endif
+            return true;
+        }
+    }
+
+    if (queued_messages_ == batch_size_ && !flush()) return false;
+
+    Entry& entry = send_.entries[queued_messages_];
+    entry.address = to;
+    std::memcpy(entry.segment.iov_base, data.data(), data.size());
+    entry.segment.iov_len = data.size();
+    entry.segment_size = static_cast<uint16_t>(data.size());
+    entry.segments = 1;
+
+    msghdr& message = send_.headers[queued_messages_].msg_hdr;
+    message.msg_control = nullptr;
+    message.msg_controllen = 0;
+
+    ++queued_messages_;
+    ++queued_datagrams_;
+    return true;
+}
+
+bool DatagramSocket::flush() noexcept {
+    while (first_unsent_ < queued_messages_) {
+        int count = ::sendmmsg(socket_.fd(), send_.headers.get() + first_unsent_, static_cast<unsigned>(queued_messages_ - first_unsent_),
+                               MSG_DONTWAIT);
+        if (count == -1) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return false;
+
+            // Drop the message the socket refuses, or it would block the rest forever
+            int error = errno;
+            queued_datagrams_ -= send_.entries[first_unsent_].segments;
+            ++first_unsent_;
+            if (first_unsent_ == queued_messages_) first_unsent_ = queued_messages_ = 0;
+            errno = error;
+            return false;
+        }
+
+        for (size_t i = 0; i < static_cast<size_t>(count); ++i) {
+            queued_datagrams_ -= send_.entries[first_unsent_ + i].segments;
+        }
+        first_unsent_ += static_cast<size_t>(count);
+    }
+
+    first_unsent_ = 0;
+    queued_messages_ = 0;
+    return true;
+}
+
+size_t DatagramSocket::queued() const noexcept {
+    return queued_datagrams_;
+}
+
+DatagramSocket::Batch DatagramSocket::make_batch(size_t buffer_size) const {
+    Batch batch;
+    batch.buffer_size = round_to_cache_lines(buffer_size);
+    batch.headers = AlignedArray<mmsghdr>(allocate_aligned<mmsghdr>(batch_size_));
+    batch.entries = std::make_unique<Entry[]>(batch_size_);
+    batch.buffers = AlignedArray<char>(allocate_aligned<char>(batch_size_ * batch.buffer_size));
+
+    for (size_t i = 0; i < batch_size_; ++i) {
+        Entry& entry = batch.entries[i];
+        entry.segment.iov_base = batch.buffers.get() + i * batch.buffer_size;
+        entry.segment.iov_len = buffer_size;
+
+        msghdr& message = batch.headers[i].msg_hdr;
+        message.msg_name = &entry.address;
+        message.msg_namelen = sizeof(entry.address);
+        message.msg_iov = &entry.segment;
+        message.msg_iovlen = 1;
+    }
+    return batch;
+}
+
+void DatagramSocket::reset_received(size_t index) noexcept {
+    Entry& entry = receive_.entries[index];
+    msghdr& message = receive_.headers[index].msg_hdr;
+    message.msg_namelen = sizeof(entry.address);
+    message.msg_control = is_gro_ ? entry.control.data() : nullptr;
+    message.msg_controllen = is_gro_ ? entry.control.size() : 0;
+    message.msg_flags = 0;
+}
+
+bool DatagramSocket::can_coalesce(const Entry& entry, size_t size, const sockaddr_in& to) const noexcept {
+    // Every datagram but the last one has the segment size
+    return entry.segments < MAX_SEGMENTS && size != 0 && size <= entry.segment_size &&
+           entry.segment.iov_len == static_cast<size_t>(entry.segments) * entry.segment_size &&
+           entry.segment.iov_len + size <= MAX_COALESCED_SIZE && entry.address.sin_addr.s_addr == to.sin_addr.s_addr &&
+           entry.address.sin_port == to.sin_port;
+}
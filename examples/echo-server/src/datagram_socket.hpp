@@ -0,0 +1,173 @@
+#pragma once
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string_view>
+
+#include "socket.hpp"
+
+/*
+ * Callback type for received datagrams.
+ * The data is only valid until the callback returns.
+ */
+using DatagramCallback = std::function<void(std::string_view data, const sockaddr_in& from)>;
+
+/*
+ * UDP socket receiving and sending datagrams in batches, a single recvmmsg() or sendmmsg() per batch.
+ * Message headers, addresses and buffers are allocated once, each message on cache lines of its own.
+ * With GRO the kernel coalesces received datagrams of a flow into one buffer, with GSO consecutive
+ * datagrams to the same address are sent as one, callers only ever see single datagrams.
+ * Datagrams larger than the buffers are truncated.
+ * Not thread-safe, used from a single loop thread.
+ */
+class DatagramSocket {
+   public:
+    static constexpr size_t DEFAULT_BATCH_SIZE = 64;
+    static constexpr size_t DEFAULT_DATAGRAM_SIZE = 2048;
+
+    /*
+     * Largest UDP payload over IPv4, the size of a buffer holding coalesced datagrams.
+     */
+    static constexpr size_t MAX_COALESCED_SIZE = 65507;
+
+    /*
+     * Most datagrams the kernel splits a single GSO send into.
+     */
+    static constexpr size_t MAX_SEGMENTS = 64;
+
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+
+   private:
+    struct AlignedDelete {
+        void operator()(void* pointer) const noexcept;
+    };
+
+    template <typename T>
+    using AlignedArray = std::unique_ptr<T[], AlignedDelete>;
+
+    /*
+     * State of a message next to the header handed to the kernel.
+     */
+    struct alignas(CACHE_LINE_SIZE) Entry {
+        sockaddr_in address{};
+        iovec segment{};
+
+        /*
+         * GRO segment size reported by the kernel, or GSO segment size handed to it.
+         */
+        alignas(cmsghdr) std::array<char, CMSG_SPACE(sizeof(int))> control{};
+
+        /*
+         * Size and number of the datagrams a queued message holds.
+         */
+        uint16_t segment_size{0};
+        uint16_t segments{0};
+    };
+
+    /*
+     * Messages of a single direction, buffers are `buffer_size` apart.
+     */
+    struct Batch {
+        AlignedArray<mmsghdr> headers;
+        std::unique_ptr<Entry[]> entries;
+        AlignedArray<char> buffers;
+        size_t buffer_size{0};
+    };
+
+    Socket socket_;
+    size_t batch_size_;
+    size_t datagram_size_;
+    bool is_gro_{false};
+    bool is_gso_{false};
+
+    Batch receive_;
+    Batch send_;
+
+    /*
+     * Messages queued in the send batch, the ones before `first_unsent_` were sent already.
+     */
+    size_t first_unsent_{0};
+    size_t queued_messages_{0};
+    size_t queued_datagrams_{0};
+
+   public:
+    /*
+     * Take over a UDP socket, bound or connected by the caller, with room for `batch_size` datagrams
+     * of up to `datagram_size` bytes in each direction, at most `MAX_COALESCED_SIZE`.
+     * Throws `std::bad_alloc` on allocation failure.
+     */
+    explicit DatagramSocket(Socket&& socket, size_t batch_size = DEFAULT_BATCH_SIZE, size_t datagram_size = DEFAULT_DATAGRAM_SIZE);
+
+    /*
+     * Get the file descriptor associated with the socket.
+     */
+    [[nodiscard]] int fd() const noexcept;
+
+    /*
+     * Let the kernel coalesce received datagrams with UDP_GRO, growing the receive buffers to `MAX_COALESCED_SIZE`.
+     * Returns true on success, false on failure (check errno for details), `ENOTSUP` where unavailable.
+     * Throws `std::bad_alloc` on allocation failure.
+     */
+    bool enable_gro();
+
+    /*
+     * Send consecutive datagrams to the same address as one with UDP_SEGMENT,
+     * growing the send buffers to `MAX_COALESCED_SIZE`. Datagrams have to fit the path MTU then.
+     * Must be called while nothing is queued, fails with `EBUSY` otherwise.
+     * Returns true on success, false on failure (check errno for details), `ENOTSUP` where unavailable.
+     * Throws `std::bad_alloc` on allocation failure.
+     */
+    bool enable_gso();
+
+    /*
+     * Receive the waiting datagrams, a batch per recvmmsg() call, invoking the callback for each of them.
+     * Stops once the socket is drained or after `max_batches` batches, 0 for no limit, so a flood can't starve the loop.
+     * Returns the number of datagrams received, or -1 if none were received because of an error (check errno for details).
+     */
+    ssize_t receive(const DatagramCallback& callback, size_t max_batches = 4);
+
+    /*
+     * Queue a copy of a datagram to `to`, flushing the batch first if it's full.
+     * Returns true on success, false on failure (check errno for details).
+     * Fails with `EAGAIN` if the batch is full and the socket doesn't take it, `EMSGSIZE` if the datagram is too large.
+     */
+    bool send(std::string_view data, const sockaddr_in& to) noexcept;
+
+    /*
+     * Send the queued datagrams with sendmmsg(), as many as the socket takes.
+     * Returns true if all of them were sent, false on failure (check errno for details).
+     * With `EAGAIN` the rest stay queued for the next flush, e.g. once the socket is writable,
+     * on other failures the message that failed is dropped.
+     */
+    bool flush() noexcept;
+
+    /*
+     * Get the number of datagrams queued and not sent yet.
+     */
+    [[nodiscard]] size_t queued() const noexcept;
+
+   private:
+    /*
+     * Allocate a batch with buffers of `buffer_size` bytes, headers pointing at their entries.
+     * Throws `std::bad_alloc` on allocation failure.
+     */
+    Batch make_batch(size_t buffer_size) const;
+
+    /*
+     * Reset what the kernel changed in a receive header.
+     */
+    void reset_received(size_t index) noexcept;
+
+    /*
+     * Check if a datagram can be appended to the last queued message, to be split again by GSO.
+     */
+    [[nodiscard]] bool can_coalesce(const Entry& entry, size_t size, const sockaddr_in& to) const noexcept;
+};
@@ -1,13 +1,17 @@
 #include <csignal>
+#include <cstddef>
 #include <cstdlib>
 #include <iostream>
-#include <string>
+#include <string_view>
 
 #include "tcp_server.hpp"
 
 static constexpr int SERVER_PORT = 8080;
 
-static TcpServer server(SERVER_PORT);
+// One loop per core, each accepting on its own SO_REUSEPORT listener
+static constexpr size_t SERVER_LOOPS = 0;
+
+static TcpServer server(SERVER_PORT, SERVER_LOOPS, AcceptMode::REUSE_PORT);
 
 void shutdown_handler(int) {
     server.close();
@@ -19,11 +23,13 @@ int main() {
     std::signal(SIGTERM, shutdown_handler);
 
     std::cout << "Server starting on port " << SERVER_PORT << '\n';
-    server.start([](const auto& client) {
-        client->write("Hello, World!\n");
+    server.start([](Client& client) {
+        client.write_borrowed("Hello, World!\n");
 
-        client->on_read([](const auto& client, const std::string& data) {
-            client->write("Echo: " + data);
+        client.on_read([](Client& client, std::string_view data) {
+            // Both parts go out with a single writev() once the callback returns
+            client.write_borrowed("Echo: ");
+            client.write(data);
         });
     });
 
@@ -0,0 +1,38 @@
+#include "read_buffer.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+
+ReadBuffer::ReadBuffer() : bytes_(std::make_unique_for_overwrite<char[]>(MIN_SIZE)), size_(MIN_SIZE) {}
+
+char* ReadBuffer::data() noexcept {
+    return bytes_.get();
+}
+
+size_t ReadBuffer::size() const noexcept {
+    return size_;
+}
+
+void ReadBuffer::record(size_t bytes_read) {
+    // A full read means more is likely waiting, take it in fewer reads
+    if (bytes_read == size_) {
+        small_reads_ = 0;
+        if (size_ < MAX_SIZE) resize(std::min(size_ * 2, MAX_SIZE));
+        return;
+    }
+
+    if (bytes_read > size_ / 4) {
+        small_reads_ = 0;
+        return;
+    }
+    if (++small_reads_ >= SHRINK_AFTER && size_ > MIN_SIZE) {
+        small_reads_ = 0;
+        resize(std::max(size_ / 2, MIN_SIZE));
+    }
+}
+
+void ReadBuffer::resize(size_t size) {
+    bytes_ = std::make_unique_for_overwrite<char[]>(size);
+    size_ = size;
+}
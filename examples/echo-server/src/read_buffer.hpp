@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+
+/*
+ * Buffer data is read into, sized after the reads it observes.
+ * Grows while reads fill it and shrinks back once they keep using a small part of it,
+ * so idle connections stay small and busy ones need few reads per burst.
+ */
+class ReadBuffer {
+   public:
+    static constexpr size_t MIN_SIZE = 2048;
+    static constexpr size_t MAX_SIZE = 65536;
+
+    /*
+     * Number of consecutive reads using at most a quarter of the buffer before it shrinks.
+     */
+    static constexpr size_t SHRINK_AFTER = 8;
+
+   private:
+    std::unique_ptr<char[]> bytes_;
+    size_t size_;
+
+    /*
+     * Consecutive reads using at most a quarter of the buffer.
+     */
+    size_t small_reads_{0};
+
+   public:
+    /*
+     * Throws `std::bad_alloc` on allocation failure.
+     */
+    ReadBuffer();
+
+    /*
+     * Get the storage to read into, valid until the next call to record().
+     */
+    [[nodiscard]] char* data() noexcept;
+
+    /*
+     * Get the number of bytes a read may take.
+     */
+    [[nodiscard]] size_t size() const noexcept;
+
+    /*
+     * Account for a read of `bytes_read` bytes, resizing the buffer if it's too small or too large.
+     * Data read before is gone once it's resized.
+     * Throws `std::bad_alloc` on allocation failure.
+     */
+    void record(size_t bytes_read);
+
+   private:
+    void resize(size_t size);
+};
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+/*
+ * Pool of objects allocated in slabs, reusing the slots of released objects.
+ * Objects never move, so their addresses can be handed out, e.g. as FdHandlers.
+ * Slots are identified by handles carrying a generation, which goes stale once the slot is released,
+ * so a handle kept past the lifetime of its object finds nothing instead of a newer object.
+ * Not thread-safe.
+ */
+template <typename T, size_t SLAB_SIZE = 64>
+class SlabPool {
+   public:
+    /*
+     * Identifies an object of the pool, checked against the generation of its slot.
+     */
+    struct Handle {
+        uint32_t index{UINT32_MAX};
+        uint32_t generation{0};
+
+        bool operator==(const Handle&) const noexcept = default;
+    };
+
+   private:
+    static constexpr uint32_t NO_SLOT = UINT32_MAX;
+
+    struct Slot {
+        alignas(T) std::byte storage[sizeof(T)];
+
+        /*
+         * Bumped when the object is released, invalidating its handles.
+         */
+        uint32_t generation{0};
+        bool is_live{false};
+
+        /*
+         * Next free slot while this one is free.
+         */
+        uint32_t next_free{NO_SLOT};
+
+        T* object() noexcept {
+            return std::launder(reinterpret_cast<T*>(storage));
+        }
+    };
+
+    std::vector<std::unique_ptr<Slot[]>> slabs_;
+
+    /*
+     * Head of the list of free slots, most recently released first.
+     */
+    uint32_t free_head_{NO_SLOT};
+
+    /*
+     * Number of slots ever used, the ones past it are free and not linked yet.
+     */
+    uint32_t used_{0};
+
+    size_t size_{0};
+
+   public:
+    SlabPool() = default;
+
+    ~SlabPool() noexcept {
+        clear();
+    }
+
+    SlabPool(const SlabPool&) = delete;
+    SlabPool& operator=(const SlabPool&) = delete;
+    SlabPool(SlabPool&& other) noexcept
+        : slabs_(std::move(other.slabs_)),
+          free_head_(std::exchange(other.free_head_, NO_SLOT)),
+          used_(std::exchange(other.used_, 0)),
+          size_(std::exchange(other.size_, 0)) {}
+    SlabPool& operator=(SlabPool&&) = delete;
+
+    /*
+     * Get the handle the next call to emplace() returns, e.g. for an object to know its own.
+     */
+    [[nodiscard]] Handle next_handle() const noexcept {
+        uint32_t index = free_head_ != NO_SLOT ? free_head_ : used_;
+        return {index, index < used_ ? slot(index).generation : 0};
+    }
+
+    /*
+     * Construct an object in a free slot, allocating a new slab if there's none.
+     * Returns the object's handle.
+     * Throws `std::bad_alloc` on allocation failure, or what the constructor throws.
+     */
+    template <typename... Args>
+    Handle emplace(Args&&... args) {
+        if (free_head_ == NO_SLOT && used_ == slabs_.size() * SLAB_SIZE) {
+            slabs_.push_back(std::make_unique<Slot[]>(SLAB_SIZE));
+        }
+
+        uint32_t index = free_head_ != NO_SLOT ? free_head_ : used_;
+        Slot& target = slot(index);
+        ::new (static_cast<void*>(target.storage)) T(std::forward<Args>(args)...);
+        target.is_live = true;
+
+        if (index == free_head_) {
+            free_head_ = target.next_free;
+        } else {
+            ++used_;
+        }
+        ++size_;
+        return {index, target.generation};
+    }
+
+    /*
+     * Get the object of a handle, or nullptr if it was released.
+     */
+    [[nodiscard]] T* get(Handle handle) noexcept {
+        if (handle.index >= used_) return nullptr;
+
+        Slot& target = slot(handle.index);
+        if (!target.is_live || target.generation != handle.generation) return nullptr;
+        return target.object();
+    }
+
+    /*
+     * Destroy the object of a handle and free its slot.
+     * Returns false if it was released already.
+     */
+    bool release(Handle handle) noexcept {
+        if (get(handle) == nullptr) return false;
+
+        Slot& target = slot(handle.index);
+        target.object()->~T();
+        target.is_live = false;
+        ++target.generation;
+        target.next_free = free_head_;
+        free_head_ = handle.index;
+        --size_;
+        return true;
+    }
+
+    /*
+     * Invoke the function with every live object.
+     * The function must not emplace or release objects.
+     */
+    template <typename F>
+    void for_each(F&& function) {
+        for (uint32_t i = 0; i < used_; ++i) {
+            Slot& target = slot(i);
+            if (target.is_live) function(*target.object());
+        }
+    }
+
+    /*
+     * Destroy every live object, keeping the slabs for reuse.
+     */
+    void clear() noexcept {
+        for (uint32_t i = 0; i < used_; ++i) {
+            if (slot(i).is_live) release({i, slot(i).generation});
+        }
+    }
+
+    /*
+     * Get the number of live objects.
+     */
+    [[nodiscard]] size_t size() const noexcept {
+        return size_;
+    }
+
+    /*
+     * Get the number of slabs allocated so far.
+     */
+    [[nodiscard]] size_t slab_count() const noexcept {
+        return slabs_.size();
+    }
+
+   private:
+    Slot& slot(uint32_t index) noexcept {
+        return slabs_[index / SLAB_SIZE][index % SLAB_SIZE];
+    }
+
+    const Slot& slot(uint32_t index) const noexcept {
+        return slabs_[index / SLAB_SIZE][index % SLAB_SIZE];
+    }
+};
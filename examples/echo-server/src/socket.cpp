@@ -2,11 +2,15 @@
 
 #include <asm-generic/socket.h>
 #include <fcntl.h>
+#include <linux/filter.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
+#include <array>
+#include <cerrno>
 #include <cstddef>
 #include <stdexcept>
 
@@ -52,17 +56,47 @@ bool Socket::set_reuse_addr() noexcept {
     return setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &value, sizeof(value)) != -1;
 }
 
+bool Socket::set_reuse_port() noexcept {
+    int value = 1;
+    return setsockopt(fd_, SOL_SOCKET, SO_REUSEPORT, &value, sizeof(value)) != -1;
+}
+
+bool Socket::set_incoming_cpu([[maybe_unused]] int cpu) noexcept {
+#ifdef SO_INCOMING_CPU
+    return setsockopt(fd_, SOL_SOCKET, SO_INCOMING_CPU, &cpu, sizeof(cpu)) != -1;
+#else
+    errno = ENOTSUP;
+    return false;
+#endif
+}
+
+bool Socket::attach_cpu_steering([[maybe_unused]] unsigned group_size) noexcept {
+#ifdef SO_ATTACH_REUSEPORT_CBPF
+    // Load the current CPU, reduce it to a listener index and return it
+    std::array<sock_filter, 3> code{{
+        {BPF_LD | BPF_W | BPF_ABS, 0, 0, static_cast<__u32>(SKF_AD_OFF + SKF_AD_CPU)},
+        {BPF_ALU | BPF_MOD | BPF_K, 0, 0, group_size},
+        {BPF_RET | BPF_A, 0, 0, 0},
+    }};
+    sock_fprog program{static_cast<unsigned short>(code.size()), code.data()};
+    return setsockopt(fd_, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &program, sizeof(program)) != -1;
+#else
+    errno = ENOTSUP;
+    return false;
+#endif
+}
+
 bool Socket::bind(const sockaddr_in& addr) noexcept {
     return ::bind(fd_, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != -1;
 }
 
-bool Socket::listen() noexcept {
-    return ::listen(fd_, SOMAXCONN) != -1;
+bool Socket::listen(int backlog) noexcept {
+    return ::listen(fd_, backlog) != -1;
 }
 
 int Socket::accept(sockaddr_in& addr) noexcept {
     socklen_t len = sizeof(addr);
-    int cfd = ::accept(fd_, reinterpret_cast<sockaddr*>(&addr), &len);
+    int cfd = ::accept4(fd_, reinterpret_cast<sockaddr*>(&addr), &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
     return cfd;
 }
 
@@ -74,7 +108,16 @@ ssize_t Socket::write(const void* buf, size_t size) noexcept {
     return ::write(fd_, buf, size);
 }
 
+ssize_t Socket::writev(const iovec* segments, int count) noexcept {
+    return ::writev(fd_, segments, count);
+}
+
 Socket Socket::create_tcp_socket() {
     int new_fd = ::socket(AF_INET, SOCK_STREAM, 0);
     return Socket(new_fd);
 }
+
+Socket Socket::create_udp_socket() {
+    int new_fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    return Socket(new_fd);
+}
@@ -1,7 +1,9 @@
 #pragma once
 
 #include <netinet/in.h>
+#include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 
 #include <cstddef>
 
@@ -39,6 +41,28 @@ class Socket {
      */
     bool set_reuse_addr() noexcept;
 
+    /*
+     * Enable SO_REUSEPORT on the socket, so several sockets can listen on the same port.
+     * The kernel spreads incoming connections across them.
+     * Returns true on success, false on failure (check errno for details).
+     */
+    bool set_reuse_port() noexcept;
+
+    /*
+     * Prefer connections handled by the CPU with SO_INCOMING_CPU.
+     * Only effective with SO_REUSEPORT, fails with `ENOTSUP` where unavailable.
+     * Returns true on success, false on failure (check errno for details).
+     */
+    bool set_incoming_cpu(int cpu) noexcept;
+
+    /*
+     * Attach a classic BPF program to the SO_REUSEPORT group of the socket,
+     * picking the listener at index `cpu % group_size` for connections handled by `cpu`.
+     * Must be called after bind(), fails with `ENOTSUP` where unavailable.
+     * Returns true on success, false on failure (check errno for details).
+     */
+    bool attach_cpu_steering(unsigned group_size) noexcept;
+
     /*
      * Bind the socket to a local address.
      * Returns true on success, false on failure (check errno for details).
@@ -46,13 +70,14 @@ class Socket {
     bool bind(const sockaddr_in& addr) noexcept;
 
     /*
-     * Put the socket in a listening state.
+     * Put the socket in a listening state, queueing up to `backlog` connections not accepted yet.
+     * The kernel caps the backlog at `net.core.somaxconn`.
      * Returns true on success, false on failure (check errno for details).
      */
-    bool listen() noexcept;
+    bool listen(int backlog = SOMAXCONN) noexcept;
 
     /*
-     * Accept a new incoming connection.
+     * Accept a new incoming connection, non-blocking and closed on exec from the start.
      * Returns the file descriptor for the accepted socket, or -1 on error (check errno for details).
      */
     int accept(sockaddr_in& addr) noexcept;
@@ -69,10 +94,23 @@ class Socket {
      */
     ssize_t write(const void* buf, size_t size) noexcept;
 
+    /*
+     * Write data gathered from several buffers to the socket, in order.
+     * Returns the number of bytes written, or -1 on error (check errno for details).
+     */
+    ssize_t writev(const iovec* segments, int count) noexcept;
+
     /*
      * Create a TCP socket.
      * Returns a Socket object for the new socket.
      * Throws `std::runtime_error` on failure.
      */
     static Socket create_tcp_socket();
+
+    /*
+     * Create a UDP socket, non-blocking and closed on exec from the start.
+     * Returns a Socket object for the new socket.
+     * Throws `std::runtime_error` on failure.
+     */
+    static Socket create_udp_socket();
 };
@@ -2,23 +2,109 @@
 
 #include <netinet/in.h>
 #include <sys/socket.h>
+#include <unistd.h>
 
 #include <cerrno>
+#include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <span>
 #include <system_error>
 #include <utility>
+#include <vector>
 
 #include "client.hpp"
 #include "loopp/event_loop.hpp"
 #include "socket.hpp"
 
-TcpServer::TcpServer(int port) : socket_(Socket::create_tcp_socket()) {
-    if (!socket_.set_reuse_addr()) {
+TcpServer::TcpServer(int port, size_t loop_count, AcceptMode mode) : loops_(loop_count), mode_(mode) {
+    workers_.resize(loops_.size());
+    handoffs_.resize(loops_.size());
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        workers_[i].loop = loops_.loop(i);
+    }
+
+    // Every loop listens on the port, or only the first one does
+    if (mode_ == AcceptMode::REUSE_PORT) {
+        for (Worker& worker : workers_) {
+            worker.listener.emplace(create_listener(port, true));
+        }
+    } else {
+        workers_.front().listener.emplace(create_listener(port, false));
+    }
+}
+
+void TcpServer::on_listener(const ListenerSetup& setup) {
+    listener_setup_ = setup;
+}
+
+void TcpServer::set_accept_limit(size_t limit) noexcept {
+    accept_limit_ = limit;
+}
+
+void TcpServer::set_backlog(int backlog) noexcept {
+    backlog_ = backlog;
+}
+
+void TcpServer::start(const NewClientCallback& new_client_callback) {
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        Worker& worker = workers_[i];
+        if (!worker.listener) continue;
+
+        if (listener_setup_ && !listener_setup_(*worker.listener, i, workers_.size(), loops_.cpu(i))) {
+            throw std::system_error(errno, std::system_category(), "Failed to set up listening socket");
+        }
+
+        if (!worker.listener->listen(backlog_)) {
+            throw std::system_error(errno, std::system_category(), "Failed to listen on socket");
+        }
+
+        // Register listening socket for reading
+        auto callback = [this, &worker, new_client_callback](int, loopp::EventType) {
+            accept_clients(worker, new_client_callback);
+        };
+        if (!worker.loop->add_fd(worker.listener->fd(), loopp::EventType::READ, callback)) {
+            throw std::system_error(errno, std::system_category(), "Failed to add server socket to event loop");
+        }
+    }
+
+    loops_.start();
+    try {
+        loops_.join();
+    } catch (...) {
+        close_clients();
+        throw;
+    }
+    close_clients();
+}
+
+Client* TcpServer::find_client(ClientHandle handle) noexcept {
+    if (handle.worker >= workers_.size()) return nullptr;
+    return workers_[handle.worker].clients.get({handle.index, handle.generation});
+}
+
+bool TcpServer::close() noexcept {
+    return loops_.stop();
+}
+
+bool TcpServer::steer_by_cpu(Socket& socket, size_t index, size_t count, int cpu) {
+    if (cpu != -1 && !socket.set_incoming_cpu(cpu)) return false;
+
+    // The program applies to the whole group, attach it once
+    return index != 0 || socket.attach_cpu_steering(static_cast<unsigned>(count));
+}
+
+Socket TcpServer::create_listener(int port, bool reuse_port) {
+    Socket socket = Socket::create_tcp_socket();
+    if (!socket.set_reuse_addr()) {
         throw std::system_error(errno, std::system_category(), "Failed to set SO_REUSEADDR");
     }
 
-    if (!socket_.set_nonblocking()) {
+    if (reuse_port && !socket.set_reuse_port()) {
+        throw std::system_error(errno, std::system_category(), "Failed to set SO_REUSEPORT");
+    }
+
+    if (!socket.set_nonblocking()) {
         throw std::system_error(errno, std::system_category(), "Failed to set non-blocking");
     }
 
@@ -27,61 +113,99 @@ TcpServer::TcpServer(int port) : socket_(Socket::create_tcp_socket()) {
     addr.sin_port = htons(static_cast<uint16_t>(port));
     addr.sin_addr.s_addr = htonl(INADDR_ANY);
 
-    if (!socket_.bind(addr)) {
+    if (!socket.bind(addr)) {
         throw std::system_error(errno, std::system_category(), "Failed to bind socket");
     }
+    return socket;
 }
 
-void TcpServer::start(const NewClientCallback& new_client_callback) {
-    if (!socket_.listen()) {
-        throw std::system_error(errno, std::system_category(), "Failed to listen on socket");
-    }
-
-    auto callback = [this, new_client_callback](int, loopp::EventType) {
+void TcpServer::accept_clients(Worker& worker, const NewClientCallback& new_client_callback) {
+    // Drain the backlog, connections for this worker are kept in its own handoff list
+    size_t worker_index = static_cast<size_t>(&worker - workers_.data());
+    for (size_t accepted = 0; accept_limit_ == 0 || accepted < accept_limit_; ++accepted) {
         sockaddr_in addr{};
-        int cfd = socket_.accept(addr);
+        int cfd = worker.listener->accept(addr);
         if (cfd == -1) {
-            return;  // Either no pending connections or an error occurred
+            break;  // Either no pending connections or an error occurred
         }
 
-        auto client = connect_client(Socket(cfd));
-        new_client_callback(client);
-    };
-
-    // Register main socket for reading
-    if (!loop_->add_fd(socket_.fd(), loopp::EventType::READ, callback)) {
-        throw std::system_error(errno, std::system_category(), "Failed to add server socket to event loop");
+        // Serve it here, or pick the next worker in round-robin mode
+        size_t target = mode_ == AcceptMode::ROUND_ROBIN ? next_worker_++ % workers_.size() : worker_index;
+        handoffs_[target].push_back(cfd);
     }
 
-    loop_->start();
-}
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        std::vector<int>& fds = handoffs_[i];
+        if (fds.empty()) continue;
 
-bool TcpServer::close() noexcept {
-    bool success = true;
+        if (i == worker_index) {
+            serve_clients(worker, fds, new_client_callback);
+            fds.clear();
+            continue;
+        }
 
-    // Close all active client connections
-    for (auto& client : clients_) {
-        success &= client->close();
+        // Hand the connections over to the worker's loop thread, all with a single task
+        Worker& target = workers_[i];
+        auto task = [this, &target, fds, new_client_callback] {
+            serve_clients(target, fds, new_client_callback);
+        };
+        if (!target.loop->post(task)) {
+            for (int fd : fds) ::close(fd);
+        }
+        fds.clear();
     }
-
-    success &= loop_->stop();
-    return success;
 }
 
-std::shared_ptr<Client> TcpServer::connect_client(Socket&& socket) {
-    auto client = std::make_shared<Client>(std::move(socket), loop_);
-    clients_.insert(client);
+void TcpServer::serve_clients(Worker& worker, std::span<const int> fds, const NewClientCallback& new_client_callback) {
+    worker.accepted.clear();
+    worker.registrations.clear();
+    for (int fd : fds) {
+        Client& client = connect_client(worker, Socket(fd));
+        worker.accepted.push_back(&client);
+        worker.registrations.push_back(client.registration());
+    }
 
-    client->on_disconnect([this](const auto& client) {
-        on_disconnect_client(client);
+    if (!worker.loop->add_fds(worker.registrations)) {
+        throw std::system_error(errno, std::system_category(), "Failed to start clients");
+    }
+    for (Client* client : worker.accepted) {
+        new_client_callback(*client);
+    }
+}
+
+Client& TcpServer::connect_client(Worker& worker, Socket&& socket) {
+    auto worker_index = static_cast<uint32_t>(&worker - workers_.data());
+    auto slot = worker.clients.next_handle();
+    worker.clients.emplace(ClientHandle{worker_index, slot.index, slot.generation}, std::move(socket), *worker.loop);
+    Client& client = *worker.clients.get(slot);
+
+    client.on_disconnect([&worker](Client& client) {
+        // It may still be handling the event, destroy it once the loop is done with it
+        ClientHandle handle = client.handle();
+        worker.disconnected.push_back({handle.index, handle.generation});
+        if (!worker.is_release_pending) {
+            // On failure the next disconnect tries again, until then the clients stay around
+            worker.is_release_pending = worker.loop->post([&worker] { release_disconnected(worker); });
+        }
     });
+    return client;
+}
 
-    if (!client->start()) {
-        throw std::system_error(errno, std::system_category(), "Failed to start client");
+void TcpServer::release_disconnected(Worker& worker) noexcept {
+    for (auto handle : worker.disconnected) {
+        worker.clients.release(handle);
     }
-    return client;
+    worker.disconnected.clear();
+    worker.is_release_pending = false;
 }
 
-void TcpServer::on_disconnect_client(const std::shared_ptr<Client>& client) noexcept {
-    clients_.erase(client);
+void TcpServer::close_clients() noexcept {
+    for (Worker& worker : workers_) {
+        worker.clients.for_each([](Client& client) {
+            client.close();
+        });
+        worker.clients.clear();
+        worker.disconnected.clear();
+        worker.is_release_pending = false;
+    }
 }
@@ -1,42 +1,129 @@
 #pragma once
 
+#include <sys/socket.h>
+
+#include <cstddef>
 #include <functional>
 #include <memory>
-#include <unordered_set>
+#include <optional>
+#include <span>
+#include <vector>
 
 #include "client.hpp"
 #include "loopp/event_loop.hpp"
+#include "loopp/loop_group.hpp"
+#include "slab_pool.hpp"
 #include "socket.hpp"
 
 /*
  * Callback type for new client connections.
+ * Invoked on the loop thread the client is served by.
+ */
+using NewClientCallback = std::function<void(Client& client)>;
+
+/*
+ * Callback type for configuring a listening socket before it starts listening.
+ * Receives the index of the loop accepting on it out of `count`, and the core that loop is pinned to, -1 if none.
+ * Returns true on success, false on failure (check errno for details).
  */
-using NewClientCallback = std::function<void(std::shared_ptr<Client> client)>;
+using ListenerSetup = std::function<bool(Socket& socket, size_t index, size_t count, int cpu)>;
+
+/*
+ * How accepted connections are spread across the loops.
+ */
+enum class AcceptMode {
+    /*
+     * Every loop accepts on its own SO_REUSEPORT listener and serves what it accepts.
+     */
+    REUSE_PORT,
+
+    /*
+     * The first loop accepts on a single listener and hands connections out round-robin.
+     */
+    ROUND_ROBIN
+};
 
 /*
  * Simple TCP server that accepts incoming connections and manages connected clients.
+ * Runs one event loop per core, each client is served by a single loop for its whole lifetime.
  */
 class TcpServer {
    private:
     /*
-     * The server's listening socket.
+     * A loop with its listening socket, if it accepts, and the clients it serves.
      */
-    Socket socket_;
+    struct Worker {
+        std::shared_ptr<loopp::EventLoop> loop;
+        std::optional<Socket> listener;
+
+        /*
+         * The clients served by the loop, only accessed on its thread while running.
+         * Pooled, so connection churn reuses their slots instead of allocating.
+         */
+        SlabPool<Client> clients;
+
+        /*
+         * Clients that disconnected, destroyed by a task once the loop is done with their events.
+         */
+        std::vector<SlabPool<Client>::Handle> disconnected;
+
+        /*
+         * Set while a task releasing the disconnected clients is posted, cleared once it ran or posting failed.
+         */
+        bool is_release_pending{false};
+
+        /*
+         * Clients accepted by the current batch and their registrations, reused across batches.
+         */
+        std::vector<Client*> accepted;
+        std::vector<loopp::HandlerRegistration> registrations;
+    };
 
     /*
-     * The event loop for handling asynchronous events.
+     * The event loops for handling asynchronous events, one thread each.
      * Passed to clients to handle their events.
      */
-    std::shared_ptr<loopp::EventLoop> loop_{loopp::EventLoop::create()};
+    loopp::LoopGroup loops_;
+
+    AcceptMode mode_;
+
+    /*
+     * Worker of every loop, index is the loop index.
+     */
+    std::vector<Worker> workers_;
+
+    /*
+     * Index of the worker the next connection is handed to in round-robin mode.
+     * Only accessed by the accepting loop.
+     */
+    size_t next_worker_{0};
+
+    ListenerSetup listener_setup_;
+
+    /*
+     * Maximum number of connections accepted per readiness event of a listener.
+     */
+    size_t accept_limit_{DEFAULT_ACCEPT_LIMIT};
 
     /*
-     * A set of active clients connected to the server.
-     * Used to ensure ownership and manage client lifetimes.
+     * Connections the kernel queues per listener until they're accepted.
      */
-    std::unordered_set<std::shared_ptr<Client>> clients_;
+    int backlog_{SOMAXCONN};
+
+    /*
+     * Connections accepted in round-robin mode, waiting to be handed to each worker.
+     * Only accessed by the accepting loop.
+     */
+    std::vector<std::vector<int>> handoffs_;
 
    public:
-    explicit TcpServer(int port);
+    static constexpr size_t DEFAULT_ACCEPT_LIMIT = 64;
+
+    /*
+     * Bind to the port with `loop_count` loops, one per core if 0.
+     * Throws `std::system_error` on failure.
+     */
+    explicit TcpServer(int port, size_t loop_count = 1, AcceptMode mode = AcceptMode::REUSE_PORT);
     ~TcpServer() noexcept = default;
 
     TcpServer(const TcpServer&) = delete;
@@ -45,29 +132,90 @@ class TcpServer {
     TcpServer& operator=(TcpServer&&) = delete;
 
     /*
-     * Start the TCP server.
+     * Set a hook configuring every listening socket when the server starts, e.g. for steering.
+     */
+    void on_listener(const ListenerSetup& setup);
+
+    /*
+     * Set the maximum number of connections accepted per readiness event, 0 for no limit.
+     * The rest are accepted on the next iteration, so a connection storm can't starve the clients.
+     * Must be called before start().
+     */
+    void set_accept_limit(size_t limit) noexcept;
+
+    /*
+     * Set the listen backlog of every listener, `SOMAXCONN` by default.
+     * Must be called before start().
+     */
+    void set_backlog(int backlog) noexcept;
+
+    /*
+     * Start the TCP server, blocking until it's closed.
+     * Client connections are closed once all loops stopped.
      * Throws `std::system_error` on failure.
      */
     void start(const NewClientCallback& callback);
 
     /*
-     * Stop the TCP server if it is running.
-     * Closes all client connections and stops the event loop.
+     * Get the client of a handle, or nullptr if it's gone.
+     * Must be called on the loop thread serving the client.
+     */
+    [[nodiscard]] Client* find_client(ClientHandle handle) noexcept;
+
+    /*
+     * Stop the TCP server if it is running, callable from any thread.
+     * Stops the event loops, start() closes the client connections afterwards.
      * Returns true on success, false on failure (check errno for details).
      * If the server is not running, it's a no-op and returns true.
      */
     bool close() noexcept;
 
+    /*
+     * Listener setup steering connections to the listener of the loop pinned to the core handling them.
+     * Keeps a connection on one core from the interrupt to the callbacks,
+     * needs reuse-port mode with loops pinned to the first cores in order.
+     */
+    static bool steer_by_cpu(Socket& socket, size_t index, size_t count, int cpu);
+
    private:
     /*
-     * Adds a new client to the server, keeping it alive.
-     * Returns a shared_ptr to the new client.
+     * Create a non-blocking socket bound to the port.
+     * Throws `std::system_error` on failure.
+     */
+    static Socket create_listener(int port, bool reuse_port);
+
+    /*
+     * Accept the pending connections on the worker's listener, up to the accept limit,
+     * serving them or handing them out.
+     * Throws `std::system_error` on failure.
+     */
+    void accept_clients(Worker& worker, const NewClientCallback& callback);
+
+    /*
+     * Serve accepted connections on the worker, registering all of them at once.
+     * Calls the callback for each of them once registered.
+     * Must be called on the worker's loop thread.
      * Throws `std::system_error` on failure.
      */
-    std::shared_ptr<Client> connect_client(Socket&& socket);
+    void serve_clients(Worker& worker, std::span<const int> fds, const NewClientCallback& callback);
+
+    /*
+     * Adds a new client to the worker's pool, keeping it alive until it disconnects.
+     * Returns the new client, not registered with the loop yet.
+     * Must be called on the worker's loop thread.
+     * Throws `std::bad_alloc` on allocation failure.
+     */
+    Client& connect_client(Worker& worker, Socket&& socket);
+
+    /*
+     * Destroy the clients of the worker that disconnected.
+     * Must be called on the worker's loop thread.
+     */
+    static void release_disconnected(Worker& worker) noexcept;
 
     /*
-     * Called when a client disconnects.
+     * Close and drop the clients of every worker.
+     * Must be called while no loop is running.
      */
-    void on_disconnect_client(const std::shared_ptr<Client>& client) noexcept;
+    void close_clients() noexcept;
 };
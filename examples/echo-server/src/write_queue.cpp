@@ -0,0 +1,137 @@
+#include "write_queue.hpp"
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "socket.hpp"
+
+void WriteQueue::append(std::string_view data) {
+    if (data.empty()) return;
+
+    // Too large to pack, copy it into a buffer of its own
+    if (data.size() > CHUNK_SIZE) {
+        append(std::string(data));
+        return;
+    }
+
+    while (!data.empty()) {
+        Chunk& chunk = writable_chunk();
+        size_t size = std::min(data.size(), CHUNK_SIZE - chunk.used);
+        char* destination = chunk.bytes.data() + chunk.used;
+        std::memcpy(destination, data.data(), size);
+        chunk.used += size;
+        size_ += size;
+        data.remove_prefix(size);
+
+        // Extend the last slice if it ends right where the copy went
+        if (!slices_.empty()) {
+            Slice& last = slices_.back();
+            if (last.chunk == &chunk && last.data + last.size == destination) {
+                last.size += size;
+                continue;
+            }
+        }
+        ++chunk.refs;
+        slices_.push_back({destination, size, nullptr, &chunk});
+    }
+}
+
+void WriteQueue::append(std::string&& data) {
+    if (data.empty()) return;
+    append(std::make_shared<const std::string>(std::move(data)));
+}
+
+void WriteQueue::append(std::shared_ptr<const std::string> data) {
+    if (data == nullptr || data->empty()) return;
+
+    const char* bytes = data->data();
+    size_t size = data->size();
+    size_ += size;
+    slices_.push_back({bytes, size, std::move(data), nullptr});
+}
+
+void WriteQueue::append_borrowed(std::string_view data) {
+    if (data.empty()) return;
+
+    size_ += data.size();
+    slices_.push_back({data.data(), data.size(), nullptr, nullptr});
+}
+
+bool WriteQueue::empty() const noexcept {
+    return size_ == 0;
+}
+
+size_t WriteQueue::size() const noexcept {
+    return size_;
+}
+
+ssize_t WriteQueue::write_to(Socket& socket) noexcept {
+    size_t total = 0;
+    while (!slices_.empty()) {
+        std::array<iovec, MAX_SEGMENTS> segments;
+        size_t count = std::min(slices_.size(), MAX_SEGMENTS);
+        size_t requested = 0;
+        for (size_t i = 0; i < count; ++i) {
+            segments[i] = {const_cast<char*>(slices_[i].data), slices_[i].size};
+            requested += slices_[i].size;
+        }
+
+        ssize_t written = socket.writev(segments.data(), static_cast<int>(count));
+        if (written < 0) {
+            if (total > 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            return -1;
+        }
+        consume(static_cast<size_t>(written));
+        total += static_cast<size_t>(written);
+
+        // A short write means the socket buffer is full
+        if (static_cast<size_t>(written) < requested) break;
+    }
+    return static_cast<ssize_t>(total);
+}
+
+void WriteQueue::consume(size_t size) noexcept {
+    size_ -= size;
+    while (size > 0) {
+        Slice& slice = slices_.front();
+        if (size < slice.size) {
+            slice.data += size;
+            slice.size -= size;
+            return;
+        }
+        size -= slice.size;
+
+        // Return chunks nothing points into anymore to the pool
+        if (Chunk* chunk = slice.chunk; chunk != nullptr && --chunk->refs == 0) {
+            auto it = std::ranges::find_if(used_chunks_, [chunk](const auto& used) { return used.get() == chunk; });
+            chunk->used = 0;
+            free_chunks_.push_back(std::move(*it));
+            used_chunks_.erase(it);
+        }
+        slices_.pop_front();
+    }
+}
+
+WriteQueue::Chunk& WriteQueue::writable_chunk() {
+    if (!used_chunks_.empty() && used_chunks_.back()->used < CHUNK_SIZE) {
+        return *used_chunks_.back();
+    }
+
+    if (free_chunks_.empty()) {
+        used_chunks_.push_back(std::make_unique<Chunk>());
+    } else {
+        used_chunks_.push_back(std::move(free_chunks_.back()));
+        free_chunks_.pop_back();
+    }
+    return *used_chunks_.back();
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <array>
+#include <climits>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "socket.hpp"
+
+/*
+ * Queue of data waiting to be written to a socket, sent with scatter-gather writes.
+ * Data is kept as a chain of slices, so sending a part of it never moves the rest.
+ * Slices either borrow the caller's buffer, share ownership of it, or point into pooled chunks
+ * for small copies, so steady state writes don't allocate.
+ */
+class WriteQueue {
+   public:
+    /*
+     * Size of the pooled chunks small copies are packed into.
+     * Larger copies get a buffer of their own.
+     */
+    static constexpr size_t CHUNK_SIZE = 4096;
+
+    /*
+     * Maximum number of slices handed to a single writev() call.
+     */
+    static constexpr size_t MAX_SEGMENTS = IOV_MAX;
+
+   private:
+    /*
+     * Pooled storage for copied data, referenced by the slices pointing into it.
+     */
+    struct Chunk {
+        std::array<char, CHUNK_SIZE> bytes;
+        size_t used{0};
+        size_t refs{0};
+    };
+
+    /*
+     * A contiguous part of the queued data.
+     * Kept alive by its owner or chunk, if any, borrowed data is kept alive by the caller.
+     */
+    struct Slice {
+        const char* data;
+        size_t size;
+        std::shared_ptr<const void> owner;
+        Chunk* chunk;
+    };
+
+    std::deque<Slice> slices_;
+
+    /*
+     * Total number of bytes queued.
+     */
+    size_t size_{0};
+
+    /*
+     * Chunks not referenced by any slice, ready for reuse.
+     */
+    std::vector<std::unique_ptr<Chunk>> free_chunks_;
+
+    /*
+     * Chunks referenced by slices, the last one takes new copies while it has room.
+     */
+    std::vector<std::unique_ptr<Chunk>> used_chunks_;
+
+   public:
+    WriteQueue() = default;
+
+    /*
+     * Queue a copy of the data, packed into pooled chunks unless it's larger than one.
+     * Throws `std::bad_alloc` on allocation failure.
+     */
+    void append(std::string_view data);
+
+    /*
+     * Queue a buffer, taking ownership of it without copying.
+     * Throws `std::bad_alloc` on allocation failure.
+     */
+    void append(std::string&& data);
+
+    /*
+     * Queue a buffer shared with others, e.g. the same message for many clients.
+     * It's kept alive until sent.
+     */
+    void append(std::shared_ptr<const std::string> data);
+
+    /*
+     * Queue data borrowed from the caller without copying, e.g. a string literal.
+     * It must stay valid until sent.
+     */
+    void append_borrowed(std::string_view data);
+
+    /*
+     * Check if there's nothing left to send.
+     */
+    [[nodiscard]] bool empty() const noexcept;
+
+    /*
+     * Get the number of bytes left to send.
+     */
+    [[nodiscard]] size_t size() const noexcept;
+
+    /*
+     * Send as much as the socket takes, up to `MAX_SEGMENTS` slices per writev() call.
+     * Returns the number of bytes sent, or -1 on error (check errno for details).
+     * A full socket buffer isn't an error if some data was sent.
+     */
+    ssize_t write_to(Socket& socket) noexcept;
+
+   private:
+    /*
+     * Drop the first bytes of the queue once sent.
+     */
+    void consume(size_t size) noexcept;
+
+    /*
+     * Get a chunk with room for more data, from the pool if possible.
+     * Throws `std::bad_alloc` on allocation failure.
+     */
+    Chunk& writable_chunk();
+};
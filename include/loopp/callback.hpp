@@ -0,0 +1,156 @@
+#pragma once
+
+#include <concepts>
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace loopp {
+
+template <typename Signature>
+class Callback;
+
+/*
+ * Move-only type-erased callable with inline storage for small captures.
+ * Functors of up to `INLINE_SIZE` bytes that are nothrow movable are stored inline and never allocate,
+ * larger ones are moved to the heap once. Moving a callback never copies the functor.
+ */
+template <typename R, typename... Args>
+class Callback<R(Args...)> {
+   public:
+    /*
+     * Capture size guaranteed to be stored without allocating.
+     */
+    static constexpr size_t INLINE_SIZE = 48;
+
+    /*
+     * Check if the functor is stored inline.
+     */
+    template <typename F>
+    static constexpr bool fits_inline = sizeof(F) <= INLINE_SIZE && alignof(F) <= alignof(std::max_align_t) &&
+                                        std::is_nothrow_move_constructible_v<F>;
+
+   private:
+    /*
+     * Operations on the stored functor, one static table per functor type.
+     */
+    struct Operations {
+        R (*invoke)(void* storage, Args&&... args);
+
+        /*
+         * Move the functor to uninitialized storage and destroy the source.
+         */
+        void (*relocate)(void* destination, void* source) noexcept;
+
+        void (*destroy)(void* storage) noexcept;
+    };
+
+    template <typename F>
+    struct InlineOperations {
+        static R invoke(void* storage, Args&&... args) {
+            return std::invoke(*static_cast<F*>(storage), std::forward<Args>(args)...);
+        }
+
+        static void relocate(void* destination, void* source) noexcept {
+            auto* functor = static_cast<F*>(source);
+            new (destination) F(std::move(*functor));
+            functor->~F();
+        }
+
+        static void destroy(void* storage) noexcept {
+            static_cast<F*>(storage)->~F();
+        }
+
+        static constexpr Operations TABLE{invoke, relocate, destroy};
+    };
+
+    template <typename F>
+    struct HeapOperations {
+        static R invoke(void* storage, Args&&... args) {
+            return std::invoke(**static_cast<F**>(storage), std::forward<Args>(args)...);
+        }
+
+        static void relocate(void* destination, void* source) noexcept {
+            new (destination) F*(*static_cast<F**>(source));
+        }
+
+        static void destroy(void* storage) noexcept {
+            delete *static_cast<F**>(storage);
+        }
+
+        static constexpr Operations TABLE{invoke, relocate, destroy};
+    };
+
+    alignas(std::max_align_t) mutable std::byte storage_[INLINE_SIZE];
+    const Operations* operations_{nullptr};
+
+   public:
+    Callback() noexcept = default;
+
+    Callback(std::nullptr_t) noexcept {}
+
+    /*
+     * Store the functor, moving it if it's an rvalue.
+     * Throws `std::bad_alloc` if it doesn't fit inline and allocation fails.
+     */
+    template <typename F>
+        requires(!std::same_as<std::remove_cvref_t<F>, Callback> && std::is_invocable_r_v<R, std::decay_t<F>&, Args...>)
+    Callback(F&& functor) {
+        using Functor = std::decay_t<F>;
+        if constexpr (fits_inline<Functor>) {
+            new (storage_) Functor(std::forward<F>(functor));
+            operations_ = &InlineOperations<Functor>::TABLE;
+        } else {
+            new (storage_) Functor*(new Functor(std::forward<F>(functor)));
+            operations_ = &HeapOperations<Functor>::TABLE;
+        }
+    }
+
+    ~Callback() noexcept {
+        reset();
+    }
+
+    Callback(const Callback&) = delete;
+    Callback& operator=(const Callback&) = delete;
+
+    Callback(Callback&& other) noexcept : operations_(std::exchange(other.operations_, nullptr)) {
+        if (operations_ != nullptr) operations_->relocate(storage_, other.storage_);
+    }
+
+    Callback& operator=(Callback&& other) noexcept {
+        if (this != &other) {
+            reset();
+            operations_ = std::exchange(other.operations_, nullptr);
+            if (operations_ != nullptr) operations_->relocate(storage_, other.storage_);
+        }
+        return *this;
+    }
+
+    Callback& operator=(std::nullptr_t) noexcept {
+        reset();
+        return *this;
+    }
+
+    /*
+     * Check if a functor is stored.
+     */
+    explicit operator bool() const noexcept {
+        return operations_ != nullptr;
+    }
+
+    /*
+     * Invoke the stored functor, which must be there.
+     */
+    R operator()(Args... args) const {
+        return operations_->invoke(storage_, std::forward<Args>(args)...);
+    }
+
+   private:
+    void reset() noexcept {
+        if (operations_ != nullptr) std::exchange(operations_, nullptr)->destroy(storage_);
+    }
+};
+
+}  // namespace loopp
@@ -0,0 +1,414 @@
+#pragma once
+
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <new>
+#include <optional>
+#include <utility>
+
+#include "loopp/event_loop.hpp"
+
+namespace loopp {
+
+namespace detail {
+
+/*
+ * Free lists of coroutine frames, one pool per thread.
+ * Loops resume their coroutines on their own thread, so each loop effectively gets its own pool
+ * and steady state coroutine calls don't reach the allocator.
+ * Frames are individually allocated, so one freed on another thread simply moves to that thread's pool.
+ */
+class FramePool {
+   private:
+    /*
+     * Frame sizes are rounded up to a granule, each size class has its own free list.
+     */
+    static constexpr size_t GRANULE = 64;
+    static constexpr size_t CLASS_COUNT = 32;
+
+    /*
+     * Frames kept per size class, the rest go back to the allocator.
+     */
+    static constexpr size_t MAX_FREE = 256;
+
+    struct FreeFrame {
+        FreeFrame* next;
+    };
+
+    struct FreeList {
+        FreeFrame* head{nullptr};
+        size_t size{0};
+    };
+
+    std::array<FreeList, CLASS_COUNT> lists_{};
+
+   public:
+    FramePool() = default;
+
+    ~FramePool() noexcept {
+        for (FreeList& list : lists_) {
+            while (list.head != nullptr) {
+                ::operator delete(std::exchange(list.head, list.head->next));
+            }
+        }
+    }
+
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+    FramePool(FramePool&&) = delete;
+    FramePool& operator=(FramePool&&) = delete;
+
+    /*
+     * Get the pool of the calling thread.
+     */
+    static FramePool& local() noexcept {
+        thread_local FramePool pool;
+        return pool;
+    }
+
+    /*
+     * Allocate a frame, reusing a freed one of the same size class if possible.
+     * Throws `std::bad_alloc` on allocation failure.
+     */
+    void* allocate(size_t size) {
+        size_t index = size_class(size);
+        if (index >= CLASS_COUNT) return ::operator new(size);
+
+        FreeList& list = lists_[index];
+        if (list.head == nullptr) return ::operator new((index + 1) * GRANULE);
+
+        --list.size;
+        return std::exchange(list.head, list.head->next);
+    }
+
+    /*
+     * Return a frame allocated with the same size.
+     */
+    void deallocate(void* frame, size_t size) noexcept {
+        size_t index = size_class(size);
+        if (index >= CLASS_COUNT || lists_[index].size == MAX_FREE) {
+            ::operator delete(frame);
+            return;
+        }
+
+        FreeList& list = lists_[index];
+        list.head = new (frame) FreeFrame{list.head};
+        ++list.size;
+    }
+
+   private:
+    static size_t size_class(size_t size) noexcept {
+        return (size + GRANULE - 1) / GRANULE - 1;
+    }
+};
+
+/*
+ * State shared by all task promises.
+ */
+class TaskPromiseBase {
+   private:
+    /*
+     * Coroutine awaiting the task, resumed once it finishes.
+     */
+    std::coroutine_handle<> continuation_;
+
+    /*
+     * Set for tasks started with spawn(), they destroy themselves once finished.
+     */
+    bool is_detached_{false};
+
+   protected:
+    std::exception_ptr exception_;
+
+   public:
+    static void* operator new(size_t size) {
+        return FramePool::local().allocate(size);
+    }
+
+    static void operator delete(void* frame, size_t size) noexcept {
+        FramePool::local().deallocate(frame, size);
+    }
+
+    /*
+     * Resumes the continuation without growing the stack, or destroys a detached task.
+     */
+    struct FinalAwaiter {
+        [[nodiscard]] bool await_ready() const noexcept {
+            return false;
+        }
+
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+            TaskPromiseBase& promise = handle.promise();
+            if (promise.continuation_) return promise.continuation_;
+            if (promise.is_detached_) handle.destroy();
+            return std::noop_coroutine();
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    /*
+     * Tasks are lazy, they start once awaited or spawned.
+     */
+    std::suspend_always initial_suspend() const noexcept {
+        return {};
+    }
+
+    FinalAwaiter final_suspend() const noexcept {
+        return {};
+    }
+
+    /*
+     * Keep the exception for the awaiting coroutine.
+     * Detached tasks have nobody to report to, it propagates to whoever resumed them,
+     * usually out of EventLoop::start() like from any other callback.
+     */
+    void unhandled_exception() {
+        if (is_detached_) throw;
+        exception_ = std::current_exception();
+    }
+
+    void set_continuation(std::coroutine_handle<> continuation) noexcept {
+        continuation_ = continuation;
+    }
+
+    void detach() noexcept {
+        is_detached_ = true;
+    }
+};
+
+}  // namespace detail
+
+/*
+ * Lazily started coroutine producing a value of type `T`.
+ * Awaiting it runs it until it finishes, then resumes the awaiting coroutine with its result,
+ * rethrowing the exception it exited with, if any.
+ * Frames come from a per-thread pool, resuming and finishing never goes through a `std::function`.
+ */
+template <typename T = void>
+class [[nodiscard]] CoTask {
+   public:
+    class promise_type : public detail::TaskPromiseBase {
+       private:
+        std::optional<T> value_;
+
+       public:
+        CoTask get_return_object() noexcept {
+            return CoTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        template <typename U>
+        void return_value(U&& value) {
+            value_.emplace(std::forward<U>(value));
+        }
+
+        T take_result() {
+            if (exception_) std::rethrow_exception(exception_);
+            return std::move(*value_);
+        }
+    };
+
+   private:
+    std::coroutine_handle<promise_type> handle_;
+
+    explicit CoTask(std::coroutine_handle<promise_type> handle) noexcept : handle_(handle) {}
+
+    template <typename U>
+    friend void spawn(CoTask<U>&& task);
+
+   public:
+    ~CoTask() noexcept {
+        if (handle_) handle_.destroy();
+    }
+
+    CoTask(const CoTask&) = delete;
+    CoTask& operator=(const CoTask&) = delete;
+
+    CoTask(CoTask&& other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+
+    CoTask& operator=(CoTask&& other) noexcept {
+        if (this != &other) {
+            if (handle_) handle_.destroy();
+            handle_ = std::exchange(other.handle_, nullptr);
+        }
+        return *this;
+    }
+
+    [[nodiscard]] bool await_ready() const noexcept {
+        return false;
+    }
+
+    /*
+     * Start the task, the awaiting coroutine is resumed once it finishes.
+     */
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) noexcept {
+        handle_.promise().set_continuation(continuation);
+        return handle_;
+    }
+
+    T await_resume() {
+        return handle_.promise().take_result();
+    }
+};
+
+/*
+ * Task producing no value.
+ */
+template <>
+class CoTask<void>::promise_type : public detail::TaskPromiseBase {
+   public:
+    CoTask get_return_object() noexcept {
+        return CoTask(std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+
+    void return_void() const noexcept {}
+
+    void take_result() const {
+        if (exception_) std::rethrow_exception(exception_);
+    }
+};
+
+/*
+ * Start a task without awaiting it, it destroys itself once finished.
+ * Runs on the calling thread until its first suspension, call it from the loop thread
+ * so it keeps running there. An exception the task exits with propagates to whoever resumed it last.
+ */
+template <typename T>
+void spawn(CoTask<T>&& task) {
+    auto handle = std::exchange(task.handle_, nullptr);
+    handle.promise().detach();
+    handle.resume();
+}
+
+/*
+ * Awaits readiness of a file descriptor, created by EventLoop::readable() and EventLoop::writable().
+ * Registers a handler while suspended and removes it before resuming, on the loop thread.
+ * Resumes with true once ready, or right away with false on failure (check errno for details).
+ * Resumes with false and `EBUSY` if the file descriptor and event type already have a handler.
+ */
+class [[nodiscard]] ReadinessAwaiter {
+   private:
+    EventLoop& loop_;
+    int fd_;
+    EventType type_;
+    std::coroutine_handle<> handle_;
+    int error_{0};
+    bool is_pending_{false};
+
+   public:
+    ReadinessAwaiter(EventLoop& loop, int fd, EventType type) noexcept : loop_(loop), fd_(fd), type_(type) {}
+
+    /*
+     * Remove the registration if the awaiting coroutine is destroyed while suspended.
+     */
+    ~ReadinessAwaiter() noexcept {
+        if (is_pending_) loop_.remove_fd(fd_, type_);
+    }
+
+    ReadinessAwaiter(const ReadinessAwaiter&) = delete;
+    ReadinessAwaiter& operator=(const ReadinessAwaiter&) = delete;
+    ReadinessAwaiter(ReadinessAwaiter&&) = delete;
+    ReadinessAwaiter& operator=(ReadinessAwaiter&&) = delete;
+
+    [[nodiscard]] bool await_ready() const noexcept {
+        return false;
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle) noexcept {
+        handle_ = handle;
+        auto callback = [this](int /*fd*/, EventType /*type*/) {
+            is_pending_ = false;
+            loop_.remove_fd(fd_, type_);
+            handle_.resume();
+        };
+
+        // Set first, the loop may resume the coroutine before add_fd_exclusive() returns
+        is_pending_ = true;
+        if (!loop_.add_fd_exclusive(fd_, type_, UniqueEventCallback(callback), EventMode::LEVEL)) {
+            error_ = errno;
+            is_pending_ = false;
+            return false;
+        }
+        return true;
+    }
+
+    [[nodiscard]] bool await_resume() const noexcept {
+        if (error_ != 0) {
+            errno = error_;
+            return false;
+        }
+        return true;
+    }
+};
+
+/*
+ * Awaits a delay with a loop timer, created by EventLoop::sleep().
+ * Resumes with true once the delay passed, or right away with false on failure (check errno for details).
+ */
+class [[nodiscard]] SleepAwaiter {
+   private:
+    EventLoop& loop_;
+    std::chrono::nanoseconds delay_;
+    std::coroutine_handle<> handle_;
+    TimerId timer_{0};
+    int error_{0};
+
+   public:
+    SleepAwaiter(EventLoop& loop, std::chrono::nanoseconds delay) noexcept : loop_(loop), delay_(delay) {}
+
+    /*
+     * Cancel the timer if the awaiting coroutine is destroyed while suspended.
+     */
+    ~SleepAwaiter() noexcept {
+        if (timer_ != 0) loop_.cancel_timer(timer_);
+    }
+
+    SleepAwaiter(const SleepAwaiter&) = delete;
+    SleepAwaiter& operator=(const SleepAwaiter&) = delete;
+    SleepAwaiter(SleepAwaiter&&) = delete;
+    SleepAwaiter& operator=(SleepAwaiter&&) = delete;
+
+    [[nodiscard]] bool await_ready() const noexcept {
+        return false;
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle) noexcept {
+        handle_ = handle;
+        timer_ = loop_.add_timer(delay_, [this] {
+            timer_ = 0;
+            handle_.resume();
+        });
+        if (timer_ == 0) {
+            error_ = errno;
+            return false;
+        }
+        return true;
+    }
+
+    [[nodiscard]] bool await_resume() const noexcept {
+        if (error_ != 0) {
+            errno = error_;
+            return false;
+        }
+        return true;
+    }
+};
+
+inline ReadinessAwaiter EventLoop::readable(int fd) noexcept {
+    return {*this, fd, EventType::READ};
+}
+
+inline ReadinessAwaiter EventLoop::writable(int fd) noexcept {
+    return {*this, fd, EventType::WRITE};
+}
+
+inline SleepAwaiter EventLoop::sleep(std::chrono::nanoseconds delay) noexcept {
+    return {*this, delay};
+}
+
+}  // namespace loopp
@@ -0,0 +1,489 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <new>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "loopp/detail/handler_table.hpp"
+#include "loopp/event_loop.hpp"
+
+namespace loopp::detail {
+
+/*
+ * Kinds of asynchronous operations.
+ */
+enum class AsyncKind : uint8_t {
+    READ,
+    WRITE,
+    WRITEV,
+    ACCEPT,
+
+    /*
+     * Continuous receive into buffers of the loop, completes more than once.
+     */
+    RECV
+};
+
+/*
+ * Event type an operation waits for when emulated with readiness.
+ */
+constexpr EventType async_event_type(AsyncKind kind) noexcept {
+    return kind == AsyncKind::WRITE || kind == AsyncKind::WRITEV ? EventType::WRITE : EventType::READ;
+}
+
+/*
+ * A pending asynchronous operation, linked into the list of its file descriptor.
+ */
+struct AsyncOp {
+    AsyncKind kind{AsyncKind::READ};
+    int fd{-1};
+
+    /*
+     * Buffer of reads and writes.
+     */
+    void* buffer{nullptr};
+    size_t size{0};
+
+    /*
+     * Copy of the buffers of vectored writes, capacity is kept when recycled.
+     */
+    std::vector<iovec> buffers;
+
+    /*
+     * Callback of receives, `callback` is used by all other kinds.
+     */
+    CompletionCallback callback;
+    ReceiveCallback receive_callback;
+
+    /*
+     * Set once cancellation was requested, so receives aren't restarted.
+     */
+    bool is_cancelled{false};
+
+    AsyncOp* prev{nullptr};
+    AsyncOp* next{nullptr};
+};
+
+/*
+ * Intrusive doubly linked list of operations, in submission order.
+ */
+class AsyncOpList {
+   private:
+    AsyncOp* head_{nullptr};
+    AsyncOp* tail_{nullptr};
+
+   public:
+    [[nodiscard]] bool empty() const noexcept {
+        return head_ == nullptr;
+    }
+
+    [[nodiscard]] AsyncOp* front() const noexcept {
+        return head_;
+    }
+
+    void push_back(AsyncOp* op) noexcept {
+        op->prev = tail_;
+        op->next = nullptr;
+        if (tail_ != nullptr) {
+            tail_->next = op;
+        } else {
+            head_ = op;
+        }
+        tail_ = op;
+    }
+
+    void push_front(AsyncOp* op) noexcept {
+        op->prev = nullptr;
+        op->next = head_;
+        if (head_ != nullptr) {
+            head_->prev = op;
+        } else {
+            tail_ = op;
+        }
+        head_ = op;
+    }
+
+    void erase(AsyncOp* op) noexcept {
+        if (op->prev != nullptr) {
+            op->prev->next = op->next;
+        } else {
+            head_ = op->next;
+        }
+        if (op->next != nullptr) {
+            op->next->prev = op->prev;
+        } else {
+            tail_ = op->prev;
+        }
+        op->prev = nullptr;
+        op->next = nullptr;
+    }
+
+    /*
+     * Move all operations to the end of another list.
+     */
+    void splice_to(AsyncOpList& other) noexcept {
+        while (AsyncOp* op = head_) {
+            erase(op);
+            other.push_back(op);
+        }
+    }
+};
+
+/*
+ * Storage of operations, recycled through a free list so steady state submission doesn't allocate them.
+ * Owns every operation, so ones still pending are freed along with it.
+ * Not thread-safe, callers are expected to hold their own lock.
+ */
+class AsyncOpPool {
+   private:
+    /*
+     * Operations, deque keeps references stable as it grows.
+     */
+    std::deque<AsyncOp> ops_;
+
+    /*
+     * Unused operations, linked through `AsyncOp::next`.
+     */
+    AsyncOp* free_list_{nullptr};
+
+   public:
+    /*
+     * Get an operation filled in with the arguments.
+     * Throws `std::bad_alloc` on allocation failure.
+     */
+    AsyncOp* allocate(AsyncKind kind, int fd, void* buffer, size_t size, std::span<const iovec> buffers,
+                      const CompletionCallback& callback, const ReceiveCallback& receive_callback = nullptr) {
+        AsyncOp* op = free_list_;
+        if (op != nullptr) {
+            free_list_ = op->next;
+        } else {
+            op = &ops_.emplace_back();
+        }
+
+        try {
+            op->buffers.assign(buffers.begin(), buffers.end());
+            op->callback = callback;
+            op->receive_callback = receive_callback;
+        } catch (...) {
+            recycle(op);
+            throw;
+        }
+        op->kind = kind;
+        op->fd = fd;
+        op->buffer = buffer;
+        op->size = size;
+        op->is_cancelled = false;
+        op->prev = nullptr;
+        op->next = nullptr;
+        return op;
+    }
+
+    /*
+     * Return an operation to the free list.
+     */
+    void recycle(AsyncOp* op) noexcept {
+        op->callback = nullptr;
+        op->receive_callback = nullptr;
+        op->buffers.clear();
+        op->next = free_list_;
+        free_list_ = op;
+    }
+};
+
+/*
+ * Perform an operation with a single non-blocking system call.
+ * Returns the result as a completion reports it, `-EAGAIN` if it would block.
+ */
+inline int perform(const AsyncOp& op) noexcept {
+    ssize_t result = -1;
+    do {
+        switch (op.kind) {
+            case AsyncKind::READ:
+            case AsyncKind::RECV:
+                result = read(op.fd, op.buffer, op.size);
+                break;
+            case AsyncKind::WRITE:
+                result = write(op.fd, op.buffer, op.size);
+                break;
+            case AsyncKind::WRITEV:
+                result = writev(op.fd, op.buffers.data(), static_cast<int>(std::min<size_t>(op.buffers.size(), IOV_MAX)));
+                break;
+            case AsyncKind::ACCEPT:
+#ifdef __linux__
+                result = accept4(op.fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+                result = accept(op.fd, nullptr, nullptr);
+                if (result != -1) {
+                    int client_fd = static_cast<int>(result);
+                    if (fcntl(client_fd, F_SETFL, fcntl(client_fd, F_GETFL) | O_NONBLOCK) == -1 ||
+                        fcntl(client_fd, F_SETFD, FD_CLOEXEC) == -1) {
+                        int error = errno;
+                        close(client_fd);
+                        errno = error;
+                        result = -1;
+                    }
+                }
+#endif
+                break;
+        }
+    } while (result == -1 && errno == EINTR);
+
+    if (result == -1) return errno == EWOULDBLOCK ? -EAGAIN : -errno;
+    return static_cast<int>(std::min<ssize_t>(result, INT_MAX));
+}
+
+/*
+ * Asynchronous operations on top of readiness, for backends without native completions.
+ * While a file descriptor has operations of an event type queued, the emulation registers
+ * a level-triggered handler for it and performs them in order as it becomes ready.
+ *
+ * The backend provides `mutex_`, `register_fd()`, `unregister_fd()`, `tasks_` and `wakeup()`,
+ * and lets the emulation access them. Its register_fd() and unregister_fd() take whether the
+ * handler is reserved for the emulation, add_fd() and remove_fd() have to leave reserved ones alone.
+ */
+template <typename Backend>
+class AsyncEmulation {
+   private:
+    /*
+     * Operations queued for a single file descriptor.
+     */
+    struct AsyncFd {
+        std::array<AsyncOpList, EVENT_TYPE_COUNT> queues;
+
+        /*
+         * Event types the emulation registered a handler for.
+         */
+        std::array<bool, EVENT_TYPE_COUNT> is_registered{};
+
+        /*
+         * Incremented on cancellation, so an operation being performed meanwhile is cancelled too.
+         */
+        uint32_t cancellations{0};
+    };
+
+    Backend& backend_;
+
+    /*
+     * State per file descriptor, index is the descriptor itself.
+     */
+    std::vector<AsyncFd> fds_;
+
+    AsyncOpPool pool_;
+
+    /*
+     * Buffer shared by all receives, data is only borrowed by callbacks while they run.
+     * Only used by the loop thread once allocated.
+     */
+    std::vector<std::byte> receive_buffer_;
+
+   public:
+    /*
+     * Size of the buffer receives are read into.
+     */
+    static constexpr size_t RECEIVE_BUFFER_SIZE = 64 * 1024;
+
+    explicit AsyncEmulation(Backend& backend) noexcept : backend_(backend) {}
+
+    AsyncEmulation(const AsyncEmulation&) = delete;
+    AsyncEmulation& operator=(const AsyncEmulation&) = delete;
+    AsyncEmulation(AsyncEmulation&&) = delete;
+    AsyncEmulation& operator=(AsyncEmulation&&) = delete;
+
+    /*
+     * Queue an operation, registering for readiness if it's the first one of its event type.
+     * Fails with `EBUSY` if the event type has a handler registered with add_fd().
+     */
+    bool submit(AsyncKind kind, int fd, void* buffer, size_t size, std::span<const iovec> buffers,
+                const CompletionCallback& callback, const ReceiveCallback& receive_callback = nullptr) noexcept {
+        std::lock_guard<std::mutex> lock(backend_.mutex_);
+
+        if (fd < 0) {
+            errno = EBADF;
+            return false;
+        }
+
+        // Allocate everything up front, so a failure leaves no registration behind
+        AsyncOp* op = nullptr;
+        try {
+            if (static_cast<size_t>(fd) >= fds_.size()) {
+                fds_.resize(std::max(static_cast<size_t>(fd) + 1, fds_.size() * 2));
+            }
+
+            // Receives read into the shared buffer
+            if (kind == AsyncKind::RECV) {
+                if (receive_buffer_.empty()) receive_buffer_.resize(RECEIVE_BUFFER_SIZE);
+                buffer = receive_buffer_.data();
+                size = receive_buffer_.size();
+            }
+            op = pool_.allocate(kind, fd, buffer, size, buffers, callback, receive_callback);
+        } catch (const std::bad_alloc&) {
+            errno = ENOMEM;
+            return false;
+        }
+
+        EventType type = async_event_type(kind);
+        AsyncFd& state = fds_[static_cast<size_t>(fd)];
+        if (!state.is_registered[static_cast<size_t>(type)]) {
+            // Fails with `EBUSY` if the type has a handler of its own
+            auto on_ready = [this](int ready_fd, EventType ready_type) { run(ready_fd, ready_type); };
+            if (!backend_.register_fd(fd, type, on_ready, EventMode::LEVEL, true)) {
+                pool_.recycle(op);
+                return false;
+            }
+            state.is_registered[static_cast<size_t>(type)] = true;
+        }
+
+        state.queues[static_cast<size_t>(type)].push_back(op);
+        return backend_.wakeup();
+    }
+
+    /*
+     * Cancel every operation queued for the file descriptor.
+     * Their callbacks are invoked with `-ECANCELED` by a task on the loop thread.
+     * Nothing is cancelled if the task can't be posted.
+     */
+    bool cancel(int fd) noexcept {
+        std::lock_guard<std::mutex> lock(backend_.mutex_);
+        if (fd < 0 || static_cast<size_t>(fd) >= fds_.size()) return true;
+
+        AsyncFd& state = fds_[static_cast<size_t>(fd)];
+        std::array<AsyncOpList, EVENT_TYPE_COUNT> cancelled;
+        bool has_ops = false;
+        for (size_t i = 0; i < EVENT_TYPE_COUNT; ++i) {
+            state.queues[i].splice_to(cancelled[i]);
+            has_ops = has_ops || !cancelled[i].empty();
+        }
+
+        // Operations stay owned by the pool, so the lists can be copied around until the task runs.
+        // They go back to their queues if the task can't be posted
+        if (has_ops && !post_cancelled(cancelled)) {
+            for (size_t i = 0; i < EVENT_TYPE_COUNT; ++i) {
+                cancelled[i].splice_to(state.queues[i]);
+            }
+            return false;
+        }
+
+        // Operations being performed meanwhile see the cancellation once they're done
+        ++state.cancellations;
+        for (size_t i = 0; i < EVENT_TYPE_COUNT; ++i) {
+            unregister(fd, static_cast<EventType>(i));
+        }
+        return !has_ops || backend_.wakeup();
+    }
+
+   private:
+    /*
+     * Perform the queued operations of the event type while the file descriptor is ready.
+     * Invoked on the loop thread without the mutex held.
+     */
+    void run(int fd, EventType type) {
+        std::unique_lock<std::mutex> lock(backend_.mutex_);
+        auto index = static_cast<size_t>(type);
+
+        while (AsyncOp* op = fds_[static_cast<size_t>(fd)].queues[index].front()) {
+            // Take the operation out of the queue while performing it without the lock
+            fds_[static_cast<size_t>(fd)].queues[index].erase(op);
+            uint32_t cancellations = fds_[static_cast<size_t>(fd)].cancellations;
+            lock.unlock();
+            int result = perform(*op);
+            lock.lock();
+
+            AsyncFd& state = fds_[static_cast<size_t>(fd)];
+            bool is_cancelled = state.cancellations != cancellations;
+            if (result == -EAGAIN) {
+                if (!is_cancelled) {
+                    state.queues[index].push_front(op);
+                    return;
+                }
+                result = -ECANCELED;
+            }
+
+            // Receives keep going after delivering data, the next chunk waits for the next readiness
+            if (op->kind == AsyncKind::RECV && result > 0) {
+                if (!is_cancelled) state.queues[index].push_front(op);
+                lock.unlock();
+                op->receive_callback(result, std::span<const std::byte>(receive_buffer_).first(static_cast<size_t>(result)));
+                if (!is_cancelled) return;
+                lock.lock();
+                result = -ECANCELED;
+            }
+
+            finish(lock, op, result);
+        }
+
+        // Nothing left to wait for
+        unregister(fd, type);
+    }
+
+    /*
+     * Post a task completing the cancelled operations with `-ECANCELED`.
+     * Returns false if the task can't be allocated, with errno set to `ENOMEM`.
+     */
+    bool post_cancelled(std::array<AsyncOpList, EVENT_TYPE_COUNT> cancelled) noexcept {
+        try {
+            Task task([this, cancelled]() mutable {
+                for (AsyncOpList& ops : cancelled) complete_all(ops, -ECANCELED);
+            });
+            return backend_.tasks_.push(std::move(task));
+        } catch (const std::bad_alloc&) {
+            errno = ENOMEM;
+            return false;
+        }
+    }
+
+    /*
+     * Invoke the callbacks of the operations with the result and recycle them.
+     */
+    void complete_all(AsyncOpList& ops, int result) {
+        std::unique_lock<std::mutex> lock(backend_.mutex_);
+        while (AsyncOp* op = ops.front()) {
+            ops.erase(op);
+            finish(lock, op, result);
+        }
+    }
+
+    /*
+     * Recycle a finished operation and invoke its callback with the result.
+     * Must be called with the lock held, it's released around the callback.
+     */
+    void finish(std::unique_lock<std::mutex>& lock, AsyncOp* op, int result) {
+        CompletionCallback callback = std::move(op->callback);
+        ReceiveCallback receive_callback = std::move(op->receive_callback);
+        pool_.recycle(op);
+        lock.unlock();
+        if (receive_callback) {
+            receive_callback(result, {});
+        } else {
+            callback(result);
+        }
+        lock.lock();
+    }
+
+    /*
+     * Unregister the handler of the emulation for the event type, if any.
+     * Must be called with the backend's mutex held.
+     */
+    void unregister(int fd, EventType type) noexcept {
+        AsyncFd& state = fds_[static_cast<size_t>(fd)];
+        if (!state.is_registered[static_cast<size_t>(type)]) return;
+
+        state.is_registered[static_cast<size_t>(type)] = false;
+        backend_.unregister_fd(fd, type, true);
+    }
+};
+
+}  // namespace loopp::detail
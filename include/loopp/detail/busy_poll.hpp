@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "loopp/event_loop.hpp"
+
+namespace loopp::detail {
+
+/*
+ * Decides when a loop polls without blocking instead of going to sleep, and counts how well it pays off.
+ * Once the loop runs out of work it keeps polling for the busy poll window, then blocks as usual.
+ * Any event reported meanwhile closes the window, it opens again the next time the loop runs out of work.
+ */
+class BusyPoll {
+   private:
+    using Clock = std::chrono::steady_clock;
+
+    /*
+     * Counters written by the loop thread only, read by stats() from any thread.
+     */
+    std::atomic<uint64_t> spins_{0};
+    std::atomic<uint64_t> spin_hits_{0};
+    std::atomic<uint64_t> blocking_waits_{0};
+
+    /*
+     * End of the current window, if one is open.
+     * Only accessed by the loop thread.
+     */
+    Clock::time_point deadline_{};
+    bool is_open_{false};
+
+    /*
+     * Set if the last wait was a poll decided by should_spin().
+     */
+    bool is_spin_{false};
+
+   public:
+    /*
+     * Check if the next wait should poll instead of blocking, called before each wait.
+     * Waits that wouldn't block anyway, with work already waiting, are left alone,
+     * work found that way while polling counts as a hit.
+     */
+    bool should_spin(bool is_blocking, std::chrono::microseconds window) noexcept {
+        is_spin_ = false;
+        if (!is_blocking) {
+            if (is_open_) increment(spin_hits_);
+            is_open_ = false;
+            return false;
+        }
+
+        if (window > std::chrono::microseconds::zero()) {
+            auto now = Clock::now();
+            if (!is_open_) {
+                is_open_ = true;
+                deadline_ = now + window;
+            }
+            if (now < deadline_) {
+                is_spin_ = true;
+                return true;
+            }
+        }
+
+        is_open_ = false;
+        increment(blocking_waits_);
+        return false;
+    }
+
+    /*
+     * Report if the last wait returned events or tasks were posted meanwhile, called after each wait.
+     * Work found by a poll counts as a hit.
+     */
+    void record(bool has_work) noexcept {
+        if (is_spin_) {
+            increment(spins_);
+            if (has_work) increment(spin_hits_);
+        }
+        if (has_work) is_open_ = false;
+    }
+
+    /*
+     * Take a snapshot of the counters, callable from any thread.
+     */
+    [[nodiscard]] BusyPollStats stats() const noexcept {
+        return {
+            .spins = spins_.load(std::memory_order_relaxed),
+            .spin_hits = spin_hits_.load(std::memory_order_relaxed),
+            .blocking_waits = blocking_waits_.load(std::memory_order_relaxed),
+        };
+    }
+
+   private:
+    /*
+     * Increment a counter without a read-modify-write, there's a single writer.
+     */
+    static void increment(std::atomic<uint64_t>& counter) noexcept {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+};
+
+}  // namespace loopp::detail
@@ -0,0 +1,669 @@
+#pragma once
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#ifdef LOOPP_TIMERFD
+#include <sys/timerfd.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <loopp/event_loop.hpp>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "loopp/detail/async_ops.hpp"
+#include "loopp/detail/busy_poll.hpp"
+#include "loopp/detail/handler_table.hpp"
+#include "loopp/detail/loop_options.hpp"
+#include "loopp/detail/loop_stats.hpp"
+#include "loopp/detail/loop_trace.hpp"
+#include "loopp/detail/loop_thread.hpp"
+#include "loopp/detail/task_queue.hpp"
+#include "loopp/detail/timer_wheel.hpp"
+
+namespace loopp {
+
+static_assert(READY_READ == EPOLLIN && READY_WRITE == EPOLLOUT && READY_ERROR == EPOLLERR && READY_HANGUP == EPOLLHUP &&
+                  READY_READ_HANGUP == EPOLLRDHUP,
+              "Epoll events are reported as they are");
+
+/*
+ * Epoll-based implementation of the EventLoop.
+ * Supported on Linux systems.
+ */
+class EventLoopEpoll final : public EventLoop {
+   private:
+    friend class detail::AsyncEmulation<EventLoopEpoll>;
+
+    /*
+     * Indicates if the event loop is running.
+     */
+    std::atomic<bool> is_running_{false};
+
+    /*
+     * Thread running the event loop, its mutations don't need a wakeup.
+     */
+    detail::LoopThread loop_thread_;
+
+    /*
+     * Set once a wakeup was issued, until the loop wakes up.
+     * Further wakeups are coalesced into the pending one.
+     */
+    std::atomic<bool> is_wakeup_pending_{false};
+
+    /*
+     * Tasks posted to the loop thread, lock-free.
+     */
+    detail::TaskQueue tasks_;
+
+    /*
+     * Options of the loop, adjustable at runtime.
+     */
+    detail::LoopSettings settings_;
+
+    /*
+     * Busy polling state and counters.
+     */
+    detail::BusyPoll busy_poll_;
+
+    /*
+     * Instrumentation, no-ops unless configured in.
+     */
+    detail::Stats stats_;
+
+    /*
+     * Tracing, records nothing until enabled.
+     */
+    detail::Trace trace_;
+
+    /*
+     * Table of file descriptors to their event callbacks.
+     * Registrations lock the shard of their descriptor, the loop reads it without locking.
+     */
+    detail::HandlerTable event_callbacks_;
+
+    /*
+     * Timers armed on the loop.
+     */
+    detail::Timers timers_;
+
+    /*
+     * Mutex to protect access to timers and asynchronous operations.
+     */
+    std::mutex mutex_;
+
+    /*
+     * Asynchronous operations, emulated with readiness.
+     */
+    detail::AsyncEmulation<EventLoopEpoll> async_{*this};
+
+    /*
+     * Handlers ready in the current iteration, only used by the loop thread.
+     * One READ and one WRITE handler at most per event.
+     */
+    detail::ReadyHandlers ready_handlers_{static_cast<size_t>(LoopOptions{}.max_events) * detail::EVENT_TYPE_COUNT};
+
+    /*
+     * Room for the events of a single wait, only used by the loop thread.
+     */
+    std::vector<struct epoll_event> events_ = std::vector<struct epoll_event>(LoopOptions{}.max_events);
+
+    /*
+     * File descriptor for the epoll instance.
+     */
+    int epoll_fd_{-1};
+
+    /*
+     * Event file descriptor for immediate wakeup.
+     */
+    int wakeup_fd_{-1};
+
+#ifdef LOOPP_TIMERFD
+    /*
+     * Timer file descriptor armed at the next timer deadline.
+     * Lets epoll_wait() block without a timeout and wake up with sub-millisecond precision.
+     */
+    int timer_fd_{-1};
+
+    /*
+     * Deadline the timer file descriptor is armed at, if any.
+     * Only used by the loop thread.
+     */
+    std::optional<detail::Timers::Clock::time_point> timer_fd_deadline_;
+#endif
+
+   public:
+    EventLoopEpoll() {
+        // Create epoll instance
+        epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_fd_ == -1) {
+            throw std::system_error(errno, std::system_category(), "Failed to create epoll instance");
+        }
+
+        // Create eventfd for immediate wakeup
+        wakeup_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (wakeup_fd_ == -1) {
+            close(epoll_fd_);
+            epoll_fd_ = -1;
+            throw std::system_error(errno, std::system_category(), "Failed to create wakeup eventfd");
+        }
+
+        // Add wakeup fd to epoll
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.fd = wakeup_fd_;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wakeup_fd_, &event) == -1) {
+            close(wakeup_fd_);
+            close(epoll_fd_);
+            wakeup_fd_ = -1;
+            epoll_fd_ = -1;
+            throw std::system_error(errno, std::system_category(), "Failed to add wakeup fd to epoll");
+        }
+
+#ifdef LOOPP_TIMERFD
+        // Create timerfd for timer deadlines and add it to epoll
+        timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+        event.events = EPOLLIN;
+        event.data.fd = timer_fd_;
+        if (timer_fd_ == -1 || epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, timer_fd_, &event) == -1) {
+            int error = errno;
+            if (timer_fd_ != -1) close(timer_fd_);
+            close(wakeup_fd_);
+            close(epoll_fd_);
+            timer_fd_ = -1;
+            wakeup_fd_ = -1;
+            epoll_fd_ = -1;
+            throw std::system_error(error, std::system_category(), "Failed to set up timerfd");
+        }
+#endif
+    }
+
+    ~EventLoopEpoll() noexcept override {
+#ifdef LOOPP_TIMERFD
+        if (timer_fd_ != -1) close(timer_fd_);
+#endif
+        if (wakeup_fd_ != -1) close(wakeup_fd_);
+        if (epoll_fd_ != -1) close(epoll_fd_);
+    }
+
+    [[nodiscard]] bool is_running() const noexcept override {
+        return is_running_.load();
+    }
+
+    bool set_options(const LoopOptions& options) noexcept override {
+        return settings_.set(options);
+    }
+
+    [[nodiscard]] LoopOptions options() const noexcept override {
+        return settings_.get();
+    }
+
+    [[nodiscard]] BusyPollStats busy_poll_stats() const noexcept override {
+        return busy_poll_.stats();
+    }
+
+    [[nodiscard]] LoopStats stats() const noexcept override {
+        return stats_.snapshot();
+    }
+
+    bool set_tracing(bool is_enabled) noexcept override {
+        return trace_.set_enabled(is_enabled);
+    }
+
+    [[nodiscard]] const TraceBuffer* trace() const noexcept override {
+        return trace_.buffer();
+    }
+
+    using EventLoop::add_fd;
+
+    bool add_fd(int fd, EventType type, UniqueEventCallback&& callback, EventMode mode) noexcept override {
+        if (!register_fd(fd, type, std::move(callback), mode)) return false;
+        return wakeup();
+    }
+
+    bool add_fd_exclusive(int fd, EventType type, UniqueEventCallback&& callback, EventMode mode) noexcept override {
+        if (!register_fd(fd, type, std::move(callback), mode, false, true)) return false;
+        return wakeup();
+    }
+
+    bool add_fd(int fd, ReadyMask interest, FdHandler* handler, void* user_data, EventMode mode) noexcept override {
+        if (!register_handler(fd, interest, handler, user_data, mode)) return false;
+        return wakeup();
+    }
+
+    bool add_fds(std::span<const Registration> registrations) noexcept override {
+        for (const auto& [fd, type, callback, mode] : registrations) {
+            if (!register_fd(fd, type, UniqueEventCallback(callback), mode)) return wakeup_after_error();
+        }
+        return wakeup();
+    }
+
+    bool add_fds(std::span<const HandlerRegistration> registrations) noexcept override {
+        for (const auto& [fd, interest, handler, user_data, mode] : registrations) {
+            if (!register_handler(fd, interest, handler, user_data, mode)) return wakeup_after_error();
+        }
+        return wakeup();
+    }
+
+    bool remove_fd(int fd, EventType type) noexcept override {
+        if (!unregister_fd(fd, type)) return false;
+        return wakeup();
+    }
+
+    bool remove_fds(std::span<const FdEvent> events) noexcept override {
+        for (const auto& [fd, type] : events) {
+            if (!unregister_fd(fd, type)) return wakeup_after_error();
+        }
+        return wakeup();
+    }
+
+    bool rearm_fd(int fd) noexcept override {
+        auto lock = event_callbacks_.lock(fd);
+
+        uint8_t mask = event_callbacks_.mask(fd);
+        if (mask == 0) {
+            errno = ENOENT;
+            return false;
+        }
+
+        // Only oneshot registrations get disarmed
+        EventMode mode = event_callbacks_.mode(fd);
+        if (mode != EventMode::ONESHOT) {
+            return true;
+        }
+
+        struct epoll_event event;
+        event.events = to_epoll_events(mask, mode);
+        event.data.fd = fd;
+        stats_.on_registration_changes();
+        trace_.record(TraceKind::REGISTRATION, fd, EPOLL_CTL_MOD);
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &event) == -1) {
+            return false;
+        }
+
+        return wakeup();
+    }
+
+    TimerId add_timer(std::chrono::nanoseconds delay, const TimerCallback& callback) noexcept override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        TimerId id = timers_.add(delay, callback);
+        if (!wakeup()) {
+            timers_.cancel(id);
+            return 0;
+        }
+        return id;
+    }
+
+    bool reset_timer(TimerId id, std::chrono::nanoseconds delay) noexcept override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!timers_.reset(id, delay)) {
+            errno = ENOENT;
+            return false;
+        }
+        return wakeup();
+    }
+
+    bool cancel_timer(TimerId id) noexcept override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return timers_.cancel(id);
+    }
+
+    bool post(Task task) noexcept override {
+        if (!tasks_.push(std::move(task))) return false;
+        return wakeup();
+    }
+
+    bool async_read(int fd, std::span<std::byte> buffer, const CompletionCallback& callback) noexcept override {
+        return async_.submit(detail::AsyncKind::READ, fd, buffer.data(), buffer.size(), {}, callback);
+    }
+
+    bool async_write(int fd, std::span<const std::byte> data, const CompletionCallback& callback) noexcept override {
+        return async_.submit(detail::AsyncKind::WRITE, fd, const_cast<std::byte*>(data.data()), data.size(), {}, callback);
+    }
+
+    bool async_writev(int fd, std::span<const iovec> buffers, const CompletionCallback& callback) noexcept override {
+        return async_.submit(detail::AsyncKind::WRITEV, fd, nullptr, 0, buffers, callback);
+    }
+
+    bool async_accept(int fd, const CompletionCallback& callback) noexcept override {
+        return async_.submit(detail::AsyncKind::ACCEPT, fd, nullptr, 0, {}, callback);
+    }
+
+    bool async_recv(int fd, const ReceiveCallback& callback) noexcept override {
+        return async_.submit(detail::AsyncKind::RECV, fd, nullptr, 0, {}, nullptr, callback);
+    }
+
+    bool cancel_async(int fd) noexcept override {
+        return async_.cancel(fd);
+    }
+
+    void start() override {
+        detail::LoopThread::Scope loop_thread_scope(loop_thread_);
+        is_running_.store(true);
+
+        while (is_running_.load()) {
+            stats_.on_iteration();
+
+            // Pick up changed options, then finish the callbacks left over by the budget before waiting again
+            if (settings_.refresh()) apply_options();
+            if (ready_handlers_.is_pending()) {
+                run_callbacks();
+                continue;
+            }
+
+            // Wait for events, or until the next timer is due, polling instead while busy polling
+            int timeout = wait_timeout();
+            if (busy_poll_.should_spin(timeout != 0, settings_.current().busy_poll)) timeout = 0;
+            trace_.record(TraceKind::WAIT_BEGIN);
+            auto wait_start = stats_.begin_wait();
+            int ready_count = epoll_wait(epoll_fd_, events_.data(), static_cast<int>(events_.size()), timeout);
+            trace_.record(TraceKind::WAIT_END, -1, static_cast<uint32_t>(std::max(ready_count, 0)));
+            if (ready_count == -1) {
+                if (errno == EINTR) continue;
+                throw std::system_error(errno, std::system_category(), "Failed to wait for events");
+            }
+            stats_.end_wait(wait_start, static_cast<size_t>(ready_count));
+            busy_poll_.record(ready_count > 0 || !tasks_.empty());
+
+            // Drain the wakeup buffer before clearing the flag, wakeups issued from now on need another write.
+            // The exchange makes the work of wakeups coalesced until then visible
+            for (int i = 0; i < ready_count; ++i) {
+                if (events_[static_cast<size_t>(i)].data.fd != wakeup_fd_) continue;
+
+                uint64_t buffer;
+                while (read(wakeup_fd_, &buffer, sizeof(buffer)) > 0) {
+                }
+                break;
+            }
+            is_wakeup_pending_.exchange(false);
+
+            // Collect ready handlers without locking, the table keeps them alive if callbacks modify it
+            for (int i = 0; i < ready_count; i++) {
+                int fd = events_[static_cast<size_t>(i)].data.fd;
+                uint32_t epoll_events = events_[static_cast<size_t>(i)].events;
+
+                if (fd == wakeup_fd_) continue;  // Skip wakeup fd
+#ifdef LOOPP_TIMERFD
+                if (fd == timer_fd_) continue;  // Skip timer fd, timers are checked below
+#endif
+
+                ready_handlers_.collect(event_callbacks_, fd, epoll_events);
+            }
+
+            run_callbacks();
+        }
+    }
+
+    bool stop() noexcept override {
+        if (!is_running_.exchange(false)) return true;
+        return wakeup();
+    }
+
+   private:
+    /*
+     * Invoke a round of callbacks within the limits of the options,
+     * ready handlers first, then posted tasks and due timers.
+     */
+    void run_callbacks() {
+        const LoopOptions& options = settings_.current();
+
+        // Execute callbacks for ready events, skipping removed ones
+        ready_handlers_.dispatch(event_callbacks_, stats_, trace_, options.max_callbacks, options.callback_budget);
+
+        // Run tasks posted so far
+        tasks_.run(options.max_tasks);
+
+        // Fire timers that are due
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            timers_.collect();
+        }
+        timers_.dispatch(mutex_);
+    }
+
+    /*
+     * Register a callback, same as add_fd() but without waking up the loop,
+     * or add_fd_exclusive() with `is_exclusive`.
+     * Handlers reserved for the emulation of asynchronous operations fail with `EBUSY` if the type is taken.
+     * Locks the shard of the file descriptor.
+     */
+    bool register_fd(int fd, EventType type, UniqueEventCallback&& callback, EventMode mode,
+                     bool is_reserved = false, bool is_exclusive = false) noexcept {
+        if (!detail::HandlerTable::can_insert(fd)) return false;
+        auto lock = event_callbacks_.lock(fd);
+
+        // Types with asynchronous operations queued are taken by the emulation
+        if (event_callbacks_.is_reserved(fd, type)) {
+            errno = EBUSY;
+            return false;
+        }
+
+        // File descriptors registered with an FdHandler take no callbacks
+        if (event_callbacks_.has_fd_handler(fd)) {
+            errno = EINVAL;
+            return false;
+        }
+
+        // Check if already registered
+        uint8_t mask = event_callbacks_.mask(fd);
+        if ((mask & detail::event_bit(type)) != 0) {
+            if (!is_reserved && !is_exclusive) return true;
+            errno = EBUSY;
+            return false;
+        }
+
+        // Epoll flags apply to the whole FD, so all event types must share the mode
+        if (mask != 0 && event_callbacks_.mode(fd) != mode) {
+            errno = EINVAL;
+            return false;
+        }
+
+        // Register the callback first, the loop may see the first event before epoll_ctl() returns
+        event_callbacks_.insert(fd, type, std::move(callback), mode, is_reserved);
+
+        struct epoll_event event;
+        event.events = to_epoll_events(static_cast<uint8_t>(mask | detail::event_bit(type)), mode);
+        event.data.fd = fd;
+
+        // Determine whether to add or modify the FD in epoll
+        int op = mask != 0 ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+        stats_.on_registration_changes();
+        trace_.record(TraceKind::REGISTRATION, fd, static_cast<uint32_t>(op));
+        if (epoll_ctl(epoll_fd_, op, fd, &event) == -1) {
+            int error = errno;
+            event_callbacks_.erase(fd, type, is_reserved);
+            errno = error;
+            return false;
+        }
+
+        return true;
+    }
+
+    /*
+     * Register an FdHandler, same as add_fd() but without waking up the loop.
+     * Locks the shard of the file descriptor.
+     */
+    bool register_handler(int fd, ReadyMask interest, FdHandler* handler, void* user_data, EventMode mode) noexcept {
+        uint8_t mask = detail::to_event_mask(interest);
+        if (!detail::HandlerTable::can_insert(fd)) return false;
+        auto lock = event_callbacks_.lock(fd);
+        if (!event_callbacks_.can_insert(fd, mask, handler)) return false;
+
+        // Keep the previous registration to restore it if epoll refuses the new one
+        uint8_t previous_mask = event_callbacks_.mask(fd);
+        EventMode previous_mode = event_callbacks_.mode(fd);
+        const detail::Handler* previous = event_callbacks_.find_fd_handler(fd);
+        FdHandler* previous_handler = previous != nullptr ? previous->fd_handler : nullptr;
+        void* previous_user_data = previous != nullptr ? previous->user_data : nullptr;
+
+        event_callbacks_.insert(fd, mask, handler, user_data, mode);
+
+        struct epoll_event event;
+        event.events = to_epoll_events(mask, mode);
+        event.data.fd = fd;
+
+        // A single change covers the new interest, whatever was registered before
+        int op = previous_mask != 0 ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+        stats_.on_registration_changes();
+        trace_.record(TraceKind::REGISTRATION, fd, static_cast<uint32_t>(op));
+        if (epoll_ctl(epoll_fd_, op, fd, &event) == -1) {
+            int error = errno;
+            if (previous_mask != 0) {
+                event_callbacks_.insert(fd, previous_mask, previous_handler, previous_user_data, previous_mode);
+            } else {
+                event_callbacks_.erase(fd, EventType::READ);
+                event_callbacks_.erase(fd, EventType::WRITE);
+            }
+            errno = error;
+            return false;
+        }
+
+        return true;
+    }
+
+    /*
+     * Unregister a callback, same as remove_fd() but without waking up the loop.
+     * Handlers reserved for the emulation are only unregistered with `is_reserved`.
+     * Locks the shard of the file descriptor.
+     */
+    bool unregister_fd(int fd, EventType type, bool is_reserved = false) noexcept {
+        auto lock = event_callbacks_.lock(fd);
+
+        // Remove the callback, no-op if already unregistered or taken by the emulation
+        if (!event_callbacks_.erase(fd, type, is_reserved)) {
+            return true;
+        }
+
+        uint8_t mask = event_callbacks_.mask(fd);
+        if (mask == 0) {
+            // No more callbacks, remove FD from epoll
+            stats_.on_registration_changes();
+            trace_.record(TraceKind::REGISTRATION, fd, EPOLL_CTL_DEL);
+            if (epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr) == -1) {
+                return false;
+            }
+        } else {
+            // Still have callbacks, modify epoll registration
+            struct epoll_event event;
+            event.events = to_epoll_events(mask, event_callbacks_.mode(fd));
+            event.data.fd = fd;
+            stats_.on_registration_changes();
+            trace_.record(TraceKind::REGISTRATION, fd, EPOLL_CTL_MOD);
+            if (epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &event) == -1) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    /*
+     * Resize the room for events to the limit of events per wait.
+     * Throws `std::bad_alloc` on allocation failure.
+     */
+    void apply_options() {
+        uint32_t max_events = settings_.current().max_events;
+        events_.resize(max_events);
+        ready_handlers_.reserve(static_cast<size_t>(max_events) * detail::EVENT_TYPE_COUNT);
+    }
+
+    /*
+     * Get the epoll_wait() timeout until the next timer deadline, -1 if there is none.
+     * With timerfd, arms it at the deadline instead and blocks without a timeout.
+     * Returns 0 if posted tasks are waiting to run.
+     */
+    int wait_timeout() {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+#ifdef LOOPP_TIMERFD
+        // Don't block with tasks already waiting
+        int timeout = tasks_.empty() ? -1 : 0;
+
+        auto deadline = timers_.next_deadline();
+        if (deadline == timer_fd_deadline_) return timeout;
+
+        // Zero disarms, an absolute time in the past fires immediately
+        struct itimerspec spec{};
+        if (deadline) {
+            auto since_epoch = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline->time_since_epoch()).count();
+            spec.it_value.tv_sec = static_cast<time_t>(since_epoch / 1'000'000'000);
+            spec.it_value.tv_nsec = static_cast<long>(since_epoch % 1'000'000'000);
+            if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0) spec.it_value.tv_nsec = 1;
+        }
+        if (timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &spec, nullptr) == -1) {
+            throw std::system_error(errno, std::system_category(), "Failed to arm timerfd");
+        }
+
+        // Clear a previous expiration so it doesn't wake the loop up again
+        uint64_t expirations;
+        while (read(timer_fd_, &expirations, sizeof(expirations)) > 0) {
+        }
+
+        timer_fd_deadline_ = deadline;
+        return timeout;
+#else
+        // Don't block with tasks already waiting
+        return tasks_.empty() ? timers_.timeout_ms() : 0;
+#endif
+    }
+
+    /*
+     * Convert a mask of registered event types and their mode to epoll events.
+     */
+    static uint32_t to_epoll_events(uint8_t mask, EventMode mode) noexcept {
+        uint32_t events = 0;
+        if (mask & detail::event_bit(EventType::READ)) events |= EPOLLIN | EPOLLRDHUP;
+        if (mask & detail::event_bit(EventType::WRITE)) events |= EPOLLOUT;
+        if (mode == EventMode::EDGE) events |= EPOLLET;
+        if (mode == EventMode::ONESHOT) events |= EPOLLONESHOT;
+        return events;
+    }
+
+    /*
+     * Wake up the event loop if it's blocked.
+     * No-op if already awake or called from the loop thread,
+     * changes made there are picked up before the next wait.
+     * Coalesced with a wakeup that's still pending.
+     */
+    bool wakeup() noexcept {
+        if (loop_thread_.is_current()) return true;
+        if (is_wakeup_pending_.exchange(true)) {
+            stats_.on_wakeup_coalesced();
+            return true;
+        }
+
+        uint64_t value = 1;
+        if (write(wakeup_fd_, &value, sizeof(value)) == -1 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            is_wakeup_pending_.store(false);
+            return false;
+        }
+        stats_.on_wakeup_issued();
+        trace_.record(TraceKind::WAKEUP);
+        return true;
+    }
+
+    /*
+     * Wake up the loop after a batch failed midway, so the changes applied so far are picked up.
+     * Always returns false, preserving errno of the failure.
+     */
+    bool wakeup_after_error() noexcept {
+        int error = errno;
+        wakeup();
+        errno = error;
+        return false;
+    }
+};
+
+}  // namespace loopp
@@ -0,0 +1,994 @@
+#pragma once
+
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <loopp/event_loop.hpp>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <span>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "loopp/detail/async_ops.hpp"
+#include "loopp/detail/busy_poll.hpp"
+#include "loopp/detail/handler_table.hpp"
+#include "loopp/detail/loop_options.hpp"
+#include "loopp/detail/loop_stats.hpp"
+#include "loopp/detail/loop_trace.hpp"
+#include "loopp/detail/loop_thread.hpp"
+#include "loopp/detail/task_queue.hpp"
+#include "loopp/detail/timer_wheel.hpp"
+#include "loopp/detail/uring.hpp"
+
+namespace loopp {
+
+static_assert(READY_READ == POLLIN && READY_WRITE == POLLOUT && READY_ERROR == POLLERR && READY_HANGUP == POLLHUP &&
+                  READY_READ_HANGUP == POLLRDHUP,
+              "Poll events are reported as they are");
+
+/*
+ * Io_uring-based implementation of the EventLoop.
+ * Supported on Linux 5.13 and newer.
+ *
+ * Readiness is watched with poll requests, one per file descriptor.
+ * Registration changes are queued and submitted in a single batch
+ * by the same io_uring_enter() call the loop waits in.
+ */
+class EventLoopIoUring final : public EventLoop {
+   private:
+    /*
+     * Number of submission entries, larger batches are split.
+     */
+    static constexpr unsigned SQ_ENTRIES = 1024;
+
+    /*
+     * Number of completion entries, completions beyond it are held back by the kernel.
+     */
+    static constexpr unsigned CQ_ENTRIES = 4096;
+
+    /*
+     * Provided buffers, enough to keep a burst of receives going, small enough for idle loops.
+     */
+    static constexpr uint16_t BUFFER_COUNT = 512;
+    static constexpr uint32_t BUFFER_SIZE = 4096;
+
+    /*
+     * Group identifier of the provided buffers.
+     */
+    static constexpr uint16_t BUFFER_GROUP = 0;
+
+    /*
+     * Completion user data of the wakeup file descriptor poll.
+     */
+    static constexpr uint64_t WAKEUP_DATA = ~uint64_t{0};
+
+    /*
+     * Completion user data of poll removals and cancellations, their results are ignored.
+     */
+    static constexpr uint64_t IGNORED_DATA = ~uint64_t{0} - 1;
+
+    /*
+     * Set in the user data of poll requests, asynchronous operations use their address instead.
+     */
+    static constexpr uint64_t POLL_TAG = uint64_t{1} << 63;
+
+    /*
+     * Bits of the poll generation, those left in the user data next to the tag and the file descriptor.
+     */
+    static constexpr uint32_t GENERATION_MASK = 0x7FFF'FFFF;
+
+    /*
+     * Poll request of a single file descriptor.
+     * The generation changes whenever the poll request is replaced, so completions of old ones are ignored.
+     * It wraps within the generation mask, so it matches the one decoded from completions.
+     */
+    struct PollState {
+        uint32_t generation{0};
+        bool is_armed{false};
+
+        /*
+         * Event types and mode the pending poll request watches.
+         */
+        uint8_t mask{0};
+        EventMode mode{EventMode::LEVEL};
+    };
+
+    /*
+     * Requests of a single file descriptor besides its poll request.
+     */
+    struct FdState {
+        /*
+         * Asynchronous operations in flight.
+         */
+        detail::AsyncOpList ops;
+    };
+
+    /*
+     * Indicates if the event loop is running.
+     */
+    std::atomic<bool> is_running_{false};
+
+    /*
+     * Thread running the event loop, its mutations don't need a wakeup.
+     */
+    detail::LoopThread loop_thread_;
+
+    /*
+     * Set once a wakeup was issued, until the loop wakes up.
+     * Further wakeups are coalesced into the pending one.
+     */
+    std::atomic<bool> is_wakeup_pending_{false};
+
+    /*
+     * Tasks posted to the loop thread, lock-free.
+     */
+    detail::TaskQueue tasks_;
+
+    /*
+     * Options of the loop, adjustable at runtime.
+     */
+    detail::LoopSettings settings_;
+
+    /*
+     * Busy polling state and counters.
+     */
+    detail::BusyPoll busy_poll_;
+
+    /*
+     * Instrumentation, no-ops unless configured in.
+     */
+    detail::Stats stats_;
+
+    /*
+     * Tracing, records nothing until enabled.
+     */
+    detail::Trace trace_;
+
+    /*
+     * Table of file descriptors to their event callbacks.
+     */
+    detail::HandlerTable event_callbacks_;
+
+    /*
+     * Poll requests, indexed by file descriptor, only used by the loop thread.
+     */
+    std::vector<PollState> polls_;
+
+    /*
+     * Request state, indexed by file descriptor.
+     */
+    std::vector<FdState> fds_;
+
+    /*
+     * Asynchronous operations, each one is in the list of its file descriptor while in flight.
+     */
+    detail::AsyncOpPool async_ops_;
+
+    /*
+     * Completion of an asynchronous operation, waiting for its callback to be invoked.
+     * Receives complete more than once, the operation is recycled after the final completion.
+     */
+    struct Completion {
+        detail::AsyncOp* op;
+        int result;
+
+        /*
+         * Provided buffer holding received data, -1 if none.
+         */
+        int buffer_id;
+
+        bool is_final;
+    };
+
+    /*
+     * Asynchronous operations completed in the current iteration, only used by the loop thread.
+     */
+    std::vector<Completion> completions_;
+
+    /*
+     * Receives stopped for lack of provided buffers, restarted once buffers are lent again.
+     * Only used by the loop thread.
+     */
+    std::vector<detail::AsyncOp*> starved_receives_;
+
+    /*
+     * Buffers receives land in, provided on the first receive.
+     * Declared before the ring so it's released after it.
+     */
+    std::unique_ptr<detail::ProvidedBuffers> buffers_;
+
+    /*
+     * Poll requests, lent back buffers and restarted receives waiting to be submitted, only used by the loop thread.
+     */
+    std::vector<io_uring_sqe> loop_sqes_;
+
+    /*
+     * Requests of asynchronous operations and provided buffers waiting for the loop thread to submit them.
+     */
+    std::vector<io_uring_sqe> pending_sqes_;
+
+    /*
+     * Timers armed on the loop.
+     */
+    detail::Timers timers_;
+
+    /*
+     * Mutex to protect access to request state, pending requests and timers.
+     * Registrations only lock the shard of their descriptor in the table.
+     */
+    std::mutex mutex_;
+
+    /*
+     * Handlers ready in the current iteration, only used by the loop thread.
+     */
+    detail::ReadyHandlers ready_handlers_{static_cast<size_t>(CQ_ENTRIES) * detail::EVENT_TYPE_COUNT};
+
+    /*
+     * Io_uring instance, only used by the loop thread once constructed.
+     */
+    detail::Uring ring_{SQ_ENTRIES, CQ_ENTRIES};
+
+    /*
+     * Event file descriptor for immediate wakeup.
+     */
+    int wakeup_fd_{-1};
+
+   public:
+    EventLoopIoUring() {
+        // Create eventfd for immediate wakeup
+        wakeup_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (wakeup_fd_ == -1) {
+            throw std::system_error(errno, std::system_category(), "Failed to create wakeup eventfd");
+        }
+
+        // Watch it for the lifetime of the loop, submitted with the first wait
+        loop_sqes_.reserve(SQ_ENTRIES);
+        pending_sqes_.reserve(SQ_ENTRIES);
+        queue_wakeup_poll();
+    }
+
+    ~EventLoopIoUring() noexcept override {
+        if (wakeup_fd_ != -1) close(wakeup_fd_);
+    }
+
+    [[nodiscard]] bool is_running() const noexcept override {
+        return is_running_.load();
+    }
+
+    bool set_options(const LoopOptions& options) noexcept override {
+        return settings_.set(options);
+    }
+
+    [[nodiscard]] LoopOptions options() const noexcept override {
+        return settings_.get();
+    }
+
+    [[nodiscard]] BusyPollStats busy_poll_stats() const noexcept override {
+        return busy_poll_.stats();
+    }
+
+    [[nodiscard]] LoopStats stats() const noexcept override {
+        return stats_.snapshot();
+    }
+
+    bool set_tracing(bool is_enabled) noexcept override {
+        return trace_.set_enabled(is_enabled);
+    }
+
+    [[nodiscard]] const TraceBuffer* trace() const noexcept override {
+        return trace_.buffer();
+    }
+
+    using EventLoop::add_fd;
+
+    bool add_fd(int fd, EventType type, UniqueEventCallback&& callback, EventMode mode) noexcept override {
+        if (!register_fd(fd, type, std::move(callback), mode)) return false;
+        return wakeup();
+    }
+
+    bool add_fd_exclusive(int fd, EventType type, UniqueEventCallback&& callback, EventMode mode) noexcept override {
+        if (!register_fd(fd, type, std::move(callback), mode, true)) return false;
+        return wakeup();
+    }
+
+    bool add_fd(int fd, ReadyMask interest, FdHandler* handler, void* user_data, EventMode mode) noexcept override {
+        if (!register_handler(fd, interest, handler, user_data, mode)) return false;
+        return wakeup();
+    }
+
+    bool add_fds(std::span<const Registration> registrations) noexcept override {
+        for (const auto& [fd, type, callback, mode] : registrations) {
+            if (!register_fd(fd, type, UniqueEventCallback(callback), mode)) return wakeup_after_error();
+        }
+        return wakeup();
+    }
+
+    bool add_fds(std::span<const HandlerRegistration> registrations) noexcept override {
+        for (const auto& [fd, interest, handler, user_data, mode] : registrations) {
+            if (!register_handler(fd, interest, handler, user_data, mode)) return wakeup_after_error();
+        }
+        return wakeup();
+    }
+
+    bool remove_fd(int fd, EventType type) noexcept override {
+        unregister_fd(fd, type);
+        return wakeup();
+    }
+
+    bool remove_fds(std::span<const FdEvent> events) noexcept override {
+        for (const auto& [fd, type] : events) {
+            unregister_fd(fd, type);
+        }
+        return wakeup();
+    }
+
+    bool rearm_fd(int fd) noexcept override {
+        if (event_callbacks_.mask(fd) == 0) {
+            errno = ENOENT;
+            return false;
+        }
+
+        // Only oneshot registrations get disarmed, the loop leaves a pending poll request alone
+        if (event_callbacks_.mode(fd) != EventMode::ONESHOT) {
+            return true;
+        }
+
+        event_callbacks_.mark_changed(fd);
+        return wakeup();
+    }
+
+    TimerId add_timer(std::chrono::nanoseconds delay, const TimerCallback& callback) noexcept override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        TimerId id = timers_.add(delay, callback);
+        if (!wakeup()) {
+            timers_.cancel(id);
+            return 0;
+        }
+        return id;
+    }
+
+    bool reset_timer(TimerId id, std::chrono::nanoseconds delay) noexcept override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!timers_.reset(id, delay)) {
+            errno = ENOENT;
+            return false;
+        }
+        return wakeup();
+    }
+
+    bool cancel_timer(TimerId id) noexcept override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return timers_.cancel(id);
+    }
+
+    bool post(Task task) noexcept override {
+        if (!tasks_.push(std::move(task))) return false;
+        return wakeup();
+    }
+
+    bool async_read(int fd, std::span<std::byte> buffer, const CompletionCallback& callback) noexcept override {
+        return submit_async(detail::AsyncKind::READ, fd, buffer.data(), buffer.size(), {}, callback);
+    }
+
+    bool async_write(int fd, std::span<const std::byte> data, const CompletionCallback& callback) noexcept override {
+        return submit_async(detail::AsyncKind::WRITE, fd, const_cast<std::byte*>(data.data()), data.size(), {}, callback);
+    }
+
+    bool async_writev(int fd, std::span<const iovec> buffers, const CompletionCallback& callback) noexcept override {
+        return submit_async(detail::AsyncKind::WRITEV, fd, nullptr, 0, buffers, callback);
+    }
+
+    bool async_accept(int fd, const CompletionCallback& callback) noexcept override {
+        return submit_async(detail::AsyncKind::ACCEPT, fd, nullptr, 0, {}, callback);
+    }
+
+    bool async_recv(int fd, const ReceiveCallback& callback) noexcept override {
+        return submit_async(detail::AsyncKind::RECV, fd, nullptr, 0, {}, nullptr, callback);
+    }
+
+    bool cancel_async(int fd) noexcept override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (fd < 0 || static_cast<size_t>(fd) >= fds_.size()) return true;
+
+        // Make room for the cancellations first, so all operations are cancelled or none
+        size_t op_count = 0;
+        for (detail::AsyncOp* op = fds_[static_cast<size_t>(fd)].ops.front(); op != nullptr; op = op->next) {
+            ++op_count;
+        }
+        try {
+            pending_sqes_.reserve(pending_sqes_.size() + op_count);
+        } catch (const std::bad_alloc&) {
+            errno = ENOMEM;
+            return false;
+        }
+
+        // Completions report the cancellation, or the result if they finished first
+        bool has_ops = false;
+        for (detail::AsyncOp* op = fds_[static_cast<size_t>(fd)].ops.front(); op != nullptr; op = op->next) {
+            op->is_cancelled = true;
+            io_uring_sqe& sqe = queue_sqe(IORING_OP_ASYNC_CANCEL, -1, IGNORED_DATA);
+            sqe.addr = reinterpret_cast<uintptr_t>(op);
+            has_ops = true;
+        }
+        return !has_ops || wakeup();
+    }
+
+    void start() override {
+        detail::LoopThread::Scope loop_thread_scope(loop_thread_);
+        is_running_.store(true);
+
+        while (is_running_.load()) {
+            stats_.on_iteration();
+
+            // Pick up changed options, then finish the callbacks left over by the budget before waiting again
+            settings_.refresh();
+            if (ready_handlers_.is_pending()) {
+                run_callbacks();
+                continue;
+            }
+
+            // Submit queued requests and wait for completions, or until the next timer is due
+            __kernel_timespec timeout{};
+            bool has_timeout = submit_pending(timeout);
+
+            // Poll instead of blocking while busy polling
+            bool is_blocking = !has_timeout || timeout.tv_sec != 0 || timeout.tv_nsec != 0;
+            if (busy_poll_.should_spin(is_blocking, settings_.current().busy_poll)) {
+                timeout = {};
+                has_timeout = true;
+            }
+            trace_.record(TraceKind::WAIT_BEGIN);
+            auto wait_start = stats_.begin_wait();
+            if (!ring_.submit_and_wait(has_timeout ? &timeout : nullptr)) {
+                throw std::system_error(errno, std::system_category(), "Failed to wait for events");
+            }
+            stats_.end_wait(wait_start, ring_.cq_ready());
+            trace_.record(TraceKind::WAIT_END, -1, ring_.cq_ready());
+
+            // Collect ready handlers, the table keeps them alive if callbacks modify it.
+            // The mutex is only taken once an asynchronous operation completes
+            {
+                std::unique_lock<std::mutex> lock(mutex_, std::defer_lock);
+                unsigned completed = ring_.for_each_cqe([&](const io_uring_cqe& cqe) { complete(cqe, lock); });
+                busy_poll_.record(completed > 0 || !tasks_.empty());
+            }
+
+            // The completions drained the wakeup buffer, wakeups issued from now on need another write.
+            // The exchange makes the work of wakeups coalesced until then visible
+            is_wakeup_pending_.exchange(false);
+
+            run_callbacks();
+        }
+    }
+
+    bool stop() noexcept override {
+        if (!is_running_.exchange(false)) return true;
+        return wakeup();
+    }
+
+   private:
+    /*
+     * Invoke a round of callbacks within the limits of the options,
+     * ready handlers first, then posted tasks and due timers.
+     */
+    void run_callbacks() {
+        const LoopOptions& options = settings_.current();
+
+        // Execute callbacks for ready events, skipping removed ones
+        ready_handlers_.dispatch(event_callbacks_, stats_, trace_, options.max_callbacks, options.callback_budget);
+
+        // Execute callbacks of completed operations
+        dispatch_completions();
+
+        // Run tasks posted so far
+        tasks_.run(options.max_tasks);
+
+        // Fire timers that are due
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            timers_.collect();
+        }
+        timers_.dispatch(mutex_);
+    }
+
+    /*
+     * Register a callback, same as add_fd() but without waking up the loop,
+     * or add_fd_exclusive() with `is_exclusive`.
+     * Errors the kernel reports for the file descriptor itself surface
+     * asynchronously, the registration then never fires.
+     * Locks the shard of the file descriptor.
+     */
+    bool register_fd(int fd, EventType type, UniqueEventCallback&& callback, EventMode mode,
+                     bool is_exclusive = false) noexcept {
+        if (!detail::HandlerTable::can_insert(fd)) return false;
+        auto lock = event_callbacks_.lock(fd);
+
+        // File descriptors registered with an FdHandler take no callbacks
+        if (event_callbacks_.has_fd_handler(fd)) {
+            errno = EINVAL;
+            return false;
+        }
+
+        // Check if already registered
+        uint8_t mask = event_callbacks_.mask(fd);
+        if ((mask & detail::event_bit(type)) != 0) {
+            if (!is_exclusive) return true;
+            errno = EBUSY;
+            return false;
+        }
+
+        // A single poll request covers the whole FD, so all event types must share the mode
+        if (mask != 0 && event_callbacks_.mode(fd) != mode) {
+            errno = EINVAL;
+            return false;
+        }
+
+        // Register the callback, the loop replaces the poll request with one covering the new mask
+        event_callbacks_.insert(fd, type, std::move(callback), mode);
+        event_callbacks_.mark_changed(fd);
+
+        return true;
+    }
+
+    /*
+     * Register an FdHandler, same as add_fd() but without waking up the loop.
+     * Locks the shard of the file descriptor.
+     */
+    bool register_handler(int fd, ReadyMask interest, FdHandler* handler, void* user_data, EventMode mode) noexcept {
+        uint8_t mask = detail::to_event_mask(interest);
+        auto lock = event_callbacks_.lock(fd);
+        if (!event_callbacks_.can_insert(fd, mask, handler)) return false;
+
+        // Register the handler, the loop replaces the poll request with one covering the new interest
+        event_callbacks_.insert(fd, mask, handler, user_data, mode);
+        event_callbacks_.mark_changed(fd);
+
+        return true;
+    }
+
+    /*
+     * Unregister a callback, same as remove_fd() but without waking up the loop.
+     * Locks the shard of the file descriptor.
+     */
+    void unregister_fd(int fd, EventType type) noexcept {
+        auto lock = event_callbacks_.lock(fd);
+
+        // Remove the callback, no-op if already unregistered
+        if (!event_callbacks_.erase(fd, type)) {
+            return;
+        }
+
+        // The loop replaces the poll request with one covering the remaining types, if any
+        event_callbacks_.mark_changed(fd);
+    }
+
+    /*
+     * Grow the request state to fit the file descriptor.
+     * Must be called with the mutex held.
+     */
+    void reserve_fd(int fd) {
+        if (static_cast<size_t>(fd) >= fds_.size()) {
+            fds_.resize(std::max(static_cast<size_t>(fd) + 1, fds_.size() * 2));
+        }
+    }
+
+    /*
+     * Queue an asynchronous operation, submitted along with the next wait.
+     */
+    bool submit_async(detail::AsyncKind kind, int fd, void* buffer, size_t size, std::span<const iovec> buffers,
+                      const CompletionCallback& callback, const ReceiveCallback& receive_callback = nullptr) noexcept {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (fd < 0) {
+            errno = EBADF;
+            return false;
+        }
+
+        detail::AsyncOp* op = nullptr;
+        try {
+            reserve_fd(fd);
+
+            // Provided buffers are only set up once something receives into them
+            if (kind == detail::AsyncKind::RECV && buffers_ == nullptr) {
+                buffers_ = std::make_unique<detail::ProvidedBuffers>(BUFFER_COUNT, BUFFER_SIZE);
+                buffers_->provide_all(queue_sqe(IORING_OP_PROVIDE_BUFFERS, -1, IGNORED_DATA), BUFFER_GROUP);
+            }
+            op = async_ops_.allocate(kind, fd, buffer, size, buffers, callback, receive_callback);
+        } catch (const std::system_error& error) {
+            errno = error.code().value();
+            return false;
+        } catch (const std::bad_alloc&) {
+            errno = ENOMEM;
+            return false;
+        }
+        fds_[static_cast<size_t>(fd)].ops.push_back(op);
+        queue_async(op, pending_sqes_);
+
+        return wakeup();
+    }
+
+    /*
+     * Queue the request of an asynchronous operation to `sqes`.
+     * Must be called with the mutex held.
+     */
+    void queue_async(detail::AsyncOp* op, std::vector<io_uring_sqe>& sqes) {
+        // Offset -1 uses the current file position, like read() and write()
+        auto user_data = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(op));
+        auto length = static_cast<uint32_t>(std::min<size_t>(op->size, UINT32_MAX));
+        int fd = op->fd;
+        switch (op->kind) {
+            case detail::AsyncKind::READ: {
+                io_uring_sqe& sqe = emplace_sqe(sqes, IORING_OP_READ, fd, user_data);
+                sqe.addr = reinterpret_cast<uintptr_t>(op->buffer);
+                sqe.len = length;
+                sqe.off = ~uint64_t{0};
+                break;
+            }
+            case detail::AsyncKind::WRITE: {
+                io_uring_sqe& sqe = emplace_sqe(sqes, IORING_OP_WRITE, fd, user_data);
+                sqe.addr = reinterpret_cast<uintptr_t>(op->buffer);
+                sqe.len = length;
+                sqe.off = ~uint64_t{0};
+                break;
+            }
+            case detail::AsyncKind::WRITEV: {
+                io_uring_sqe& sqe = emplace_sqe(sqes, IORING_OP_WRITEV, fd, user_data);
+                sqe.addr = reinterpret_cast<uintptr_t>(op->buffers.data());
+                sqe.len = static_cast<uint32_t>(std::min<size_t>(op->buffers.size(), IOV_MAX));
+                sqe.off = ~uint64_t{0};
+                break;
+            }
+            case detail::AsyncKind::ACCEPT: {
+                io_uring_sqe& sqe = emplace_sqe(sqes, IORING_OP_ACCEPT, fd, user_data);
+                sqe.accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+                break;
+            }
+            case detail::AsyncKind::RECV: {
+                // Multishot, the kernel picks a provided buffer for every chunk
+                io_uring_sqe& sqe = emplace_sqe(sqes, IORING_OP_RECV, fd, user_data);
+                sqe.ioprio = IORING_RECV_MULTISHOT;
+                sqe.flags = IOSQE_BUFFER_SELECT;
+                sqe.buf_group = BUFFER_GROUP;
+                break;
+            }
+        }
+    }
+
+    /*
+     * Invoke the callbacks of the operations completed in this iteration.
+     * Must be called without the mutex held.
+     */
+    void dispatch_completions() {
+        // Make room for the requests of the release up front, it can't fail once callbacks ran
+        size_t release_count = 2 * starved_receives_.size();
+        for (const auto& completion : completions_) {
+            if (completion.buffer_id >= 0) ++release_count;
+        }
+        loop_sqes_.reserve(loop_sqes_.size() + release_count);
+
+        // Release buffers and operations even if a callback throws, so completions aren't invoked twice
+        struct ReleaseGuard {
+            EventLoopIoUring& loop;
+
+            ~ReleaseGuard() noexcept {
+                std::lock_guard<std::mutex> lock(loop.mutex_);
+                for (const auto& completion : loop.completions_) {
+                    if (completion.buffer_id >= 0) loop.provide_buffer(static_cast<uint16_t>(completion.buffer_id));
+                    if (completion.is_final) loop.async_ops_.recycle(completion.op);
+                }
+                loop.completions_.clear();
+                loop.restart_starved_receives();
+            }
+        } guard{*this};
+
+        for (const auto& [op, result, buffer_id, is_final] : completions_) {
+            if (op->kind != detail::AsyncKind::RECV) {
+                op->callback(result);
+                continue;
+            }
+
+            std::span<const std::byte> data;
+            if (buffer_id >= 0 && result > 0) {
+                data = buffers_->buffer(static_cast<uint16_t>(buffer_id)).first(static_cast<size_t>(result));
+            }
+            op->receive_callback(result, data);
+        }
+    }
+
+    /*
+     * Lend a provided buffer back to the kernel.
+     * Must be called with the mutex held, and room reserved for the request.
+     */
+    void provide_buffer(uint16_t id) {
+        buffers_->provide(queue_loop_sqe(IORING_OP_PROVIDE_BUFFERS, -1, IGNORED_DATA), BUFFER_GROUP, id);
+    }
+
+    /*
+     * Restart receives stopped for lack of buffers, queued after the buffers lent meanwhile.
+     * Those cancelled while stopped are restarted and cancelled again, so they still complete.
+     * Must be called with the mutex held, and room reserved for two requests per receive.
+     */
+    void restart_starved_receives() {
+        for (detail::AsyncOp* op : starved_receives_) {
+            queue_async(op, loop_sqes_);
+            if (!op->is_cancelled) continue;
+            io_uring_sqe& sqe = queue_loop_sqe(IORING_OP_ASYNC_CANCEL, -1, IGNORED_DATA);
+            sqe.addr = reinterpret_cast<uintptr_t>(op);
+        }
+        starved_receives_.clear();
+    }
+
+    /*
+     * Bring the poll request of the file descriptor in line with its registrations, rearming it.
+     * A pending request watching the same event types in the same mode is left alone.
+     * Only called by the loop thread. Throws `std::bad_alloc` on allocation failure.
+     */
+    void apply_changes(int fd) {
+        if (static_cast<size_t>(fd) >= polls_.size()) {
+            polls_.resize(std::max(static_cast<size_t>(fd) + 1, polls_.size() * 2));
+        }
+        const PollState& poll = polls_[static_cast<size_t>(fd)];
+        if (poll.is_armed && poll.mask == event_callbacks_.mask(fd) && poll.mode == event_callbacks_.mode(fd)) return;
+        arm(fd);
+    }
+
+    /*
+     * Queue a poll request for the registered event types of the file descriptor,
+     * removing the pending one if any.
+     * Only called by the loop thread.
+     */
+    void arm(int fd) {
+        PollState& poll = polls_[static_cast<size_t>(fd)];
+        if (poll.is_armed) {
+            io_uring_sqe& sqe = queue_loop_sqe(IORING_OP_POLL_REMOVE, -1, IGNORED_DATA);
+            sqe.addr = poll_data(fd, poll.generation);
+            stats_.on_registration_changes();
+            trace_.record(TraceKind::REGISTRATION, fd, 1);
+        }
+        poll.generation = (poll.generation + 1) & GENERATION_MASK;
+
+        uint8_t mask = event_callbacks_.mask(fd);
+        EventMode mode = event_callbacks_.mode(fd);
+        poll.is_armed = mask != 0;
+        poll.mask = mask;
+        poll.mode = mode;
+        if (mask == 0) return;
+
+        // Multishot polls only report readiness changes, level-triggered ones are re-armed after each event
+        io_uring_sqe& sqe = queue_loop_sqe(IORING_OP_POLL_ADD, fd, poll_data(fd, poll.generation));
+        sqe.poll32_events = to_poll_events(mask);
+        sqe.len = mode == EventMode::EDGE ? IORING_POLL_ADD_MULTI : 0;
+        stats_.on_registration_changes();
+        trace_.record(TraceKind::REGISTRATION, fd, 1);
+    }
+
+    /*
+     * Queue the poll request of the wakeup file descriptor.
+     * Only called by the loop thread, or before the loop is shared.
+     */
+    void queue_wakeup_poll() {
+        io_uring_sqe& sqe = queue_loop_sqe(IORING_OP_POLL_ADD, wakeup_fd_, WAKEUP_DATA);
+        sqe.poll32_events = POLLIN;
+        sqe.len = IORING_POLL_ADD_MULTI;
+    }
+
+    /*
+     * Queue a zeroed request for the loop thread to submit.
+     * Must be called with the mutex held.
+     */
+    io_uring_sqe& queue_sqe(uint8_t opcode, int fd, uint64_t user_data) {
+        return emplace_sqe(pending_sqes_, opcode, fd, user_data);
+    }
+
+    /*
+     * Queue a zeroed request without locking.
+     * Only called by the loop thread.
+     */
+    io_uring_sqe& queue_loop_sqe(uint8_t opcode, int fd, uint64_t user_data) {
+        return emplace_sqe(loop_sqes_, opcode, fd, user_data);
+    }
+
+    /*
+     * Append a zeroed request to the queue.
+     */
+    static io_uring_sqe& emplace_sqe(std::vector<io_uring_sqe>& sqes, uint8_t opcode, int fd, uint64_t user_data) {
+        io_uring_sqe& sqe = sqes.emplace_back();
+        sqe.opcode = opcode;
+        sqe.fd = fd;
+        sqe.user_data = user_data;
+        return sqe;
+    }
+
+    /*
+     * Move the queued requests to the submission ring, submitting early if it fills up.
+     * Returns false if the kernel takes no more, e.g. while completions overflow,
+     * the rest then stays queued until completions are reaped.
+     */
+    bool submit_sqes(std::vector<io_uring_sqe>& sqes) {
+        size_t moved = 0;
+        for (; moved < sqes.size(); ++moved) {
+            io_uring_sqe* sqe = ring_.get_sqe();
+            if (sqe == nullptr) {
+                if (!ring_.submit()) {
+                    throw std::system_error(errno, std::system_category(), "Failed to submit requests");
+                }
+                sqe = ring_.get_sqe();
+                if (sqe == nullptr) break;
+            }
+            *sqe = sqes[moved];
+        }
+
+        bool is_all_moved = moved == sqes.size();
+        sqes.erase(sqes.begin(), sqes.begin() + static_cast<std::ptrdiff_t>(moved));
+        return is_all_moved;
+    }
+
+    /*
+     * Queue the poll requests of the registrations marked in the table,
+     * then move them and the requests queued under lock to the submission ring.
+     * Sets the wait timeout until the next timer deadline, returns false if there is none.
+     * The timeout is zero if posted tasks are waiting to run, or requests are left queued.
+     */
+    bool submit_pending(__kernel_timespec& timeout) {
+        event_callbacks_.take_changed([this](int fd) { apply_changes(fd); });
+        bool is_submitted = submit_sqes(loop_sqes_);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        is_submitted = submit_sqes(pending_sqes_) && is_submitted;
+
+        // Don't block with tasks already waiting, or with requests the kernel has yet to take
+        if (!tasks_.empty() || !is_submitted) return true;
+
+        auto deadline = timers_.next_deadline();
+        if (!deadline) return false;
+
+        auto remaining = std::chrono::duration_cast<std::chrono::nanoseconds>(*deadline - detail::Timers::Clock::now());
+        remaining = std::max(remaining, std::chrono::nanoseconds::zero());
+        timeout.tv_sec = remaining.count() / 1'000'000'000;
+        timeout.tv_nsec = remaining.count() % 1'000'000'000;
+        return true;
+    }
+
+    /*
+     * Handle a single completion, collecting the handlers of ready event types.
+     * Locks the mutex for completions of asynchronous operations, if not locked already.
+     */
+    void complete(const io_uring_cqe& cqe, std::unique_lock<std::mutex>& lock) {
+        bool is_done = (cqe.flags & IORING_CQE_F_MORE) == 0;
+
+        if (cqe.user_data == IGNORED_DATA) return;
+        if (cqe.user_data == WAKEUP_DATA) {
+            // Drain the wakeup buffer
+            uint64_t buffer;
+            while (read(wakeup_fd_, &buffer, sizeof(buffer)) > 0) {
+            }
+            if (is_done) queue_wakeup_poll();
+            return;
+        }
+
+        if ((cqe.user_data & POLL_TAG) == 0) {
+            if (!lock.owns_lock()) lock.lock();
+            complete_async(cqe, is_done);
+            return;
+        }
+
+        // Skip completions of replaced poll requests
+        int fd = static_cast<int>(static_cast<uint32_t>(cqe.user_data));
+        auto generation = static_cast<uint32_t>((cqe.user_data & ~POLL_TAG) >> 32);
+        PollState& poll = polls_[static_cast<size_t>(fd)];
+        if (poll.generation != generation) return;
+
+        if (is_done) poll.is_armed = false;
+
+        // Leave the FD disarmed if the kernel rejected it
+        if (cqe.res < 0) return;
+
+        auto poll_events = static_cast<uint32_t>(cqe.res);
+        ready_handlers_.collect(event_callbacks_, fd, poll_events);
+
+        // Re-arm all but oneshot registrations, submitted after the callbacks ran
+        if (is_done && event_callbacks_.mode(fd) != EventMode::ONESHOT) {
+            arm(fd);
+        }
+    }
+
+    /*
+     * Handle a completion of an asynchronous operation.
+     * Must be called with the mutex held.
+     */
+    void complete_async(const io_uring_cqe& cqe, bool is_done) {
+        auto* op = reinterpret_cast<detail::AsyncOp*>(static_cast<uintptr_t>(cqe.user_data));
+        int buffer_id = (cqe.flags & IORING_CQE_F_BUFFER) != 0 ? static_cast<int>(cqe.flags >> IORING_CQE_BUFFER_SHIFT) : -1;
+
+        if (op->kind == detail::AsyncKind::RECV && is_done) {
+            // Multishot receives stop when out of buffers or when the kernel decides to, restart those
+            bool is_interrupted = cqe.res > 0 || cqe.res == -ENOBUFS;
+            if (is_interrupted && !op->is_cancelled) {
+                if (cqe.res > 0) {
+                    completions_.push_back({op, cqe.res, buffer_id, false});
+                    queue_async(op, pending_sqes_);
+                } else {
+                    // Only after the buffers consumed in this iteration are lent again, retrying now would spin
+                    starved_receives_.push_back(op);
+                }
+                return;
+            }
+
+            // Cancelled while interrupted, deliver the data and report the cancellation after it
+            if (is_interrupted) {
+                if (cqe.res > 0) completions_.push_back({op, cqe.res, buffer_id, false});
+                fds_[static_cast<size_t>(op->fd)].ops.erase(op);
+                completions_.push_back({op, -ECANCELED, -1, true});
+                return;
+            }
+        }
+
+        if (is_done) fds_[static_cast<size_t>(op->fd)].ops.erase(op);
+        completions_.push_back({op, cqe.res, buffer_id, is_done});
+    }
+
+    /*
+     * Get the user data identifying the poll request of the file descriptor.
+     */
+    static uint64_t poll_data(int fd, uint32_t generation) noexcept {
+        return POLL_TAG | (static_cast<uint64_t>(generation & GENERATION_MASK) << 32) | static_cast<uint32_t>(fd);
+    }
+
+    /*
+     * Convert a mask of registered event types to poll events.
+     */
+    static uint32_t to_poll_events(uint8_t mask) noexcept {
+        uint32_t events = 0;
+        if (mask & detail::event_bit(EventType::READ)) events |= POLLIN | POLLRDHUP;
+        if (mask & detail::event_bit(EventType::WRITE)) events |= POLLOUT;
+        return events;
+    }
+
+    /*
+     * Wake up the event loop if it's blocked.
+     * No-op if already awake or called from the loop thread,
+     * changes made there are picked up before the next wait.
+     * Coalesced with a wakeup that's still pending.
+     */
+    bool wakeup() noexcept {
+        if (loop_thread_.is_current()) return true;
+        if (is_wakeup_pending_.exchange(true)) {
+            stats_.on_wakeup_coalesced();
+            return true;
+        }
+
+        uint64_t value = 1;
+        if (write(wakeup_fd_, &value, sizeof(value)) == -1 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            is_wakeup_pending_.store(false);
+            return false;
+        }
+        stats_.on_wakeup_issued();
+        trace_.record(TraceKind::WAKEUP);
+        return true;
+    }
+
+    /*
+     * Wake up the loop after a batch failed midway, so the changes applied so far are picked up.
+     * Always returns false, preserving errno of the failure.
+     */
+    bool wakeup_after_error() noexcept {
+        int error = errno;
+        wakeup();
+        errno = error;
+        return false;
+    }
+};
+
+}  // namespace loopp
@@ -0,0 +1,637 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/event.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "loopp/detail/async_ops.hpp"
+#include "loopp/detail/busy_poll.hpp"
+#include "loopp/detail/handler_table.hpp"
+#include "loopp/detail/loop_options.hpp"
+#include "loopp/detail/loop_stats.hpp"
+#include "loopp/detail/loop_trace.hpp"
+#include "loopp/detail/loop_thread.hpp"
+#include "loopp/detail/task_queue.hpp"
+#include "loopp/detail/timer_wheel.hpp"
+#include "loopp/event_loop.hpp"
+
+namespace loopp {
+
+/*
+ * Kqueue-based implementation of the EventLoop.
+ * Supported on macOS and the BSDs.
+ *
+ * Registration changes are queued as a changelist and applied
+ * by the same kevent() call the loop waits in.
+ */
+class EventLoopKqueue final : public EventLoop {
+   private:
+    friend class detail::AsyncEmulation<EventLoopKqueue>;
+
+    /*
+     * Identifier of the user event used for immediate wakeup.
+     */
+    static constexpr uintptr_t WAKEUP_IDENT = 0;
+
+    /*
+     * Indicates if the event loop is running.
+     */
+    std::atomic<bool> is_running_{false};
+
+    /*
+     * Thread running the event loop, its mutations don't need a wakeup.
+     */
+    detail::LoopThread loop_thread_;
+
+    /*
+     * Set once a wakeup was issued, until the loop wakes up.
+     * Further wakeups are coalesced into the pending one.
+     */
+    std::atomic<bool> is_wakeup_pending_{false};
+
+    /*
+     * Tasks posted to the loop thread, lock-free.
+     */
+    detail::TaskQueue tasks_;
+
+    /*
+     * Options of the loop, adjustable at runtime.
+     */
+    detail::LoopSettings settings_;
+
+    /*
+     * Busy polling state and counters.
+     */
+    detail::BusyPoll busy_poll_;
+
+    /*
+     * Instrumentation, no-ops unless configured in.
+     */
+    detail::Stats stats_;
+
+    /*
+     * Tracing, records nothing until enabled.
+     */
+    detail::Trace trace_;
+
+    /*
+     * Table of file descriptors to their event callbacks.
+     */
+    detail::HandlerTable event_callbacks_;
+
+    /*
+     * Filters added to the kqueue for a file descriptor, as last applied by the loop thread.
+     */
+    struct Filters {
+        uint8_t mask{0};
+        EventMode mode{EventMode::LEVEL};
+
+        /*
+         * Set for oneshot file descriptors disabled after reporting an event.
+         */
+        bool is_disarmed{false};
+    };
+
+    /*
+     * Filters of the file descriptors, indexed by file descriptor, only used by the loop thread.
+     */
+    std::vector<Filters> filters_;
+
+    /*
+     * Changes waiting to be submitted with the next wait, only used by the loop thread.
+     */
+    std::vector<struct kevent> changes_;
+
+    /*
+     * Timers armed on the loop.
+     */
+    detail::Timers timers_;
+
+    /*
+     * Mutex to protect access to timers and asynchronous operations.
+     * Registrations only lock the shard of their descriptor in the table.
+     */
+    std::mutex mutex_;
+
+    /*
+     * Asynchronous operations, emulated with readiness.
+     */
+    detail::AsyncEmulation<EventLoopKqueue> async_{*this};
+
+    /*
+     * Copy of the pending changes and room for the events, only used by the loop thread.
+     * Failed changes are reported as events, so there's room for one per change on top of the limit of events per wait.
+     */
+    std::vector<struct kevent> submitted_changes_;
+    std::vector<struct kevent> events_;
+
+    /*
+     * Handlers ready in the current iteration, only used by the loop thread.
+     * Each event reports a single event type.
+     */
+    detail::ReadyHandlers ready_handlers_{static_cast<size_t>(LoopOptions{}.max_events)};
+
+    /*
+     * File descriptor for the kqueue instance.
+     */
+    int kqueue_fd_{-1};
+
+   public:
+    EventLoopKqueue() {
+        // Create kqueue instance, it isn't inherited by children but may still leak through exec
+        kqueue_fd_ = kqueue();
+        if (kqueue_fd_ == -1) {
+            throw std::system_error(errno, std::system_category(), "Failed to create kqueue instance");
+        }
+        if (fcntl(kqueue_fd_, F_SETFD, FD_CLOEXEC) == -1) {
+            int error = errno;
+            close(kqueue_fd_);
+            kqueue_fd_ = -1;
+            throw std::system_error(error, std::system_category(), "Failed to set close-on-exec on kqueue");
+        }
+
+        // Add the user event for immediate wakeup, cleared once reported
+        struct kevent change;
+        EV_SET(&change, WAKEUP_IDENT, EVFILT_USER, EV_ADD | EV_CLEAR, 0, 0, nullptr);
+        if (kevent(kqueue_fd_, &change, 1, nullptr, 0, nullptr) == -1) {
+            int error = errno;
+            close(kqueue_fd_);
+            kqueue_fd_ = -1;
+            throw std::system_error(error, std::system_category(), "Failed to add wakeup event to kqueue");
+        }
+
+        changes_.reserve(LoopOptions{}.max_events);
+    }
+
+    ~EventLoopKqueue() noexcept override {
+        if (kqueue_fd_ != -1) close(kqueue_fd_);
+    }
+
+    [[nodiscard]] bool is_running() const noexcept override {
+        return is_running_.load();
+    }
+
+    bool set_options(const LoopOptions& options) noexcept override {
+        return settings_.set(options);
+    }
+
+    [[nodiscard]] LoopOptions options() const noexcept override {
+        return settings_.get();
+    }
+
+    [[nodiscard]] BusyPollStats busy_poll_stats() const noexcept override {
+        return busy_poll_.stats();
+    }
+
+    [[nodiscard]] LoopStats stats() const noexcept override {
+        return stats_.snapshot();
+    }
+
+    bool set_tracing(bool is_enabled) noexcept override {
+        return trace_.set_enabled(is_enabled);
+    }
+
+    [[nodiscard]] const TraceBuffer* trace() const noexcept override {
+        return trace_.buffer();
+    }
+
+    using EventLoop::add_fd;
+
+    bool add_fd(int fd, EventType type, UniqueEventCallback&& callback, EventMode mode) noexcept override {
+        if (!register_fd(fd, type, std::move(callback), mode)) return false;
+        return wakeup();
+    }
+
+    bool add_fd_exclusive(int fd, EventType type, UniqueEventCallback&& callback, EventMode mode) noexcept override {
+        if (!register_fd(fd, type, std::move(callback), mode, false, true)) return false;
+        return wakeup();
+    }
+
+    bool add_fd(int fd, ReadyMask interest, FdHandler* handler, void* user_data, EventMode mode) noexcept override {
+        if (!register_handler(fd, interest, handler, user_data, mode)) return false;
+        return wakeup();
+    }
+
+    bool add_fds(std::span<const Registration> registrations) noexcept override {
+        for (const auto& [fd, type, callback, mode] : registrations) {
+            if (!register_fd(fd, type, UniqueEventCallback(callback), mode)) return wakeup_after_error();
+        }
+        return wakeup();
+    }
+
+    bool add_fds(std::span<const HandlerRegistration> registrations) noexcept override {
+        for (const auto& [fd, interest, handler, user_data, mode] : registrations) {
+            if (!register_handler(fd, interest, handler, user_data, mode)) return wakeup_after_error();
+        }
+        return wakeup();
+    }
+
+    bool remove_fd(int fd, EventType type) noexcept override {
+        unregister_fd(fd, type);
+        return wakeup();
+    }
+
+    bool remove_fds(std::span<const FdEvent> events) noexcept override {
+        for (const auto& [fd, type] : events) {
+            unregister_fd(fd, type);
+        }
+        return wakeup();
+    }
+
+    bool rearm_fd(int fd) noexcept override {
+        if (event_callbacks_.mask(fd) == 0) {
+            errno = ENOENT;
+            return false;
+        }
+
+        // Only oneshot registrations get disarmed
+        if (event_callbacks_.mode(fd) != EventMode::ONESHOT) {
+            return true;
+        }
+
+        event_callbacks_.mark_changed(fd);
+        return wakeup();
+    }
+
+    TimerId add_timer(std::chrono::nanoseconds delay, const TimerCallback& callback) noexcept override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        TimerId id = timers_.add(delay, callback);
+        if (!wakeup()) {
+            timers_.cancel(id);
+            return 0;
+        }
+        return id;
+    }
+
+    bool reset_timer(TimerId id, std::chrono::nanoseconds delay) noexcept override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!timers_.reset(id, delay)) {
+            errno = ENOENT;
+            return false;
+        }
+        return wakeup();
+    }
+
+    bool cancel_timer(TimerId id) noexcept override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return timers_.cancel(id);
+    }
+
+    bool post(Task task) noexcept override {
+        if (!tasks_.push(std::move(task))) return false;
+        return wakeup();
+    }
+
+    bool async_read(int fd, std::span<std::byte> buffer, const CompletionCallback& callback) noexcept override {
+        return async_.submit(detail::AsyncKind::READ, fd, buffer.data(), buffer.size(), {}, callback);
+    }
+
+    bool async_write(int fd, std::span<const std::byte> data, const CompletionCallback& callback) noexcept override {
+        return async_.submit(detail::AsyncKind::WRITE, fd, const_cast<std::byte*>(data.data()), data.size(), {}, callback);
+    }
+
+    bool async_writev(int fd, std::span<const iovec> buffers, const CompletionCallback& callback) noexcept override {
+        return async_.submit(detail::AsyncKind::WRITEV, fd, nullptr, 0, buffers, callback);
+    }
+
+    bool async_accept(int fd, const CompletionCallback& callback) noexcept override {
+        return async_.submit(detail::AsyncKind::ACCEPT, fd, nullptr, 0, {}, callback);
+    }
+
+    bool async_recv(int fd, const ReceiveCallback& callback) noexcept override {
+        return async_.submit(detail::AsyncKind::RECV, fd, nullptr, 0, {}, nullptr, callback);
+    }
+
+    bool cancel_async(int fd) noexcept override {
+        return async_.cancel(fd);
+    }
+
+    void start() override {
+        detail::LoopThread::Scope loop_thread_scope(loop_thread_);
+        is_running_.store(true);
+
+        while (is_running_.load()) {
+            stats_.on_iteration();
+
+            // Pick up changed options, then finish the callbacks left over by the budget before waiting again
+            if (settings_.refresh()) apply_options();
+            if (ready_handlers_.is_pending()) {
+                run_callbacks();
+                continue;
+            }
+
+            // Take the changed registrations, and the next timer deadline under lock
+            struct timespec timeout{};
+            bool has_timeout = take_changes(timeout);
+
+            // Poll instead of blocking while busy polling
+            bool is_blocking = !has_timeout || timeout.tv_sec != 0 || timeout.tv_nsec != 0;
+            if (busy_poll_.should_spin(is_blocking, settings_.current().busy_poll)) {
+                timeout = {};
+                has_timeout = true;
+            }
+
+            // Apply the changes and wait for events, or until the next timer is due
+            events_.resize(submitted_changes_.size() + settings_.current().max_events);
+            stats_.on_registration_changes(submitted_changes_.size());
+            if (!submitted_changes_.empty()) trace_.record(TraceKind::REGISTRATION, -1, static_cast<uint32_t>(submitted_changes_.size()));
+            trace_.record(TraceKind::WAIT_BEGIN);
+            auto wait_start = stats_.begin_wait();
+            int ready_count = kevent(kqueue_fd_, submitted_changes_.data(), static_cast<int>(submitted_changes_.size()),
+                                     events_.data(), static_cast<int>(events_.size()), has_timeout ? &timeout : nullptr);
+            trace_.record(TraceKind::WAIT_END, -1, static_cast<uint32_t>(std::max(ready_count, 0)));
+            if (ready_count == -1) {
+                if (errno == EINTR) continue;
+                throw std::system_error(errno, std::system_category(), "Failed to wait for events");
+            }
+            stats_.end_wait(wait_start, static_cast<size_t>(ready_count));
+            busy_poll_.record(ready_count > 0 || !tasks_.empty());
+
+            // The wakeup event is cleared once reported, wakeups issued from now on need another trigger.
+            // The exchange makes the work of wakeups coalesced until then visible
+            is_wakeup_pending_.exchange(false);
+
+            // Collect ready handlers without locking, the table keeps them alive if callbacks modify it
+            for (int i = 0; i < ready_count; ++i) {
+                const struct kevent& event = events_[static_cast<size_t>(i)];
+
+                // Skip the wakeup event and changes the kernel rejected, those registrations never fire
+                if (event.filter == EVFILT_USER || (event.flags & EV_ERROR) != 0) continue;
+
+                // Skip oneshot FDs disarmed by an earlier event of this batch
+                auto fd = static_cast<int>(event.ident);
+                if (static_cast<size_t>(fd) >= filters_.size() || filters_[static_cast<size_t>(fd)].is_disarmed) continue;
+
+                ready_handlers_.collect(event_callbacks_, fd, to_ready_mask(event));
+
+                // Disarm the whole FD, the kernel only disabled the filter that fired
+                if (filters_[static_cast<size_t>(fd)].mode == EventMode::ONESHOT) disarm(fd);
+            }
+
+            run_callbacks();
+        }
+    }
+
+    bool stop() noexcept override {
+        if (!is_running_.exchange(false)) return true;
+        return wakeup();
+    }
+
+   private:
+    /*
+     * Invoke a round of callbacks within the limits of the options,
+     * ready handlers first, then posted tasks and due timers.
+     */
+    void run_callbacks() {
+        const LoopOptions& options = settings_.current();
+
+        // Execute callbacks for ready events, skipping removed ones
+        ready_handlers_.dispatch(event_callbacks_, stats_, trace_, options.max_callbacks, options.callback_budget);
+
+        // Run tasks posted so far
+        tasks_.run(options.max_tasks);
+
+        // Fire timers that are due
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            timers_.collect();
+        }
+        timers_.dispatch(mutex_);
+    }
+
+    /*
+     * Reserve room for the handlers of a wait at the limit of events per wait.
+     * Throws `std::bad_alloc` on allocation failure.
+     */
+    void apply_options() {
+        ready_handlers_.reserve(settings_.current().max_events);
+    }
+
+    /*
+     * Register a callback, same as add_fd() but without waking up the loop,
+     * or add_fd_exclusive() with `is_exclusive`.
+     * Errors the kernel reports for the file descriptor itself surface
+     * when the changes are applied, the registration then never fires.
+     * Handlers reserved for the emulation of asynchronous operations fail with `EBUSY` if the type is taken.
+     * Locks the shard of the file descriptor.
+     */
+    bool register_fd(int fd, EventType type, UniqueEventCallback&& callback, EventMode mode,
+                     bool is_reserved = false, bool is_exclusive = false) noexcept {
+        if (!detail::HandlerTable::can_insert(fd)) return false;
+        auto lock = event_callbacks_.lock(fd);
+
+        // Types with asynchronous operations queued are taken by the emulation
+        if (event_callbacks_.is_reserved(fd, type)) {
+            errno = EBUSY;
+            return false;
+        }
+
+        // File descriptors registered with an FdHandler take no callbacks
+        if (event_callbacks_.has_fd_handler(fd)) {
+            errno = EINVAL;
+            return false;
+        }
+
+        // Check if already registered
+        uint8_t mask = event_callbacks_.mask(fd);
+        if ((mask & detail::event_bit(type)) != 0) {
+            if (!is_reserved && !is_exclusive) return true;
+            errno = EBUSY;
+            return false;
+        }
+
+        // Oneshot disarms the whole FD, so all event types must share the mode
+        if (mask != 0 && event_callbacks_.mode(fd) != mode) {
+            errno = EINVAL;
+            return false;
+        }
+
+        // Register the callback, the loop adds filters for all event types, re-enabling disarmed ones
+        event_callbacks_.insert(fd, type, std::move(callback), mode, is_reserved);
+        event_callbacks_.mark_changed(fd);
+
+        return true;
+    }
+
+    /*
+     * Register an FdHandler, same as add_fd() but without waking up the loop.
+     * Locks the shard of the file descriptor.
+     */
+    bool register_handler(int fd, ReadyMask interest, FdHandler* handler, void* user_data, EventMode mode) noexcept {
+        uint8_t mask = detail::to_event_mask(interest);
+        auto lock = event_callbacks_.lock(fd);
+        if (!event_callbacks_.can_insert(fd, mask, handler)) return false;
+
+        // Register the handler, the loop drops the filters outside the new interest and adds or re-enables the others
+        event_callbacks_.insert(fd, mask, handler, user_data, mode);
+        event_callbacks_.mark_changed(fd);
+
+        return true;
+    }
+
+    /*
+     * Unregister a callback, same as remove_fd() but without waking up the loop.
+     * Handlers reserved for the emulation are only unregistered with `is_reserved`.
+     * Locks the shard of the file descriptor.
+     */
+    void unregister_fd(int fd, EventType type, bool is_reserved = false) noexcept {
+        auto lock = event_callbacks_.lock(fd);
+
+        // Remove the callback, no-op if already unregistered or taken by the emulation
+        if (!event_callbacks_.erase(fd, type, is_reserved)) {
+            return;
+        }
+
+        // The loop deletes the filter
+        event_callbacks_.mark_changed(fd);
+    }
+
+    /*
+     * Queue the changes bringing the filters of the FD in line with its registrations, rearming it.
+     * Only called by the loop thread. Throws `std::bad_alloc` on allocation failure.
+     */
+    void apply_changes(int fd) {
+        if (static_cast<size_t>(fd) >= filters_.size()) {
+            filters_.resize(std::max(static_cast<size_t>(fd) + 1, filters_.size() * 2));
+        }
+        Filters& filters = filters_[static_cast<size_t>(fd)];
+        uint8_t mask = event_callbacks_.mask(fd);
+        EventMode mode = event_callbacks_.mode(fd);
+        if (mask == filters.mask && mode == filters.mode && !filters.is_disarmed) return;
+
+        // Drop the filters outside the registrations, or all of them to change the mode.
+        // Fails if the FD was closed meanwhile, the kernel already dropped its filters then
+        uint8_t dropped = mask == 0 || mode == filters.mode ? filters.mask & static_cast<uint8_t>(~mask) : filters.mask;
+        if (dropped & detail::event_bit(EventType::READ)) queue_change(fd, EVFILT_READ, EV_DELETE);
+        if (dropped & detail::event_bit(EventType::WRITE)) queue_change(fd, EVFILT_WRITE, EV_DELETE);
+
+        // Add or re-enable the others
+        auto flags = static_cast<uint16_t>(EV_ADD | EV_ENABLE | to_flags(mode));
+        if (mask & detail::event_bit(EventType::READ)) queue_change(fd, EVFILT_READ, flags);
+        if (mask & detail::event_bit(EventType::WRITE)) queue_change(fd, EVFILT_WRITE, flags);
+        filters = {mask, mode, false};
+    }
+
+    /*
+     * Queue disabling the filters of the FD.
+     * Only called by the loop thread.
+     */
+    void disarm(int fd) {
+        Filters& filters = filters_[static_cast<size_t>(fd)];
+        if (filters.mask & detail::event_bit(EventType::READ)) queue_change(fd, EVFILT_READ, EV_DISABLE);
+        if (filters.mask & detail::event_bit(EventType::WRITE)) queue_change(fd, EVFILT_WRITE, EV_DISABLE);
+        filters.is_disarmed = true;
+    }
+
+    /*
+     * Queue a change of a filter, submitted with the next wait.
+     */
+    void queue_change(int fd, int16_t filter, uint16_t flags) {
+        struct kevent& change = changes_.emplace_back();
+        EV_SET(&change, static_cast<uintptr_t>(fd), filter, flags, 0, 0, nullptr);
+    }
+
+    /*
+     * Queue the changes of the registrations marked in the table, and move them to the submitted copy.
+     * Sets the wait timeout until the next timer deadline, returns false if there is none.
+     * The timeout is zero if posted tasks are waiting to run.
+     */
+    bool take_changes(struct timespec& timeout) {
+        event_callbacks_.take_changed([this](int fd) { apply_changes(fd); });
+        submitted_changes_.clear();
+        std::swap(submitted_changes_, changes_);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        // Don't block with tasks already waiting
+        if (!tasks_.empty()) return true;
+
+        auto deadline = timers_.next_deadline();
+        if (!deadline) return false;
+
+        auto remaining = std::chrono::duration_cast<std::chrono::nanoseconds>(*deadline - detail::Timers::Clock::now());
+        remaining = std::max(remaining, std::chrono::nanoseconds::zero());
+        timeout.tv_sec = static_cast<time_t>(remaining.count() / 1'000'000'000);
+        timeout.tv_nsec = static_cast<long>(remaining.count() % 1'000'000'000);
+        return true;
+    }
+
+    /*
+     * Convert a reported event to the conditions it stands for.
+     * End of file while reading means the peer shut down its writing side,
+     * while writing that the connection is gone. An error is attached to it if the kernel set one.
+     */
+    static ReadyMask to_ready_mask(const struct kevent& event) noexcept {
+        bool is_write = event.filter == EVFILT_WRITE;
+        ReadyMask ready = is_write ? READY_WRITE : READY_READ;
+        if (event.flags & EV_EOF) ready |= is_write ? READY_HANGUP : READY_READ_HANGUP;
+        if ((event.flags & EV_EOF) && event.fflags != 0) ready |= READY_ERROR;
+        return ready;
+    }
+
+    /*
+     * Get the filter flags providing the mode.
+     * Dispatch only disables the filter that fired, the loop disables the others.
+     */
+    static uint16_t to_flags(EventMode mode) noexcept {
+        switch (mode) {
+            case EventMode::EDGE:
+                return EV_CLEAR;
+            case EventMode::ONESHOT:
+                return EV_DISPATCH;
+            default:
+                return 0;
+        }
+    }
+
+    /*
+     * Wake up the event loop if it's blocked.
+     * No-op if already awake or called from the loop thread,
+     * changes made there are picked up before the next wait.
+     * Coalesced with a wakeup that's still pending.
+     */
+    bool wakeup() noexcept {
+        if (loop_thread_.is_current()) return true;
+        if (is_wakeup_pending_.exchange(true)) {
+            stats_.on_wakeup_coalesced();
+            return true;
+        }
+
+        struct kevent trigger;
+        EV_SET(&trigger, WAKEUP_IDENT, EVFILT_USER, 0, NOTE_TRIGGER, 0, nullptr);
+        if (kevent(kqueue_fd_, &trigger, 1, nullptr, 0, nullptr) == -1) {
+            is_wakeup_pending_.store(false);
+            return false;
+        }
+        stats_.on_wakeup_issued();
+        trace_.record(TraceKind::WAKEUP);
+        return true;
+    }
+
+    /*
+     * Wake up the loop after a batch failed midway, so the changes applied so far are picked up.
+     * Always returns false, preserving errno of the failure.
+     */
+    bool wakeup_after_error() noexcept {
+        int error = errno;
+        wakeup();
+        errno = error;
+        return false;
+    }
+};
+
+}  // namespace loopp
@@ -0,0 +1,655 @@
+#pragma once
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "loopp/detail/async_ops.hpp"
+#include "loopp/detail/busy_poll.hpp"
+#include "loopp/detail/handler_table.hpp"
+#include "loopp/detail/loop_options.hpp"
+#include "loopp/detail/loop_stats.hpp"
+#include "loopp/detail/loop_trace.hpp"
+#include "loopp/detail/loop_thread.hpp"
+#include "loopp/detail/task_queue.hpp"
+#include "loopp/detail/timer_wheel.hpp"
+#include "loopp/event_loop.hpp"
+
+namespace loopp {
+
+/*
+ * Poll-based implementation of the EventLoop.
+ * Supported on all POSIX systems, without the `FD_SETSIZE` limit of select().
+ * Each wait still scans every registered file descriptor.
+ */
+class EventLoopPoll final : public EventLoop {
+   private:
+    friend class detail::AsyncEmulation<EventLoopPoll>;
+
+    /*
+     * Initial capacity of the ready handlers, grows with the number of registered file descriptors.
+     */
+    static constexpr size_t READY_CAPACITY = 1024;
+
+    /*
+     * Indicates if the event loop is running.
+     */
+    std::atomic<bool> is_running_{false};
+
+    /*
+     * Thread running the event loop, its mutations don't need a wakeup.
+     */
+    detail::LoopThread loop_thread_;
+
+    /*
+     * Set once a wakeup was issued, until the loop wakes up.
+     * Further wakeups are coalesced into the pending one.
+     */
+    std::atomic<bool> is_wakeup_pending_{false};
+
+    /*
+     * Tasks posted to the loop thread, lock-free.
+     */
+    detail::TaskQueue tasks_;
+
+    /*
+     * Options of the loop, adjustable at runtime.
+     */
+    detail::LoopSettings settings_;
+
+    /*
+     * Busy polling state and counters.
+     */
+    detail::BusyPoll busy_poll_;
+
+    /*
+     * Instrumentation, no-ops unless configured in.
+     */
+    detail::Stats stats_;
+
+    /*
+     * Tracing, records nothing until enabled.
+     */
+    detail::Trace trace_;
+
+    /*
+     * Table of file descriptors to their event callbacks.
+     */
+    detail::HandlerTable event_callbacks_;
+
+    /*
+     * Entries of the registered file descriptors, the wakeup pipe comes first.
+     * Disarmed ones have their descriptor negated, so poll() skips them.
+     * Only used by the loop thread, which applies the registrations marked in the table.
+     * Should not be passed directly to poll(), copy it first.
+     */
+    std::vector<pollfd> poll_fds_;
+
+    /*
+     * Index of each file descriptor's entry in `poll_fds_`, 0 if it has none.
+     * Only used by the loop thread.
+     */
+    std::vector<size_t> positions_;
+
+    /*
+     * Set when `poll_fds_` changed since the loop last copied it.
+     */
+    bool is_changed_{true};
+
+    /*
+     * Copy of `poll_fds_` passed to poll(), only used by the loop thread.
+     * Kept between iterations and only copied again after changes.
+     */
+    std::vector<pollfd> ready_fds_;
+
+    /*
+     * Timers armed on the loop.
+     */
+    detail::Timers timers_;
+
+    /*
+     * Mutex to protect access to timers and asynchronous operations.
+     * Registrations only lock the shard of their descriptor in the table.
+     */
+    std::mutex mutex_;
+
+    /*
+     * Asynchronous operations, emulated with readiness.
+     */
+    detail::AsyncEmulation<EventLoopPoll> async_{*this};
+
+    /*
+     * Handlers ready in the current iteration, only used by the loop thread.
+     * One READ and one WRITE handler at most per file descriptor.
+     */
+    detail::ReadyHandlers ready_handlers_{READY_CAPACITY * detail::EVENT_TYPE_COUNT};
+
+    /*
+     * Pipe for immediate wakeup.
+     * First element is read end, second is write end.
+     */
+    int wakeup_fd_[2]{-1, -1};
+
+   public:
+    EventLoopPoll() {
+        // Create pipe for immediate wakeup
+        if (pipe(wakeup_fd_) == -1) {
+            throw std::system_error(errno, std::system_category(), "Failed to create wakeup pipe");
+        }
+
+        // Set both ends of the pipe to non-blocking
+        if (fcntl(wakeup_fd_[0], F_SETFL, O_NONBLOCK) == -1 || fcntl(wakeup_fd_[1], F_SETFL, O_NONBLOCK) == -1) {
+            close(wakeup_fd_[0]);
+            close(wakeup_fd_[1]);
+            wakeup_fd_[0] = -1;
+            wakeup_fd_[1] = -1;
+            throw std::system_error(errno, std::system_category(), "Failed to set non-blocking on wakeup pipe");
+        }
+
+        poll_fds_.push_back({wakeup_fd_[0], POLLIN, 0});
+    }
+
+    ~EventLoopPoll() noexcept override {
+        // Close the wakeup pipe
+        if (wakeup_fd_[0] != -1) close(wakeup_fd_[0]);
+        if (wakeup_fd_[1] != -1) close(wakeup_fd_[1]);
+    }
+
+    [[nodiscard]] bool is_running() const noexcept override {
+        return is_running_.load();
+    }
+
+    bool set_options(const LoopOptions& options) noexcept override {
+        return settings_.set(options);
+    }
+
+    [[nodiscard]] LoopOptions options() const noexcept override {
+        return settings_.get();
+    }
+
+    [[nodiscard]] BusyPollStats busy_poll_stats() const noexcept override {
+        return busy_poll_.stats();
+    }
+
+    [[nodiscard]] LoopStats stats() const noexcept override {
+        return stats_.snapshot();
+    }
+
+    bool set_tracing(bool is_enabled) noexcept override {
+        return trace_.set_enabled(is_enabled);
+    }
+
+    [[nodiscard]] const TraceBuffer* trace() const noexcept override {
+        return trace_.buffer();
+    }
+
+    using EventLoop::add_fd;
+
+    bool add_fd(int fd, EventType type, UniqueEventCallback&& callback, EventMode mode) noexcept override {
+        if (!register_fd(fd, type, std::move(callback), mode)) return false;
+        return wakeup();
+    }
+
+    bool add_fd_exclusive(int fd, EventType type, UniqueEventCallback&& callback, EventMode mode) noexcept override {
+        if (!register_fd(fd, type, std::move(callback), mode, false, true)) return false;
+        return wakeup();
+    }
+
+    bool add_fd(int fd, ReadyMask interest, FdHandler* handler, void* user_data, EventMode mode) noexcept override {
+        if (!register_handler(fd, interest, handler, user_data, mode)) return false;
+        return wakeup();
+    }
+
+    bool add_fds(std::span<const Registration> registrations) noexcept override {
+        for (const auto& [fd, type, callback, mode] : registrations) {
+            if (!register_fd(fd, type, UniqueEventCallback(callback), mode)) return wakeup_after_error();
+        }
+        return wakeup();
+    }
+
+    bool add_fds(std::span<const HandlerRegistration> registrations) noexcept override {
+        for (const auto& [fd, interest, handler, user_data, mode] : registrations) {
+            if (!register_handler(fd, interest, handler, user_data, mode)) return wakeup_after_error();
+        }
+        return wakeup();
+    }
+
+    bool remove_fd(int fd, EventType type) noexcept override {
+        if (!unregister_fd(fd, type)) return false;
+        return wakeup();
+    }
+
+    bool remove_fds(std::span<const FdEvent> events) noexcept override {
+        for (const auto& [fd, type] : events) {
+            if (!unregister_fd(fd, type)) return wakeup_after_error();
+        }
+        return wakeup();
+    }
+
+    bool rearm_fd(int fd) noexcept override {
+        if (event_callbacks_.mask(fd) == 0) {
+            errno = ENOENT;
+            return false;
+        }
+
+        // Only oneshot registrations get disarmed
+        if (event_callbacks_.mode(fd) != EventMode::ONESHOT) {
+            return true;
+        }
+
+        event_callbacks_.mark_changed(fd);
+        return wakeup();
+    }
+
+    TimerId add_timer(std::chrono::nanoseconds delay, const TimerCallback& callback) noexcept override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        TimerId id = timers_.add(delay, callback);
+        if (!wakeup()) {
+            timers_.cancel(id);
+            return 0;
+        }
+        return id;
+    }
+
+    bool reset_timer(TimerId id, std::chrono::nanoseconds delay) noexcept override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!timers_.reset(id, delay)) {
+            errno = ENOENT;
+            return false;
+        }
+        return wakeup();
+    }
+
+    bool cancel_timer(TimerId id) noexcept override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return timers_.cancel(id);
+    }
+
+    bool post(Task task) noexcept override {
+        if (!tasks_.push(std::move(task))) return false;
+        return wakeup();
+    }
+
+    bool async_read(int fd, std::span<std::byte> buffer, const CompletionCallback& callback) noexcept override {
+        return async_.submit(detail::AsyncKind::READ, fd, buffer.data(), buffer.size(), {}, callback);
+    }
+
+    bool async_write(int fd, std::span<const std::byte> data, const CompletionCallback& callback) noexcept override {
+        return async_.submit(detail::AsyncKind::WRITE, fd, const_cast<std::byte*>(data.data()), data.size(), {}, callback);
+    }
+
+    bool async_writev(int fd, std::span<const iovec> buffers, const CompletionCallback& callback) noexcept override {
+        return async_.submit(detail::AsyncKind::WRITEV, fd, nullptr, 0, buffers, callback);
+    }
+
+    bool async_accept(int fd, const CompletionCallback& callback) noexcept override {
+        return async_.submit(detail::AsyncKind::ACCEPT, fd, nullptr, 0, {}, callback);
+    }
+
+    bool async_recv(int fd, const ReceiveCallback& callback) noexcept override {
+        return async_.submit(detail::AsyncKind::RECV, fd, nullptr, 0, {}, nullptr, callback);
+    }
+
+    bool cancel_async(int fd) noexcept override {
+        return async_.cancel(fd);
+    }
+
+    void start() override {
+        detail::LoopThread::Scope loop_thread_scope(loop_thread_);
+        is_running_.store(true);
+
+        while (is_running_.load()) {
+            stats_.on_iteration();
+
+            // Pick up changed options, then finish the callbacks left over by the budget before waiting again
+            settings_.refresh();
+            if (ready_handlers_.is_pending()) {
+                run_callbacks();
+                continue;
+            }
+
+            // Apply changed registrations and copy the poll entries if they changed
+            event_callbacks_.take_changed([this](int fd) { apply_changes(fd); });
+            if (is_changed_) {
+                ready_fds_ = poll_fds_;
+                is_changed_ = false;
+            }
+
+            // Get the next timer deadline under lock
+            int timeout_ms;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                timeout_ms = tasks_.empty() ? timers_.timeout_ms() : 0;  // Don't block with tasks waiting
+            }
+
+            // Poll instead of blocking while busy polling
+            if (busy_poll_.should_spin(timeout_ms != 0, settings_.current().busy_poll)) timeout_ms = 0;
+
+            // Wait for events, or until the next timer is due
+            trace_.record(TraceKind::WAIT_BEGIN);
+            auto wait_start = stats_.begin_wait();
+            int ready_count = poll(ready_fds_.data(), static_cast<nfds_t>(ready_fds_.size()), timeout_ms);
+            trace_.record(TraceKind::WAIT_END, -1, static_cast<uint32_t>(std::max(ready_count, 0)));
+            if (ready_count == -1) {
+                if (errno == EINTR) continue;
+                throw std::system_error(errno, std::system_category(), "Failed to wait for events");
+            }
+            stats_.end_wait(wait_start, static_cast<size_t>(ready_count));
+            busy_poll_.record(ready_count > 0 || !tasks_.empty());
+
+            // Drain the wakeup buffer before clearing the flag, wakeups issued from now on need another write.
+            // The exchange makes the work of wakeups coalesced until then visible
+            if (ready_fds_[0].revents != 0) {
+                --ready_count;
+                uint64_t buffer;
+                while (read(wakeup_fd_[0], &buffer, sizeof(buffer)) > 0) {
+                }
+            }
+            is_wakeup_pending_.exchange(false);
+
+            // Collect ready handlers without locking, the table keeps them alive if callbacks modify it
+            for (size_t i = 1; i < ready_fds_.size() && ready_count > 0; ++i) {
+                const pollfd& entry = ready_fds_[i];
+                if (entry.revents == 0) continue;
+                --ready_count;
+
+                // Skip entries disarmed since they were copied
+                int fd = entry.fd;
+                if (!is_armed(fd)) continue;
+
+                // Closed without being removed, stop watching it or every poll() returns right away.
+                // Checked again, the number may have been reused and registered meanwhile
+                if ((entry.revents & POLLNVAL) != 0) {
+                    if (fcntl(fd, F_GETFD) == -1 && errno == EBADF) disarm(fd);
+                    continue;
+                }
+
+                ready_handlers_.collect(event_callbacks_, fd, to_ready_mask(entry.revents));
+
+                // Emulate oneshot by disarming the whole FD once reported
+                if (event_callbacks_.mode(fd) == EventMode::ONESHOT) {
+                    disarm(fd);
+                }
+            }
+
+            run_callbacks();
+        }
+    };
+
+    bool stop() noexcept override {
+        if (!is_running_.exchange(false)) return true;
+        return wakeup();
+    }
+
+   private:
+    /*
+     * Invoke a round of callbacks within the limits of the options,
+     * ready handlers first, then posted tasks and due timers.
+     */
+    void run_callbacks() {
+        const LoopOptions& options = settings_.current();
+
+        // Execute callbacks for ready events, skipping removed ones
+        ready_handlers_.dispatch(event_callbacks_, stats_, trace_, options.max_callbacks, options.callback_budget);
+
+        // Run tasks posted so far
+        tasks_.run(options.max_tasks);
+
+        // Fire timers that are due
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            timers_.collect();
+        }
+        timers_.dispatch(mutex_);
+    }
+
+    /*
+     * Register a callback, same as add_fd() but without waking up the loop,
+     * or add_fd_exclusive() with `is_exclusive`.
+     * Handlers reserved for the emulation of asynchronous operations fail with `EBUSY` if the type is taken.
+     * Locks the shard of the file descriptor.
+     */
+    bool register_fd(int fd, EventType type, UniqueEventCallback&& callback, EventMode mode,
+                     bool is_reserved = false, bool is_exclusive = false) noexcept {
+        if (!detail::HandlerTable::can_insert(fd)) return false;
+        auto lock = event_callbacks_.lock(fd);
+
+        // Types with asynchronous operations queued are taken by the emulation
+        if (event_callbacks_.is_reserved(fd, type)) {
+            errno = EBUSY;
+            return false;
+        }
+
+        // File descriptors registered with an FdHandler take no callbacks
+        if (event_callbacks_.has_fd_handler(fd)) {
+            errno = EINVAL;
+            return false;
+        }
+
+        // Check if already registered
+        uint8_t mask = event_callbacks_.mask(fd);
+        if ((mask & detail::event_bit(type)) != 0) {
+            if (!is_reserved && !is_exclusive) return true;
+            errno = EBUSY;
+            return false;
+        }
+
+        // Poll only reports the current state, edge-triggered can't be emulated reliably
+        if (mode == EventMode::EDGE) {
+            errno = ENOTSUP;
+            return false;
+        }
+
+        // Mode is shared by all event types of the FD
+        if (mask != 0 && event_callbacks_.mode(fd) != mode) {
+            errno = EINVAL;
+            return false;
+        }
+
+        if (type != EventType::READ && type != EventType::WRITE) {
+            errno = EINVAL;
+            return false;
+        }
+
+        // Register the callback, the loop adds the event type to the FD's entry
+        event_callbacks_.insert(fd, type, std::move(callback), mode, is_reserved);
+        event_callbacks_.mark_changed(fd);
+
+        return true;
+    }
+
+    /*
+     * Register an FdHandler, same as add_fd() but without waking up the loop.
+     * Locks the shard of the file descriptor.
+     */
+    bool register_handler(int fd, ReadyMask interest, FdHandler* handler, void* user_data, EventMode mode) noexcept {
+        uint8_t mask = detail::to_event_mask(interest);
+        auto lock = event_callbacks_.lock(fd);
+        if (!event_callbacks_.can_insert(fd, mask, handler)) return false;
+
+        if (mode == EventMode::EDGE) {
+            errno = ENOTSUP;
+            return false;
+        }
+
+        // Register the handler, the loop watches the new interest and rearms the entry
+        event_callbacks_.insert(fd, mask, handler, user_data, mode);
+        event_callbacks_.mark_changed(fd);
+
+        return true;
+    }
+
+    /*
+     * Unregister a callback, same as remove_fd() but without waking up the loop.
+     * Handlers reserved for the emulation are only unregistered with `is_reserved`.
+     * Locks the shard of the file descriptor.
+     */
+    bool unregister_fd(int fd, EventType type, bool is_reserved = false) noexcept {
+        auto lock = event_callbacks_.lock(fd);
+
+        // Check if already unregistered or taken by the emulation
+        if (!event_callbacks_.contains(fd, type) || event_callbacks_.is_reserved(fd, type) != is_reserved) {
+            return true;
+        }
+
+        if (type != EventType::READ && type != EventType::WRITE) {
+            errno = EINVAL;
+            return false;
+        }
+
+        // Remove the callback, the loop updates the FD's entry or drops it if nothing is left
+        event_callbacks_.erase(fd, type, is_reserved);
+        event_callbacks_.mark_changed(fd);
+
+        return true;
+    }
+
+    /*
+     * Update the FD's entry to its current registrations, rearming it, or drop it if there are none.
+     * Only called by the loop thread.
+     * Throws `std::bad_alloc` on allocation failure.
+     */
+    void apply_changes(int fd) {
+        if (event_callbacks_.mask(fd) == 0) {
+            erase(fd);
+        } else {
+            arm(fd);
+        }
+    }
+
+    /*
+     * Set the FD's entry to watch all its registered event types, adding the entry if needed.
+     * Only called by the loop thread.
+     */
+    void arm(int fd) {
+        auto index = static_cast<size_t>(fd);
+        if (index >= positions_.size()) {
+            positions_.resize(std::max(index + 1, positions_.size() * 2));
+        }
+        if (positions_[index] == 0) {
+            positions_[index] = poll_fds_.size();
+            poll_fds_.push_back({fd, 0, 0});
+        }
+
+        pollfd& entry = poll_fds_[positions_[index]];
+        entry.fd = fd;
+        entry.events = to_poll_events(event_callbacks_.mask(fd));
+        is_changed_ = true;
+    }
+
+    /*
+     * Stop watching the FD without dropping its entry, poll() ignores negative descriptors.
+     * Only called by the loop thread.
+     */
+    void disarm(int fd) noexcept {
+        poll_fds_[positions_[static_cast<size_t>(fd)]].fd = -fd - 1;
+        is_changed_ = true;
+    }
+
+    /*
+     * Drop the FD's entry, moving the last entry into its place.
+     * Only called by the loop thread.
+     */
+    void erase(int fd) noexcept {
+        // Registered and removed again before the loop armed it
+        if (static_cast<size_t>(fd) >= positions_.size()) return;
+
+        size_t position = std::exchange(positions_[static_cast<size_t>(fd)], 0);
+        if (position == 0) return;
+
+        if (position != poll_fds_.size() - 1) {
+            poll_fds_[position] = poll_fds_.back();
+            int moved_fd = poll_fds_[position].fd;
+            if (moved_fd < 0) moved_fd = -moved_fd - 1;
+            positions_[static_cast<size_t>(moved_fd)] = position;
+        }
+        poll_fds_.pop_back();
+        is_changed_ = true;
+    }
+
+    /*
+     * Check if the FD has an entry that's currently watched.
+     * Only called by the loop thread.
+     */
+    [[nodiscard]] bool is_armed(int fd) const noexcept {
+        if (static_cast<size_t>(fd) >= positions_.size()) return false;
+        size_t position = positions_[static_cast<size_t>(fd)];
+        return position != 0 && poll_fds_[position].fd == fd;
+    }
+
+    /*
+     * Convert poll events to the conditions they report.
+     */
+    static ReadyMask to_ready_mask(short events) noexcept {
+        ReadyMask ready = 0;
+        if (events & POLLIN) ready |= READY_READ;
+        if (events & POLLOUT) ready |= READY_WRITE;
+        if (events & POLLERR) ready |= READY_ERROR;
+        if (events & POLLHUP) ready |= READY_HANGUP;
+#ifdef POLLRDHUP
+        if (events & POLLRDHUP) ready |= READY_READ_HANGUP;
+#endif
+        return ready;
+    }
+
+    /*
+     * Convert a mask of registered event types to poll events.
+     */
+    static short to_poll_events(uint8_t mask) noexcept {
+        short events = 0;
+        if (mask & detail::event_bit(EventType::READ)) events = static_cast<short>(events | POLLIN);
+#ifdef POLLRDHUP
+        // Linux extension, the peer shutting down its writing side
+        if (mask & detail::event_bit(EventType::READ)) events = static_cast<short>(events | POLLRDHUP);
+#endif
+        if (mask & detail::event_bit(EventType::WRITE)) events = static_cast<short>(events | POLLOUT);
+        return events;
+    }
+
+    /*
+     * Wake up the event loop if it's blocked.
+     * No-op if already awake or called from the loop thread,
+     * changes made there are picked up before the next wait.
+     * Coalesced with a wakeup that's still pending.
+     */
+    bool wakeup() noexcept {
+        if (loop_thread_.is_current()) return true;
+        if (is_wakeup_pending_.exchange(true)) {
+            stats_.on_wakeup_coalesced();
+            return true;
+        }
+
+        if (write(wakeup_fd_[1], "x", 1) == -1 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            is_wakeup_pending_.store(false);
+            return false;
+        }
+        stats_.on_wakeup_issued();
+        trace_.record(TraceKind::WAKEUP);
+        return true;
+    }
+
+    /*
+     * Wake up the loop after a batch failed midway, so the changes applied so far are picked up.
+     * Always returns false, preserving errno of the failure.
+     */
+    bool wakeup_after_error() noexcept {
+        int error = errno;
+        wakeup();
+        errno = error;
+        return false;
+    }
+};
+
+}  // namespace loopp
@@ -0,0 +1,569 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/select.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "loopp/detail/async_ops.hpp"
+#include "loopp/detail/busy_poll.hpp"
+#include "loopp/detail/handler_table.hpp"
+#include "loopp/detail/loop_options.hpp"
+#include "loopp/detail/loop_stats.hpp"
+#include "loopp/detail/loop_trace.hpp"
+#include "loopp/detail/loop_thread.hpp"
+#include "loopp/detail/task_queue.hpp"
+#include "loopp/detail/timer_wheel.hpp"
+#include "loopp/event_loop.hpp"
+
+namespace loopp {
+
+/*
+ * Select-based implementation of the EventLoop.
+ * Supported on all POSIX systems.
+ * Has limitation on maximum number of file descriptors (`FD_SETSIZE`).
+ */
+class EventLoopSelect final : public EventLoop {
+   private:
+    friend class detail::AsyncEmulation<EventLoopSelect>;
+
+    /*
+     * Indicates if the event loop is running.
+     */
+    std::atomic<bool> is_running_{false};
+
+    /*
+     * Thread running the event loop, its mutations don't need a wakeup.
+     */
+    detail::LoopThread loop_thread_;
+
+    /*
+     * Set once a wakeup was issued, until the loop wakes up.
+     * Further wakeups are coalesced into the pending one.
+     */
+    std::atomic<bool> is_wakeup_pending_{false};
+
+    /*
+     * Tasks posted to the loop thread, lock-free.
+     */
+    detail::TaskQueue tasks_;
+
+    /*
+     * Options of the loop, adjustable at runtime.
+     */
+    detail::LoopSettings settings_;
+
+    /*
+     * Busy polling state and counters.
+     */
+    detail::BusyPoll busy_poll_;
+
+    /*
+     * Instrumentation, no-ops unless configured in.
+     */
+    detail::Stats stats_;
+
+    /*
+     * Tracing, records nothing until enabled.
+     */
+    detail::Trace trace_;
+
+    /*
+     * Table of file descriptors to their event callbacks.
+     */
+    detail::HandlerTable event_callbacks_;
+
+    /*
+     * File descriptor set.
+     * Only used by the loop thread, which applies the registrations marked in the table.
+     * Should not be passed directly to select(), copy it first.
+     */
+    fd_set read_set_, write_set_;
+
+    /*
+     * Largest file descriptor in the sets, the wakeup pipe aside, -1 if none.
+     * May be larger while oneshot file descriptors are disarmed. Only used by the loop thread.
+     */
+    int max_fd_{-1};
+
+    /*
+     * Timers armed on the loop.
+     */
+    detail::Timers timers_;
+
+    /*
+     * Mutex to protect access to timers and asynchronous operations.
+     * Registrations only lock the shard of their descriptor in the table.
+     */
+    std::mutex mutex_;
+
+    /*
+     * Asynchronous operations, emulated with readiness.
+     */
+    detail::AsyncEmulation<EventLoopSelect> async_{*this};
+
+    /*
+     * Handlers ready in the current iteration, only used by the loop thread.
+     * One READ and one WRITE handler at most per file descriptor.
+     */
+    detail::ReadyHandlers ready_handlers_{static_cast<size_t>(FD_SETSIZE) * detail::EVENT_TYPE_COUNT};
+
+    /*
+     * Pipe for immediate wakeup.
+     * First element is read end, second is write end.
+     */
+    int wakeup_fd_[2]{-1, -1};
+
+   public:
+    EventLoopSelect() {
+        FD_ZERO(&read_set_);
+        FD_ZERO(&write_set_);
+
+        // Create pipe for immediate wakeup
+        if (pipe(wakeup_fd_) == -1) {
+            throw std::system_error(errno, std::system_category(), "Failed to create wakeup pipe");
+        }
+
+        // Set both ends of the pipe to non-blocking
+        if (fcntl(wakeup_fd_[0], F_SETFL, O_NONBLOCK) == -1 || fcntl(wakeup_fd_[1], F_SETFL, O_NONBLOCK) == -1) {
+            close(wakeup_fd_[0]);
+            close(wakeup_fd_[1]);
+            wakeup_fd_[0] = -1;
+            wakeup_fd_[1] = -1;
+            throw std::system_error(errno, std::system_category(), "Failed to set non-blocking on wakeup pipe");
+        }
+
+        FD_SET(wakeup_fd_[0], &read_set_);
+    }
+
+    ~EventLoopSelect() noexcept override {
+        // Close the wakeup pipe
+        if (wakeup_fd_[0] != -1) close(wakeup_fd_[0]);
+        if (wakeup_fd_[1] != -1) close(wakeup_fd_[1]);
+    }
+
+    [[nodiscard]] bool is_running() const noexcept override {
+        return is_running_.load();
+    }
+
+    bool set_options(const LoopOptions& options) noexcept override {
+        return settings_.set(options);
+    }
+
+    [[nodiscard]] LoopOptions options() const noexcept override {
+        return settings_.get();
+    }
+
+    [[nodiscard]] BusyPollStats busy_poll_stats() const noexcept override {
+        return busy_poll_.stats();
+    }
+
+    [[nodiscard]] LoopStats stats() const noexcept override {
+        return stats_.snapshot();
+    }
+
+    bool set_tracing(bool is_enabled) noexcept override {
+        return trace_.set_enabled(is_enabled);
+    }
+
+    [[nodiscard]] const TraceBuffer* trace() const noexcept override {
+        return trace_.buffer();
+    }
+
+    using EventLoop::add_fd;
+
+    bool add_fd(int fd, EventType type, UniqueEventCallback&& callback, EventMode mode) noexcept override {
+        if (!register_fd(fd, type, std::move(callback), mode)) return false;
+        return wakeup();
+    }
+
+    bool add_fd_exclusive(int fd, EventType type, UniqueEventCallback&& callback, EventMode mode) noexcept override {
+        if (!register_fd(fd, type, std::move(callback), mode, false, true)) return false;
+        return wakeup();
+    }
+
+    bool add_fd(int fd, ReadyMask interest, FdHandler* handler, void* user_data, EventMode mode) noexcept override {
+        if (!register_handler(fd, interest, handler, user_data, mode)) return false;
+        return wakeup();
+    }
+
+    bool add_fds(std::span<const Registration> registrations) noexcept override {
+        for (const auto& [fd, type, callback, mode] : registrations) {
+            if (!register_fd(fd, type, UniqueEventCallback(callback), mode)) return wakeup_after_error();
+        }
+        return wakeup();
+    }
+
+    bool add_fds(std::span<const HandlerRegistration> registrations) noexcept override {
+        for (const auto& [fd, interest, handler, user_data, mode] : registrations) {
+            if (!register_handler(fd, interest, handler, user_data, mode)) return wakeup_after_error();
+        }
+        return wakeup();
+    }
+
+    bool remove_fd(int fd, EventType type) noexcept override {
+        if (!unregister_fd(fd, type)) return false;
+        return wakeup();
+    }
+
+    bool remove_fds(std::span<const FdEvent> events) noexcept override {
+        for (const auto& [fd, type] : events) {
+            if (!unregister_fd(fd, type)) return wakeup_after_error();
+        }
+        return wakeup();
+    }
+
+    bool rearm_fd(int fd) noexcept override {
+        if (event_callbacks_.mask(fd) == 0) {
+            errno = ENOENT;
+            return false;
+        }
+
+        // Only oneshot registrations get disarmed
+        if (event_callbacks_.mode(fd) != EventMode::ONESHOT) {
+            return true;
+        }
+
+        event_callbacks_.mark_changed(fd);
+        return wakeup();
+    }
+
+    TimerId add_timer(std::chrono::nanoseconds delay, const TimerCallback& callback) noexcept override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        TimerId id = timers_.add(delay, callback);
+        if (!wakeup()) {
+            timers_.cancel(id);
+            return 0;
+        }
+        return id;
+    }
+
+    bool reset_timer(TimerId id, std::chrono::nanoseconds delay) noexcept override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!timers_.reset(id, delay)) {
+            errno = ENOENT;
+            return false;
+        }
+        return wakeup();
+    }
+
+    bool cancel_timer(TimerId id) noexcept override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return timers_.cancel(id);
+    }
+
+    bool post(Task task) noexcept override {
+        if (!tasks_.push(std::move(task))) return false;
+        return wakeup();
+    }
+
+    bool async_read(int fd, std::span<std::byte> buffer, const CompletionCallback& callback) noexcept override {
+        return async_.submit(detail::AsyncKind::READ, fd, buffer.data(), buffer.size(), {}, callback);
+    }
+
+    bool async_write(int fd, std::span<const std::byte> data, const CompletionCallback& callback) noexcept override {
+        return async_.submit(detail::AsyncKind::WRITE, fd, const_cast<std::byte*>(data.data()), data.size(), {}, callback);
+    }
+
+    bool async_writev(int fd, std::span<const iovec> buffers, const CompletionCallback& callback) noexcept override {
+        return async_.submit(detail::AsyncKind::WRITEV, fd, nullptr, 0, buffers, callback);
+    }
+
+    bool async_accept(int fd, const CompletionCallback& callback) noexcept override {
+        return async_.submit(detail::AsyncKind::ACCEPT, fd, nullptr, 0, {}, callback);
+    }
+
+    bool async_recv(int fd, const ReceiveCallback& callback) noexcept override {
+        return async_.submit(detail::AsyncKind::RECV, fd, nullptr, 0, {}, nullptr, callback);
+    }
+
+    bool cancel_async(int fd) noexcept override {
+        return async_.cancel(fd);
+    }
+
+    void start() override {
+        detail::LoopThread::Scope loop_thread_scope(loop_thread_);
+        is_running_.store(true);
+
+        while (is_running_.load()) {
+            stats_.on_iteration();
+
+            // Pick up changed options, then finish the callbacks left over by the budget before waiting again
+            settings_.refresh();
+            if (ready_handlers_.is_pending()) {
+                run_callbacks();
+                continue;
+            }
+
+            // Apply changed registrations and copy the FD sets
+            event_callbacks_.take_changed([this](int fd) { apply_changes(fd); });
+            int max_fd = std::max(max_fd_, wakeup_fd_[0]);
+            fd_set read_set = read_set_;
+            fd_set write_set = write_set_;
+
+            // Get the next timer deadline under lock
+            int timeout_ms;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                timeout_ms = tasks_.empty() ? timers_.timeout_ms() : 0;  // Don't block with tasks waiting
+            }
+
+            // Poll instead of blocking while busy polling
+            if (busy_poll_.should_spin(timeout_ms != 0, settings_.current().busy_poll)) timeout_ms = 0;
+
+            // Wait for events, or until the next timer is due
+            struct timeval timeout{timeout_ms / 1000, (timeout_ms % 1000) * 1000};
+            trace_.record(TraceKind::WAIT_BEGIN);
+            auto wait_start = stats_.begin_wait();
+            int ready_count = select(max_fd + 1, &read_set, &write_set, nullptr, timeout_ms == -1 ? nullptr : &timeout);
+            trace_.record(TraceKind::WAIT_END, -1, static_cast<uint32_t>(std::max(ready_count, 0)));
+            if (ready_count == -1) {
+                if (errno == EINTR) continue;
+                throw std::system_error(errno, std::system_category(), "Failed to wait for events");
+            }
+            stats_.end_wait(wait_start, static_cast<size_t>(ready_count));
+            busy_poll_.record(ready_count > 0 || !tasks_.empty());
+
+            // Drain the wakeup buffer before clearing the flag, wakeups issued from now on need another write.
+            // The exchange makes the work of wakeups coalesced until then visible
+            uint64_t buffer;
+            while (read(wakeup_fd_[0], &buffer, sizeof(buffer)) > 0) {
+            }
+            is_wakeup_pending_.exchange(false);
+
+            // Collect ready handlers without locking, the table keeps them alive if callbacks modify it
+            for (int fd = 0; fd <= max_fd; ++fd) {
+                bool is_readable = FD_ISSET(fd, &read_set) && FD_ISSET(fd, &read_set_);
+                bool is_writable = FD_ISSET(fd, &write_set) && FD_ISSET(fd, &write_set_);
+                if (!is_readable && !is_writable) continue;
+
+                ReadyMask ready = (is_readable ? READY_READ : 0) | (is_writable ? READY_WRITE : 0);
+                ready_handlers_.collect(event_callbacks_, fd, ready);
+
+                // Emulate oneshot by disarming the whole FD once reported
+                if (event_callbacks_.mode(fd) == EventMode::ONESHOT) {
+                    FD_CLR(fd, &read_set_);
+                    FD_CLR(fd, &write_set_);
+                }
+            }
+
+            run_callbacks();
+        }
+    };
+
+    bool stop() noexcept override {
+        if (!is_running_.exchange(false)) return true;
+        return wakeup();
+    }
+
+   private:
+    /*
+     * Invoke a round of callbacks within the limits of the options,
+     * ready handlers first, then posted tasks and due timers.
+     */
+    void run_callbacks() {
+        const LoopOptions& options = settings_.current();
+
+        // Execute callbacks for ready events, skipping removed ones
+        ready_handlers_.dispatch(event_callbacks_, stats_, trace_, options.max_callbacks, options.callback_budget);
+
+        // Run tasks posted so far
+        tasks_.run(options.max_tasks);
+
+        // Fire timers that are due
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            timers_.collect();
+        }
+        timers_.dispatch(mutex_);
+    }
+
+    /*
+     * Register a callback, same as add_fd() but without waking up the loop,
+     * or add_fd_exclusive() with `is_exclusive`.
+     * Handlers reserved for the emulation of asynchronous operations fail with `EBUSY` if the type is taken.
+     * Locks the shard of the file descriptor.
+     */
+    bool register_fd(int fd, EventType type, UniqueEventCallback&& callback, EventMode mode,
+                     bool is_reserved = false, bool is_exclusive = false) noexcept {
+        if (!detail::HandlerTable::can_insert(fd)) return false;
+        auto lock = event_callbacks_.lock(fd);
+
+        // Types with asynchronous operations queued are taken by the emulation
+        if (event_callbacks_.is_reserved(fd, type)) {
+            errno = EBUSY;
+            return false;
+        }
+
+        // File descriptors registered with an FdHandler take no callbacks
+        if (event_callbacks_.has_fd_handler(fd)) {
+            errno = EINVAL;
+            return false;
+        }
+
+        // Check if already registered
+        uint8_t mask = event_callbacks_.mask(fd);
+        if ((mask & detail::event_bit(type)) != 0) {
+            if (!is_reserved && !is_exclusive) return true;
+            errno = EBUSY;
+            return false;
+        }
+
+        // Select only reports the current state, edge-triggered can't be emulated reliably
+        if (mode == EventMode::EDGE) {
+            errno = ENOTSUP;
+            return false;
+        }
+
+        // Mode is shared by all event types of the FD
+        if (mask != 0 && event_callbacks_.mode(fd) != mode) {
+            errno = EINVAL;
+            return false;
+        }
+
+        // Check FD_SETSIZE limitation, refer to unix man for more info
+        if (fd >= FD_SETSIZE) {
+            errno = EMFILE;
+            return false;
+        }
+
+        if (type != EventType::READ && type != EventType::WRITE) {
+            errno = EINVAL;
+            return false;
+        }
+
+        // Register the callback, the loop adds the FD to the appropriate FD sets
+        event_callbacks_.insert(fd, type, std::move(callback), mode, is_reserved);
+        event_callbacks_.mark_changed(fd);
+
+        return true;
+    }
+
+    /*
+     * Register an FdHandler, same as add_fd() but without waking up the loop.
+     * Locks the shard of the file descriptor.
+     */
+    bool register_handler(int fd, ReadyMask interest, FdHandler* handler, void* user_data, EventMode mode) noexcept {
+        uint8_t mask = detail::to_event_mask(interest);
+        auto lock = event_callbacks_.lock(fd);
+        if (!event_callbacks_.can_insert(fd, mask, handler)) return false;
+
+        if (mode == EventMode::EDGE) {
+            errno = ENOTSUP;
+            return false;
+        }
+
+        if (fd >= FD_SETSIZE) {
+            errno = EMFILE;
+            return false;
+        }
+
+        // Register the handler, the loop replaces the FD's set membership with the new interest
+        event_callbacks_.insert(fd, mask, handler, user_data, mode);
+        event_callbacks_.mark_changed(fd);
+
+        return true;
+    }
+
+    /*
+     * Unregister a callback, same as remove_fd() but without waking up the loop.
+     * Handlers reserved for the emulation are only unregistered with `is_reserved`.
+     * Locks the shard of the file descriptor.
+     */
+    bool unregister_fd(int fd, EventType type, bool is_reserved = false) noexcept {
+        auto lock = event_callbacks_.lock(fd);
+
+        // Check if already unregistered or taken by the emulation
+        if (!event_callbacks_.contains(fd, type) || event_callbacks_.is_reserved(fd, type) != is_reserved) {
+            return true;
+        }
+
+        if (type != EventType::READ && type != EventType::WRITE) {
+            errno = EINVAL;
+            return false;
+        }
+
+        // Remove the callback, the loop removes the FD from the appropriate FD set
+        event_callbacks_.erase(fd, type, is_reserved);
+        event_callbacks_.mark_changed(fd);
+
+        return true;
+    }
+
+    /*
+     * Set the FD's membership in the FD sets to its current registrations, rearming it.
+     * Only called by the loop thread.
+     */
+    void apply_changes(int fd) noexcept {
+        if (fd >= FD_SETSIZE) return;
+
+        uint8_t mask = event_callbacks_.mask(fd);
+        if (mask & detail::event_bit(EventType::READ)) {
+            FD_SET(fd, &read_set_);
+        } else {
+            FD_CLR(fd, &read_set_);
+        }
+        if (mask & detail::event_bit(EventType::WRITE)) {
+            FD_SET(fd, &write_set_);
+        } else {
+            FD_CLR(fd, &write_set_);
+        }
+
+        // Find the new largest descriptor if this one is gone
+        if (mask != 0) {
+            max_fd_ = std::max(max_fd_, fd);
+        } else if (fd == max_fd_) {
+            while (max_fd_ >= 0 && !FD_ISSET(max_fd_, &read_set_) && !FD_ISSET(max_fd_, &write_set_)) {
+                --max_fd_;
+            }
+        }
+    }
+
+    /*
+     * Wake up the event loop if it's blocked.
+     * No-op if already awake or called from the loop thread,
+     * changes made there are picked up before the next wait.
+     * Coalesced with a wakeup that's still pending.
+     */
+    bool wakeup() noexcept {
+        if (loop_thread_.is_current()) return true;
+        if (is_wakeup_pending_.exchange(true)) {
+            stats_.on_wakeup_coalesced();
+            return true;
+        }
+
+        if (write(wakeup_fd_[1], "x", 1) == -1 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            is_wakeup_pending_.store(false);
+            return false;
+        }
+        stats_.on_wakeup_issued();
+        trace_.record(TraceKind::WAKEUP);
+        return true;
+    }
+
+    /*
+     * Wake up the loop after a batch failed midway, so the changes applied so far are picked up.
+     * Always returns false, preserving errno of the failure.
+     */
+    bool wakeup_after_error() noexcept {
+        int error = errno;
+        wakeup();
+        errno = error;
+        return false;
+    }
+};
+
+}  // namespace loopp
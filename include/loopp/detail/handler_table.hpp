@@ -0,0 +1,732 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "loopp/detail/loop_stats.hpp"
+#include "loopp/detail/loop_trace.hpp"
+#include "loopp/event_loop.hpp"
+
+namespace loopp::detail {
+
+/*
+ * Number of event types a single file descriptor can have handlers for.
+ */
+inline constexpr size_t EVENT_TYPE_COUNT = 2;
+
+/*
+ * Bit assigned to the event type in `FdHandlers::mask`.
+ */
+constexpr uint8_t event_bit(EventType type) noexcept {
+    return static_cast<uint8_t>(1U << static_cast<uint8_t>(type));
+}
+
+/*
+ * Convert a mask of event types to the conditions they stand for.
+ */
+constexpr ReadyMask to_ready_mask(uint8_t mask) noexcept {
+    ReadyMask ready = 0;
+    if (mask & event_bit(EventType::READ)) ready |= READY_READ | READY_READ_HANGUP;
+    if (mask & event_bit(EventType::WRITE)) ready |= READY_WRITE;
+    return ready;
+}
+
+/*
+ * Convert an interest in conditions to a mask of event types.
+ */
+constexpr uint8_t to_event_mask(ReadyMask interest) noexcept {
+    uint8_t mask = 0;
+    if (interest & READY_READ) mask |= event_bit(EventType::READ);
+    if (interest & READY_WRITE) mask |= event_bit(EventType::WRITE);
+    return mask;
+}
+
+/*
+ * A registered callback, reclaimed through the table's epochs so it can outlive its registration.
+ * Registrations with an FdHandler set it instead of the callback, one handler covers every event type.
+ */
+struct Handler {
+    UniqueEventCallback callback;
+
+    FdHandler* fd_handler{nullptr};
+    void* user_data{nullptr};
+
+    /*
+     * Cleared on removal, checked right before invoking the callback.
+     */
+    std::atomic<bool> active{false};
+
+    /*
+     * Epoch the handler was unregistered in, only valid while retired.
+     */
+    uint64_t retired_epoch{0};
+
+    /*
+     * Next handler in the free or retired list of its shard, only valid while unregistered.
+     */
+    Handler* next_free{nullptr};
+};
+
+/*
+ * Handlers registered for a single file descriptor.
+ * Each event type has a fixed slot, `mask` tells which of them are in use.
+ * With an FdHandler, the first slot holds the only handler and `mask` is its interest.
+ * The mode is shared by all event types of the file descriptor.
+ * Written under the lock of the descriptor's shard, read by the loop thread without it.
+ */
+struct FdHandlers {
+    std::array<std::atomic<Handler*>, EVENT_TYPE_COUNT> handlers{};
+    std::atomic<uint8_t> mask{0};
+    std::atomic<EventMode> mode{EventMode::LEVEL};
+    std::atomic<bool> is_shared{false};
+
+    /*
+     * Event types taken by the emulation of asynchronous operations, only used by writers.
+     */
+    uint8_t reserved{0};
+
+    /*
+     * Set while the descriptor is in the table's list of changed ones, see mark_changed().
+     * The link and the descriptor are only written by whoever set the flag.
+     */
+    std::atomic<bool> is_changed{false};
+    FdHandlers* next_changed{nullptr};
+    int fd{-1};
+};
+
+/*
+ * Table of handlers indexed directly by file descriptor, lookups never hash.
+ * Registrations of a descriptor are serialized by the lock of its shard, see lock(),
+ * so threads registering different descriptors rarely contend.
+ * The loop thread reads the table without any lock: slots live in segments that never move,
+ * and unregistered handlers are only recycled once the loop is done with the handlers it collected.
+ * Between begin_read() and end_read() the loop announces the epoch it started reading in,
+ * a handler retired in an earlier epoch waits on its shard until the loop moved past it.
+ * Handlers are recycled through free lists, so steady state registration doesn't allocate them.
+ * Backends that keep the kernel-side watch list themselves have writers mark the descriptors
+ * they changed, and the loop applies them before waiting, so writers never take a backend lock.
+ */
+class HandlerTable {
+   public:
+    /*
+     * Number of writer locks, descriptors are spread over them by their number.
+     */
+    static constexpr size_t SHARD_COUNT = 16;
+
+    /*
+     * Number of descriptors per segment of slots, segments are allocated as they're needed.
+     */
+    static constexpr size_t SEGMENT_SIZE = 1024;
+
+    /*
+     * Number of segments, registering a descriptor beyond them fails.
+     */
+    static constexpr size_t SEGMENT_COUNT = 4096;
+
+   private:
+    using Segment = std::array<FdHandlers, SEGMENT_SIZE>;
+
+    /*
+     * Writer lock along with the handlers it protects, on a cache line of its own.
+     */
+    struct alignas(64) Shard {
+        std::mutex mutex;
+
+        /*
+         * Unused handlers ready to be reused.
+         */
+        Handler* free_list{nullptr};
+
+        /*
+         * Handlers unregistered while the loop might still be dispatching them.
+         */
+        Handler* retired{nullptr};
+        std::atomic<bool> has_retired{false};
+    };
+
+    /*
+     * Segments of slots per file descriptor, index is the descriptor itself.
+     */
+    std::array<std::atomic<Segment*>, SEGMENT_COUNT> segments_{};
+
+    std::array<Shard, SHARD_COUNT> shards_;
+
+    /*
+     * Descriptors whose registrations changed since the loop last took them, newest first.
+     */
+    std::atomic<FdHandlers*> changed_{nullptr};
+
+    /*
+     * Incremented whenever a handler is retired.
+     */
+    std::atomic<uint64_t> epoch_{1};
+
+    /*
+     * Epoch the loop thread started reading in, 0 while it isn't reading.
+     */
+    std::atomic<uint64_t> reader_epoch_{0};
+
+   public:
+    HandlerTable() = default;
+
+    ~HandlerTable() noexcept {
+        for (std::atomic<Segment*>& segment : segments_) {
+            Segment* slots = segment.load(std::memory_order_relaxed);
+            if (slots == nullptr) continue;
+            for (FdHandlers& slot : *slots) {
+                for (std::atomic<Handler*>& handler : slot.handlers) {
+                    delete handler.load(std::memory_order_relaxed);
+                }
+            }
+            delete slots;
+        }
+        for (Shard& shard : shards_) {
+            for (Handler* list : {shard.free_list, shard.retired}) {
+                while (list != nullptr) {
+                    delete std::exchange(list, list->next_free);
+                }
+            }
+        }
+    }
+
+    HandlerTable(const HandlerTable&) = delete;
+    HandlerTable& operator=(const HandlerTable&) = delete;
+    HandlerTable(HandlerTable&&) = delete;
+    HandlerTable& operator=(HandlerTable&&) = delete;
+
+    /*
+     * Lock the shard of the file descriptor, required by every method that changes its registrations.
+     * Methods that only read can be called without it.
+     */
+    [[nodiscard]] std::unique_lock<std::mutex> lock(int fd) noexcept {
+        return std::unique_lock<std::mutex>(shard(fd).mutex);
+    }
+
+    /*
+     * Check if a handler is registered for the file descriptor and event type.
+     */
+    [[nodiscard]] bool contains(int fd, EventType type) const noexcept {
+        return (mask(fd) & event_bit(type)) != 0;
+    }
+
+    /*
+     * Get the mask of event types registered for the file descriptor.
+     */
+    [[nodiscard]] uint8_t mask(int fd) const noexcept {
+        const FdHandlers* slot = find_slot(fd);
+        return slot != nullptr ? slot->mask.load(std::memory_order_acquire) : 0;
+    }
+
+    /*
+     * Check if the file descriptor is registered with an FdHandler.
+     */
+    [[nodiscard]] bool has_fd_handler(int fd) const noexcept {
+        const FdHandlers* slot = find_slot(fd);
+        return slot != nullptr && slot->is_shared.load(std::memory_order_acquire);
+    }
+
+    /*
+     * Check if the event type of the file descriptor is taken by the emulation of asynchronous operations.
+     * Must be called with the shard locked.
+     */
+    [[nodiscard]] bool is_reserved(int fd, EventType type) const noexcept {
+        const FdHandlers* slot = find_slot(fd);
+        return slot != nullptr && (slot->reserved & event_bit(type)) != 0;
+    }
+
+    /*
+     * Check that a handler can be registered for the file descriptor.
+     * Returns false with `EBADF` for a negative file descriptor or one beyond the segments.
+     */
+    [[nodiscard]] static bool can_insert(int fd) noexcept {
+        if (fd < 0 || static_cast<size_t>(fd) >= SEGMENT_SIZE * SEGMENT_COUNT) {
+            errno = EBADF;
+            return false;
+        }
+        return true;
+    }
+
+    /*
+     * Check that an FdHandler can be registered for the file descriptor with the mask of event types.
+     * Returns false with `EBADF` for an invalid file descriptor, or with `EINVAL` if the mask is empty,
+     * the handler is null or the file descriptor has callbacks registered.
+     */
+    [[nodiscard]] bool can_insert(int fd, uint8_t mask, const FdHandler* fd_handler) const noexcept {
+        if (!can_insert(fd)) return false;
+        if (mask == 0 || fd_handler == nullptr || (this->mask(fd) != 0 && !has_fd_handler(fd))) {
+            errno = EINVAL;
+            return false;
+        }
+        return true;
+    }
+
+    /*
+     * Get the mode the file descriptor is registered with.
+     * Only meaningful if the file descriptor is registered.
+     */
+    [[nodiscard]] EventMode mode(int fd) const noexcept {
+        const FdHandlers* slot = find_slot(fd);
+        return slot != nullptr ? slot->mode.load(std::memory_order_relaxed) : EventMode::LEVEL;
+    }
+
+    /*
+     * Get the callback registered for the file descriptor and event type.
+     * Returns nullptr if there is none.
+     * Must be called with the shard locked, or while reading.
+     */
+    [[nodiscard]] const UniqueEventCallback* find(int fd, EventType type) const noexcept {
+        Handler* handler = load(fd, type);
+        return handler != nullptr ? &handler->callback : nullptr;
+    }
+
+    /*
+     * Get the FdHandler registration of the file descriptor, e.g. to restore it.
+     * Returns nullptr if there is none.
+     * Must be called with the shard locked.
+     */
+    [[nodiscard]] const Handler* find_fd_handler(int fd) const noexcept {
+        return load_fd_handler(fd);
+    }
+
+    /*
+     * Register a handler, replacing the existing one if any.
+     * The mode applies to every event type of the file descriptor.
+     * Handlers of the emulation are reserved, erase() only removes them when told so.
+     * Must be called with the shard locked, for a file descriptor accepted by can_insert().
+     * Throws `std::bad_alloc` if a segment can't be allocated.
+     */
+    void insert(int fd, EventType type, UniqueEventCallback&& callback, EventMode mode = EventMode::LEVEL,
+                bool is_reserved = false) {
+        FdHandlers& slot = grow(fd);
+        Handler* handler = allocate(shard(fd));
+        handler->callback = std::move(callback);
+        handler->active.store(true, std::memory_order_relaxed);
+
+        erase(fd, type, (slot.reserved & event_bit(type)) != 0);
+        if (is_reserved) slot.reserved |= event_bit(type);
+        slot.mode.store(mode, std::memory_order_relaxed);
+        slot.handlers[static_cast<size_t>(type)].store(handler, std::memory_order_release);
+        slot.mask.fetch_or(event_bit(type), std::memory_order_release);
+    }
+
+    /*
+     * Register an FdHandler for the mask of event types, replacing the existing one if any.
+     * A new handler is only allocated if the handler or the user data changed,
+     * so changing the interest alone never allocates.
+     * Must be called with the shard locked, for a file descriptor accepted by can_insert().
+     * Throws `std::bad_alloc` if a segment can't be allocated.
+     */
+    void insert(int fd, uint8_t mask, FdHandler* fd_handler, void* user_data, EventMode mode) {
+        FdHandlers& slot = grow(fd);
+        const Handler* current = load_fd_handler(fd);
+        if (current == nullptr || current->fd_handler != fd_handler || current->user_data != user_data) {
+            Handler* handler = allocate(shard(fd));
+            handler->fd_handler = fd_handler;
+            handler->user_data = user_data;
+            handler->active.store(true, std::memory_order_relaxed);
+
+            Handler* previous = slot.handlers[0].exchange(handler, std::memory_order_acq_rel);
+            if (previous != nullptr) retire(shard(fd), previous);
+        }
+        slot.mode.store(mode, std::memory_order_relaxed);
+        slot.is_shared.store(true, std::memory_order_release);
+        slot.mask.store(mask, std::memory_order_release);
+    }
+
+    /*
+     * Unregister a handler, reserved ones only if `is_reserved` is set.
+     * The handler is deactivated at once, but stays alive until the loop is done reading it.
+     * An FdHandler only loses the event type from its interest, it's unregistered with the last one.
+     * Must be called with the shard locked.
+     * Returns true if the handler was registered.
+     */
+    bool erase(int fd, EventType type, bool is_reserved = false) noexcept {
+        if (!contains(fd, type) || this->is_reserved(fd, type) != is_reserved) return false;
+
+        FdHandlers& slot = *find_slot(fd);
+        slot.reserved &= static_cast<uint8_t>(~event_bit(type));
+        uint8_t mask = slot.mask.fetch_and(static_cast<uint8_t>(~event_bit(type)), std::memory_order_acq_rel) &
+                       static_cast<uint8_t>(~event_bit(type));
+        bool is_shared = slot.is_shared.load(std::memory_order_relaxed);
+        if (!is_shared || mask == 0) {
+            size_t index = is_shared ? 0 : static_cast<size_t>(type);
+            Handler* handler = slot.handlers[index].exchange(nullptr, std::memory_order_acq_rel);
+            slot.is_shared.store(false, std::memory_order_release);
+            retire(shard(fd), handler);
+        }
+        return true;
+    }
+
+    /*
+     * Load the callback registered for the file descriptor and event type, nullptr if there is none.
+     * The handler stays valid until end_read().
+     * Must be called by the loop thread between begin_read() and end_read(), or with the shard locked.
+     */
+    [[nodiscard]] Handler* load(int fd, EventType type) const noexcept {
+        const FdHandlers* slot = find_slot(fd);
+        if (slot == nullptr) return nullptr;
+
+        // Skips an FdHandler registered since the caller checked for one
+        Handler* handler = slot->handlers[static_cast<size_t>(type)].load(std::memory_order_acquire);
+        return handler != nullptr && handler->fd_handler == nullptr ? handler : nullptr;
+    }
+
+    /*
+     * Load the FdHandler registered for the file descriptor, nullptr if there is none.
+     * Same rules as load().
+     */
+    [[nodiscard]] Handler* load_fd_handler(int fd) const noexcept {
+        const FdHandlers* slot = find_slot(fd);
+        if (slot == nullptr) return nullptr;
+
+        Handler* handler = slot->handlers[0].load(std::memory_order_acquire);
+        return handler != nullptr && handler->fd_handler != nullptr ? handler : nullptr;
+    }
+
+    /*
+     * Announce that the loop thread starts loading handlers, none of them is recycled until end_read().
+     */
+    void begin_read() noexcept {
+        reader_epoch_.store(epoch_.load(std::memory_order_acquire), std::memory_order_relaxed);
+
+        // Pairs with the fence of retire(), either the writer sees the epoch or the loop sees the removal
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    /*
+     * Announce that the loop thread is done with the handlers it loaded, and recycle the ones retired meanwhile.
+     * Cheap if nothing was retired, the loop calls it after every round.
+     * Shards locked by a writer are left to the writer's own reclaim, or the next round, so the loop never waits.
+     */
+    void end_read() noexcept {
+        reader_epoch_.store(0, std::memory_order_release);
+
+        // Pairs with the fence of retire(), either the writer sees the loop is done or the loop sees the handler
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        for (Shard& shard : shards_) {
+            if (!shard.has_retired.load(std::memory_order_relaxed)) continue;
+            std::unique_lock<std::mutex> lock(shard.mutex, std::try_to_lock);
+            if (!lock.owns_lock()) continue;
+            reclaim(shard);
+        }
+    }
+
+    /*
+     * Queue the file descriptor for the loop to apply its changed registrations, lock-free.
+     * Called by writers after changing them, a descriptor already queued isn't queued twice.
+     * No-op if the descriptor never had a handler.
+     */
+    void mark_changed(int fd) noexcept {
+        FdHandlers* slot = find_slot(fd);
+        if (slot == nullptr || slot->is_changed.exchange(true, std::memory_order_acq_rel)) return;
+        slot->fd = fd;
+        push_changed(slot);
+    }
+
+    /*
+     * Invoke `apply` with every file descriptor marked since the last call, in no particular order.
+     * Each one is unmarked before `apply` reads its registrations, changes made meanwhile mark it again.
+     * If `apply` throws, the descriptors not applied yet stay marked for the next call.
+     * Only called by the loop thread.
+     */
+    template <typename F>
+    void take_changed(F&& apply) {
+        FdHandlers* slot = changed_.exchange(nullptr, std::memory_order_acquire);
+        while (slot != nullptr) {
+            FdHandlers* next = slot->next_changed;
+            int fd = slot->fd;
+
+            // Pairs with mark_changed(), a writer that still saw the flag set left its change for this read
+            slot->is_changed.exchange(false, std::memory_order_acq_rel);
+            try {
+                apply(fd);
+            } catch (...) {
+                mark_changed(fd);
+                while (next != nullptr) {
+                    push_changed(std::exchange(next, next->next_changed));
+                }
+                throw;
+            }
+            slot = next;
+        }
+    }
+
+   private:
+    [[nodiscard]] Shard& shard(int fd) noexcept {
+        return shards_[static_cast<size_t>(fd) % SHARD_COUNT];
+    }
+
+    /*
+     * Get the slot of the file descriptor, nullptr if its segment doesn't exist.
+     */
+    [[nodiscard]] const FdHandlers* find_slot(int fd) const noexcept {
+        if (fd < 0 || static_cast<size_t>(fd) >= SEGMENT_SIZE * SEGMENT_COUNT) return nullptr;
+
+        auto index = static_cast<size_t>(fd);
+        const Segment* segment = segments_[index / SEGMENT_SIZE].load(std::memory_order_acquire);
+        return segment != nullptr ? &(*segment)[index % SEGMENT_SIZE] : nullptr;
+    }
+
+    [[nodiscard]] FdHandlers* find_slot(int fd) noexcept {
+        return const_cast<FdHandlers*>(std::as_const(*this).find_slot(fd));
+    }
+
+    /*
+     * Get the slot of the file descriptor, allocating its segment if needed.
+     * Shards share segments, so a segment allocated by two of them at once is kept only once.
+     * Throws `std::bad_alloc` on allocation failure.
+     */
+    FdHandlers& grow(int fd) {
+        auto index = static_cast<size_t>(fd);
+        std::atomic<Segment*>& segment = segments_[index / SEGMENT_SIZE];
+        Segment* slots = segment.load(std::memory_order_acquire);
+        if (slots == nullptr) {
+            auto allocated = std::make_unique<Segment>();
+            if (segment.compare_exchange_strong(slots, allocated.get(), std::memory_order_acq_rel)) {
+                slots = allocated.release();
+            }
+        }
+        return (*slots)[index % SEGMENT_SIZE];
+    }
+
+    /*
+     * Push a marked slot onto the list of changed descriptors.
+     */
+    void push_changed(FdHandlers* slot) noexcept {
+        slot->next_changed = changed_.load(std::memory_order_relaxed);
+        while (!changed_.compare_exchange_weak(slot->next_changed, slot, std::memory_order_release, std::memory_order_relaxed)) {
+        }
+    }
+
+    /*
+     * Get an unused handler, from the free list of the shard if possible.
+     * Throws `std::bad_alloc` on allocation failure.
+     */
+    static Handler* allocate(Shard& shard) {
+        if (shard.free_list == nullptr) return new Handler();
+        return std::exchange(shard.free_list, shard.free_list->next_free);
+    }
+
+    /*
+     * Deactivate a handler no slot points to anymore, and recycle it once the loop can't be reading it.
+     * Must be called with the shard locked.
+     */
+    void retire(Shard& shard, Handler* handler) noexcept {
+        handler->active.store(false, std::memory_order_release);
+        handler->retired_epoch = epoch_.fetch_add(1, std::memory_order_acq_rel);
+        handler->next_free = shard.retired;
+        shard.retired = handler;
+        shard.has_retired.store(true, std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        reclaim(shard);
+    }
+
+    /*
+     * Recycle the retired handlers of the shard the loop can't be reading anymore.
+     * A loop that started reading after a handler was retired can't have loaded it.
+     * Must be called with the shard locked.
+     */
+    void reclaim(Shard& shard) noexcept {
+        uint64_t reader_epoch = reader_epoch_.load(std::memory_order_acquire);
+        Handler** link = &shard.retired;
+        while (*link != nullptr) {
+            Handler* handler = *link;
+            if (reader_epoch != 0 && reader_epoch <= handler->retired_epoch) {
+                link = &handler->next_free;
+                continue;
+            }
+            *link = handler->next_free;
+            recycle(shard, handler);
+        }
+        shard.has_retired.store(shard.retired != nullptr, std::memory_order_relaxed);
+    }
+
+    /*
+     * Return an unused handler to the free list of the shard.
+     */
+    static void recycle(Shard& shard, Handler* handler) noexcept {
+        handler->callback = nullptr;
+        handler->fd_handler = nullptr;
+        handler->user_data = nullptr;
+        handler->next_free = shard.free_list;
+        shard.free_list = handler;
+    }
+};
+
+/*
+ * Handlers collected for a single dispatch round, read from the table without locking it.
+ * The table holds off recycling them until the round is fully dispatched.
+ * Storage is reused between rounds so steady state dispatch doesn't allocate.
+ */
+class ReadyHandlers {
+   private:
+    /*
+     * Handler picked up for dispatch along with the event that triggered it.
+     */
+    struct ReadyHandler {
+        int fd;
+        EventType type;
+        Handler* handler;
+
+        /*
+         * Conditions reported to an FdHandler.
+         */
+        ReadyMask ready;
+    };
+
+    std::vector<ReadyHandler> handlers_;
+
+    /*
+     * Index of the first handler not dispatched yet, the ones before it are done.
+     */
+    size_t next_{0};
+
+    /*
+     * Set while the round is reading from the table.
+     */
+    bool is_reading_{false};
+
+   public:
+    /*
+     * Reserve space for the largest expected round.
+     * Throws `std::bad_alloc` on allocation failure.
+     */
+    explicit ReadyHandlers(size_t capacity) {
+        reserve(capacity);
+    }
+
+    /*
+     * Reserve space for a larger round, e.g. after the limit of events per wait was raised.
+     * Throws `std::bad_alloc` on allocation failure.
+     */
+    void reserve(size_t capacity) {
+        handlers_.reserve(capacity);
+    }
+
+    /*
+     * Check if a dispatch stopped by its budget left handlers of the round.
+     * They have to be dispatched before collecting new ones, which could be reported twice otherwise.
+     */
+    [[nodiscard]] bool is_pending() const noexcept {
+        return next_ < handlers_.size();
+    }
+
+    /*
+     * Collect the handler for the file descriptor and event type, if registered.
+     * Only called by the loop thread, no lock needed.
+     */
+    void collect(HandlerTable& table, int fd, EventType type) {
+        begin_read(table);
+        if (Handler* handler = table.load(fd, type)) {
+            handlers_.push_back({fd, type, handler, 0});
+        }
+    }
+
+    /*
+     * Collect the handlers for the conditions the file descriptor is ready for.
+     * An FdHandler is collected once with the conditions it registered for, plus errors and hangups.
+     * Callbacks of both event types are collected on errors and hangups, so they find out with their next call.
+     * Only called by the loop thread, no lock needed.
+     */
+    void collect(HandlerTable& table, int fd, ReadyMask ready) {
+        begin_read(table);
+        Handler* fd_handler = table.load_fd_handler(fd);
+        if (fd_handler == nullptr) {
+            if (ready & (READY_READ | READY_READ_HANGUP | READY_ERROR | READY_HANGUP)) collect(table, fd, EventType::READ);
+            if (ready & (READY_WRITE | READY_ERROR | READY_HANGUP)) collect(table, fd, EventType::WRITE);
+            return;
+        }
+
+        ready &= to_ready_mask(table.mask(fd)) | READY_ERROR | READY_HANGUP;
+        if (ready == 0) return;
+
+        // Backends reporting each condition separately would call it twice otherwise
+        if (!handlers_.empty() && handlers_.back().fd == fd && handlers_.back().handler->fd_handler != nullptr) {
+            handlers_.back().ready |= ready;
+            return;
+        }
+        handlers_.push_back({fd, EventType::READ, fd_handler, ready});
+    }
+
+    /*
+     * Invoke the collected handlers that are still active.
+     * Stops once `max_count` handlers were invoked or `budget` has elapsed, unless they're 0,
+     * the rest stay collected for the next call. Each handler is timed by the stats and traced.
+     * Once the round is done, the table may recycle the handlers removed meanwhile.
+     */
+    void dispatch(HandlerTable& table, Stats& stats, Trace& trace, size_t max_count = 0,
+                  std::chrono::nanoseconds budget = std::chrono::nanoseconds::zero()) {
+        // Finish the round even if a callback throws, so removed handlers aren't held forever
+        struct RoundGuard {
+            ReadyHandlers& ready;
+            HandlerTable& table;
+
+            ~RoundGuard() noexcept {
+                if (ready.is_pending()) return;
+                ready.handlers_.clear();
+                ready.next_ = 0;
+                ready.is_reading_ = false;
+                table.end_read();
+            }
+        } guard{*this, table};
+
+        bool has_budget = budget > std::chrono::nanoseconds::zero();
+        auto deadline = has_budget ? std::chrono::steady_clock::now() + budget : std::chrono::steady_clock::time_point{};
+
+        size_t count = 0;
+        while (is_pending()) {
+            if (max_count != 0 && count == max_count) break;
+            if (has_budget && count != 0 && std::chrono::steady_clock::now() >= deadline) break;
+
+            // Done before the call, so a throwing handler is not invoked again
+            const auto& [fd, type, handler, ready] = handlers_[next_++];
+            if (!handler->active.load(std::memory_order_acquire)) continue;
+            ++count;
+
+            // Ended even if the handler throws, so the trace stays balanced
+            struct TraceGuard {
+                Trace& trace;
+                TraceKind kind;
+                int fd;
+                uint8_t type;
+
+                ~TraceGuard() noexcept {
+                    trace.record(kind, fd, 0, type);
+                }
+            };
+            bool is_fd_handler = handler->fd_handler != nullptr;
+            trace.record(is_fd_handler ? TraceKind::HANDLER_BEGIN : TraceKind::CALLBACK_BEGIN, fd, ready, static_cast<uint8_t>(type));
+            TraceGuard trace_guard{trace, is_fd_handler ? TraceKind::HANDLER_END : TraceKind::CALLBACK_END, fd, static_cast<uint8_t>(type)};
+
+            stats.time_callback([&]() {
+                if (is_fd_handler) {
+                    handler->fd_handler->on_ready(fd, ready, handler->user_data);
+                } else {
+                    handler->callback(fd, type);
+                }
+            });
+        }
+    }
+
+   private:
+    /*
+     * Start reading from the table with the first handler of the round.
+     */
+    void begin_read(HandlerTable& table) noexcept {
+        if (is_reading_) return;
+        table.begin_read();
+        is_reading_ = true;
+    }
+};
+
+}  // namespace loopp::detail
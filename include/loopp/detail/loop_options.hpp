@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+
+#include "loopp/event_loop.hpp"
+
+namespace loopp::detail {
+
+/*
+ * Options of a loop, changed from any thread and picked up by the loop thread between iterations.
+ * The loop thread works on its own copy, so reading them costs nothing while they don't change.
+ */
+class LoopSettings {
+   private:
+    /*
+     * Latest options set, protected by the mutex.
+     */
+    LoopOptions options_;
+    mutable std::mutex mutex_;
+
+    /*
+     * Bumped on every change, lets the loop thread skip the lock while nothing changed.
+     */
+    std::atomic<uint64_t> version_{0};
+
+    /*
+     * Copy of the options the loop thread runs with, and the version it was taken at.
+     * Only accessed by the loop thread.
+     */
+    LoopOptions current_;
+    uint64_t current_version_{0};
+
+   public:
+    /*
+     * Check that the options are in range.
+     * Returns true if they are, false with `EINVAL` otherwise.
+     */
+    static bool validate(const LoopOptions& options) noexcept {
+        bool is_valid = options.max_events > 0 &&
+                        options.max_events <= static_cast<uint32_t>(std::numeric_limits<int>::max()) &&
+                        options.callback_budget >= std::chrono::nanoseconds::zero() &&
+                        options.busy_poll >= std::chrono::microseconds::zero();
+        if (!is_valid) errno = EINVAL;
+        return is_valid;
+    }
+
+    /*
+     * Replace the options, safe to call from any thread.
+     * Returns true on success, false with `EINVAL` if they are out of range.
+     */
+    bool set(const LoopOptions& options) noexcept {
+        if (!validate(options)) return false;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        options_ = options;
+        version_.fetch_add(1, std::memory_order_release);
+        return true;
+    }
+
+    /*
+     * Get the latest options set, safe to call from any thread.
+     */
+    [[nodiscard]] LoopOptions get() const noexcept {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return options_;
+    }
+
+    /*
+     * Take the latest options for the loop thread.
+     * Returns true if they changed since the last call.
+     */
+    bool refresh() noexcept {
+        uint64_t version = version_.load(std::memory_order_acquire);
+        if (version == current_version_) return false;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        current_ = options_;
+        current_version_ = version_.load(std::memory_order_relaxed);
+        return true;
+    }
+
+    /*
+     * Get the options the loop thread runs with, as of the last refresh().
+     */
+    [[nodiscard]] const LoopOptions& current() const noexcept {
+        return current_;
+    }
+};
+
+}  // namespace loopp::detail
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include "loopp/stats.hpp"
+
+namespace loopp::detail {
+
+#ifdef LOOPP_STATS
+
+/*
+ * Histogram written by a single thread and read by any other, without a lock.
+ * Snapshots are taken bucket by bucket, so they may miss values recorded meanwhile.
+ */
+class AtomicHistogram {
+   private:
+    std::array<std::atomic<uint64_t>, Histogram::BUCKET_COUNT> counts_{};
+
+   public:
+    /*
+     * Count a value, only called by the writer.
+     */
+    void record(uint64_t value) noexcept {
+        auto& count = counts_[Histogram::bucket_index(value)];
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    /*
+     * Copy the counts into a histogram, callable from any thread.
+     */
+    [[nodiscard]] Histogram snapshot() const noexcept {
+        Histogram histogram;
+        for (size_t i = 0; i < Histogram::BUCKET_COUNT; ++i) {
+            uint64_t count = counts_[i].load(std::memory_order_relaxed);
+            if (count != 0) histogram.record(Histogram::bucket_value(i), count);
+        }
+        return histogram;
+    }
+};
+
+/*
+ * Instrumentation of a loop, read by EventLoop::stats() without the loop's lock.
+ * Loop thread counters have a single writer, the others are written from any thread.
+ * Configured out without `LOOPP_STATS`, leaving no-ops that compile to nothing.
+ */
+class Stats {
+   private:
+    using Clock = std::chrono::steady_clock;
+
+    std::atomic<uint64_t> iterations_{0};
+    std::atomic<uint64_t> waits_{0};
+    std::atomic<uint64_t> wait_time_ns_{0};
+    AtomicHistogram events_per_wait_;
+    AtomicHistogram callback_time_ns_;
+
+    std::atomic<uint64_t> wakeups_issued_{0};
+    std::atomic<uint64_t> wakeups_coalesced_{0};
+    std::atomic<uint64_t> registration_changes_{0};
+
+   public:
+    /*
+     * Start of a wait, passed back to end_wait().
+     */
+    using WaitStart = Clock::time_point;
+
+    /*
+     * Count an iteration of the loop, only called by the loop thread.
+     */
+    void on_iteration() noexcept {
+        increment(iterations_);
+    }
+
+    /*
+     * Mark the start of a wait for events, only called by the loop thread.
+     */
+    [[nodiscard]] WaitStart begin_wait() const noexcept {
+        return Clock::now();
+    }
+
+    /*
+     * Count a finished wait and the events it returned, only called by the loop thread.
+     */
+    void end_wait(WaitStart start, size_t events) noexcept {
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+        increment(waits_);
+        increment(wait_time_ns_, static_cast<uint64_t>(elapsed));
+        events_per_wait_.record(events);
+    }
+
+    /*
+     * Invoke a ready callback, timing it, only called by the loop thread.
+     */
+    template <typename F>
+    void time_callback(F&& function) {
+        // Recorded even if the callback throws
+        struct Timer {
+            AtomicHistogram& histogram;
+            Clock::time_point start{Clock::now()};
+
+            ~Timer() noexcept {
+                auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+                histogram.record(static_cast<uint64_t>(elapsed));
+            }
+        } timer{callback_time_ns_};
+
+        std::forward<F>(function)();
+    }
+
+    /*
+     * Count a wakeup written to the loop, callable from any thread.
+     */
+    void on_wakeup_issued() noexcept {
+        wakeups_issued_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /*
+     * Count a wakeup coalesced into a pending one, callable from any thread.
+     */
+    void on_wakeup_coalesced() noexcept {
+        wakeups_coalesced_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /*
+     * Count registration changes handed to the kernel, callable from any thread.
+     */
+    void on_registration_changes(size_t count = 1) noexcept {
+        registration_changes_.fetch_add(count, std::memory_order_relaxed);
+    }
+
+    /*
+     * Take a snapshot of the counters, callable from any thread.
+     */
+    [[nodiscard]] LoopStats snapshot() const noexcept {
+        LoopStats stats;
+        stats.is_enabled = true;
+        stats.iterations = iterations_.load(std::memory_order_relaxed);
+        stats.waits = waits_.load(std::memory_order_relaxed);
+        stats.wait_time_ns = wait_time_ns_.load(std::memory_order_relaxed);
+        stats.events_per_wait = events_per_wait_.snapshot();
+        stats.callback_time_ns = callback_time_ns_.snapshot();
+        stats.wakeups_issued = wakeups_issued_.load(std::memory_order_relaxed);
+        stats.wakeups_coalesced = wakeups_coalesced_.load(std::memory_order_relaxed);
+        stats.registration_changes = registration_changes_.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+   private:
+    /*
+     * Add to a counter without a read-modify-write, there's a single writer.
+     */
+    static void increment(std::atomic<uint64_t>& counter, uint64_t amount = 1) noexcept {
+        counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+};
+
+#else
+
+/*
+ * Instrumentation configured out, every call is a no-op.
+ */
+class Stats {
+   public:
+    struct WaitStart {};
+
+    void on_iteration() noexcept {}
+
+    [[nodiscard]] WaitStart begin_wait() const noexcept {
+        return {};
+    }
+
+    void end_wait(WaitStart /*start*/, size_t /*events*/) noexcept {}
+
+    template <typename F>
+    void time_callback(F&& function) {
+        std::forward<F>(function)();
+    }
+
+    void on_wakeup_issued() noexcept {}
+    void on_wakeup_coalesced() noexcept {}
+    void on_registration_changes(size_t /*count*/ = 1) noexcept {}
+
+    [[nodiscard]] LoopStats snapshot() const noexcept {
+        return {};
+    }
+};
+
+#endif
+
+}  // namespace loopp::detail
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+
+namespace loopp::detail {
+
+/*
+ * Tracks the thread currently running the event loop.
+ * Lets mutations made from the loop thread itself skip waking it up.
+ */
+class LoopThread {
+   private:
+    /*
+     * Identifier of the loop thread, default-constructed if the loop is not running.
+     */
+    std::atomic<std::thread::id> id_{};
+
+   public:
+    /*
+     * Marks the calling thread as the loop thread for the lifetime of the scope.
+     */
+    class Scope {
+       private:
+        LoopThread& owner_;
+
+       public:
+        explicit Scope(LoopThread& owner) noexcept : owner_(owner) {
+            owner_.id_.store(std::this_thread::get_id(), std::memory_order_release);
+        }
+
+        ~Scope() noexcept {
+            owner_.id_.store(std::thread::id{}, std::memory_order_release);
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+        Scope(Scope&&) = delete;
+        Scope& operator=(Scope&&) = delete;
+    };
+
+    /*
+     * Check if the calling thread is the one running the event loop.
+     */
+    [[nodiscard]] bool is_current() const noexcept {
+        return id_.load(std::memory_order_acquire) == std::this_thread::get_id();
+    }
+};
+
+}  // namespace loopp::detail
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+
+#include "loopp/trace.hpp"
+
+namespace loopp::detail {
+
+/*
+ * Tracing of a loop, toggled at runtime from any thread.
+ * The buffer is allocated when tracing is first enabled and kept until the loop is destroyed,
+ * so disabling only stops the recording and the records stay readable.
+ * While disabled, recording costs a load and a branch.
+ */
+class Trace {
+   private:
+    /*
+     * Buffer recorded into, null while tracing is disabled.
+     */
+    std::atomic<TraceBuffer*> active_{nullptr};
+
+    std::unique_ptr<TraceBuffer> buffer_;
+    std::atomic<const TraceBuffer*> allocated_{nullptr};
+    std::mutex mutex_;
+
+   public:
+    /*
+     * Enable or disable recording, callable from any thread.
+     * Returns true on success, false on failure (check errno for details).
+     */
+    bool set_enabled(bool is_enabled) noexcept {
+        std::lock_guard lock(mutex_);
+        if (is_enabled && buffer_ == nullptr) {
+            try {
+                buffer_ = std::make_unique<TraceBuffer>();
+            } catch (const std::bad_alloc&) {
+                errno = ENOMEM;
+                return false;
+            }
+            allocated_.store(buffer_.get(), std::memory_order_release);
+        }
+        active_.store(is_enabled ? buffer_.get() : nullptr, std::memory_order_release);
+        return true;
+    }
+
+    /*
+     * Get the buffer, null if tracing was never enabled.
+     */
+    [[nodiscard]] const TraceBuffer* buffer() const noexcept {
+        return allocated_.load(std::memory_order_acquire);
+    }
+
+    /*
+     * Record an event if tracing is enabled, callable from any thread.
+     */
+    void record(TraceKind kind, int fd = -1, uint32_t value = 0, uint8_t type = 0) noexcept {
+        TraceBuffer* buffer = active_.load(std::memory_order_acquire);
+        if (buffer != nullptr) [[unlikely]] {
+            buffer->record(kind, fd, value, type);
+        }
+    }
+};
+
+}  // namespace loopp::detail
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+
+#include "loopp/event_loop.hpp"
+
+namespace loopp::detail {
+
+/*
+ * Lock-free multi-producer single-consumer queue of tasks.
+ * Producers push onto an atomic stack, the consumer takes all of it in one exchange
+ * and restores posting order, so a batch only contains tasks posted before it started.
+ */
+class TaskQueue {
+   private:
+    struct Node {
+        Task task;
+        Node* next{nullptr};
+    };
+
+    /*
+     * Posted tasks, newest first.
+     */
+    std::atomic<Node*> head_{nullptr};
+
+    /*
+     * Tasks taken by the consumer but not run yet, oldest first.
+     * Only accessed by the consumer.
+     */
+    Node* pending_{nullptr};
+
+   public:
+    TaskQueue() = default;
+
+    ~TaskQueue() noexcept {
+        free(pending_);
+        free(head_.load(std::memory_order_acquire));
+    }
+
+    TaskQueue(const TaskQueue&) = delete;
+    TaskQueue& operator=(const TaskQueue&) = delete;
+    TaskQueue(TaskQueue&&) = delete;
+    TaskQueue& operator=(TaskQueue&&) = delete;
+
+    /*
+     * Enqueue a task, safe to call from any thread.
+     * Returns true on success, false with `ENOMEM` on allocation failure.
+     */
+    bool push(Task&& task) noexcept {
+        auto* node = new (std::nothrow) Node{std::move(task)};
+        if (node == nullptr) {
+            errno = ENOMEM;
+            return false;
+        }
+
+        node->next = head_.load(std::memory_order_relaxed);
+        while (!head_.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {
+        }
+        return true;
+    }
+
+    /*
+     * Check if there are tasks waiting to run.
+     * Only accurate when called by the consumer.
+     */
+    [[nodiscard]] bool empty() const noexcept {
+        return pending_ == nullptr && head_.load(std::memory_order_acquire) == nullptr;
+    }
+
+    /*
+     * Run the tasks posted so far, in posting order, at most `max_count` of them unless it's 0.
+     * Tasks posted meanwhile and the ones over the limit are left for the next call.
+     * If a task throws, the remaining ones stay queued for the next call.
+     */
+    void run(size_t max_count = 0) {
+        if (pending_ == nullptr) {
+            pending_ = reverse(head_.exchange(nullptr, std::memory_order_acquire));
+        }
+
+        for (size_t count = 0; pending_ != nullptr && (max_count == 0 || count < max_count); ++count) {
+            std::unique_ptr<Node> node(std::exchange(pending_, pending_->next));
+            node->task();
+        }
+    }
+
+   private:
+    /*
+     * Reverse a list in place, returning its new head.
+     */
+    static Node* reverse(Node* node) noexcept {
+        Node* reversed = nullptr;
+        while (node != nullptr) {
+            reversed = std::exchange(node, std::exchange(node->next, reversed));
+        }
+        return reversed;
+    }
+
+    /*
+     * Delete every node of a list.
+     */
+    static void free(Node* node) noexcept {
+        while (node != nullptr) {
+            delete std::exchange(node, node->next);
+        }
+    }
+};
+
+}  // namespace loopp::detail
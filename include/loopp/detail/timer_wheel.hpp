@@ -0,0 +1,495 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include "loopp/event_loop.hpp"
+
+namespace loopp::detail {
+
+/*
+ * Hierarchical timing wheel, arming and cancelling timers are O(1).
+ * Time is measured in ticks, each level has 64 slots spanning 64 times the level below.
+ * Timers further away than the top level can hold are clamped and re-cascaded later.
+ * Not thread-safe, callers are expected to hold their own lock.
+ */
+class TimerWheel {
+   public:
+    /*
+     * Number of slots per level, as a power of two.
+     */
+    static constexpr unsigned SLOT_BITS = 6;
+    static constexpr size_t SLOT_COUNT = size_t{1} << SLOT_BITS;
+    static constexpr uint64_t SLOT_MASK = SLOT_COUNT - 1;
+
+    /*
+     * Number of levels, covering 2^30 ticks (~12 days with 1 ms ticks).
+     */
+    static constexpr size_t LEVEL_COUNT = 5;
+
+   private:
+    /*
+     * Index that marks the end of a slot list.
+     */
+    static constexpr uint32_t NIL = std::numeric_limits<uint32_t>::max();
+
+    /*
+     * Lifecycle of a timer node.
+     */
+    enum class State : uint8_t {
+        FREE,      // In the free list
+        ARMED,     // Linked into a slot
+        EXPIRED,   // Taken out by advance(), waiting to be fired
+        DETACHED,  // Neither linked nor free, either firing or cancelled after expiring
+    };
+
+    struct Node {
+        TimerCallback callback;
+        uint64_t expiry{0};
+        uint32_t generation{0};
+        uint32_t prev{NIL};
+        uint32_t next{NIL};
+        uint8_t level{0};
+        uint8_t slot{0};
+        State state{State::FREE};
+
+        /*
+         * Set while the callback runs, the node can't be recycled until it returns.
+         */
+        bool is_firing{false};
+    };
+
+    /*
+     * Timer nodes, deque keeps references stable while callbacks arm new timers.
+     */
+    std::deque<Node> nodes_;
+
+    /*
+     * Head of the free node list, linked through `Node::next`.
+     */
+    uint32_t free_list_{NIL};
+
+    /*
+     * Heads of the slot lists, per level.
+     */
+    std::array<std::array<uint32_t, SLOT_COUNT>, LEVEL_COUNT> slots_{};
+
+    /*
+     * Bitmap of non-empty slots, per level.
+     */
+    std::array<uint64_t, LEVEL_COUNT> occupied_{};
+
+    /*
+     * Next tick to be processed.
+     */
+    uint64_t current_{0};
+
+    /*
+     * Number of armed timers.
+     */
+    size_t armed_count_{0};
+
+   public:
+    TimerWheel() {
+        for (auto& level : slots_) level.fill(NIL);
+    }
+
+    /*
+     * Arm a new timer expiring at the given tick.
+     * Returns the timer id, never 0.
+     * Throws `std::bad_alloc` if the node pool can't grow.
+     */
+    TimerId add(uint64_t expiry, const TimerCallback& callback) {
+        uint32_t index = allocate();
+        Node& node = nodes_[index];
+        node.callback = callback;
+        node.state = State::ARMED;
+        link(index, expiry);
+        return make_id(index, node.generation);
+    }
+
+    /*
+     * Cancel a timer, it won't fire even if it already expired.
+     * Returns true if the timer was pending.
+     */
+    bool cancel(TimerId id) noexcept {
+        uint32_t index = 0;
+        Node* node = lookup(id, index);
+        if (node == nullptr) return false;
+
+        bool was_pending = node->state != State::DETACHED;
+        if (node->state == State::ARMED) unlink(index);
+
+        if (node->state == State::EXPIRED || node->is_firing) {
+            // Still referenced by the loop, end_fire() recycles it
+            node->state = State::DETACHED;
+            ++node->generation;
+        } else {
+            release(index);
+        }
+        return was_pending;
+    }
+
+    /*
+     * Move a timer to a new expiry tick, reusing its callback.
+     * Works for pending timers as well as from the timer's own callback.
+     * Returns true on success, false if the timer doesn't exist anymore.
+     */
+    bool reset(TimerId id, uint64_t expiry) noexcept {
+        uint32_t index = 0;
+        Node* node = lookup(id, index);
+        if (node == nullptr) return false;
+
+        if (node->state == State::ARMED) unlink(index);
+        node->state = State::ARMED;
+        link(index, expiry);
+        return true;
+    }
+
+    /*
+     * Process all ticks up to and including `now`, appending expired timer indices to `expired`.
+     * Expired timers stay reserved until passed to begin_fire() or requeue().
+     */
+    void advance(uint64_t now, std::vector<uint32_t>& expired) {
+        while (current_ <= now) {
+            // Entering a new window of level 0, pull timers down from the levels above
+            if ((current_ & SLOT_MASK) == 0) cascade();
+
+            auto slot = static_cast<size_t>(current_ & SLOT_MASK);
+            while (slots_[0][slot] != NIL) {
+                uint32_t index = slots_[0][slot];
+                unlink(index);
+                nodes_[index].state = State::EXPIRED;
+                expired.push_back(index);
+            }
+            ++current_;
+
+            // Nothing left in level 0, skip ahead to the next cascade or the target
+            if (occupied_[0] == 0) {
+                current_ = std::max(current_, std::min(now + 1, next_expiry().value_or(now + 1)));
+            }
+        }
+    }
+
+    /*
+     * Start firing an expired timer.
+     * Returns the callback to run, or nullptr if the timer was cancelled or reset meanwhile.
+     * Every non-null result must be followed by end_fire() once the callback returns.
+     */
+    const TimerCallback* begin_fire(uint32_t index) noexcept {
+        Node& node = nodes_[index];
+        if (node.state == State::ARMED) return nullptr;  // Reset after expiring
+        if (node.state == State::DETACHED) {
+            // Cancelled after expiring
+            release(index);
+            return nullptr;
+        }
+
+        node.state = State::DETACHED;
+        node.is_firing = true;
+        return &node.callback;
+    }
+
+    /*
+     * Finish firing a timer, recycling it unless its callback re-armed it.
+     */
+    void end_fire(uint32_t index) noexcept {
+        Node& node = nodes_[index];
+        node.is_firing = false;
+        if (node.state == State::DETACHED) release(index);
+    }
+
+    /*
+     * Put an expired timer that couldn't be fired back into the wheel, to fire as soon as possible.
+     */
+    void requeue(uint32_t index) noexcept {
+        Node& node = nodes_[index];
+        if (node.state == State::EXPIRED) {
+            node.state = State::ARMED;
+            link(index, current_);
+        } else if (node.state == State::DETACHED) {
+            release(index);
+        }
+    }
+
+    /*
+     * Get the earliest tick at which a timer may need processing.
+     * Might be earlier than the actual expiry when a higher level needs cascading.
+     * Returns nothing if no timer is armed.
+     */
+    [[nodiscard]] std::optional<uint64_t> next_expiry() const noexcept {
+        if (armed_count_ == 0) return std::nullopt;
+
+        uint64_t next = std::numeric_limits<uint64_t>::max();
+        for (size_t level = 0; level < LEVEL_COUNT; ++level) {
+            if (occupied_[level] == 0) continue;
+
+            unsigned shift = static_cast<unsigned>(level) * SLOT_BITS;
+            uint64_t window = current_ >> shift;
+            auto position = static_cast<unsigned>(window & SLOT_MASK);
+
+            // Distance to the nearest occupied slot, following the ring from the current one
+            uint64_t rotated = std::rotr(occupied_[level], static_cast<int>(position));
+            auto distance = static_cast<uint64_t>(std::countr_zero(rotated));
+
+            // Higher level slots are only due when their window starts, the current one is the next lap
+            if (level > 0 && distance == 0) distance = SLOT_COUNT;
+            next = std::min(next, level == 0 ? current_ + distance : (window + distance) << shift);
+        }
+        return next;
+    }
+
+    /*
+     * Get the number of armed timers.
+     */
+    [[nodiscard]] size_t size() const noexcept {
+        return armed_count_;
+    }
+
+   private:
+    static TimerId make_id(uint32_t index, uint32_t generation) noexcept {
+        return (static_cast<uint64_t>(generation) << 32) | (static_cast<uint64_t>(index) + 1);
+    }
+
+    /*
+     * Find the live node for the id, nullptr if it's gone.
+     */
+    Node* lookup(TimerId id, uint32_t& index) noexcept {
+        uint64_t position = id & 0xFFFFFFFFU;
+        if (position == 0 || position > nodes_.size()) return nullptr;
+
+        index = static_cast<uint32_t>(position - 1);
+        Node& node = nodes_[index];
+        if (node.generation != static_cast<uint32_t>(id >> 32) || node.state == State::FREE) return nullptr;
+        return &node;
+    }
+
+    /*
+     * Get an unused node index.
+     * Throws `std::bad_alloc` if the pool can't grow.
+     */
+    uint32_t allocate() {
+        if (free_list_ == NIL) {
+            nodes_.emplace_back();
+            return static_cast<uint32_t>(nodes_.size() - 1);
+        }
+        uint32_t index = free_list_;
+        free_list_ = nodes_[index].next;
+        return index;
+    }
+
+    /*
+     * Return a node to the free list, invalidating its id.
+     */
+    void release(uint32_t index) noexcept {
+        Node& node = nodes_[index];
+        node.callback = nullptr;
+        node.state = State::FREE;
+        ++node.generation;
+        node.prev = NIL;
+        node.next = free_list_;
+        free_list_ = index;
+    }
+
+    /*
+     * Link a node into the slot matching its expiry.
+     */
+    void link(uint32_t index, uint64_t expiry) noexcept {
+        Node& node = nodes_[index];
+        node.expiry = std::max(expiry, current_);
+
+        // Pick the lowest level whose span covers the delay
+        uint64_t delta = node.expiry - current_;
+        size_t level = 0;
+        while (level + 1 < LEVEL_COUNT && delta >= (uint64_t{1} << ((level + 1) * SLOT_BITS))) {
+            ++level;
+        }
+
+        // Beyond the top level, park it in the furthest slot and re-cascade from there
+        uint64_t position = node.expiry;
+        uint64_t top_span = uint64_t{1} << (LEVEL_COUNT * SLOT_BITS);
+        if (delta >= top_span) position = current_ + top_span - 1;
+
+        auto slot = static_cast<size_t>((position >> (level * SLOT_BITS)) & SLOT_MASK);
+        node.level = static_cast<uint8_t>(level);
+        node.slot = static_cast<uint8_t>(slot);
+        node.prev = NIL;
+        node.next = slots_[level][slot];
+        if (node.next != NIL) nodes_[node.next].prev = index;
+        slots_[level][slot] = index;
+        occupied_[level] |= uint64_t{1} << slot;
+        ++armed_count_;
+    }
+
+    /*
+     * Unlink an armed node from its slot.
+     */
+    void unlink(uint32_t index) noexcept {
+        Node& node = nodes_[index];
+        if (node.prev != NIL) {
+            nodes_[node.prev].next = node.next;
+        } else {
+            slots_[node.level][node.slot] = node.next;
+            if (node.next == NIL) occupied_[node.level] &= ~(uint64_t{1} << node.slot);
+        }
+        if (node.next != NIL) nodes_[node.next].prev = node.prev;
+        node.prev = NIL;
+        node.next = NIL;
+        --armed_count_;
+    }
+
+    /*
+     * Redistribute timers of the slots whose window starts at the current tick.
+     * Higher levels go first so their timers can cascade further down in the same pass.
+     */
+    void cascade() noexcept {
+        size_t top = 1;
+        while (top + 1 < LEVEL_COUNT && ((current_ >> (top * SLOT_BITS)) & SLOT_MASK) == 0) {
+            ++top;
+        }
+
+        for (size_t level = top; level >= 1; --level) {
+            auto slot = static_cast<size_t>((current_ >> (level * SLOT_BITS)) & SLOT_MASK);
+            uint32_t index = slots_[level][slot];
+            slots_[level][slot] = NIL;
+            occupied_[level] &= ~(uint64_t{1} << slot);
+
+            while (index != NIL) {
+                uint32_t next = nodes_[index].next;
+                --armed_count_;
+                link(index, nodes_[index].expiry);
+                index = next;
+            }
+        }
+    }
+};
+
+/*
+ * Timers of an event loop, converts between clock time and wheel ticks of 1 ms.
+ * Not thread-safe, callers are expected to hold their own lock unless noted otherwise.
+ */
+class Timers {
+   public:
+    using Clock = std::chrono::steady_clock;
+    using Tick = std::chrono::milliseconds;
+
+   private:
+    TimerWheel wheel_;
+
+    /*
+     * Time of tick 0.
+     */
+    Clock::time_point origin_{Clock::now()};
+
+    /*
+     * Timers expired in the current iteration, only used by the loop thread.
+     */
+    std::vector<uint32_t> expired_;
+
+   public:
+    /*
+     * Arm a timer firing after the delay.
+     * Returns the timer id, never 0.
+     * Throws `std::bad_alloc` on allocation failure.
+     */
+    TimerId add(std::chrono::nanoseconds delay, const TimerCallback& callback) {
+        return wheel_.add(expiry_tick(delay), callback);
+    }
+
+    /*
+     * Cancel a timer.
+     * Returns true if the timer was pending.
+     */
+    bool cancel(TimerId id) noexcept {
+        return wheel_.cancel(id);
+    }
+
+    /*
+     * Re-arm a timer to fire after the delay.
+     * Returns true on success, false if the timer doesn't exist anymore.
+     */
+    bool reset(TimerId id, std::chrono::nanoseconds delay) noexcept {
+        return wheel_.reset(id, expiry_tick(delay));
+    }
+
+    /*
+     * Get the time the loop has to wake up at to process timers.
+     * Returns nothing if no timer is armed.
+     */
+    [[nodiscard]] std::optional<Clock::time_point> next_deadline() const noexcept {
+        auto tick = wheel_.next_expiry();
+        if (!tick) return std::nullopt;
+        return origin_ + Tick(static_cast<Tick::rep>(*tick));
+    }
+
+    /*
+     * Get the timeout in milliseconds until the next deadline, as expected by poll-like calls.
+     * Returns -1 if no timer is armed.
+     */
+    [[nodiscard]] int timeout_ms() const noexcept {
+        auto deadline = next_deadline();
+        if (!deadline) return -1;
+
+        auto remaining = std::chrono::ceil<std::chrono::milliseconds>(*deadline - Clock::now()).count();
+        return static_cast<int>(std::clamp<decltype(remaining)>(remaining, 0, std::numeric_limits<int>::max()));
+    }
+
+    /*
+     * Collect the timers expired by now.
+     */
+    void collect() {
+        auto now = std::chrono::floor<Tick>(Clock::now() - origin_).count();
+        wheel_.advance(static_cast<uint64_t>(std::max<decltype(now)>(now, 0)), expired_);
+    }
+
+    /*
+     * Fire the collected timers.
+     * Must be called without the lock held, it's released around each callback.
+     */
+    template <typename Mutex>
+    void dispatch(Mutex& mutex) {
+        if (expired_.empty()) return;
+
+        std::unique_lock<Mutex> lock(mutex);
+        for (size_t i = 0; i < expired_.size(); ++i) {
+            uint32_t index = expired_[i];
+            const TimerCallback* callback = wheel_.begin_fire(index);
+            if (callback == nullptr) continue;
+
+            lock.unlock();
+            try {
+                (*callback)();
+            } catch (...) {
+                // Keep the remaining timers for a later iteration
+                lock.lock();
+                wheel_.end_fire(index);
+                for (++i; i < expired_.size(); ++i) wheel_.requeue(expired_[i]);
+                expired_.clear();
+                throw;
+            }
+            lock.lock();
+            wheel_.end_fire(index);
+        }
+        expired_.clear();
+    }
+
+   private:
+    /*
+     * Convert a delay to the first tick at which it has fully elapsed.
+     */
+    [[nodiscard]] uint64_t expiry_tick(std::chrono::nanoseconds delay) const noexcept {
+        auto expiry = std::chrono::ceil<Tick>(Clock::now() + std::max(delay, std::chrono::nanoseconds::zero()) - origin_);
+        return static_cast<uint64_t>(std::max<Tick::rep>(expiry.count(), 0));
+    }
+};
+
+}  // namespace loopp::detail
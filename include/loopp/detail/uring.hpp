@@ -0,0 +1,334 @@
+#pragma once
+
+#include <linux/io_uring.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <system_error>
+#include <utility>
+
+namespace loopp::detail {
+
+/*
+ * Minimal io_uring instance on top of the raw kernel interface.
+ * Submission and completion rings are only meant to be used by a single thread.
+ */
+class Uring {
+   private:
+    int ring_fd_{-1};
+
+    /*
+     * Mapping shared by both rings on kernels with `IORING_FEAT_SINGLE_MMAP`,
+     * otherwise the submission ring only.
+     */
+    void* sq_ring_{MAP_FAILED};
+    size_t sq_ring_size_{0};
+
+    /*
+     * Separate completion ring mapping, `MAP_FAILED` if shared with the submission ring.
+     */
+    void* cq_ring_{MAP_FAILED};
+    size_t cq_ring_size_{0};
+
+    io_uring_sqe* sqes_{nullptr};
+    size_t sqes_size_{0};
+
+    unsigned* sq_head_{nullptr};
+    unsigned* sq_tail_{nullptr};
+    unsigned sq_mask_{0};
+    unsigned sq_entries_{0};
+
+    /*
+     * Tail including entries prepared but not published yet.
+     */
+    unsigned sq_local_tail_{0};
+
+    unsigned* cq_head_{nullptr};
+    unsigned* cq_tail_{nullptr};
+    unsigned cq_mask_{0};
+    unsigned cq_entries_{0};
+    io_uring_cqe* cqes_{nullptr};
+
+   public:
+    /*
+     * Set up a ring with room for `entries` submissions and `cq_entries` completions.
+     * Throws `std::system_error` if io_uring is unavailable or lacks required features.
+     */
+    Uring(unsigned entries, unsigned cq_entries) {
+        io_uring_params params{};
+        params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN;
+        params.cq_entries = cq_entries;
+        ring_fd_ = setup(entries, params);
+        if (ring_fd_ == -1 && errno == EINVAL) {
+            // Older kernels don't know the optimization flags
+            params = {};
+            params.flags = IORING_SETUP_CQSIZE;
+            params.cq_entries = cq_entries;
+            ring_fd_ = setup(entries, params);
+        }
+        if (ring_fd_ == -1) {
+            throw std::system_error(errno, std::system_category(), "Failed to set up io_uring");
+        }
+
+        // Timeouts are passed to io_uring_enter() directly
+        if ((params.features & IORING_FEAT_EXT_ARG) == 0) {
+            close(ring_fd_);
+            throw std::system_error(ENOTSUP, std::system_category(), "io_uring lacks IORING_FEAT_EXT_ARG");
+        }
+
+        if (!map(params)) {
+            int error = errno;
+            unmap();
+            close(ring_fd_);
+            throw std::system_error(error, std::system_category(), "Failed to map io_uring");
+        }
+    }
+
+    ~Uring() noexcept {
+        unmap();
+        if (ring_fd_ != -1) close(ring_fd_);
+    }
+
+    Uring(const Uring&) = delete;
+    Uring& operator=(const Uring&) = delete;
+    Uring(Uring&&) = delete;
+    Uring& operator=(Uring&&) = delete;
+
+    /*
+     * Get a zeroed submission entry to fill in, published on the next submit().
+     * Returns nullptr if the submission ring is full.
+     */
+    [[nodiscard]] io_uring_sqe* get_sqe() noexcept {
+        unsigned head = std::atomic_ref<unsigned>(*sq_head_).load(std::memory_order_acquire);
+        if (sq_local_tail_ - head >= sq_entries_) return nullptr;
+
+        io_uring_sqe* sqe = &sqes_[sq_local_tail_ & sq_mask_];
+        ++sq_local_tail_;
+        std::memset(sqe, 0, sizeof(*sqe));
+        return sqe;
+    }
+
+    /*
+     * Submit the prepared entries without waiting.
+     * Returns false with errno set on failure.
+     */
+    bool submit() noexcept {
+        return enter(0, nullptr);
+    }
+
+    /*
+     * Submit the prepared entries and wait for at least one completion,
+     * or until the timeout elapses if one is given.
+     * Returns false with errno set on failure.
+     * Timing out, being interrupted and completions held back on overflow are not failures.
+     */
+    bool submit_and_wait(const __kernel_timespec* timeout) noexcept {
+        return enter(1, timeout);
+    }
+
+    /*
+     * Invoke `function` for each available completion, then mark them consumed.
+     * Returns the number of completions handled.
+     */
+    template <typename Function>
+    unsigned for_each_cqe(Function&& function) {
+        std::atomic_ref<unsigned> head_ref(*cq_head_);
+        unsigned head = head_ref.load(std::memory_order_relaxed);
+        unsigned tail = std::atomic_ref<unsigned>(*cq_tail_).load(std::memory_order_acquire);
+
+        // Consume even if the function throws, so completions aren't handled twice
+        struct Consume {
+            std::atomic_ref<unsigned>& head_ref;
+            unsigned& head;
+
+            ~Consume() noexcept {
+                head_ref.store(head, std::memory_order_release);
+            }
+        } consume{head_ref, head};
+
+        unsigned count = tail - head;
+        while (head != tail) {
+            const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+            ++head;
+            function(cqe);
+        }
+        return count;
+    }
+
+    /*
+     * Get the number of completions available, not consumed yet.
+     */
+    [[nodiscard]] unsigned cq_ready() const noexcept {
+        unsigned head = std::atomic_ref<unsigned>(*cq_head_).load(std::memory_order_relaxed);
+        return std::atomic_ref<unsigned>(*cq_tail_).load(std::memory_order_acquire) - head;
+    }
+
+    /*
+     * Get the number of completions the ring can hold.
+     */
+    [[nodiscard]] unsigned cq_entries() const noexcept {
+        return cq_entries_;
+    }
+
+   private:
+    static int setup(unsigned entries, io_uring_params& params) noexcept {
+        return static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    }
+
+    /*
+     * Publish prepared entries and enter the kernel to submit them.
+     */
+    bool enter(unsigned min_complete, const __kernel_timespec* timeout) noexcept {
+        std::atomic_ref<unsigned>(*sq_tail_).store(sq_local_tail_, std::memory_order_release);
+        unsigned to_submit = sq_local_tail_ - std::atomic_ref<unsigned>(*sq_head_).load(std::memory_order_acquire);
+        if (to_submit == 0 && min_complete == 0) return true;
+
+        unsigned flags = min_complete > 0 ? IORING_ENTER_GETEVENTS : 0;
+        io_uring_getevents_arg arg{};
+        arg.sigmask_sz = _NSIG / 8;
+        arg.ts = reinterpret_cast<uint64_t>(timeout);
+        flags |= IORING_ENTER_EXT_ARG;
+
+        long result = syscall(__NR_io_uring_enter, ring_fd_, to_submit, min_complete, flags, &arg, sizeof(arg));
+        if (result == -1 && errno != ETIME && errno != EINTR && errno != EBUSY) return false;
+        return true;
+    }
+
+    /*
+     * Map the rings and the submission entries.
+     */
+    bool map(const io_uring_params& params) noexcept {
+        sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool is_single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (is_single_mmap) {
+            sq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+        }
+
+        sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+                        IORING_OFF_SQ_RING);
+        if (sq_ring_ == MAP_FAILED) return false;
+
+        char* cq_ring = static_cast<char*>(sq_ring_);
+        if (!is_single_mmap) {
+            cq_ring_ = mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+                            IORING_OFF_CQ_RING);
+            if (cq_ring_ == MAP_FAILED) return false;
+            cq_ring = static_cast<char*>(cq_ring_);
+        }
+
+        sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+                          IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) return false;
+        sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+        char* sq_ring = static_cast<char*>(sq_ring_);
+        sq_head_ = reinterpret_cast<unsigned*>(sq_ring + params.sq_off.head);
+        sq_tail_ = reinterpret_cast<unsigned*>(sq_ring + params.sq_off.tail);
+        sq_mask_ = *reinterpret_cast<unsigned*>(sq_ring + params.sq_off.ring_mask);
+        sq_entries_ = *reinterpret_cast<unsigned*>(sq_ring + params.sq_off.ring_entries);
+        sq_local_tail_ = *sq_tail_;
+
+        // Entries are used in ring order, so the indirection array is the identity
+        auto* sq_array = reinterpret_cast<unsigned*>(sq_ring + params.sq_off.array);
+        for (unsigned i = 0; i < sq_entries_; ++i) {
+            sq_array[i] = i;
+        }
+
+        cq_head_ = reinterpret_cast<unsigned*>(cq_ring + params.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned*>(cq_ring + params.cq_off.tail);
+        cq_mask_ = *reinterpret_cast<unsigned*>(cq_ring + params.cq_off.ring_mask);
+        cq_entries_ = *reinterpret_cast<unsigned*>(cq_ring + params.cq_off.ring_entries);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq_ring + params.cq_off.cqes);
+        return true;
+    }
+
+    void unmap() noexcept {
+        if (sqes_ != nullptr) munmap(sqes_, sqes_size_);
+        if (cq_ring_ != MAP_FAILED) munmap(cq_ring_, cq_ring_size_);
+        if (sq_ring_ != MAP_FAILED) munmap(sq_ring_, sq_ring_size_);
+        sqes_ = nullptr;
+        cq_ring_ = MAP_FAILED;
+        sq_ring_ = MAP_FAILED;
+    }
+};
+
+/*
+ * Pool of equally sized buffers lent to the kernel with IORING_OP_PROVIDE_BUFFERS.
+ * Receives pick a buffer themselves and report its identifier in the completion,
+ * the buffer is lent again once its data was consumed.
+ */
+class ProvidedBuffers {
+   private:
+    std::byte* buffers_{nullptr};
+    size_t size_{0};
+
+    uint16_t count_{0};
+    uint32_t buffer_size_{0};
+
+   public:
+    /*
+     * Allocate `count` buffers of `buffer_size` bytes.
+     * Throws `std::system_error` on failure.
+     */
+    ProvidedBuffers(uint16_t count, uint32_t buffer_size) : count_(count), buffer_size_(buffer_size) {
+        size_ = static_cast<size_t>(count) * buffer_size;
+        void* buffers = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (buffers == MAP_FAILED) {
+            throw std::system_error(errno, std::system_category(), "Failed to allocate provided buffers");
+        }
+        buffers_ = static_cast<std::byte*>(buffers);
+    }
+
+    ~ProvidedBuffers() noexcept {
+        munmap(buffers_, size_);
+    }
+
+    ProvidedBuffers(const ProvidedBuffers&) = delete;
+    ProvidedBuffers& operator=(const ProvidedBuffers&) = delete;
+    ProvidedBuffers(ProvidedBuffers&&) = delete;
+    ProvidedBuffers& operator=(ProvidedBuffers&&) = delete;
+
+    /*
+     * Get the buffer with the identifier reported by a completion.
+     */
+    [[nodiscard]] std::span<std::byte> buffer(uint16_t id) const noexcept {
+        return {buffers_ + static_cast<size_t>(id) * buffer_size_, buffer_size_};
+    }
+
+    /*
+     * Fill a request lending all buffers to the kernel under the group identifier.
+     */
+    void provide_all(io_uring_sqe& sqe, uint16_t group) const noexcept {
+        provide(sqe, group, 0, count_);
+    }
+
+    /*
+     * Fill a request lending a single buffer back to the kernel.
+     */
+    void provide(io_uring_sqe& sqe, uint16_t group, uint16_t id) const noexcept {
+        provide(sqe, group, id, 1);
+    }
+
+   private:
+    void provide(io_uring_sqe& sqe, uint16_t group, uint16_t id, uint16_t count) const noexcept {
+        sqe.opcode = IORING_OP_PROVIDE_BUFFERS;
+        sqe.fd = count;
+        sqe.addr = reinterpret_cast<uintptr_t>(buffer(id).data());
+        sqe.len = buffer_size_;
+        sqe.off = id;
+        sqe.buf_group = group;
+    }
+};
+
+}  // namespace loopp::detail
@@ -1,8 +1,23 @@
 #pragma once
 
+#include <sys/uio.h>
+
+#include <cerrno>
+#include <chrono>
+#include <concepts>
+#include <cstddef>
 #include <cstdint>
 #include <functional>
 #include <memory>
+#include <new>
+#include <span>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#include "loopp/callback.hpp"
+#include "loopp/stats.hpp"
+#include "loopp/trace.hpp"
 
 namespace loopp {
 
@@ -15,14 +30,200 @@ enum class EventType : uint8_t {
     WRITE
 };
 
+/*
+ * How readiness of a registered file descriptor is reported.
+ * The mode applies to the file descriptor as a whole, not to a single event type.
+ */
+enum class EventMode : uint8_t {
+    /*
+     * Reported on every iteration for as long as the file descriptor is ready.
+     */
+    LEVEL,
+
+    /*
+     * Reported only when the file descriptor becomes ready.
+     * Callbacks should drain it until `EAGAIN`, or they won't be notified again.
+     */
+    EDGE,
+
+    /*
+     * Reported once, after which the file descriptor is disarmed until rearm_fd() is called.
+     */
+    ONESHOT
+};
+
+/*
+ * Readiness conditions of a file descriptor, combined into a mask.
+ * Values match epoll's and poll's, so their masks pass through unchanged.
+ */
+using ReadyMask = uint32_t;
+
+inline constexpr ReadyMask READY_READ = 0x001;
+inline constexpr ReadyMask READY_WRITE = 0x004;
+inline constexpr ReadyMask READY_ERROR = 0x008;
+inline constexpr ReadyMask READY_HANGUP = 0x010;
+
+/*
+ * The peer shut down its writing side, reported along with `READY_READ` while reading.
+ * Lets stream sockets be torn down without reading the end of file first, select can't detect it.
+ */
+inline constexpr ReadyMask READY_READ_HANGUP = 0x2000;
+
+/*
+ * Handles all event types of a file descriptor with a single object, see EventLoop::add_fd().
+ * The loop only stores the pointer and the user data, instead of a callback per event type.
+ */
+class FdHandler {
+   public:
+    FdHandler() = default;
+    virtual ~FdHandler() noexcept = default;
+
+    FdHandler(const FdHandler&) = default;
+    FdHandler& operator=(const FdHandler&) = default;
+    FdHandler(FdHandler&&) = default;
+    FdHandler& operator=(FdHandler&&) = default;
+
+    /*
+     * Called on the loop thread with the conditions the file descriptor is ready for,
+     * the registered ones plus `READY_ERROR` and `READY_HANGUP`, which are always reported,
+     * and `READY_READ_HANGUP` if registered for reading.
+     */
+    virtual void on_ready(int fd, ReadyMask ready, void* user_data) = 0;
+};
+
 /*
  * Function signature for event callbacks.
  */
 using EventCallback = std::function<void(int fd, EventType type)>;
 
+/*
+ * Move-only event callback, stored by the loop without copying.
+ * Captures of up to `Callback::INLINE_SIZE` bytes don't allocate.
+ */
+using UniqueEventCallback = Callback<void(int fd, EventType type)>;
+
+/*
+ * Function signature for timer callbacks.
+ */
+using TimerCallback = std::function<void()>;
+
+/*
+ * Function signature for tasks posted to the loop thread.
+ */
+using Task = std::function<void()>;
+
+/*
+ * Function signature for completions of asynchronous operations.
+ * Receives the number of bytes transferred or the accepted file descriptor,
+ * or a negated errno value on failure, `-ECANCELED` if the operation was cancelled.
+ */
+using CompletionCallback = std::function<void(int result)>;
+
+/*
+ * Function signature for receives into buffers owned by the loop.
+ * Receives the number of bytes received and the data, borrowed until the callback returns.
+ * A result of 0 means end of file, a negative one is a negated errno value, the data is empty then.
+ */
+using ReceiveCallback = std::function<void(int result, std::span<const std::byte> data)>;
+
+/*
+ * Identifier of an armed timer, 0 is never a valid identifier.
+ */
+using TimerId = uint64_t;
+
+/*
+ * A single registration for batched EventLoop::add_fds().
+ */
+struct Registration {
+    int fd;
+    EventType type;
+    EventCallback callback;
+    EventMode mode{EventMode::LEVEL};
+};
+
+/*
+ * A single FdHandler registration for batched EventLoop::add_fds().
+ */
+struct HandlerRegistration {
+    int fd;
+    ReadyMask interest;
+    FdHandler* handler;
+    void* user_data{nullptr};
+    EventMode mode{EventMode::LEVEL};
+};
+
+/*
+ * A file descriptor and event type pair for batched EventLoop::remove_fds().
+ */
+struct FdEvent {
+    int fd;
+    EventType type;
+};
+
+/*
+ * Tuning of an event loop, see EventLoop::set_options().
+ * Each iteration waits for events, invokes the ready callbacks, runs posted tasks and fires due timers.
+ * Limits of 0 mean unlimited, bounding them interleaves a busy phase with the others.
+ */
+struct LoopOptions {
+    /*
+     * Maximum number of events picked up by a single wait.
+     * Only used by backends waiting into an array of events, epoll and kqueue.
+     */
+    uint32_t max_events{1024};
+
+    /*
+     * Maximum number of ready callbacks invoked per iteration.
+     * The rest are invoked first thing in the next iteration, before waiting for new events.
+     */
+    uint32_t max_callbacks{0};
+
+    /*
+     * Time ready callbacks may take per iteration, checked after each of them.
+     * Otherwise same as `max_callbacks`.
+     */
+    std::chrono::nanoseconds callback_budget{0};
+
+    /*
+     * Maximum number of posted tasks run per iteration, the rest run in the next one.
+     */
+    uint32_t max_tasks{0};
+
+    /*
+     * Time the loop keeps polling without blocking once it runs out of work, before going to sleep.
+     * Trades a busy core for the scheduler latency of waking up, 0 never polls.
+     */
+    std::chrono::microseconds busy_poll{0};
+};
+
+/*
+ * Snapshot of the busy polling of an event loop, see `LoopOptions::busy_poll`.
+ * Counters only grow.
+ */
+struct BusyPollStats {
+    /*
+     * Waits that polled instead of blocking.
+     */
+    uint64_t spins{0};
+
+    /*
+     * Polls that found events or posted tasks, the wakeups busy polling sped up.
+     */
+    uint64_t spin_hits{0};
+
+    /*
+     * Waits that blocked, with the window elapsed or busy polling off.
+     */
+    uint64_t blocking_waits{0};
+};
+
+class ReadinessAwaiter;
+class SleepAwaiter;
+
 /*
  * Manages I/O events for multiple file descriptors, thread-safe.
  * Uses the best available mechanism based on the platform.
+ * Changes made from the loop thread itself don't need to wake it up, so they're cheaper.
  */
 class EventLoop {
    public:
@@ -34,6 +235,18 @@ class EventLoop {
      */
     static std::unique_ptr<EventLoop> create();
 
+    /*
+     * Create an instance of the EventLoop with the options.
+     * Throws `std::system_error` on initialization failure or if the options are out of range.
+     */
+    static std::unique_ptr<EventLoop> create(const LoopOptions& options) {
+        std::unique_ptr<EventLoop> loop = create();
+        if (!loop->set_options(options)) {
+            throw std::system_error(errno, std::system_category(), "Invalid event loop options");
+        }
+        return loop;
+    }
+
     EventLoop() = default;
     virtual ~EventLoop() noexcept = default;
 
@@ -47,12 +260,153 @@ class EventLoop {
      */
     [[nodiscard]] virtual bool is_running() const noexcept = 0;
 
+    /*
+     * Change the options of the loop, callable from any thread, even while it's running.
+     * Picked up by the loop at the start of its next iteration.
+     * Returns true on success, false with `EINVAL` if an option is out of range.
+     */
+    virtual bool set_options(const LoopOptions& options) noexcept = 0;
+
+    /*
+     * Get the options last set on the loop.
+     */
+    [[nodiscard]] virtual LoopOptions options() const noexcept = 0;
+
+    /*
+     * Take a snapshot of the busy polling counters, callable from any thread.
+     */
+    [[nodiscard]] virtual BusyPollStats busy_poll_stats() const noexcept = 0;
+
+    /*
+     * Take a snapshot of the instrumentation, callable from any thread without blocking the loop.
+     * All zero unless the library is configured with `-DSTATS=ON`, see LoopStats.
+     */
+    [[nodiscard]] virtual LoopStats stats() const noexcept = 0;
+
+    /*
+     * Start or stop recording a trace of the loop, callable from any thread at any time.
+     * Records waits, callbacks, wakeups and registration changes into a ring buffer allocated on first use.
+     * While disabled, recording costs a branch and the records made so far stay readable.
+     * Returns true on success, false on failure (check errno for details).
+     */
+    virtual bool set_tracing(bool is_enabled) noexcept = 0;
+
+    /*
+     * Get the trace buffer, null if tracing was never enabled. It lives as long as the loop.
+     */
+    [[nodiscard]] virtual const TraceBuffer* trace() const noexcept = 0;
+
     /*
      * Add a file descriptor to the event loop with the specified event type and callback.
      * Returns true on success, false on failure (check errno for details).
      * If the file descriptor and event type are already registered, it's a no-op and returns true.
+     * Uses level-triggered mode.
+     */
+    bool add_fd(int fd, EventType type, const EventCallback& callback) noexcept {
+        return add_fd(fd, type, callback, EventMode::LEVEL);
+    }
+
+    /*
+     * Same as above, taking ownership of the callback.
+     */
+    bool add_fd(int fd, EventType type, UniqueEventCallback&& callback) noexcept {
+        return add_fd(fd, type, std::move(callback), EventMode::LEVEL);
+    }
+
+    /*
+     * Add a file descriptor with a copy of the callback.
+     * Fails with `ENOMEM` if the callback can't be copied.
+     * Otherwise same as the overload taking ownership of the callback.
+     */
+    bool add_fd(int fd, EventType type, const EventCallback& callback, EventMode mode) noexcept {
+        try {
+            return add_fd(fd, type, UniqueEventCallback(callback), mode);
+        } catch (const std::bad_alloc&) {
+            errno = ENOMEM;
+            return false;
+        }
+    }
+
+    /*
+     * Add a file descriptor with any callable, moved or copied straight into the loop's storage
+     * without going through a `std::function`.
+     * Fails with `ENOMEM` if the callable is too large to store inline and allocation fails.
+     * Otherwise same as the overload taking ownership of the callback.
+     */
+    template <typename F>
+        requires(!std::same_as<std::remove_cvref_t<F>, EventCallback> &&
+                 !std::same_as<std::remove_cvref_t<F>, UniqueEventCallback> &&
+                 std::is_invocable_v<std::decay_t<F>&, int, EventType>)
+    bool add_fd(int fd, EventType type, F&& callback, EventMode mode = EventMode::LEVEL) noexcept {
+        try {
+            return add_fd(fd, type, UniqueEventCallback(std::forward<F>(callback)), mode);
+        } catch (const std::bad_alloc&) {
+            errno = ENOMEM;
+            return false;
+        }
+    }
+
+    /*
+     * Add a file descriptor to the event loop with the specified event type, callback and mode.
+     * Returns true on success, false on failure (check errno for details).
+     * If the file descriptor and event type are already registered, it's a no-op and returns true,
+     * the callback is dropped then.
+     * Fails with `EINVAL` if the file descriptor is already registered with a different mode
+     * or with an FdHandler, and with `ENOTSUP` if the backend can't provide the mode.
+     */
+    virtual bool add_fd(int fd, EventType type, UniqueEventCallback&& callback, EventMode mode) noexcept = 0;
+
+    /*
+     * Same as add_fd(), but fails with `EBUSY` if the file descriptor and event type are already
+     * registered instead of dropping the callback, for callers that must own the registration.
+     */
+    virtual bool add_fd_exclusive(int fd, EventType type, UniqueEventCallback&& callback, EventMode mode) noexcept = 0;
+
+    /*
+     * Add a file descriptor with a single handler for all of its event types, level-triggered.
+     * Otherwise same as the overload taking a mode.
+     */
+    bool add_fd(int fd, ReadyMask interest, FdHandler* handler, void* user_data) noexcept {
+        return add_fd(fd, interest, handler, user_data, EventMode::LEVEL);
+    }
+
+    /*
+     * Add a file descriptor with a single handler for all of its event types, instead of a callback per type.
+     * The interest is a mask of `READY_READ` and `READY_WRITE`, errors and hangups are always reported.
+     * The handler receives the user data with every call, it must stay valid until removed.
+     * Adding the file descriptor again replaces its interest, handler, user data and mode,
+     * so toggling `READY_WRITE` costs a single change.
+     * remove_fd() drops an event type from the interest, the registration is gone with the last one.
+     * Returns true on success, false on failure (check errno for details).
+     * Fails with `EINVAL` if the interest is empty, the handler is null,
+     * or the file descriptor has callbacks registered (and vice versa).
+     * Fails with `ENOTSUP` if the backend can't provide the mode.
+     */
+    virtual bool add_fd(int fd, ReadyMask interest, FdHandler* handler, void* user_data, EventMode mode) noexcept = 0;
+
+    /*
+     * Add multiple registrations at once, same as calling add_fd() for each of them.
+     * Wakes up the loop at most once for the whole batch.
+     * Returns true on success, false on failure (check errno for details).
+     * Registrations are applied in order and the batch stops at the first failure,
+     * the ones applied before it stay registered.
+     */
+    virtual bool add_fds(std::span<const Registration> registrations) noexcept = 0;
+
+    /*
+     * Add multiple FdHandler registrations at once, same as calling add_fd() for each of them.
+     * Otherwise same as the overload taking callback registrations.
+     */
+    virtual bool add_fds(std::span<const HandlerRegistration> registrations) noexcept = 0;
+
+    /*
+     * Rearm a file descriptor registered in oneshot mode, re-enabling all of its event types.
+     * Changing the registration with add_fd() or remove_fd() rearms it as well.
+     * Returns true on success, false on failure (check errno for details).
+     * Fails with `ENOENT` if the file descriptor is not registered.
+     * For other modes it's a no-op and returns true.
      */
-    virtual bool add_fd(int fd, EventType type, const EventCallback& callback) noexcept = 0;
+    virtual bool rearm_fd(int fd) noexcept = 0;
 
     /*
      * Remove a file descriptor and event type from the event loop.
@@ -61,6 +415,115 @@ class EventLoop {
      */
     virtual bool remove_fd(int fd, EventType type) noexcept = 0;
 
+    /*
+     * Remove multiple file descriptors and event types at once, same as calling remove_fd() for each of them.
+     * Wakes up the loop at most once for the whole batch.
+     * Returns true on success, false on failure (check errno for details).
+     * Removals are applied in order and the batch stops at the first failure,
+     * the ones applied before it stay removed.
+     */
+    virtual bool remove_fds(std::span<const FdEvent> events) noexcept = 0;
+
+    /*
+     * Arm a timer calling the callback once on the loop thread after the delay.
+     * Timers have millisecond resolution and never fire early.
+     * Returns the timer identifier, or 0 on failure (check errno for details).
+     */
+    virtual TimerId add_timer(std::chrono::nanoseconds delay, const TimerCallback& callback) noexcept = 0;
+
+    /*
+     * Re-arm a timer to fire after the delay, counting from now.
+     * Works on pending timers and from the timer's own callback, e.g. to make it periodic.
+     * Returns true on success, false on failure (check errno for details).
+     * Fails with `ENOENT` if the timer already fired or was cancelled.
+     */
+    virtual bool reset_timer(TimerId id, std::chrono::nanoseconds delay) noexcept = 0;
+
+    /*
+     * Cancel a timer so it doesn't fire.
+     * Returns true if the timer was pending, false if it already fired or was cancelled.
+     */
+    virtual bool cancel_timer(TimerId id) noexcept = 0;
+
+    /*
+     * Run the task on the loop thread, callable from any thread.
+     * Tasks run in posting order after the I/O callbacks of an iteration.
+     * Tasks posted before start() run once the loop starts.
+     * Wakeups are coalesced, posting many tasks while the loop is busy costs a single wakeup.
+     * Returns true on success, false on failure (check errno for details).
+     */
+    virtual bool post(Task task) noexcept = 0;
+
+    /*
+     * Read into the buffer once the file descriptor is readable, then invoke the callback on the loop thread.
+     * Reads may be short, a result of 0 means end of file.
+     * The buffer must stay valid until the callback is invoked.
+     * Backends without native completions emulate them with readiness and non-blocking system calls,
+     * the file descriptor must be non-blocking then, and fails with `EBUSY` if the event type
+     * is registered with add_fd() (and vice versa).
+     * Operations of the same event type on a file descriptor are only ordered when emulated,
+     * keep a single one in flight to rely on their order.
+     * Returns true if the operation was queued, false on failure (check errno for details).
+     */
+    virtual bool async_read(int fd, std::span<std::byte> buffer, const CompletionCallback& callback) noexcept = 0;
+
+    /*
+     * Write the data once the file descriptor is writable, then invoke the callback on the loop thread.
+     * Writes may be short, the data must stay valid until the callback is invoked.
+     * Otherwise same as async_read().
+     */
+    virtual bool async_write(int fd, std::span<const std::byte> data, const CompletionCallback& callback) noexcept = 0;
+
+    /*
+     * Write the buffers in order with a single vectored write, then invoke the callback on the loop thread.
+     * The array of buffers is copied, the data they point to must stay valid until the callback is invoked.
+     * Otherwise same as async_write().
+     */
+    virtual bool async_writev(int fd, std::span<const iovec> buffers, const CompletionCallback& callback) noexcept = 0;
+
+    /*
+     * Accept a connection on the listening socket, then invoke the callback on the loop thread.
+     * The result is the accepted socket, non-blocking and close-on-exec.
+     * Otherwise same as async_read().
+     */
+    virtual bool async_accept(int fd, const CompletionCallback& callback) noexcept = 0;
+
+    /*
+     * Receive from the socket continuously, invoking the callback on the loop thread for every chunk.
+     * Data lands in pooled buffers owned by the loop, taken only while it's being delivered,
+     * so idle sockets don't hold any buffer memory.
+     * Receiving stops at end of file, on error or on cancel_async(), reported by a last callback.
+     * Takes the read side of the socket the same way async_read() does.
+     * Returns true if receiving started, false on failure (check errno for details).
+     */
+    virtual bool async_recv(int fd, const ReceiveCallback& callback) noexcept = 0;
+
+    /*
+     * Cancel the pending asynchronous operations on the file descriptor.
+     * Their callbacks are still invoked on the loop thread, with `-ECANCELED` unless they completed meanwhile.
+     * Call it before closing a file descriptor with operations in flight.
+     * Returns true on success, false on failure (check errno for details).
+     */
+    virtual bool cancel_async(int fd) noexcept = 0;
+
+    /*
+     * Suspend the calling coroutine until the file descriptor is readable, see loopp/coro.hpp.
+     * `co_await` resumes it on the loop thread with true, or with false on failure (check errno for details).
+     */
+    [[nodiscard]] ReadinessAwaiter readable(int fd) noexcept;
+
+    /*
+     * Suspend the calling coroutine until the file descriptor is writable.
+     * Otherwise same as readable().
+     */
+    [[nodiscard]] ReadinessAwaiter writable(int fd) noexcept;
+
+    /*
+     * Suspend the calling coroutine for the delay, with the same resolution as add_timer().
+     * Otherwise same as readable().
+     */
+    [[nodiscard]] SleepAwaiter sleep(std::chrono::nanoseconds delay) noexcept;
+
     /*
      * Start the event loop.
      * This call blocks until stop() is called from another thread.
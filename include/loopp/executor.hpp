@@ -0,0 +1,135 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "loopp/event_loop.hpp"
+
+namespace loopp {
+
+/*
+ * Snapshot of the activity of an Executor.
+ * Counters only grow, depths are approximate while workers are busy.
+ */
+struct ExecutorStats {
+    /*
+     * Tasks submitted so far.
+     */
+    uint64_t submitted{0};
+
+    /*
+     * Tasks that finished running.
+     */
+    uint64_t completed{0};
+
+    /*
+     * Tasks a worker took from another worker's queue.
+     */
+    uint64_t steals{0};
+
+    /*
+     * Tasks waiting in each worker's queue, indexed by worker.
+     */
+    std::vector<size_t> queue_depths;
+};
+
+/*
+ * Work-stealing thread pool for work too heavy to run on a loop thread.
+ * Every worker owns a Chase-Lev deque, idle workers steal from the others.
+ * Tasks submitted by a worker go to its own deque, others are spread across them.
+ * Tasks must not throw, an exception escaping one terminates the program.
+ */
+class Executor {
+   private:
+    struct Job;
+    struct Worker;
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread> threads_;
+
+    /*
+     * Worker the next task from outside the pool is handed to, wraps around.
+     */
+    std::atomic<size_t> next_worker_{0};
+
+    /*
+     * Number of workers about to sleep or sleeping, submitters only wake them up if there are any.
+     */
+    std::atomic<size_t> sleepers_{0};
+
+    /*
+     * Bumped to wake up sleeping workers.
+     */
+    std::atomic<uint32_t> epoch_{0};
+
+    /*
+     * Set on destruction, workers exit once no task is left.
+     */
+    std::atomic<bool> is_stopping_{false};
+
+    std::atomic<uint64_t> submitted_{0};
+
+   public:
+    /*
+     * Start `count` workers, one per core if 0.
+     * Throws `std::system_error` if a worker can't be started.
+     */
+    explicit Executor(size_t count = 0);
+
+    /*
+     * Run the tasks submitted so far, then join the workers.
+     */
+    ~Executor() noexcept;
+
+    Executor(const Executor&) = delete;
+    Executor& operator=(const Executor&) = delete;
+    Executor(Executor&&) = delete;
+    Executor& operator=(Executor&&) = delete;
+
+    /*
+     * Get the number of workers.
+     */
+    [[nodiscard]] size_t size() const noexcept;
+
+    /*
+     * Run the task on a worker, callable from any thread.
+     * Returns true on success, false with `ENOMEM` on allocation failure.
+     */
+    bool submit(Task task) noexcept;
+
+    /*
+     * Run the work on a worker, then post the resumption to the loop, callable from any thread.
+     * Lets a callback move heavy work off the loop thread and continue there once it's done.
+     * The loop must outlive the work, a resumption the loop can't take is dropped.
+     * Returns true on success, false with `ENOMEM` on allocation failure.
+     */
+    bool offload(EventLoop& loop, Task work, Task resume) noexcept;
+
+    /*
+     * Take a snapshot of the counters and queue depths, callable from any thread.
+     */
+    [[nodiscard]] ExecutorStats stats() const;
+
+   private:
+    /*
+     * Run tasks until stopped, sleeping while there's nothing to run.
+     */
+    void run(size_t index);
+
+    /*
+     * Find a task for the worker: its own deque first, then new submissions, then the other deques.
+     * Returns nullptr if there's nothing to run.
+     */
+    Job* find_job(Worker& worker);
+
+    /*
+     * Wake up one sleeping worker, if any.
+     */
+    void wake_one() noexcept;
+};
+
+}  // namespace loopp
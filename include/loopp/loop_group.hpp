@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "loopp/event_loop.hpp"
+
+namespace loopp {
+
+/*
+ * Group of event loops, each one running on its own thread pinned to its own core.
+ * Spreads work across cores with one reactor per thread, nothing is shared between the loops.
+ * Work is usually handed to a loop with next(), or every loop accepts on its own listening socket.
+ */
+class LoopGroup {
+   private:
+    std::vector<std::shared_ptr<EventLoop>> loops_;
+
+    /*
+     * Cores the loops are pinned to, empty if pinning is disabled or unsupported.
+     */
+    std::vector<int> cpus_;
+
+    std::vector<std::thread> threads_;
+
+    /*
+     * Index of the loop next() returns, wraps around.
+     */
+    std::atomic<size_t> next_{0};
+
+    /*
+     * Set by stop(), so loops that didn't start yet stop right away.
+     */
+    std::atomic<bool> is_stopping_{false};
+
+    /*
+     * First exception a loop thread exited with, rethrown by join().
+     */
+    std::exception_ptr error_;
+    std::mutex error_mutex_;
+
+   public:
+    /*
+     * Create `count` loops, one per core available to the process if 0.
+     * With `pin_threads`, loop `i` runs on the `i`-th available core, wrapping around.
+     * Throws `std::system_error` if a loop can't be created.
+     */
+    explicit LoopGroup(size_t count = 0, bool pin_threads = true);
+
+    /*
+     * Stop and join the loops if they're running.
+     */
+    ~LoopGroup() noexcept;
+
+    LoopGroup(const LoopGroup&) = delete;
+    LoopGroup& operator=(const LoopGroup&) = delete;
+    LoopGroup(LoopGroup&&) = delete;
+    LoopGroup& operator=(LoopGroup&&) = delete;
+
+    /*
+     * Get the number of loops.
+     */
+    [[nodiscard]] size_t size() const noexcept;
+
+    /*
+     * Get the loop at the index.
+     */
+    [[nodiscard]] const std::shared_ptr<EventLoop>& loop(size_t index) const noexcept;
+
+    /*
+     * Get the next loop in round-robin order, callable from any thread.
+     */
+    [[nodiscard]] const std::shared_ptr<EventLoop>& next() noexcept;
+
+    /*
+     * Get the core the loop at the index is pinned to, -1 if it isn't pinned.
+     */
+    [[nodiscard]] int cpu(size_t index) const noexcept;
+
+    /*
+     * Start every loop on its own thread, doesn't block.
+     * Pinning is best effort, a loop whose core can't be set runs unpinned.
+     * Throws `std::system_error` if a thread can't be started, the started ones are stopped and joined.
+     */
+    void start();
+
+    /*
+     * Stop every loop, callable from any thread including the loop threads.
+     * Loops that didn't start running yet stop as soon as they do.
+     * Returns true on success, false if a loop can't be woken up (check errno for details).
+     */
+    bool stop() noexcept;
+
+    /*
+     * Wait for every loop thread to exit.
+     * Rethrows the first exception a loop exited with, the other loops are stopped then.
+     * Must not be called from a loop thread.
+     */
+    void join();
+};
+
+}  // namespace loopp
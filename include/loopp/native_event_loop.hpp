@@ -0,0 +1,38 @@
+#pragma once
+
+/*
+ * The backend the library was built with, as a concrete type.
+ * Calls through it are resolved at compile time and can be inlined, and the loop can be
+ * embedded by value, unlike EventLoop::create() which returns it behind the virtual interface.
+ * Both share the implementation, a NativeEventLoop can still be passed on as an EventLoop&.
+ * Requires the compile definitions of the loopp target, which CMake passes on to its users.
+ */
+#if defined(LOOPP_BACKEND_IO_URING)
+#include "loopp/detail/event_loop_io_uring.hpp"
+#elif defined(LOOPP_BACKEND_EPOLL)
+#include "loopp/detail/event_loop_epoll.hpp"
+#elif defined(LOOPP_BACKEND_KQUEUE)
+#include "loopp/detail/event_loop_kqueue.hpp"
+#elif defined(LOOPP_BACKEND_POLL)
+#include "loopp/detail/event_loop_poll.hpp"
+#elif defined(LOOPP_BACKEND_SELECT)
+#include "loopp/detail/event_loop_select.hpp"
+#else
+#error "No loopp backend defined, link against the loopp target"
+#endif
+
+namespace loopp {
+
+#if defined(LOOPP_BACKEND_IO_URING)
+using NativeEventLoop = EventLoopIoUring;
+#elif defined(LOOPP_BACKEND_EPOLL)
+using NativeEventLoop = EventLoopEpoll;
+#elif defined(LOOPP_BACKEND_KQUEUE)
+using NativeEventLoop = EventLoopKqueue;
+#elif defined(LOOPP_BACKEND_POLL)
+using NativeEventLoop = EventLoopPoll;
+#else
+using NativeEventLoop = EventLoopSelect;
+#endif
+
+}  // namespace loopp
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace loopp {
+
+/*
+ * Log-linear histogram of values, in the style of HDR histograms.
+ * Values below 16 are exact, larger ones land in one of 16 buckets per power of two,
+ * so reported values are within 1/16 of the recorded ones. Values from 2^40 up are clamped.
+ */
+class Histogram {
+   public:
+    /*
+     * Bits of a value kept by its bucket, and the number of buckets per power of two.
+     */
+    static constexpr unsigned PRECISION_BITS = 4;
+    static constexpr size_t SUB_BUCKET_COUNT = size_t{1} << PRECISION_BITS;
+
+    /*
+     * Values from `2^MAX_EXPONENT` up are recorded as the largest trackable one.
+     */
+    static constexpr unsigned MAX_EXPONENT = 40;
+    static constexpr uint64_t MAX_VALUE = (uint64_t{1} << MAX_EXPONENT) - 1;
+
+    static constexpr size_t BUCKET_COUNT = SUB_BUCKET_COUNT + (MAX_EXPONENT - PRECISION_BITS) * SUB_BUCKET_COUNT;
+
+   private:
+    std::array<uint64_t, BUCKET_COUNT> counts_{};
+    uint64_t count_{0};
+
+   public:
+    /*
+     * Get the bucket a value is counted in.
+     */
+    [[nodiscard]] static constexpr size_t bucket_index(uint64_t value) noexcept {
+        value = std::min(value, MAX_VALUE);
+        if (value < SUB_BUCKET_COUNT) return static_cast<size_t>(value);
+
+        auto exponent = static_cast<unsigned>(std::bit_width(value)) - 1;
+        auto mantissa = static_cast<size_t>(value >> (exponent - PRECISION_BITS));
+        return (exponent - PRECISION_BITS + 1) * SUB_BUCKET_COUNT + (mantissa - SUB_BUCKET_COUNT);
+    }
+
+    /*
+     * Get the largest value counted in a bucket.
+     */
+    [[nodiscard]] static constexpr uint64_t bucket_value(size_t index) noexcept {
+        if (index < SUB_BUCKET_COUNT) return index;
+
+        size_t exponent = index / SUB_BUCKET_COUNT + PRECISION_BITS - 1;
+        uint64_t mantissa = index % SUB_BUCKET_COUNT + SUB_BUCKET_COUNT;
+        size_t shift = exponent - PRECISION_BITS;
+        return ((mantissa + 1) << shift) - 1;
+    }
+
+    /*
+     * Count a value, `count` times.
+     */
+    void record(uint64_t value, uint64_t count = 1) noexcept {
+        counts_[bucket_index(value)] += count;
+        count_ += count;
+    }
+
+    /*
+     * Get the number of values recorded.
+     */
+    [[nodiscard]] uint64_t count() const noexcept {
+        return count_;
+    }
+
+    /*
+     * Get the counts of every bucket, indexed as by bucket_index().
+     */
+    [[nodiscard]] std::span<const uint64_t, BUCKET_COUNT> buckets() const noexcept {
+        return counts_;
+    }
+
+    /*
+     * Get the value at or below which the percentile of recorded values fall, e.g. 99.9.
+     * Returns 0 if nothing was recorded.
+     */
+    [[nodiscard]] uint64_t percentile(double percentile) const noexcept {
+        if (count_ == 0) return 0;
+
+        double clamped = std::clamp(percentile, 0.0, 100.0);
+        auto rank = static_cast<uint64_t>(clamped / 100.0 * static_cast<double>(count_) + 0.5);
+        rank = std::clamp<uint64_t>(rank, 1, count_);
+
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+            seen += counts_[i];
+            if (seen >= rank) return bucket_value(i);
+        }
+        return MAX_VALUE;
+    }
+
+    /*
+     * Get the largest value recorded, as reported by its bucket.
+     */
+    [[nodiscard]] uint64_t max() const noexcept {
+        for (size_t i = BUCKET_COUNT; i > 0; --i) {
+            if (counts_[i - 1] != 0) return bucket_value(i - 1);
+        }
+        return 0;
+    }
+};
+
+/*
+ * Snapshot of the instrumentation of an event loop, see EventLoop::stats().
+ * Only collected when the library is configured with `-DSTATS=ON`, all zero otherwise.
+ * Counters only grow.
+ */
+struct LoopStats {
+    /*
+     * Whether the library collects statistics at all.
+     */
+    bool is_enabled{false};
+
+    /*
+     * Iterations of the loop, each waiting for events once or finishing left over callbacks.
+     */
+    uint64_t iterations{0};
+
+    /*
+     * Waits for events and the time spent in them, blocked or not.
+     */
+    uint64_t waits{0};
+    uint64_t wait_time_ns{0};
+
+    /*
+     * Events, or completions with io_uring, reported per wait.
+     */
+    Histogram events_per_wait;
+
+    /*
+     * Execution time of ready callbacks and FdHandlers, in nanoseconds.
+     */
+    Histogram callback_time_ns;
+
+    /*
+     * Wakeups written to the loop, and the ones coalesced into a pending wakeup instead.
+     */
+    uint64_t wakeups_issued{0};
+    uint64_t wakeups_coalesced{0};
+
+    /*
+     * Registration changes handed to the kernel: epoll_ctl() calls with epoll, submission entries
+     * with io_uring and changes with kqueue. Poll and select keep registrations in user space.
+     */
+    uint64_t registration_changes{0};
+};
+
+}  // namespace loopp
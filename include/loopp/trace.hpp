@@ -0,0 +1,220 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace loopp {
+
+/*
+ * What a trace record stands for, see TraceRecord for the meaning of its fields.
+ */
+enum class TraceKind : uint8_t {
+    /*
+     * The loop starts and stops waiting for events, the end carries the number of events returned.
+     */
+    WAIT_BEGIN,
+    WAIT_END,
+
+    /*
+     * A ready callback starts and returns, with its file descriptor and event type.
+     */
+    CALLBACK_BEGIN,
+    CALLBACK_END,
+
+    /*
+     * An FdHandler starts and returns, with its file descriptor and the conditions it's told about.
+     */
+    HANDLER_BEGIN,
+    HANDLER_END,
+
+    /*
+     * A wakeup is written to the loop, by the thread waking it up.
+     */
+    WAKEUP,
+
+    /*
+     * A registration change is handed to the kernel, on the thread making it.
+     * Carries the operation with epoll, e.g. `EPOLL_CTL_ADD`, and the number of changes otherwise.
+     */
+    REGISTRATION
+};
+
+/*
+ * Fixed-size binary trace record, written as is to dumps.
+ */
+struct TraceRecord {
+    /*
+     * Time of the record on the steady clock.
+     */
+    uint64_t timestamp_ns{0};
+
+    /*
+     * File descriptor the record is about, -1 if none.
+     */
+    int32_t fd{-1};
+
+    /*
+     * Count, operation or ready mask, depending on the kind.
+     */
+    uint32_t value{0};
+
+    /*
+     * Small number identifying the recording thread, unique within the process.
+     */
+    uint32_t thread{0};
+
+    TraceKind kind{TraceKind::WAIT_BEGIN};
+
+    /*
+     * Event type of callbacks, as the value of `EventType`.
+     */
+    uint8_t type{0};
+
+    uint16_t padding{0};
+};
+
+static_assert(sizeof(TraceRecord) == 24, "Trace records are dumped as they are");
+
+namespace detail {
+
+/*
+ * Get the number of the calling thread in trace records, assigned on first use.
+ */
+inline uint32_t trace_thread() noexcept {
+    static std::atomic<uint32_t> next_thread{1};
+    thread_local uint32_t thread = next_thread.fetch_add(1, std::memory_order_relaxed);
+    return thread;
+}
+
+}  // namespace detail
+
+/*
+ * Ring buffer of trace records, written without locks, allocations or formatting.
+ * Any thread can record, once full the oldest records are overwritten.
+ * Each slot carries a sequence number, so snapshots skip records being written instead of tearing them.
+ * A writer lapped by the ring while it's still writing drops its record instead of clobbering a newer one.
+ */
+class TraceBuffer {
+   public:
+    /*
+     * Number of records kept by default, 1.5 MiB worth of them.
+     */
+    static constexpr size_t DEFAULT_CAPACITY = size_t{1} << 16;
+
+   private:
+    static constexpr size_t WORD_COUNT = sizeof(TraceRecord) / sizeof(uint64_t);
+
+    /*
+     * A record stored as words, so snapshots can read it while it's overwritten.
+     * The sequence is odd while the record is written, and even once it's complete.
+     */
+    struct Slot {
+        std::atomic<uint64_t> sequence{0};
+        std::array<std::atomic<uint64_t>, WORD_COUNT> words{};
+    };
+
+    std::unique_ptr<Slot[]> slots_;
+    size_t mask_;
+
+    /*
+     * Index of the next record, only grows.
+     */
+    alignas(64) std::atomic<uint64_t> head_{0};
+    std::atomic<uint64_t> dropped_{0};
+
+   public:
+    /*
+     * Capacity is rounded up to a power of two.
+     * Throws `std::bad_alloc` if the slots can't be allocated.
+     */
+    explicit TraceBuffer(size_t capacity = DEFAULT_CAPACITY);
+
+    TraceBuffer(const TraceBuffer&) = delete;
+    TraceBuffer& operator=(const TraceBuffer&) = delete;
+    TraceBuffer(TraceBuffer&&) = delete;
+    TraceBuffer& operator=(TraceBuffer&&) = delete;
+
+    /*
+     * Append a record stamped with the current time and thread, callable from any thread.
+     */
+    void record(TraceKind kind, int fd = -1, uint32_t value = 0, uint8_t type = 0) noexcept {
+        uint64_t index = head_.fetch_add(1, std::memory_order_relaxed);
+        Slot& slot = slots_[index & mask_];
+
+        TraceRecord record;
+        record.timestamp_ns = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+        record.fd = fd;
+        record.value = value;
+        record.thread = detail::trace_thread();
+        record.kind = kind;
+        record.type = type;
+        auto words = std::bit_cast<std::array<uint64_t, WORD_COUNT>>(record);
+
+        // Claim the slot, unless a newer record took it or another writer is still busy with it
+        uint64_t sequence = slot.sequence.load(std::memory_order_relaxed);
+        do {
+            if ((sequence & 1) != 0 || sequence > index * 2) {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+        } while (!slot.sequence.compare_exchange_weak(sequence, index * 2 + 1, std::memory_order_relaxed));
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < WORD_COUNT; ++i) {
+            slot.words[i].store(words[i], std::memory_order_relaxed);
+        }
+        slot.sequence.store(index * 2 + 2, std::memory_order_release);
+    }
+
+    /*
+     * Copy the complete records still in the buffer, oldest first, callable from any thread.
+     * Throws `std::bad_alloc` on allocation failure.
+     */
+    [[nodiscard]] std::vector<TraceRecord> snapshot() const;
+
+    /*
+     * Get the number of records the buffer keeps.
+     */
+    [[nodiscard]] size_t capacity() const noexcept;
+
+    /*
+     * Get the number of records ever made, those beyond the capacity were overwritten.
+     */
+    [[nodiscard]] uint64_t recorded() const noexcept;
+
+    /*
+     * Get the number of records dropped because their slot was busy, rare unless the buffer is tiny.
+     */
+    [[nodiscard]] uint64_t dropped() const noexcept;
+};
+
+/*
+ * Write records as a binary dump: a header with their count, then the records as they are.
+ * Returns true on success, false on failure (check errno for details).
+ */
+bool write_trace(std::FILE* file, std::span<const TraceRecord> records) noexcept;
+
+/*
+ * Read the records of a binary dump written by write_trace() on the same architecture.
+ * Returns true on success, false on failure (check errno for details), `EINVAL` if it's not a dump.
+ * Throws `std::bad_alloc` on allocation failure.
+ */
+bool read_trace(std::FILE* file, std::vector<TraceRecord>& records);
+
+/*
+ * Write records as Chrome trace event JSON, readable by Perfetto and chrome://tracing.
+ * Begin and end records become duration events per thread, the others instant events.
+ * Timestamps are relative to the first record, ends without a recorded begin are skipped.
+ * Returns true on success, false on failure (check errno for details).
+ */
+bool write_chrome_trace(std::FILE* file, std::span<const TraceRecord> records) noexcept;
+
+}  // namespace loopp
@@ -0,0 +1,353 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <span>
+
+#include "loopp/event_loop.hpp"
+
+namespace loopp {
+
+/*
+ * Function signature for the completion of a transfer.
+ * Receives the number of bytes transferred, or a negated errno value on failure.
+ */
+using TransferCallback = std::function<void(int64_t result)>;
+
+/*
+ * Moves data from a socket or pipe to another file descriptor until end of file, without copying
+ * it through user space: splice() into a pipe of its own, then out of it.
+ * Reading is only armed while the pipe has room and writing while it holds data,
+ * so a slow destination stops the reads instead of piling data up.
+ * Takes the READ event type of the source and the WRITE event type of the destination
+ * with add_fd(), so transfers in both directions can share a pair of sockets.
+ * Both file descriptors must be non-blocking.
+ * Not thread-safe, used from the loop thread or before the loop starts.
+ * Only available on Linux, start() fails with `ENOTSUP` elsewhere.
+ */
+class SpliceTransfer {
+   public:
+    /*
+     * Size requested for the pipe, the most data buffered between the source and the destination.
+     * The kernel may grant less.
+     */
+    static constexpr size_t PIPE_SIZE = 1 << 20;
+
+   private:
+    EventLoop& loop_;
+    int pipe_read_{-1};
+    int pipe_write_{-1};
+    size_t pipe_capacity_{0};
+
+    int from_{-1};
+    int to_{-1};
+    TransferCallback callback_;
+
+    /*
+     * Bytes sitting in the pipe, and bytes written to the destination so far.
+     */
+    size_t buffered_{0};
+    int64_t transferred_{0};
+    bool is_source_done_{false};
+
+    /*
+     * Event types currently registered with the loop.
+     */
+    bool is_reading_{false};
+    bool is_writing_{false};
+
+   public:
+    /*
+     * Throws `std::system_error` if the pipe can't be created.
+     */
+    explicit SpliceTransfer(EventLoop& loop);
+
+    /*
+     * Cancel the transfer if it's running.
+     */
+    ~SpliceTransfer() noexcept;
+
+    SpliceTransfer(const SpliceTransfer&) = delete;
+    SpliceTransfer& operator=(const SpliceTransfer&) = delete;
+    SpliceTransfer(SpliceTransfer&&) = delete;
+    SpliceTransfer& operator=(SpliceTransfer&&) = delete;
+
+    /*
+     * Start moving data from `from` to `to`, invoking the callback once `from` reached end of file
+     * and everything was written, or on failure. It's invoked on the loop thread without the transfer
+     * running anymore, so it may start another one or destroy this one.
+     * Returns true on success, false on failure (check errno for details).
+     * Fails with `EBUSY` if a transfer is running.
+     */
+    bool start(int from, int to, const TransferCallback& callback) noexcept;
+
+    /*
+     * Stop the transfer without invoking its callback, data still in the pipe is dropped.
+     * Returns true on success, false on failure (check errno for details).
+     * If no transfer is running, it's a no-op and returns true.
+     */
+    bool cancel() noexcept;
+
+    /*
+     * Check if a transfer is running.
+     */
+    [[nodiscard]] bool is_running() const noexcept;
+
+    /*
+     * Get the number of bytes written to the destination by the current or last transfer.
+     */
+    [[nodiscard]] int64_t transferred() const noexcept;
+
+   private:
+    /*
+     * Called when the source is readable, moves what it holds into the pipe.
+     */
+    void on_readable();
+
+    /*
+     * Called when the destination is writable, or after reading, moves the pipe out to it.
+     */
+    void on_writable();
+
+    /*
+     * Register the event types the state calls for, reads while the pipe has room, writes while it holds data.
+     * Returns true on success, false on failure (check errno for details).
+     */
+    bool update_interest() noexcept;
+
+    /*
+     * Stop the transfer and invoke the callback with the result.
+     */
+    void finish(int64_t result);
+
+    /*
+     * Drop the registrations and whatever is left in the pipe.
+     */
+    bool stop() noexcept;
+};
+
+/*
+ * Sends a range of a file to a socket with sendfile(), without copying it through user space.
+ * Writing is armed until the range is sent, so a slow socket simply waits for the loop.
+ * Takes the WRITE event type of the socket with add_fd(), it must be non-blocking.
+ * Not thread-safe, used from the loop thread or before the loop starts.
+ * Only available on Linux, start() fails with `ENOTSUP` elsewhere.
+ */
+class FileTransfer {
+   public:
+    /*
+     * Maximum number of bytes sent per readiness event, so one large file can't starve the loop.
+     */
+    static constexpr size_t MAX_PER_EVENT = 1 << 20;
+
+   private:
+    EventLoop& loop_;
+    int file_{-1};
+    int to_{-1};
+    off_t offset_{0};
+    TransferCallback callback_;
+
+    /*
+     * Bytes left to send, sent until end of file if unbounded.
+     */
+    size_t remaining_{0};
+    bool is_bounded_{false};
+    int64_t transferred_{0};
+
+   public:
+    explicit FileTransfer(EventLoop& loop) noexcept;
+
+    /*
+     * Cancel the transfer if it's running.
+     */
+    ~FileTransfer() noexcept;
+
+    FileTransfer(const FileTransfer&) = delete;
+    FileTransfer& operator=(const FileTransfer&) = delete;
+    FileTransfer(FileTransfer&&) = delete;
+    FileTransfer& operator=(FileTransfer&&) = delete;
+
+    /*
+     * Start sending `count` bytes of the file from `offset` to the socket, up to end of file if `count` is 0.
+     * The file's own offset is left untouched.
+     * Invokes the callback the same way SpliceTransfer does, a file ending early isn't an error.
+     * Returns true on success, false on failure (check errno for details).
+     * Fails with `EBUSY` if a transfer is running.
+     */
+    bool start(int file, off_t offset, size_t count, int to, const TransferCallback& callback) noexcept;
+
+    /*
+     * Stop the transfer without invoking its callback.
+     * Returns true on success, false on failure (check errno for details).
+     * If no transfer is running, it's a no-op and returns true.
+     */
+    bool cancel() noexcept;
+
+    /*
+     * Check if a transfer is running.
+     */
+    [[nodiscard]] bool is_running() const noexcept;
+
+    /*
+     * Get the number of bytes sent by the current or last transfer.
+     */
+    [[nodiscard]] int64_t transferred() const noexcept;
+
+   private:
+    /*
+     * Called when the socket is writable, sends the next part of the range.
+     */
+    void on_writable();
+
+    /*
+     * Stop the transfer and invoke the callback with the result.
+     */
+    void finish(int64_t result);
+};
+
+/*
+ * Sends buffers over a TCP socket with `MSG_ZEROCOPY`, so the kernel transmits straight from them.
+ * A buffer must stay untouched until its callback reports that the kernel is done with it,
+ * which it tells on the socket's error queue once the data was acknowledged.
+ * Buffers below `MIN_ZERO_COPY_SIZE` are copied, pinning their pages would cost more.
+ * Falls back to copying everything where the socket doesn't support zero-copy.
+ * Takes the WRITE event type of the socket with add_fd() while sending, it must be non-blocking.
+ * Completions of the error queue also wake the socket's READ callback, if any, until they're
+ * collected, so a reader of the socket should call collect_completions() on errors.
+ * Not thread-safe, used from the loop thread or before the loop starts.
+ */
+class ZeroCopySender {
+   public:
+    /*
+     * Size from which buffers are sent without copying them.
+     */
+    static constexpr size_t MIN_ZERO_COPY_SIZE = 16384;
+
+    /*
+     * Delay between collections of completions once everything is sent.
+     */
+    static constexpr std::chrono::milliseconds COMPLETION_POLL{1};
+
+   private:
+    /*
+     * A buffer being sent, and the range of zero-copy send calls it took.
+     */
+    struct Send {
+        std::span<const std::byte> data;
+        TransferCallback callback;
+        size_t sent{0};
+        bool is_zero_copy{false};
+        uint32_t first_call{0};
+        uint32_t calls{0};
+        uint32_t completions{0};
+    };
+
+    EventLoop& loop_;
+    int fd_;
+    bool is_zero_copy_{false};
+
+    /*
+     * Buffers in sending order, the first ones may be sent and only waiting for completions.
+     */
+    std::deque<Send> sends_;
+
+    /*
+     * Index of the first buffer with data left to send.
+     */
+    size_t next_send_{0};
+
+    /*
+     * Counter of zero-copy send calls, the kernel reports completions as ranges of it.
+     */
+    uint32_t next_call_{0};
+
+    bool is_writing_{false};
+    TimerId poll_timer_{0};
+
+    /*
+     * Set by the destructor, so a callback destroying the sender stops the collection.
+     */
+    bool* is_destroyed_{nullptr};
+
+   public:
+    /*
+     * Enable zero-copy on the socket if it supports it.
+     */
+    ZeroCopySender(EventLoop& loop, int fd) noexcept;
+
+    /*
+     * Drop the registrations, callbacks of pending buffers are not invoked.
+     * Data the kernel still references stays pinned until it's transmitted.
+     */
+    ~ZeroCopySender() noexcept;
+
+    ZeroCopySender(const ZeroCopySender&) = delete;
+    ZeroCopySender& operator=(const ZeroCopySender&) = delete;
+    ZeroCopySender(ZeroCopySender&&) = delete;
+    ZeroCopySender& operator=(ZeroCopySender&&) = delete;
+
+    /*
+     * Queue a buffer, sent once the ones before it are and the socket is writable.
+     * The callback is invoked on the loop thread with the size of the buffer once the kernel is done with it,
+     * or with a negated errno value if sending failed. Callbacks are invoked in queueing order.
+     * Returns true on success, false on failure (check errno for details).
+     */
+    bool send(std::span<const std::byte> data, const TransferCallback& callback) noexcept;
+
+    /*
+     * Collect the completions waiting on the socket's error queue, invoking the callbacks of finished buffers.
+     * Called by the sender itself while it's busy, readers of the socket call it when woken up by them.
+     */
+    void collect_completions();
+
+    /*
+     * Check if the socket sends without copying.
+     */
+    [[nodiscard]] bool is_zero_copy() const noexcept;
+
+    /*
+     * Get the number of buffers queued whose callbacks weren't invoked yet.
+     */
+    [[nodiscard]] size_t pending() const noexcept;
+
+   private:
+    /*
+     * Called when the socket is writable or has an error, sends what's left.
+     */
+    void on_writable();
+
+    /*
+     * Send the queued buffers until the socket is full.
+     * Returns false if a send failed, the buffers are failed then.
+     */
+    bool send_queued();
+
+    /*
+     * Count the completions waiting on the error queue against the buffers they belong to.
+     */
+    void read_error_queue() noexcept;
+
+    /*
+     * Invoke the callbacks of the buffers at the front that are done with.
+     * Returns false if a callback destroyed the sender.
+     */
+    bool complete_finished();
+
+    /*
+     * Fail every queued buffer with the negated errno value.
+     */
+    void fail_all(int64_t result);
+
+    /*
+     * Arm writes while data is left and the completion timer while completions are, drop them otherwise.
+     * Returns true on success, false on failure (check errno for details).
+     */
+    bool update_interest() noexcept;
+};
+
+}  // namespace loopp
@@ -0,0 +1,13 @@
+#include "loopp/detail/event_loop_poll.hpp"
+
+#include <memory>
+
+#include "loopp/event_loop.hpp"
+
+namespace loopp {
+
+std::unique_ptr<EventLoop> EventLoop::create() {
+    return std::make_unique<EventLoopPoll>();
+}
+
+}  // namespace loopp
@@ -0,0 +1,221 @@
+#include "loopp/executor.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "loopp/event_loop.hpp"
+#include "work_deque.hpp"
+
+namespace loopp {
+
+/*
+ * A submitted task, linked into an inbox until a worker moves it to its deque.
+ */
+struct Executor::Job {
+    Task task;
+    Job* next{nullptr};
+};
+
+struct Executor::Worker {
+    detail::WorkDeque<Job> deque;
+
+    /*
+     * Tasks submitted from outside the pool, newest first.
+     * Any worker may take all of them at once, so a sleeping worker doesn't hold them up.
+     */
+    alignas(64) std::atomic<Job*> inbox{nullptr};
+
+    /*
+     * Counters written by the worker only, read by stats().
+     */
+    alignas(64) std::atomic<uint64_t> completed{0};
+    std::atomic<uint64_t> steals{0};
+
+    /*
+     * Tasks in the inbox, for queue depths.
+     */
+    std::atomic<size_t> inbox_size{0};
+};
+
+namespace {
+
+/*
+ * Executor and worker index of the calling thread, if it's a worker.
+ */
+thread_local const Executor* current_executor = nullptr;
+thread_local size_t current_worker = 0;
+
+}  // namespace
+
+Executor::Executor(size_t count) {
+    if (count == 0) count = std::max(std::thread::hardware_concurrency(), 1U);
+
+    workers_.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+
+    threads_.reserve(count);
+    try {
+        for (size_t i = 0; i < count; ++i) {
+            threads_.emplace_back([this, i] { run(i); });
+        }
+    } catch (...) {
+        is_stopping_.store(true);
+        epoch_.fetch_add(1);
+        epoch_.notify_all();
+        for (std::thread& thread : threads_) thread.join();
+        throw;
+    }
+}
+
+Executor::~Executor() noexcept {
+    is_stopping_.store(true);
+    epoch_.fetch_add(1);
+    epoch_.notify_all();
+    for (std::thread& thread : threads_) thread.join();
+}
+
+size_t Executor::size() const noexcept {
+    return workers_.size();
+}
+
+bool Executor::submit(Task task) noexcept {
+    auto* job = new (std::nothrow) Job{std::move(task)};
+    if (job == nullptr) {
+        errno = ENOMEM;
+        return false;
+    }
+    submitted_.fetch_add(1, std::memory_order_relaxed);
+
+    // Workers keep their own tasks, the others can still steal them
+    if (current_executor == this) {
+        try {
+            workers_[current_worker]->deque.push(job);
+        } catch (const std::bad_alloc&) {
+            delete job;
+            submitted_.fetch_sub(1, std::memory_order_relaxed);
+            errno = ENOMEM;
+            return false;
+        }
+    } else {
+        Worker& worker = *workers_[next_worker_.fetch_add(1, std::memory_order_relaxed) % workers_.size()];
+        worker.inbox_size.fetch_add(1, std::memory_order_relaxed);
+        job->next = worker.inbox.load(std::memory_order_relaxed);
+        while (!worker.inbox.compare_exchange_weak(job->next, job, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        }
+    }
+
+    wake_one();
+    return true;
+}
+
+bool Executor::offload(EventLoop& loop, Task work, Task resume) noexcept {
+    return submit([&loop, work = std::move(work), resume = std::move(resume)]() mutable {
+        work();
+        loop.post(std::move(resume));
+    });
+}
+
+ExecutorStats Executor::stats() const {
+    ExecutorStats stats;
+    stats.submitted = submitted_.load(std::memory_order_relaxed);
+    stats.queue_depths.reserve(workers_.size());
+    for (const auto& worker : workers_) {
+        stats.completed += worker->completed.load(std::memory_order_relaxed);
+        stats.steals += worker->steals.load(std::memory_order_relaxed);
+        stats.queue_depths.push_back(worker->deque.size() + worker->inbox_size.load(std::memory_order_relaxed));
+    }
+    return stats;
+}
+
+void Executor::run(size_t index) {
+    current_executor = this;
+    current_worker = index;
+    Worker& worker = *workers_[index];
+
+    while (true) {
+        if (Job* job = find_job(worker)) {
+            std::unique_ptr<Job> owned(job);
+            owned->task();
+            worker.completed.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        // Announce sleeping before checking once more, so a submission either sees it or is found here
+        sleepers_.fetch_add(1);
+        uint32_t epoch = epoch_.load();
+        if (Job* job = find_job(worker)) {
+            sleepers_.fetch_sub(1);
+            std::unique_ptr<Job> owned(job);
+            owned->task();
+            worker.completed.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        if (is_stopping_.load()) {
+            sleepers_.fetch_sub(1);
+            return;
+        }
+        epoch_.wait(epoch);
+        sleepers_.fetch_sub(1);
+    }
+}
+
+Executor::Job* Executor::find_job(Worker& worker) {
+    if (Job* job = worker.deque.pop()) return job;
+
+    // Take new submissions, starting with the worker's own inbox
+    size_t count = workers_.size();
+    size_t self = current_worker;
+    for (size_t offset = 0; offset < count; ++offset) {
+        Worker& source = *workers_[(self + offset) % count];
+        if (source.inbox.load() == nullptr) continue;
+
+        Job* jobs = source.inbox.exchange(nullptr, std::memory_order_seq_cst);
+        Job* reversed = nullptr;
+        size_t taken = 0;
+        while (jobs != nullptr) {
+            reversed = std::exchange(jobs, std::exchange(jobs->next, reversed));
+            ++taken;
+        }
+        source.inbox_size.fetch_sub(taken, std::memory_order_relaxed);
+
+        // Run the oldest one right away, queue the rest where idle workers can steal them
+        Job* first = reversed;
+        for (Job* job = first->next; job != nullptr;) {
+            Job* next = job->next;
+            worker.deque.push(job);
+            job = next;
+        }
+        if (first->next != nullptr) wake_one();
+        return first;
+    }
+
+    // Steal from the others, starting after this worker so thieves spread out
+    for (size_t offset = 1; offset < count; ++offset) {
+        if (Job* job = workers_[(self + offset) % count]->deque.steal()) {
+            worker.steals.fetch_add(1, std::memory_order_relaxed);
+            return job;
+        }
+    }
+    return nullptr;
+}
+
+void Executor::wake_one() noexcept {
+    // Orders the task's push before the check, pairing with the fence of a sleeper's last steal
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleepers_.load() == 0) return;
+    epoch_.fetch_add(1);
+    epoch_.notify_one();
+}
+
+}  // namespace loopp
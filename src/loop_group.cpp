@@ -0,0 +1,153 @@
+#include "loopp/loop_group.hpp"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "loopp/event_loop.hpp"
+
+namespace loopp {
+
+namespace {
+
+/*
+ * Get the cores the process is allowed to run on, in ascending order.
+ * Empty if the platform can't pin threads.
+ */
+std::vector<int> available_cpus() {
+    std::vector<int> cpus;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (size_t cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) cpus.push_back(static_cast<int>(cpu));
+        }
+    }
+#endif
+    return cpus;
+}
+
+/*
+ * Pin the calling thread to the core, best effort.
+ */
+void pin_current_thread([[maybe_unused]] int cpu) noexcept {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(static_cast<size_t>(cpu), &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+}
+
+}  // namespace
+
+LoopGroup::LoopGroup(size_t count, bool pin_threads) {
+    std::vector<int> cpus = available_cpus();
+    if (count == 0) {
+        count = !cpus.empty() ? cpus.size() : std::max(std::thread::hardware_concurrency(), 1U);
+    }
+
+    loops_.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        loops_.push_back(EventLoop::create());
+    }
+
+    if (pin_threads && !cpus.empty()) {
+        cpus_.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            cpus_.push_back(cpus[i % cpus.size()]);
+        }
+    }
+}
+
+LoopGroup::~LoopGroup() noexcept {
+    stop();
+    for (std::thread& thread : threads_) {
+        if (thread.joinable()) thread.join();
+    }
+}
+
+size_t LoopGroup::size() const noexcept {
+    return loops_.size();
+}
+
+const std::shared_ptr<EventLoop>& LoopGroup::loop(size_t index) const noexcept {
+    return loops_[index];
+}
+
+const std::shared_ptr<EventLoop>& LoopGroup::next() noexcept {
+    return loops_[next_.fetch_add(1, std::memory_order_relaxed) % loops_.size()];
+}
+
+int LoopGroup::cpu(size_t index) const noexcept {
+    return cpus_.empty() ? -1 : cpus_[index];
+}
+
+void LoopGroup::start() {
+    is_stopping_.store(false);
+    error_ = nullptr;
+
+    threads_.reserve(loops_.size());
+    for (size_t i = 0; i < loops_.size(); ++i) {
+        try {
+            threads_.emplace_back([this, i] {
+                if (!cpus_.empty()) pin_current_thread(cpus_[i]);
+
+                // Runs once the loop is marked running, so a stop() issued before that isn't lost
+                EventLoop& loop = *loops_[i];
+                loop.post([this, &loop] {
+                    if (is_stopping_.load()) loop.stop();
+                });
+
+                try {
+                    loop.start();
+                } catch (...) {
+                    {
+                        std::lock_guard<std::mutex> lock(error_mutex_);
+                        if (!error_) error_ = std::current_exception();
+                    }
+                    stop();
+                }
+            });
+        } catch (...) {
+            stop();
+            join();
+            throw;
+        }
+    }
+}
+
+bool LoopGroup::stop() noexcept {
+    is_stopping_.store(true);
+
+    bool success = true;
+    for (const auto& loop : loops_) {
+        success &= loop->stop();
+    }
+    return success;
+}
+
+void LoopGroup::join() {
+    for (std::thread& thread : threads_) {
+        if (thread.joinable()) thread.join();
+    }
+    threads_.clear();
+
+    std::lock_guard<std::mutex> lock(error_mutex_);
+    if (error_) std::rethrow_exception(std::exchange(error_, nullptr));
+}
+
+}  // namespace loopp
@@ -0,0 +1,206 @@
+#include "loopp/trace.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <new>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace loopp {
+
+namespace {
+
+/*
+ * Header of binary dumps.
+ */
+struct TraceHeader {
+    std::array<char, 8> magic{'L', 'O', 'O', 'P', 'P', 'T', 'R', 'C'};
+    uint32_t version{1};
+    uint32_t record_size{sizeof(TraceRecord)};
+    uint64_t count{0};
+};
+
+constexpr TraceHeader EXPECTED_HEADER{};
+
+/*
+ * Get the name of a record in the Chrome trace, shared by the begin and end of a duration.
+ */
+const char* trace_name(const TraceRecord& record) noexcept {
+    switch (record.kind) {
+        case TraceKind::WAIT_BEGIN:
+        case TraceKind::WAIT_END:
+            return "wait";
+        case TraceKind::CALLBACK_BEGIN:
+        case TraceKind::CALLBACK_END:
+            return record.type == 0 ? "read callback" : "write callback";
+        case TraceKind::HANDLER_BEGIN:
+        case TraceKind::HANDLER_END:
+            return "handler";
+        case TraceKind::WAKEUP:
+            return "wakeup";
+        case TraceKind::REGISTRATION:
+            return "registration";
+    }
+    return "unknown";
+}
+
+bool is_begin(TraceKind kind) noexcept {
+    return kind == TraceKind::WAIT_BEGIN || kind == TraceKind::CALLBACK_BEGIN || kind == TraceKind::HANDLER_BEGIN;
+}
+
+bool is_end(TraceKind kind) noexcept {
+    return kind == TraceKind::WAIT_END || kind == TraceKind::CALLBACK_END || kind == TraceKind::HANDLER_END;
+}
+
+}  // namespace
+
+TraceBuffer::TraceBuffer(size_t capacity)
+    : slots_(std::make_unique<Slot[]>(std::bit_ceil(std::max<size_t>(capacity, 1)))),
+      mask_(std::bit_ceil(std::max<size_t>(capacity, 1)) - 1) {}
+
+std::vector<TraceRecord> TraceBuffer::snapshot() const {
+    uint64_t head = head_.load(std::memory_order_acquire);
+    uint64_t first = head > capacity() ? head - capacity() : 0;
+
+    std::vector<TraceRecord> records;
+    records.reserve(static_cast<size_t>(head - first));
+    for (uint64_t index = first; index < head; ++index) {
+        const Slot& slot = slots_[index & mask_];
+
+        // Skip records still being written, or already overwritten by newer ones
+        uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence != index * 2 + 2) continue;
+        std::array<uint64_t, WORD_COUNT> words{};
+        for (size_t i = 0; i < WORD_COUNT; ++i) {
+            words[i] = slot.words[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != sequence) continue;
+
+        records.push_back(std::bit_cast<TraceRecord>(words));
+    }
+    return records;
+}
+
+size_t TraceBuffer::capacity() const noexcept {
+    return mask_ + 1;
+}
+
+uint64_t TraceBuffer::recorded() const noexcept {
+    return head_.load(std::memory_order_relaxed);
+}
+
+uint64_t TraceBuffer::dropped() const noexcept {
+    return dropped_.load(std::memory_order_relaxed);
+}
+
+bool write_trace(std::FILE* file, std::span<const TraceRecord> records) noexcept {
+    TraceHeader header;
+    header.count = records.size();
+    if (std::fwrite(&header, sizeof(header), 1, file) != 1) return false;
+    if (!records.empty() && std::fwrite(records.data(), sizeof(TraceRecord), records.size(), file) != records.size()) return false;
+    return std::fflush(file) == 0;
+}
+
+bool read_trace(std::FILE* file, std::vector<TraceRecord>& records) {
+    TraceHeader header;
+    if (std::fread(&header, sizeof(header), 1, file) != 1) {
+        if (std::ferror(file) == 0) errno = EINVAL;
+        return false;
+    }
+    if (header.magic != EXPECTED_HEADER.magic || header.version != EXPECTED_HEADER.version ||
+        header.record_size != EXPECTED_HEADER.record_size) {
+        errno = EINVAL;
+        return false;
+    }
+
+    // Read in chunks, so a corrupt count can't allocate more than the file holds
+    records.clear();
+    constexpr size_t CHUNK_SIZE = 4096;
+    while (records.size() < header.count) {
+        size_t chunk = static_cast<size_t>(std::min<uint64_t>(header.count - records.size(), CHUNK_SIZE));
+        size_t offset = records.size();
+        records.resize(offset + chunk);
+        if (std::fread(records.data() + offset, sizeof(TraceRecord), chunk, file) != chunk) {
+            if (std::ferror(file) == 0) errno = EINVAL;
+            records.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool write_chrome_trace(std::FILE* file, std::span<const TraceRecord> records) noexcept {
+    uint64_t base = UINT64_MAX;
+    for (const TraceRecord& record : records) {
+        base = std::min(base, record.timestamp_ns);
+    }
+
+    // Durations open per thread, ends recorded before the buffer's oldest begin are dropped
+    std::unordered_map<uint32_t, size_t> open_durations;
+    try {
+        open_durations.reserve(16);
+    } catch (const std::bad_alloc&) {
+        errno = ENOMEM;
+        return false;
+    }
+
+    std::fputs("{\"traceEvents\":[", file);
+    bool is_first = true;
+    for (const TraceRecord& record : records) {
+        size_t* open = nullptr;
+        if (is_begin(record.kind) || is_end(record.kind)) {
+            try {
+                open = &open_durations[record.thread];
+            } catch (const std::bad_alloc&) {
+                errno = ENOMEM;
+                return false;
+            }
+            if (is_end(record.kind) && *open == 0) continue;
+            *open = is_begin(record.kind) ? *open + 1 : *open - 1;
+        }
+
+        const char* phase = is_begin(record.kind) ? "B" : is_end(record.kind) ? "E" : "i";
+        double timestamp = static_cast<double>(record.timestamp_ns - base) / 1000.0;
+        std::fprintf(file, "%s\n{\"name\":\"%s\",\"cat\":\"loopp\",\"ph\":\"%s\",\"ts\":%.3f,\"pid\":1,\"tid\":%u",
+                     is_first ? "" : ",", trace_name(record), phase, timestamp, record.thread);
+        is_first = false;
+
+        switch (record.kind) {
+            case TraceKind::WAIT_END:
+                std::fprintf(file, ",\"args\":{\"events\":%u}", record.value);
+                break;
+            case TraceKind::CALLBACK_BEGIN:
+                std::fprintf(file, ",\"args\":{\"fd\":%d}", record.fd);
+                break;
+            case TraceKind::HANDLER_BEGIN:
+                std::fprintf(file, ",\"args\":{\"fd\":%d,\"ready\":%u}", record.fd, record.value);
+                break;
+            case TraceKind::WAKEUP:
+                std::fputs(",\"s\":\"t\"", file);
+                break;
+            case TraceKind::REGISTRATION:
+                std::fprintf(file, ",\"s\":\"t\",\"args\":{\"fd\":%d,\"value\":%u}", record.fd, record.value);
+                break;
+            default:
+                break;
+        }
+        std::fputc('}', file);
+    }
+    std::fputs("\n],\"displayTimeUnit\":\"ns\"}\n", file);
+
+    if (std::ferror(file) != 0) {
+        errno = EIO;
+        return false;
+    }
+    return std::fflush(file) == 0;
+}
+
+}  // namespace loopp
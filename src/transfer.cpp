@@ -0,0 +1,505 @@
+#include "loopp/transfer.hpp"
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#include <sys/sendfile.h>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <new>
+#include <span>
+#include <system_error>
+#include <utility>
+
+#include "loopp/event_loop.hpp"
+
+namespace loopp {
+
+namespace {
+
+/*
+ * Check if a failed call only lacks readiness.
+ */
+bool would_block() noexcept {
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+}
+
+/*
+ * Register or drop an event type of a file descriptor, invoking the member function when ready.
+ * Returns true on success, false on failure (check errno for details).
+ */
+template <typename T, void (T::*Handler)()>
+bool set_registration(EventLoop& loop, int fd, EventType type, bool& is_registered, bool is_wanted, T* owner) noexcept {
+    if (is_registered == is_wanted) return true;
+
+    bool success = is_wanted ? loop.add_fd(fd, type, [owner](int, EventType) { (owner->*Handler)(); }) : loop.remove_fd(fd, type);
+    if (success) is_registered = is_wanted;
+    return success;
+}
+
+}  // namespace
+
+SpliceTransfer::SpliceTransfer(EventLoop& loop) : loop_(loop) {
+#ifdef __linux__
+    std::array<int, 2> fds{};
+    if (pipe2(fds.data(), O_NONBLOCK | O_CLOEXEC) == -1) {
+        throw std::system_error(errno, std::system_category(), "Failed to create splice pipe");
+    }
+
+    // Best effort, unprivileged processes are capped by fs.pipe-max-size
+    fcntl(fds[1], F_SETPIPE_SZ, static_cast<int>(PIPE_SIZE));
+    int capacity = fcntl(fds[1], F_GETPIPE_SZ);
+    pipe_capacity_ = capacity > 0 ? static_cast<size_t>(capacity) : 0;
+    pipe_read_ = fds[0];
+    pipe_write_ = fds[1];
+#endif
+}
+
+SpliceTransfer::~SpliceTransfer() noexcept {
+    cancel();
+    if (pipe_read_ != -1) ::close(pipe_read_);
+    if (pipe_write_ != -1) ::close(pipe_write_);
+}
+
+bool SpliceTransfer::start(int from, int to, const TransferCallback& callback) noexcept {
+#ifdef __linux__
+    if (is_running()) {
+        errno = EBUSY;
+        return false;
+    }
+    if (from < 0 || to < 0 || !callback) {
+        errno = EINVAL;
+        return false;
+    }
+
+    try {
+        callback_ = callback;
+    } catch (const std::bad_alloc&) {
+        errno = ENOMEM;
+        return false;
+    }
+    from_ = from;
+    to_ = to;
+    buffered_ = 0;
+    transferred_ = 0;
+    is_source_done_ = false;
+
+    if (!update_interest()) {
+        int error = errno;
+        stop();
+        errno = error;
+        return false;
+    }
+    return true;
+#else
+    static_cast<void>(from);
+    static_cast<void>(to);
+    static_cast<void>(callback);
+    errno = ENOTSUP;
+    return false;
+#endif
+}
+
+bool SpliceTransfer::cancel() noexcept {
+    if (!is_running()) return true;
+    return stop();
+}
+
+bool SpliceTransfer::is_running() const noexcept {
+    return from_ != -1;
+}
+
+int64_t SpliceTransfer::transferred() const noexcept {
+    return transferred_;
+}
+
+void SpliceTransfer::on_readable() {
+#ifdef __linux__
+    ssize_t result = splice(from_, nullptr, pipe_write_, nullptr, pipe_capacity_ - buffered_, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if (result > 0) {
+        buffered_ += static_cast<size_t>(result);
+    } else if (result == 0) {
+        is_source_done_ = true;
+    } else if (!would_block()) {
+        finish(-errno);
+        return;
+    }
+
+    // Move it out right away, the destination is most likely writable
+    on_writable();
+#endif
+}
+
+void SpliceTransfer::on_writable() {
+#ifdef __linux__
+    while (buffered_ > 0) {
+        ssize_t result = splice(pipe_read_, nullptr, to_, nullptr, buffered_, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (result < 0) {
+            if (would_block()) break;
+            finish(-errno);
+            return;
+        }
+        buffered_ -= static_cast<size_t>(result);
+        transferred_ += result;
+    }
+
+    if (is_source_done_ && buffered_ == 0) {
+        finish(transferred_);
+        return;
+    }
+    if (!update_interest()) {
+        finish(-errno);
+    }
+#endif
+}
+
+bool SpliceTransfer::update_interest() noexcept {
+    bool wants_read = !is_source_done_ && buffered_ < pipe_capacity_;
+    bool wants_write = buffered_ > 0;
+    return set_registration<SpliceTransfer, &SpliceTransfer::on_readable>(loop_, from_, EventType::READ, is_reading_, wants_read, this) &&
+           set_registration<SpliceTransfer, &SpliceTransfer::on_writable>(loop_, to_, EventType::WRITE, is_writing_, wants_write, this);
+}
+
+void SpliceTransfer::finish(int64_t result) {
+    TransferCallback callback = std::move(callback_);
+    stop();
+
+    // Last, the callback may destroy the transfer
+    callback(result);
+}
+
+bool SpliceTransfer::stop() noexcept {
+    bool success = true;
+    if (is_reading_) success = loop_.remove_fd(from_, EventType::READ) && success;
+    if (is_writing_) success = loop_.remove_fd(to_, EventType::WRITE) && success;
+    is_reading_ = false;
+    is_writing_ = false;
+    from_ = -1;
+    to_ = -1;
+    callback_ = nullptr;
+
+    // Drop what the destination didn't take, so the pipe starts empty next time
+    std::array<char, 4096> discard;
+    while (buffered_ > 0) {
+        ssize_t result = ::read(pipe_read_, discard.data(), std::min(discard.size(), buffered_));
+        if (result <= 0) break;
+        buffered_ -= static_cast<size_t>(result);
+    }
+    buffered_ = 0;
+    return success;
+}
+
+FileTransfer::FileTransfer(EventLoop& loop) noexcept : loop_(loop) {}
+
+FileTransfer::~FileTransfer() noexcept {
+    cancel();
+}
+
+bool FileTransfer::start(int file, off_t offset, size_t count, int to, const TransferCallback& callback) noexcept {
+#ifdef __linux__
+    if (is_running()) {
+        errno = EBUSY;
+        return false;
+    }
+    if (file < 0 || offset < 0 || to < 0 || !callback) {
+        errno = EINVAL;
+        return false;
+    }
+
+    try {
+        callback_ = callback;
+    } catch (const std::bad_alloc&) {
+        errno = ENOMEM;
+        return false;
+    }
+
+    // Sent once the socket is writable, so the callback is never invoked from here
+    if (!loop_.add_fd(to, EventType::WRITE, [this](int, EventType) { on_writable(); })) {
+        callback_ = nullptr;
+        return false;
+    }
+    file_ = file;
+    to_ = to;
+    offset_ = offset;
+    remaining_ = count;
+    is_bounded_ = count != 0;
+    transferred_ = 0;
+    return true;
+#else
+    static_cast<void>(file);
+    static_cast<void>(offset);
+    static_cast<void>(count);
+    static_cast<void>(to);
+    static_cast<void>(callback);
+    errno = ENOTSUP;
+    return false;
+#endif
+}
+
+bool FileTransfer::cancel() noexcept {
+    if (!is_running()) return true;
+
+    bool success = loop_.remove_fd(to_, EventType::WRITE);
+    file_ = -1;
+    to_ = -1;
+    callback_ = nullptr;
+    return success;
+}
+
+bool FileTransfer::is_running() const noexcept {
+    return to_ != -1;
+}
+
+int64_t FileTransfer::transferred() const noexcept {
+    return transferred_;
+}
+
+void FileTransfer::on_writable() {
+#ifdef __linux__
+    size_t budget = MAX_PER_EVENT;
+    while (budget > 0) {
+        size_t size = is_bounded_ ? std::min(remaining_, budget) : budget;
+        ssize_t result = sendfile(to_, file_, &offset_, size);
+        if (result < 0) {
+            if (would_block()) return;
+            finish(-errno);
+            return;
+        }
+
+        // End of file, or the range is done
+        if (result == 0) break;
+
+        auto sent = static_cast<size_t>(result);
+        transferred_ += result;
+        budget -= sent;
+        if (is_bounded_) {
+            remaining_ -= sent;
+            if (remaining_ == 0) break;
+        }
+    }
+
+    // Out of budget, the rest is sent on the next iteration
+    if (budget == 0 && (!is_bounded_ || remaining_ > 0)) return;
+    finish(transferred_);
+#endif
+}
+
+void FileTransfer::finish(int64_t result) {
+    TransferCallback callback = std::move(callback_);
+    cancel();
+
+    // Last, the callback may destroy the transfer
+    callback(result);
+}
+
+ZeroCopySender::ZeroCopySender(EventLoop& loop, int fd) noexcept : loop_(loop), fd_(fd) {
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+    int value = 1;
+    is_zero_copy_ = setsockopt(fd_, SOL_SOCKET, SO_ZEROCOPY, &value, sizeof(value)) == 0;
+#endif
+}
+
+ZeroCopySender::~ZeroCopySender() noexcept {
+    if (is_destroyed_ != nullptr) *is_destroyed_ = true;
+    if (is_writing_) loop_.remove_fd(fd_, EventType::WRITE);
+    if (poll_timer_ != 0) loop_.cancel_timer(poll_timer_);
+}
+
+bool ZeroCopySender::send(std::span<const std::byte> data, const TransferCallback& callback) noexcept {
+    if (!callback) {
+        errno = EINVAL;
+        return false;
+    }
+
+    try {
+        sends_.push_back({data, callback});
+    } catch (const std::bad_alloc&) {
+        errno = ENOMEM;
+        return false;
+    }
+    sends_.back().is_zero_copy = is_zero_copy_ && data.size() >= MIN_ZERO_COPY_SIZE;
+
+    // Sent once the socket is writable, so callbacks are never invoked from here
+    if (!update_interest()) {
+        int error = errno;
+        sends_.pop_back();
+        errno = error;
+        return false;
+    }
+    return true;
+}
+
+void ZeroCopySender::collect_completions() {
+    read_error_queue();
+    if (!complete_finished()) return;
+    if (!update_interest()) fail_all(-errno);
+}
+
+bool ZeroCopySender::is_zero_copy() const noexcept {
+    return is_zero_copy_;
+}
+
+size_t ZeroCopySender::pending() const noexcept {
+    return sends_.size();
+}
+
+void ZeroCopySender::on_writable() {
+    read_error_queue();
+    if (!send_queued()) return;
+    if (!complete_finished()) return;
+    if (!update_interest()) fail_all(-errno);
+}
+
+bool ZeroCopySender::send_queued() {
+    bool is_copy_forced = false;
+    while (next_send_ < sends_.size()) {
+        Send& send = sends_[next_send_];
+        int flags = MSG_DONTWAIT;
+#ifdef MSG_NOSIGNAL
+        flags |= MSG_NOSIGNAL;
+#endif
+#ifdef MSG_ZEROCOPY
+        bool is_zero_copy = send.is_zero_copy && !is_copy_forced;
+        if (is_zero_copy) flags |= MSG_ZEROCOPY;
+#else
+        bool is_zero_copy = false;
+#endif
+
+        ssize_t result = ::send(fd_, send.data.data() + send.sent, send.data.size() - send.sent, flags);
+        if (result < 0) {
+            if (would_block()) return true;
+
+            // Out of memory for pinned pages, copy this part instead
+            if (errno == ENOBUFS && is_zero_copy) {
+                is_copy_forced = true;
+                continue;
+            }
+            fail_all(-errno);
+            return false;
+        }
+        is_copy_forced = false;
+
+        // Every zero-copy call gets the next number of the counter
+        if (is_zero_copy) {
+            if (send.calls == 0) send.first_call = next_call_;
+            ++send.calls;
+            ++next_call_;
+        }
+
+        send.sent += static_cast<size_t>(result);
+        if (send.sent < send.data.size()) return true;
+        ++next_send_;
+    }
+    return true;
+}
+
+void ZeroCopySender::read_error_queue() noexcept {
+#if defined(__linux__) && defined(MSG_ZEROCOPY)
+    if (!is_zero_copy_) return;
+
+    while (true) {
+        alignas(cmsghdr) std::array<char, 128> control;
+        msghdr message{};
+        message.msg_control = control.data();
+        message.msg_controllen = control.size();
+        if (recvmsg(fd_, &message, MSG_ERRQUEUE | MSG_DONTWAIT) == -1) return;
+
+        for (cmsghdr* header = CMSG_FIRSTHDR(&message); header != nullptr; header = CMSG_NXTHDR(&message, header)) {
+            bool is_ip_error = (header->cmsg_level == SOL_IP && header->cmsg_type == IP_RECVERR) ||
+                               (header->cmsg_level == SOL_IPV6 && header->cmsg_type == IPV6_RECVERR);
+            if (!is_ip_error) continue;
+
+            const auto* error = reinterpret_cast<const sock_extended_err*>(CMSG_DATA(header));
+            if (error->ee_errno != 0 || error->ee_origin != SO_EE_ORIGIN_ZEROCOPY) continue;
+
+            // Calls from `ee_info` to `ee_data` completed, measured back from the counter to handle wrapping
+            uint64_t range_begin = static_cast<uint32_t>(next_call_ - error->ee_data);
+            uint64_t range_end = static_cast<uint32_t>(next_call_ - error->ee_info);
+            for (Send& send : sends_) {
+                if (send.calls == 0) continue;
+
+                uint64_t send_end = static_cast<uint32_t>(next_call_ - send.first_call);
+                uint64_t send_begin = send_end - send.calls + 1;
+                uint64_t begin = std::max(range_begin, send_begin);
+                uint64_t end = std::min(range_end, send_end);
+                if (begin <= end) send.completions += static_cast<uint32_t>(end - begin + 1);
+            }
+        }
+    }
+#endif
+}
+
+bool ZeroCopySender::complete_finished() {
+    while (!sends_.empty() && next_send_ > 0) {
+        Send& front = sends_.front();
+        if (front.completions < front.calls) break;
+
+        auto size = static_cast<int64_t>(front.data.size());
+        TransferCallback callback = std::move(front.callback);
+        sends_.pop_front();
+        --next_send_;
+
+        // Nested collections from the callback report to this one as well
+        bool is_destroyed = false;
+        bool* outer = std::exchange(is_destroyed_, &is_destroyed);
+        callback(size);
+        if (is_destroyed) {
+            if (outer != nullptr) *outer = true;
+            return false;
+        }
+        is_destroyed_ = outer;
+    }
+    return true;
+}
+
+void ZeroCopySender::fail_all(int64_t result) {
+    std::deque<Send> failed = std::move(sends_);
+    sends_.clear();
+    next_send_ = 0;
+    update_interest();
+
+    bool is_destroyed = false;
+    bool* outer = std::exchange(is_destroyed_, &is_destroyed);
+    for (Send& send : failed) {
+        send.callback(result);
+        if (is_destroyed) {
+            if (outer != nullptr) *outer = true;
+            return;
+        }
+    }
+    is_destroyed_ = outer;
+}
+
+bool ZeroCopySender::update_interest() noexcept {
+    bool wants_write = next_send_ < sends_.size();
+    if (!set_registration<ZeroCopySender, &ZeroCopySender::on_writable>(loop_, fd_, EventType::WRITE, is_writing_, wants_write, this)) {
+        return false;
+    }
+
+    // Everything is sent, poll for the completions left
+    bool wants_poll = !wants_write && !sends_.empty();
+    if (wants_poll && poll_timer_ == 0) {
+        poll_timer_ = loop_.add_timer(COMPLETION_POLL, [this] {
+            poll_timer_ = 0;
+            collect_completions();
+        });
+        if (poll_timer_ == 0) return false;
+    } else if (!wants_poll && poll_timer_ != 0) {
+        loop_.cancel_timer(poll_timer_);
+        poll_timer_ = 0;
+    }
+    return true;
+}
+
+}  // namespace loopp
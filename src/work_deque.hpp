@@ -0,0 +1,165 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace loopp::detail {
+
+/*
+ * Chase-Lev work-stealing deque of pointers.
+ * The owner pushes and pops at the bottom, thieves steal from the top, all lock-free.
+ * The buffer doubles when full, replaced buffers are kept until destruction
+ * since a thief may still be reading from them.
+ */
+template <typename T>
+class WorkDeque {
+   private:
+    /*
+     * Circular buffer with a power of two capacity.
+     */
+    struct Buffer {
+        int64_t mask;
+        std::unique_ptr<std::atomic<T*>[]> slots;
+
+        explicit Buffer(int64_t capacity)
+            : mask(capacity - 1), slots(std::make_unique<std::atomic<T*>[]>(static_cast<size_t>(capacity))) {}
+
+        [[nodiscard]] int64_t capacity() const noexcept {
+            return mask + 1;
+        }
+
+        [[nodiscard]] T* get(int64_t index) const noexcept {
+            return slots[static_cast<size_t>(index & mask)].load(std::memory_order_relaxed);
+        }
+
+        void put(int64_t index, T* item) noexcept {
+            slots[static_cast<size_t>(index & mask)].store(item, std::memory_order_relaxed);
+        }
+    };
+
+    /*
+     * Next index thieves steal from, only ever incremented.
+     */
+    alignas(64) std::atomic<int64_t> top_{0};
+
+    /*
+     * Next index the owner pushes to.
+     */
+    alignas(64) std::atomic<int64_t> bottom_{0};
+
+    std::atomic<Buffer*> buffer_;
+
+    /*
+     * Every buffer ever used, only accessed by the owner.
+     */
+    std::vector<std::unique_ptr<Buffer>> buffers_;
+
+   public:
+    /*
+     * Create an empty deque, the capacity must be a power of two.
+     * Throws `std::bad_alloc` on allocation failure.
+     */
+    explicit WorkDeque(int64_t capacity = 256) {
+        buffers_.push_back(std::make_unique<Buffer>(capacity));
+        buffer_.store(buffers_.back().get(), std::memory_order_relaxed);
+    }
+
+    WorkDeque(const WorkDeque&) = delete;
+    WorkDeque& operator=(const WorkDeque&) = delete;
+    WorkDeque(WorkDeque&&) = delete;
+    WorkDeque& operator=(WorkDeque&&) = delete;
+
+    /*
+     * Push an item at the bottom, growing the buffer if it's full.
+     * Only called by the owner.
+     * Throws `std::bad_alloc` if the buffer can't grow, the deque is unchanged then.
+     */
+    void push(T* item) {
+        int64_t bottom = bottom_.load(std::memory_order_relaxed);
+        int64_t top = top_.load(std::memory_order_acquire);
+        Buffer* buffer = buffer_.load(std::memory_order_relaxed);
+
+        if (bottom - top >= buffer->capacity()) {
+            buffer = grow(buffer, top, bottom);
+        }
+
+        buffer->put(bottom, item);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom_.store(bottom + 1, std::memory_order_relaxed);
+    }
+
+    /*
+     * Pop the most recently pushed item, racing thieves for the last one.
+     * Only called by the owner.
+     * Returns nullptr if the deque is empty.
+     */
+    T* pop() noexcept {
+        int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+        Buffer* buffer = buffer_.load(std::memory_order_relaxed);
+        bottom_.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t top = top_.load(std::memory_order_relaxed);
+
+        if (top > bottom) {
+            bottom_.store(bottom + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        T* item = buffer->get(bottom);
+        if (top == bottom) {
+            // Last item, whoever moves the top first gets it
+            if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                item = nullptr;
+            }
+            bottom_.store(bottom + 1, std::memory_order_relaxed);
+        }
+        return item;
+    }
+
+    /*
+     * Steal the least recently pushed item, callable from any thread.
+     * Returns nullptr if the deque is empty or another thread won the race for the item.
+     */
+    T* steal() noexcept {
+        int64_t top = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t bottom = bottom_.load(std::memory_order_acquire);
+        if (top >= bottom) return nullptr;
+
+        T* item = buffer_.load(std::memory_order_acquire)->get(top);
+        if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return item;
+    }
+
+    /*
+     * Get the number of items, approximate while other threads use the deque.
+     */
+    [[nodiscard]] size_t size() const noexcept {
+        int64_t bottom = bottom_.load(std::memory_order_relaxed);
+        int64_t top = top_.load(std::memory_order_relaxed);
+        return bottom > top ? static_cast<size_t>(bottom - top) : 0;
+    }
+
+   private:
+    /*
+     * Replace the buffer with one twice as large holding the same items.
+     */
+    Buffer* grow(Buffer* buffer, int64_t top, int64_t bottom) {
+        auto grown = std::make_unique<Buffer>(buffer->capacity() * 2);
+        for (int64_t index = top; index < bottom; ++index) {
+            grown->put(index, buffer->get(index));
+        }
+
+        buffers_.push_back(std::move(grown));
+        Buffer* replacement = buffers_.back().get();
+        buffer_.store(replacement, std::memory_order_release);
+        return replacement;
+    }
+};
+
+}  // namespace loopp::detail
@@ -0,0 +1,198 @@
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <array>
+#include <chrono>
+#include <atomic>
+#include <catch2/catch_test_macros.hpp>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include "loopp/event_loop.hpp"
+
+namespace {
+
+/*
+ * Create a non-blocking pipe, as required for emulated operations.
+ */
+std::array<int, 2> make_pipe() {
+    std::array<int, 2> pipe_fds{};
+    REQUIRE(pipe(pipe_fds.data()) == 0);
+    for (int fd : pipe_fds) {
+        REQUIRE(fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) == 0);
+    }
+    return pipe_fds;
+}
+
+}  // namespace
+
+TEST_CASE("Asynchronous read completes with the data", "[async]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    auto pipe_fds = make_pipe();
+
+    // Queue the read before there is anything to read
+    std::array<std::byte, 16> buffer{};
+    int read_result = 0;
+    REQUIRE(loop->async_read(pipe_fds[0], buffer, [&](int result) {
+        read_result = result;
+        loop->stop();
+    }));
+
+    std::thread loop_thread([&]() { loop->start(); });
+    [[maybe_unused]] auto _ = write(pipe_fds[1], "test", 4);
+
+    // Wait for the loop to stop
+    loop_thread.join();
+
+    REQUIRE(read_result == 4);
+    REQUIRE(std::memcmp(buffer.data(), "test", 4) == 0);
+
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+}
+
+TEST_CASE("Asynchronous writes complete in order", "[async]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    auto pipe_fds = make_pipe();
+
+    // Chain the vectored write from the completion of the plain one
+    std::string first = "hello ";
+    std::string second = "async ";
+    std::string third = "world";
+    std::array<iovec, 2> buffers{{{second.data(), second.size()}, {third.data(), third.size()}}};
+    int write_result = 0;
+    int writev_result = 0;
+    REQUIRE(loop->async_write(pipe_fds[1], std::as_bytes(std::span(first)), [&](int result) {
+        write_result = result;
+        REQUIRE(loop->async_writev(pipe_fds[1], buffers, [&](int vector_result) {
+            writev_result = vector_result;
+            loop->stop();
+        }));
+    }));
+
+    // Wait for the loop to stop
+    std::thread loop_thread([&]() { loop->start(); });
+    loop_thread.join();
+
+    REQUIRE(write_result == 6);
+    REQUIRE(writev_result == 11);
+
+    std::array<char, 32> received{};
+    REQUIRE(read(pipe_fds[0], received.data(), received.size()) == 17);
+    REQUIRE(std::string(received.data(), 17) == "hello async world");
+
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+}
+
+TEST_CASE("Asynchronous accept completes with the connection", "[async]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    // Listen on an ephemeral loopback port
+    int listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    REQUIRE(listen_fd != -1);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    REQUIRE(bind(listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0);
+    REQUIRE(listen(listen_fd, 1) == 0);
+    socklen_t address_size = sizeof(address);
+    REQUIRE(getsockname(listen_fd, reinterpret_cast<sockaddr*>(&address), &address_size) == 0);
+
+    int accepted_fd = -1;
+    REQUIRE(loop->async_accept(listen_fd, [&](int result) {
+        accepted_fd = result;
+        loop->stop();
+    }));
+
+    std::thread loop_thread([&]() { loop->start(); });
+    int client_fd = socket(AF_INET, SOCK_STREAM, 0);
+    REQUIRE(client_fd != -1);
+    REQUIRE(connect(client_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0);
+
+    // Wait for the loop to stop
+    loop_thread.join();
+
+    REQUIRE(accepted_fd >= 0);
+    REQUIRE((fcntl(accepted_fd, F_GETFL) & O_NONBLOCK) != 0);
+
+    close(accepted_fd);
+    close(client_fd);
+    close(listen_fd);
+}
+
+TEST_CASE("Cancelled asynchronous operations complete with ECANCELED", "[async]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    auto pipe_fds = make_pipe();
+
+    // Nothing is ever written, so the read only completes by being cancelled
+    std::array<std::byte, 16> buffer{};
+    std::atomic<int> read_result{0};
+    REQUIRE(loop->async_read(pipe_fds[0], buffer, [&](int result) {
+        read_result = result;
+        loop->stop();
+    }));
+
+    std::thread loop_thread([&]() { loop->start(); });
+    while (!loop->is_running()) {
+        std::this_thread::yield();
+    }
+    REQUIRE(loop->cancel_async(pipe_fds[0]));
+
+    // Wait for the loop to stop
+    loop_thread.join();
+
+    REQUIRE(read_result == -ECANCELED);
+
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+}
+
+TEST_CASE("Pooled receives deliver data until end of file", "[async]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    std::array<int, 2> socket_fds{};
+    REQUIRE(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, socket_fds.data()) == 0);
+
+    // Data is only borrowed by the callback, so it's copied out
+    std::string received;
+    int last_result = 1;
+    REQUIRE(loop->async_recv(socket_fds[0], [&](int result, std::span<const std::byte> data) {
+        if (result > 0) {
+            REQUIRE(data.size() == static_cast<size_t>(result));
+            received.append(reinterpret_cast<const char*>(data.data()), data.size());
+            return;
+        }
+        last_result = result;
+        loop->stop();
+    }));
+
+    std::thread loop_thread([&]() { loop->start(); });
+    for (const char* chunk : {"hello ", "pooled ", "world"}) {
+        REQUIRE(write(socket_fds[1], chunk, std::strlen(chunk)) == static_cast<ssize_t>(std::strlen(chunk)));
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    close(socket_fds[1]);
+
+    // Wait for the loop to stop
+    loop_thread.join();
+
+    REQUIRE(received == "hello pooled world");
+    REQUIRE(last_result == 0);
+
+    close(socket_fds[0]);
+}
@@ -0,0 +1,81 @@
+#include <array>
+#include <catch2/catch_test_macros.hpp>
+#include <memory>
+#include <utility>
+
+#include "loopp/callback.hpp"
+
+namespace {
+
+/*
+ * Counts live instances to check the callback destroys what it stores.
+ */
+struct Counted {
+    static inline int live = 0;
+
+    Counted() noexcept {
+        ++live;
+    }
+
+    Counted(const Counted& /*other*/) noexcept {
+        ++live;
+    }
+
+    Counted(Counted&& /*other*/) noexcept {
+        ++live;
+    }
+
+    Counted& operator=(const Counted&) = delete;
+    Counted& operator=(Counted&&) = delete;
+
+    ~Counted() noexcept {
+        --live;
+    }
+};
+
+}  // namespace
+
+TEST_CASE("Small captures are stored inline", "[callback]") {
+    using Callback = loopp::Callback<int(int)>;
+
+    auto small = [value = std::array<char, Callback::INLINE_SIZE>{}](int x) { return x + value[0]; };
+    auto large = [value = std::array<char, Callback::INLINE_SIZE + 1>{}](int x) { return x + value[0]; };
+    STATIC_REQUIRE(Callback::fits_inline<decltype(small)>);
+    STATIC_REQUIRE_FALSE(Callback::fits_inline<decltype(large)>);
+
+    Callback inline_callback(small);
+    Callback heap_callback(large);
+    REQUIRE(inline_callback(1) == 1);
+    REQUIRE(heap_callback(2) == 2);
+}
+
+TEST_CASE("Callbacks take move-only captures and move them along", "[callback]") {
+    loopp::Callback<int()> callback([value = std::make_unique<int>(42)] { return *value; });
+    REQUIRE(callback);
+
+    loopp::Callback<int()> moved(std::move(callback));
+    REQUIRE_FALSE(callback);
+    REQUIRE(moved() == 42);
+
+    callback = std::move(moved);
+    REQUIRE(callback() == 42);
+}
+
+TEST_CASE("Callbacks destroy their functor exactly once", "[callback]") {
+    {
+        loopp::Callback<void()> small([counted = Counted()] { static_cast<void>(counted); });
+        loopp::Callback<void()> large([counted = Counted(), padding = std::array<char, 64>{}] {
+            static_cast<void>(counted);
+            static_cast<void>(padding);
+        });
+        REQUIRE(Counted::live == 2);
+
+        loopp::Callback<void()> moved(std::move(small));
+        moved = std::move(large);
+        REQUIRE(Counted::live == 1);
+
+        moved = nullptr;
+        REQUIRE(Counted::live == 0);
+    }
+    REQUIRE(Counted::live == 0);
+}
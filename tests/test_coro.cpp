@@ -0,0 +1,231 @@
+#include <unistd.h>
+
+#include <array>
+#include <catch2/catch_test_macros.hpp>
+#include <cerrno>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+#include "loopp/coro.hpp"
+#include "loopp/event_loop.hpp"
+
+namespace {
+
+loopp::CoTask<int> read_byte(loopp::EventLoop& loop, int fd) {
+    if (!co_await loop.readable(fd)) co_return -1;
+
+    char byte = 0;
+    if (read(fd, &byte, 1) != 1) co_return -1;
+    co_return byte;
+}
+
+loopp::CoTask<int> add_one(int value) {
+    co_return value + 1;
+}
+
+loopp::CoTask<int> fail() {
+    throw std::runtime_error("failed");
+    co_return 0;
+}
+
+}  // namespace
+
+TEST_CASE("Coroutines resume once the file descriptor is readable", "[coro]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    std::array<int, 2> fds{};
+    REQUIRE(pipe(fds.data()) == 0);
+
+    std::thread::id loop_thread_id;
+    std::thread::id resume_thread_id;
+    int result = 0;
+    auto run = [&]() -> loopp::CoTask<> {
+        result = co_await read_byte(*loop, fds[0]);
+        resume_thread_id = std::this_thread::get_id();
+        loop->stop();
+    };
+    REQUIRE(loop->post([&]() { loopp::spawn(run()); }));
+
+    std::thread loop_thread([&]() {
+        loop_thread_id = std::this_thread::get_id();
+        loop->start();
+    });
+    REQUIRE(write(fds[1], "x", 1) == 1);
+    loop_thread.join();
+
+    REQUIRE(result == 'x');
+    REQUIRE(resume_thread_id == loop_thread_id);
+
+    // The registration is gone once resumed
+    REQUIRE(write(fds[1], "y", 1) == 1);
+    std::thread second_run([&]() {
+        REQUIRE(loop->add_timer(std::chrono::milliseconds(20), [&]() { loop->stop(); }) != 0);
+        loop->start();
+    });
+    second_run.join();
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST_CASE("Coroutines resume once the file descriptor is writable", "[coro]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    std::array<int, 2> fds{};
+    REQUIRE(pipe(fds.data()) == 0);
+
+    bool is_writable = false;
+    auto run = [&]() -> loopp::CoTask<> {
+        is_writable = co_await loop->writable(fds[1]);
+        loop->stop();
+    };
+    REQUIRE(loop->post([&]() { loopp::spawn(run()); }));
+
+    std::thread loop_thread([&]() { loop->start(); });
+    loop_thread.join();
+
+    REQUIRE(is_writable);
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST_CASE("Failed registrations resume right away", "[coro]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    bool is_readable = true;
+    int error = 0;
+    auto run = [&]() -> loopp::CoTask<> {
+        is_readable = co_await loop->readable(-1);
+        error = errno;
+        loop->stop();
+    };
+    REQUIRE(loop->post([&]() { loopp::spawn(run()); }));
+
+    std::thread loop_thread([&]() { loop->start(); });
+    loop_thread.join();
+
+    REQUIRE_FALSE(is_readable);
+    REQUIRE(error != 0);
+}
+
+TEST_CASE("Awaiting a file descriptor with a handler fails with EBUSY", "[coro]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    std::array<int, 2> fds{};
+    REQUIRE(pipe(fds.data()) == 0);
+    bool is_called = false;
+    REQUIRE(loop->add_fd(fds[0], loopp::EventType::READ, [&](int, loopp::EventType) {
+        is_called = true;
+        loop->stop();
+    }));
+
+    // Resumes right away, and leaves the other handler registered when destroyed
+    {
+        auto awaiter = loop->readable(fds[0]);
+        REQUIRE_FALSE(awaiter.await_suspend(std::noop_coroutine()));
+        REQUIRE_FALSE(awaiter.await_resume());
+        REQUIRE(errno == EBUSY);
+    }
+    REQUIRE(write(fds[1], "x", 1) == 1);
+
+    std::thread loop_thread([&]() { loop->start(); });
+    loop_thread.join();
+
+    REQUIRE(is_called);
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST_CASE("Coroutines sleep for at least the delay", "[coro]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    auto delay = std::chrono::milliseconds(30);
+    std::chrono::steady_clock::duration elapsed{};
+    auto run = [&]() -> loopp::CoTask<> {
+        auto begin = std::chrono::steady_clock::now();
+        co_await loop->sleep(delay);
+        co_await loop->sleep(delay);
+        elapsed = std::chrono::steady_clock::now() - begin;
+        loop->stop();
+    };
+    REQUIRE(loop->post([&]() { loopp::spawn(run()); }));
+
+    std::thread loop_thread([&]() { loop->start(); });
+    loop_thread.join();
+
+    REQUIRE(elapsed >= 2 * delay);
+}
+
+TEST_CASE("Awaited tasks return values and exceptions", "[coro]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    int sum = 0;
+    bool is_caught = false;
+    auto run = [&]() -> loopp::CoTask<> {
+        for (int i = 0; i < 1000; ++i) {
+            sum = co_await add_one(sum);
+        }
+        try {
+            co_await fail();
+        } catch (const std::runtime_error&) {
+            is_caught = true;
+        }
+        loop->stop();
+    };
+    REQUIRE(loop->post([&]() { loopp::spawn(run()); }));
+
+    std::thread loop_thread([&]() { loop->start(); });
+    loop_thread.join();
+
+    REQUIRE(sum == 1000);
+    REQUIRE(is_caught);
+}
+
+TEST_CASE("Destroying a suspended awaiter removes its registration", "[coro]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    std::array<int, 2> fds{};
+    REQUIRE(pipe(fds.data()) == 0);
+
+    // Suspend as a coroutine would, then drop the awaiter like a destroyed frame does
+    {
+        auto awaiter = loop->readable(fds[0]);
+        REQUIRE(awaiter.await_suspend(std::noop_coroutine()));
+    }
+
+    // A new registration would be a no-op if the old one was still there
+    bool is_called = false;
+    REQUIRE(loop->add_fd(fds[0], loopp::EventType::READ, [&](int, loopp::EventType) {
+        is_called = true;
+        loop->stop();
+    }));
+    REQUIRE(write(fds[1], "x", 1) == 1);
+
+    std::thread loop_thread([&]() { loop->start(); });
+    loop_thread.join();
+
+    REQUIRE(is_called);
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST_CASE("Freed frames are reused for the same size class", "[coro]") {
+    auto& pool = loopp::detail::FramePool::local();
+
+    void* frame = pool.allocate(100);
+    pool.deallocate(frame, 100);
+    void* reused = pool.allocate(120);
+    REQUIRE(reused == frame);
+    pool.deallocate(reused, 120);
+}
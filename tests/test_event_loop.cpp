@@ -1,11 +1,23 @@
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/select.h>
+#include <sys/socket.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <array>
+#include <cerrno>
 #include <atomic>
 #include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <ctime>
+#include <memory>
 #include <thread>
+#include <type_traits>
+#include <vector>
 
 #include "loopp/event_loop.hpp"
+#include "loopp/native_event_loop.hpp"
 
 TEST_CASE("EventLoop handles READ events", "[event_loop]") {
     auto loop = loopp::EventLoop::create();
@@ -172,3 +184,661 @@ TEST_CASE("EventLoop can be stopped", "[event_loop]") {
     // Wait for the loop to finish
     loop_thread.join();
 }
+
+TEST_CASE("Removing one event type keeps the other registered", "[event_loop]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    // Create a pipe
+    std::array<int, 2> pipe_fds{};
+    REQUIRE(pipe(pipe_fds.data()) == 0);
+
+    // Set up callbacks
+    std::atomic<bool> is_read_invoked{false};
+    std::atomic<bool> is_write_invoked{false};
+    auto read_callback = [&](int /*fd*/, loopp::EventType /*type*/) {
+        is_read_invoked = true;
+    };
+    auto write_callback = [&](int /*fd*/, loopp::EventType type) {
+        is_write_invoked = true;
+        REQUIRE(type == loopp::EventType::WRITE);
+
+        loop->stop();
+    };
+
+    // Register both event types on the write end, then drop READ
+    REQUIRE(loop->add_fd(pipe_fds[1], loopp::EventType::READ, read_callback));
+    REQUIRE(loop->add_fd(pipe_fds[1], loopp::EventType::WRITE, write_callback));
+    REQUIRE(loop->remove_fd(pipe_fds[1], loopp::EventType::READ));
+
+    // Wait for the loop to stop (WRITE should be immediately ready)
+    std::thread loop_thread([&]() { loop->start(); });
+    loop_thread.join();
+
+    REQUIRE(is_write_invoked);
+    REQUIRE_FALSE(is_read_invoked);
+
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+}
+
+TEST_CASE("Handlers removed during dispatch don't fire", "[event_loop]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    // Create two pipes, both readable before the loop starts
+    std::array<int, 2> first_fds{};
+    std::array<int, 2> second_fds{};
+    REQUIRE(pipe(first_fds.data()) == 0);
+    REQUIRE(pipe(second_fds.data()) == 0);
+    [[maybe_unused]] auto _ = write(first_fds[1], "test", 4);
+    [[maybe_unused]] auto __ = write(second_fds[1], "test", 4);
+
+    // Whichever callback runs first removes both handlers, so only one may fire
+    std::atomic<int> invocations{0};
+    auto callback = [&](int /*fd*/, loopp::EventType /*type*/) {
+        ++invocations;
+        REQUIRE(loop->remove_fd(first_fds[0], loopp::EventType::READ));
+        REQUIRE(loop->remove_fd(second_fds[0], loopp::EventType::READ));
+
+        loop->stop();
+    };
+
+    REQUIRE(loop->add_fd(first_fds[0], loopp::EventType::READ, callback));
+    REQUIRE(loop->add_fd(second_fds[0], loopp::EventType::READ, callback));
+
+    // Wait for the loop to stop
+    std::thread loop_thread([&]() { loop->start(); });
+    loop_thread.join();
+
+    REQUIRE(invocations == 1);
+
+    close(first_fds[0]);
+    close(first_fds[1]);
+    close(second_fds[0]);
+    close(second_fds[1]);
+}
+
+TEST_CASE("Threads register and remove handlers while the loop dispatches", "[event_loop]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    constexpr size_t THREAD_COUNT = 4;
+    constexpr size_t PIPES_PER_THREAD = 8;
+    constexpr size_t ROUNDS = 500;
+
+    // Every pipe stays readable, so registered handlers keep getting dispatched
+    std::vector<std::array<int, 2>> pipes(THREAD_COUNT * PIPES_PER_THREAD);
+    for (auto& fds : pipes) {
+        REQUIRE(pipe(fds.data()) == 0);
+        REQUIRE(write(fds[1], "x", 1) == 1);
+    }
+
+    std::thread loop_thread([&]() { loop->start(); });
+    while (!loop->is_running()) {
+        std::this_thread::yield();
+    }
+
+    // Callbacks share the token, it's released once every removed callback is destroyed
+    auto token = std::make_shared<int>(0);
+    std::atomic<bool> is_failed{false};
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < THREAD_COUNT; ++t) {
+        workers.emplace_back([&, t]() {
+            for (size_t round = 0; round < ROUNDS; ++round) {
+                for (size_t i = 0; i < PIPES_PER_THREAD; ++i) {
+                    int fd = pipes[t * PIPES_PER_THREAD + i][0];
+                    if (!loop->add_fd(fd, loopp::EventType::READ, [token](int, loopp::EventType) { ++*token; })) is_failed = true;
+                }
+                for (size_t i = 0; i < PIPES_PER_THREAD; ++i) {
+                    if (!loop->remove_fd(pipes[t * PIPES_PER_THREAD + i][0], loopp::EventType::READ)) is_failed = true;
+                }
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    REQUIRE_FALSE(is_failed);
+
+    // One more round on the loop recycles whatever it was still dispatching
+    int last_fd = pipes[0][0];
+    REQUIRE(loop->add_fd(last_fd, loopp::EventType::READ, [&](int, loopp::EventType) {
+        loop->remove_fd(last_fd, loopp::EventType::READ);
+        loop->stop();
+    }));
+    loop_thread.join();
+
+    REQUIRE(token.use_count() == 1);
+
+    for (const auto& fds : pipes) {
+        close(fds[0]);
+        close(fds[1]);
+    }
+}
+
+TEST_CASE("Oneshot registration fires once until rearmed", "[event_loop]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    // Create a pipe and keep it readable, the callback never drains it
+    std::array<int, 2> pipe_fds{};
+    REQUIRE(pipe(pipe_fds.data()) == 0);
+    [[maybe_unused]] auto _ = write(pipe_fds[1], "test", 4);
+
+    // Level-triggered WRITE on the other end counts loop iterations
+    std::atomic<int> read_invocations{0};
+    std::atomic<int> iterations{0};
+    auto read_callback = [&](int fd, loopp::EventType /*type*/) {
+        ++read_invocations;
+        if (read_invocations < 3) {
+            REQUIRE(loop->rearm_fd(fd));
+        }
+    };
+    auto write_callback = [&](int /*fd*/, loopp::EventType /*type*/) {
+        if (++iterations == 16) {
+            loop->stop();
+        }
+    };
+
+    REQUIRE(loop->add_fd(pipe_fds[0], loopp::EventType::READ, read_callback, loopp::EventMode::ONESHOT));
+    REQUIRE(loop->add_fd(pipe_fds[1], loopp::EventType::WRITE, write_callback));
+
+    // Wait for the loop to stop
+    std::thread loop_thread([&]() { loop->start(); });
+    loop_thread.join();
+
+    // Fired once, then once per rearm
+    REQUIRE(read_invocations == 3);
+
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+}
+
+TEST_CASE("Edge-triggered registration fires once per readiness change", "[event_loop]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    // Create a pipe and keep it readable, the callback never drains it
+    std::array<int, 2> pipe_fds{};
+    REQUIRE(pipe(pipe_fds.data()) == 0);
+    [[maybe_unused]] auto _ = write(pipe_fds[1], "test", 4);
+
+    std::atomic<int> read_invocations{0};
+    std::atomic<int> iterations{0};
+    auto read_callback = [&](int /*fd*/, loopp::EventType /*type*/) {
+        ++read_invocations;
+    };
+    auto write_callback = [&](int /*fd*/, loopp::EventType /*type*/) {
+        if (++iterations == 16) {
+            loop->stop();
+        }
+    };
+
+    // Not every backend can provide edge-triggered mode
+    if (!loop->add_fd(pipe_fds[0], loopp::EventType::READ, read_callback, loopp::EventMode::EDGE)) {
+        REQUIRE(errno == ENOTSUP);
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+        WARN("Edge-triggered mode is not supported by this backend");
+        return;
+    }
+    REQUIRE(loop->add_fd(pipe_fds[1], loopp::EventType::WRITE, write_callback));
+
+    // Wait for the loop to stop
+    std::thread loop_thread([&]() { loop->start(); });
+    loop_thread.join();
+
+    REQUIRE(read_invocations == 1);
+
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+}
+
+TEST_CASE("Registering event types with different modes fails", "[event_loop]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    // Create a pipe
+    std::array<int, 2> pipe_fds{};
+    REQUIRE(pipe(pipe_fds.data()) == 0);
+
+    auto callback = [](int /*fd*/, loopp::EventType /*type*/) {};
+
+    REQUIRE(loop->add_fd(pipe_fds[1], loopp::EventType::WRITE, callback, loopp::EventMode::ONESHOT));
+    REQUIRE_FALSE(loop->add_fd(pipe_fds[1], loopp::EventType::READ, callback, loopp::EventMode::LEVEL));
+    REQUIRE(errno == EINVAL);
+
+    // Rearming requires a registration
+    REQUIRE_FALSE(loop->rearm_fd(pipe_fds[0]));
+    REQUIRE(errno == ENOENT);
+
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+}
+
+TEST_CASE("Registrations made from the loop thread take effect", "[event_loop]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    // Create two pipes, the first one readable
+    std::array<int, 2> read_fds{};
+    std::array<int, 2> write_fds{};
+    REQUIRE(pipe(read_fds.data()) == 0);
+    REQUIRE(pipe(write_fds.data()) == 0);
+    [[maybe_unused]] auto _ = write(read_fds[1], "test", 4);
+
+    std::atomic<bool> is_read_invoked{false};
+    auto read_callback = [&](int /*fd*/, loopp::EventType /*type*/) {
+        is_read_invoked = true;
+        loop->stop();
+    };
+
+    // WRITE callback swaps itself for the READ one from within the loop
+    auto write_callback = [&](int fd, loopp::EventType /*type*/) {
+        REQUIRE(loop->remove_fd(fd, loopp::EventType::WRITE));
+        REQUIRE(loop->add_fd(read_fds[0], loopp::EventType::READ, read_callback));
+    };
+    REQUIRE(loop->add_fd(write_fds[1], loopp::EventType::WRITE, write_callback));
+
+    // Wait for the loop to stop
+    std::thread loop_thread([&]() { loop->start(); });
+    loop_thread.join();
+
+    REQUIRE(is_read_invoked);
+
+    close(read_fds[0]);
+    close(read_fds[1]);
+    close(write_fds[0]);
+    close(write_fds[1]);
+}
+
+TEST_CASE("EventLoop registers and removes file descriptors in batches", "[event_loop]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    // Create a few pipes, all readable
+    constexpr size_t PIPE_COUNT = 8;
+    std::array<std::array<int, 2>, PIPE_COUNT> pipes{};
+    for (auto& pipe_fds : pipes) {
+        REQUIRE(pipe(pipe_fds.data()) == 0);
+        [[maybe_unused]] auto _ = write(pipe_fds[1], "test", 4);
+    }
+
+    // Every callback removes the whole batch, so only one of them fires
+    std::vector<loopp::FdEvent> events;
+    std::atomic<int> invocations{0};
+    auto callback = [&](int /*fd*/, loopp::EventType /*type*/) {
+        ++invocations;
+        REQUIRE(loop->remove_fds(events));
+
+        loop->stop();
+    };
+
+    std::vector<loopp::Registration> registrations;
+    for (const auto& pipe_fds : pipes) {
+        registrations.push_back({pipe_fds[0], loopp::EventType::READ, callback});
+        events.push_back({pipe_fds[0], loopp::EventType::READ});
+    }
+    REQUIRE(loop->add_fds(registrations));
+
+    // Wait for the loop to stop
+    std::thread loop_thread([&]() { loop->start(); });
+    loop_thread.join();
+
+    REQUIRE(invocations == 1);
+
+    for (const auto& pipe_fds : pipes) {
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+    }
+}
+
+TEST_CASE("Batched registration stops at the first failure", "[event_loop]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    // Create a pipe
+    std::array<int, 2> pipe_fds{};
+    REQUIRE(pipe(pipe_fds.data()) == 0);
+
+    auto callback = [](int /*fd*/, loopp::EventType /*type*/) {};
+
+    // Second registration conflicts with the mode of the first one
+    std::array<loopp::Registration, 3> registrations{{
+        {pipe_fds[0], loopp::EventType::READ, callback, loopp::EventMode::ONESHOT},
+        {pipe_fds[0], loopp::EventType::WRITE, callback, loopp::EventMode::LEVEL},
+        {pipe_fds[1], loopp::EventType::WRITE, callback, loopp::EventMode::LEVEL},
+    }};
+    REQUIRE_FALSE(loop->add_fds(registrations));
+    REQUIRE(errno == EINVAL);
+
+    // The registration before the failure was applied, the one after wasn't
+    REQUIRE(loop->rearm_fd(pipe_fds[0]));
+    REQUIRE_FALSE(loop->rearm_fd(pipe_fds[1]));
+
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+}
+
+TEST_CASE("File descriptors above FD_SETSIZE can be registered", "[event_loop]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    // Raise the soft limit so a descriptor past FD_SETSIZE can be allocated
+    rlimit limit{};
+    REQUIRE(getrlimit(RLIMIT_NOFILE, &limit) == 0);
+    if (limit.rlim_max != RLIM_INFINITY && limit.rlim_max <= FD_SETSIZE) {
+        WARN("The file descriptor limit doesn't go past FD_SETSIZE");
+        return;
+    }
+    rlimit raised = limit;
+    raised.rlim_cur = limit.rlim_max == RLIM_INFINITY ? FD_SETSIZE + 1 : limit.rlim_max;
+    raised.rlim_cur = std::max<rlim_t>(raised.rlim_cur, limit.rlim_cur);
+    REQUIRE(setrlimit(RLIMIT_NOFILE, &raised) == 0);
+
+    // Move the read end of a pipe past FD_SETSIZE
+    std::array<int, 2> pipe_fds{};
+    REQUIRE(pipe(pipe_fds.data()) == 0);
+    int high_fd = fcntl(pipe_fds[0], F_DUPFD, FD_SETSIZE);
+    REQUIRE(high_fd >= FD_SETSIZE);
+
+    std::atomic<bool> is_callback_invoked{false};
+    auto callback = [&](int fd, loopp::EventType /*type*/) {
+        REQUIRE(fd == high_fd);
+        is_callback_invoked = true;
+        loop->stop();
+    };
+
+    // Only select is limited to FD_SETSIZE
+    if (!loop->add_fd(high_fd, loopp::EventType::READ, callback)) {
+        REQUIRE(errno == EMFILE);
+        WARN("File descriptors above FD_SETSIZE are not supported by this backend");
+    } else {
+        [[maybe_unused]] auto _ = write(pipe_fds[1], "test", 4);
+        std::thread loop_thread([&]() { loop->start(); });
+        loop_thread.join();
+        REQUIRE(is_callback_invoked);
+    }
+
+    close(high_fd);
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+    setrlimit(RLIMIT_NOFILE, &limit);
+}
+
+TEST_CASE("Move-only callbacks can be registered", "[event_loop]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    std::array<int, 2> fds{};
+    REQUIRE(pipe(fds.data()) == 0);
+
+    // Captures a unique_ptr, which a std::function couldn't hold
+    int result = 0;
+    auto value = std::make_unique<int>(42);
+    REQUIRE(loop->add_fd(fds[0], loopp::EventType::READ, [&, value = std::move(value)](int, loopp::EventType) {
+        result = *value;
+        loop->stop();
+    }));
+
+    // Large captures are stored as well
+    std::array<char, loopp::UniqueEventCallback::INLINE_SIZE * 2> padding{};
+    padding.back() = 1;
+    loopp::UniqueEventCallback large = [&result, padding](int, loopp::EventType) { result += padding.back(); };
+    REQUIRE(loop->add_fd(fds[1], loopp::EventType::WRITE, std::move(large), loopp::EventMode::ONESHOT));
+
+    REQUIRE(write(fds[1], "x", 1) == 1);
+    std::thread loop_thread([&]() { loop->start(); });
+    loop_thread.join();
+
+    REQUIRE(result >= 42);
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+namespace {
+
+/*
+ * Records the calls of an FdHandler, stopping the loop after the first one.
+ */
+struct RecordingHandler : loopp::FdHandler {
+    loopp::EventLoop& loop;
+    int calls{0};
+    int fd{-1};
+    loopp::ReadyMask ready{0};
+    void* user_data{nullptr};
+
+    explicit RecordingHandler(loopp::EventLoop& loop) : loop(loop) {}
+
+    void on_ready(int ready_fd, loopp::ReadyMask ready_mask, void* data) override {
+        ++calls;
+        fd = ready_fd;
+        ready = ready_mask;
+        user_data = data;
+        loop.stop();
+    }
+};
+
+}  // namespace
+
+TEST_CASE("FdHandler receives all ready conditions in a single call", "[event_loop]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    // A socket pair is readable and writable at the same time
+    std::array<int, 2> fds{};
+    REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds.data()) == 0);
+    REQUIRE(write(fds[1], "x", 1) == 1);
+
+    RecordingHandler handler(*loop);
+    int context = 0;
+    REQUIRE(loop->add_fd(fds[0], loopp::READY_READ | loopp::READY_WRITE, &handler, &context));
+
+    std::thread loop_thread([&]() { loop->start(); });
+    loop_thread.join();
+
+    REQUIRE(handler.calls == 1);
+    REQUIRE(handler.fd == fds[0]);
+    REQUIRE(handler.user_data == &context);
+    REQUIRE((handler.ready & loopp::READY_READ) != 0);
+    REQUIRE((handler.ready & loopp::READY_WRITE) != 0);
+
+    // Registering again changes the interest, write readiness is no longer reported
+    REQUIRE(loop->add_fd(fds[0], loopp::READY_READ, &handler, nullptr));
+    std::thread second_run([&]() { loop->start(); });
+    second_run.join();
+
+    REQUIRE(handler.calls == 2);
+    REQUIRE(handler.user_data == nullptr);
+    REQUIRE(handler.ready == loopp::READY_READ);
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST_CASE("FdHandler registrations don't mix with callbacks", "[event_loop]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    std::array<int, 2> fds{};
+    REQUIRE(pipe(fds.data()) == 0);
+
+    RecordingHandler handler(*loop);
+    REQUIRE_FALSE(loop->add_fd(fds[0], 0, &handler, nullptr));
+    REQUIRE(errno == EINVAL);
+    REQUIRE_FALSE(loop->add_fd(fds[0], loopp::READY_READ, nullptr, nullptr));
+    REQUIRE(errno == EINVAL);
+
+    // Callbacks and handlers exclude each other on the same FD
+    REQUIRE(loop->add_fd(fds[0], loopp::READY_READ, &handler, nullptr));
+    REQUIRE_FALSE(loop->add_fd(fds[0], loopp::EventType::WRITE, [](int, loopp::EventType) {}));
+    REQUIRE(errno == EINVAL);
+
+    // Removing the last event type of the interest removes the registration
+    REQUIRE(loop->remove_fd(fds[0], loopp::EventType::READ));
+    REQUIRE(loop->add_fd(fds[0], loopp::EventType::READ, [](int, loopp::EventType) {}));
+    REQUIRE_FALSE(loop->add_fd(fds[0], loopp::READY_READ, &handler, nullptr));
+    REQUIRE(errno == EINVAL);
+    REQUIRE(loop->remove_fd(fds[0], loopp::EventType::READ));
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST_CASE("FdHandlers can be registered in a batch", "[event_loop]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    std::array<int, 2> idle_fds{};
+    std::array<int, 2> ready_fds{};
+    REQUIRE(pipe(idle_fds.data()) == 0);
+    REQUIRE(pipe(ready_fds.data()) == 0);
+    REQUIRE(write(ready_fds[1], "x", 1) == 1);
+
+    RecordingHandler handler(*loop);
+    int context = 0;
+    std::array<loopp::HandlerRegistration, 2> registrations{{
+        {idle_fds[0], loopp::READY_READ, &handler, nullptr},
+        {ready_fds[0], loopp::READY_READ, &handler, &context},
+    }};
+    REQUIRE(loop->add_fds(registrations));
+
+    std::thread loop_thread([&]() { loop->start(); });
+    loop_thread.join();
+
+    REQUIRE(handler.calls == 1);
+    REQUIRE(handler.fd == ready_fds[0]);
+    REQUIRE(handler.user_data == &context);
+
+    // The batch stops at the first failure, an empty interest
+    std::array<loopp::HandlerRegistration, 2> invalid{{
+        {idle_fds[0], 0, &handler, nullptr},
+        {ready_fds[0], loopp::READY_WRITE, &handler, nullptr},
+    }};
+    REQUIRE_FALSE(loop->add_fds(invalid));
+    REQUIRE(errno == EINVAL);
+
+    for (int fd : {idle_fds[0], idle_fds[1], ready_fds[0], ready_fds[1]}) {
+        close(fd);
+    }
+}
+
+TEST_CASE("FdHandler is told about hangups", "[event_loop]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    std::array<int, 2> fds{};
+    REQUIRE(pipe(fds.data()) == 0);
+    close(fds[1]);
+
+    RecordingHandler handler(*loop);
+    REQUIRE(loop->add_fd(fds[0], loopp::READY_READ, &handler, nullptr));
+
+    std::thread loop_thread([&]() { loop->start(); });
+    loop_thread.join();
+
+    // Select can only tell the FD became readable
+    REQUIRE(handler.calls == 1);
+    REQUIRE((handler.ready & (loopp::READY_READ | loopp::READY_HANGUP)) != 0);
+
+    close(fds[0]);
+}
+
+TEST_CASE("Peers shutting down their writing side are reported", "[event_loop]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    std::array<int, 2> fds{};
+    REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds.data()) == 0);
+    REQUIRE(shutdown(fds[1], SHUT_WR) == 0);
+
+    RecordingHandler handler(*loop);
+    REQUIRE(loop->add_fd(fds[0], loopp::READY_READ, &handler, nullptr));
+
+    std::thread loop_thread([&]() { loop->start(); });
+    loop_thread.join();
+
+    REQUIRE(handler.calls == 1);
+    REQUIRE((handler.ready & loopp::READY_READ) != 0);
+    REQUIRE((handler.ready & loopp::READY_HANGUP) == 0);
+    if ((handler.ready & loopp::READY_READ_HANGUP) == 0) {
+        WARN("Read hangups are not reported by this backend");
+    }
+
+    // Closing the peer as well hangs up the connection
+    close(fds[1]);
+    std::thread second_run([&]() { loop->start(); });
+    second_run.join();
+
+    REQUIRE(handler.calls == 2);
+    if ((handler.ready & loopp::READY_READ_HANGUP) != 0) {
+        REQUIRE((handler.ready & loopp::READY_HANGUP) != 0);
+    }
+
+    close(fds[0]);
+}
+
+#ifndef LOOPP_BACKEND_SELECT
+// Select fails the wait with EBADF instead
+TEST_CASE("File descriptors closed without removal don't keep the loop busy", "[event_loop]") {
+    using namespace std::chrono_literals;
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    std::array<int, 2> fds{};
+    REQUIRE(pipe(fds.data()) == 0);
+    bool is_called = false;
+    REQUIRE(loop->add_fd(fds[0], loopp::EventType::READ, [&](int, loopp::EventType) { is_called = true; }));
+
+    // Picked up while armed, then closed behind the loop's back
+    REQUIRE(loop->add_timer(10ms, [&]() { close(fds[0]); }) != 0);
+    REQUIRE(loop->add_timer(200ms, [&]() { loop->stop(); }) != 0);
+
+    timespec cpu_start{};
+    timespec cpu_end{};
+    REQUIRE(clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_start) == 0);
+    loop->start();
+    REQUIRE(clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_end) == 0);
+
+    // Spinning would burn most of the 200ms
+    auto cpu_ns = (cpu_end.tv_sec - cpu_start.tv_sec) * 1'000'000'000L + (cpu_end.tv_nsec - cpu_start.tv_nsec);
+    REQUIRE(cpu_ns < 50'000'000L);
+    REQUIRE_FALSE(is_called);
+
+    loop->remove_fd(fds[0], loopp::EventType::READ);
+    close(fds[1]);
+}
+#endif
+
+TEST_CASE("Native event loop is usable by value and as an EventLoop", "[event_loop]") {
+    static_assert(std::is_final_v<loopp::NativeEventLoop>);
+    static_assert(std::is_base_of_v<loopp::EventLoop, loopp::NativeEventLoop>);
+
+    // Heap allocated only to keep the handler table off the test's stack
+    auto native = std::make_unique<loopp::NativeEventLoop>();
+    loopp::NativeEventLoop& loop = *native;
+
+    std::array<int, 2> fds{};
+    REQUIRE(pipe(fds.data()) == 0);
+    REQUIRE(write(fds[1], "x", 1) == 1);
+
+    int calls = 0;
+    REQUIRE(loop.add_fd(fds[0], loopp::EventType::READ, [&](int, loopp::EventType) {
+        ++calls;
+        loop.stop();
+    }));
+    loop.start();
+    REQUIRE(calls == 1);
+
+    // Same implementation behind the virtual interface
+    loopp::EventLoop& base = loop;
+    REQUIRE(base.remove_fd(fds[0], loopp::EventType::READ));
+    REQUIRE(base.post([&] { base.stop(); }));
+    base.start();
+    REQUIRE(calls == 1);
+
+    close(fds[0]);
+    close(fds[1]);
+}
@@ -0,0 +1,85 @@
+#include <atomic>
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <thread>
+
+#include "loopp/event_loop.hpp"
+#include "loopp/executor.hpp"
+
+TEST_CASE("Executor runs every submitted task", "[executor]") {
+    std::atomic<int> runs{0};
+    {
+        loopp::Executor executor(4);
+        REQUIRE(executor.size() == 4);
+
+        // Tasks submitted by tasks land on the worker's own deque
+        for (int i = 0; i < 100; ++i) {
+            REQUIRE(executor.submit([&] {
+                ++runs;
+                executor.submit([&] { ++runs; });
+            }));
+        }
+    }
+
+    // Destruction runs what's left before joining
+    REQUIRE(runs == 200);
+}
+
+TEST_CASE("Offloaded work resumes on the loop thread", "[executor]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+    loopp::Executor executor(2);
+
+    std::thread::id loop_thread_id;
+    std::thread::id work_thread_id;
+    std::thread::id resume_thread_id;
+    REQUIRE(loop->post([&] {
+        loop_thread_id = std::this_thread::get_id();
+        executor.offload(
+            *loop, [&] { work_thread_id = std::this_thread::get_id(); },
+            [&] {
+                resume_thread_id = std::this_thread::get_id();
+                loop->stop();
+            });
+    }));
+
+    std::thread loop_thread([&] { loop->start(); });
+    loop_thread.join();
+
+    REQUIRE(work_thread_id != loop_thread_id);
+    REQUIRE(resume_thread_id == loop_thread_id);
+}
+
+TEST_CASE("Executor reports steals and queue depths", "[executor]") {
+    loopp::Executor executor(2);
+
+    // Block one worker, the tasks it spawns meanwhile can only run if the other one steals them
+    std::atomic<bool> is_released{false};
+    std::atomic<int> runs{0};
+    REQUIRE(executor.submit([&] {
+        for (int i = 0; i < 8; ++i) {
+            executor.submit([&] { ++runs; });
+        }
+        while (!is_released.load()) {
+            std::this_thread::yield();
+        }
+    }));
+
+    while (runs.load() < 8) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    is_released.store(true);
+
+    // The blocking task may still be finishing up
+    loopp::ExecutorStats stats = executor.stats();
+    while (stats.completed < 9) {
+        std::this_thread::yield();
+        stats = executor.stats();
+    }
+
+    REQUIRE(stats.submitted == 9);
+    REQUIRE(stats.steals >= 8);
+    REQUIRE(stats.queue_depths.size() == 2);
+    REQUIRE(stats.queue_depths[0] == 0);
+    REQUIRE(stats.queue_depths[1] == 0);
+}
@@ -0,0 +1,59 @@
+#include <atomic>
+#include <catch2/catch_test_macros.hpp>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+
+#include "loopp/event_loop.hpp"
+#include "loopp/loop_group.hpp"
+
+TEST_CASE("Loop group runs every loop on its own thread", "[loop_group]") {
+    loopp::LoopGroup group(3);
+    REQUIRE(group.size() == 3);
+    group.start();
+
+    // Collect the thread of every loop, the last one stops the group
+    std::mutex mutex;
+    std::set<std::thread::id> thread_ids;
+    for (size_t i = 0; i < group.size(); ++i) {
+        REQUIRE(group.loop(i)->post([&] {
+            std::lock_guard<std::mutex> lock(mutex);
+            thread_ids.insert(std::this_thread::get_id());
+            if (thread_ids.size() == group.size()) group.stop();
+        }));
+    }
+
+    group.join();
+
+    REQUIRE(thread_ids.size() == 3);
+    REQUIRE(thread_ids.count(std::this_thread::get_id()) == 0);
+}
+
+TEST_CASE("Loop group hands out loops in round-robin order", "[loop_group]") {
+    loopp::LoopGroup group(2, false);
+
+    REQUIRE(group.next() == group.loop(0));
+    REQUIRE(group.next() == group.loop(1));
+    REQUIRE(group.next() == group.loop(0));
+    REQUIRE(group.cpu(0) == -1);
+}
+
+TEST_CASE("Loop group stopped before its loops run still stops", "[loop_group]") {
+    loopp::LoopGroup group(2);
+    group.start();
+    REQUIRE(group.stop());
+
+    // Would hang if a loop missed the stop
+    group.join();
+}
+
+TEST_CASE("Loop group rethrows the exception a loop exited with", "[loop_group]") {
+    loopp::LoopGroup group(2);
+    group.start();
+
+    REQUIRE(group.loop(1)->post([] { throw std::runtime_error("task failed"); }));
+
+    // The failing loop stops the others
+    REQUIRE_THROWS_AS(group.join(), std::runtime_error);
+}
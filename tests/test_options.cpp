@@ -0,0 +1,167 @@
+#include <unistd.h>
+
+#include <array>
+#include <catch2/catch_test_macros.hpp>
+#include <cerrno>
+#include <chrono>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "loopp/event_loop.hpp"
+
+TEST_CASE("Options are validated and can be read back", "[options]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    REQUIRE(loop->options().max_events == loopp::LoopOptions{}.max_events);
+
+    REQUIRE(loop->set_options({.max_events = 16, .max_callbacks = 4, .max_tasks = 8}));
+    loopp::LoopOptions options = loop->options();
+    REQUIRE(options.max_events == 16);
+    REQUIRE(options.max_callbacks == 4);
+    REQUIRE(options.max_tasks == 8);
+
+    errno = 0;
+    REQUIRE_FALSE(loop->set_options({.max_events = 0}));
+    REQUIRE(errno == EINVAL);
+    REQUIRE_FALSE(loop->set_options({.callback_budget = std::chrono::nanoseconds(-1)}));
+    REQUIRE(loop->options().max_events == 16);
+
+    REQUIRE_THROWS_AS(loopp::EventLoop::create({.max_events = 0}), std::system_error);
+}
+
+TEST_CASE("Callbacks over the limit run after posted tasks", "[options]") {
+    auto loop = loopp::EventLoop::create({.max_callbacks = 1});
+    REQUIRE(loop != nullptr);
+
+    // Create two pipes, readable at once
+    std::array<int, 2> first{};
+    std::array<int, 2> second{};
+    REQUIRE(pipe(first.data()) == 0);
+    REQUIRE(pipe(second.data()) == 0);
+    REQUIRE(write(first[1], "x", 1) == 1);
+    REQUIRE(write(second[1], "x", 1) == 1);
+
+    // The first callback posts a task, which gets its turn before the second callback
+    std::vector<std::string> order;
+    auto callback = [&](int fd, loopp::EventType type) {
+        loop->remove_fd(fd, type);
+        order.emplace_back("io");
+        if (order.size() == 1) loop->post([&]() { order.emplace_back("task"); });
+        if (order.size() == 3) loop->stop();
+    };
+    REQUIRE(loop->add_fd(first[0], loopp::EventType::READ, callback));
+    REQUIRE(loop->add_fd(second[0], loopp::EventType::READ, callback));
+
+    std::thread loop_thread([&]() { loop->start(); });
+    loop_thread.join();
+
+    REQUIRE(order == std::vector<std::string>{"io", "task", "io"});
+
+    for (int fd : {first[0], first[1], second[0], second[1]}) close(fd);
+}
+
+TEST_CASE("Tasks over the limit run after ready callbacks", "[options]") {
+    auto loop = loopp::EventLoop::create({.max_tasks = 1});
+    REQUIRE(loop != nullptr);
+
+    // Create a pipe that stays readable
+    std::array<int, 2> fds{};
+    REQUIRE(pipe(fds.data()) == 0);
+    REQUIRE(write(fds[1], "x", 1) == 1);
+
+    std::vector<std::string> order;
+    REQUIRE(loop->post([&]() { order.emplace_back("first"); }));
+    REQUIRE(loop->post([&]() {
+        order.emplace_back("second");
+        loop->stop();
+    }));
+    REQUIRE(loop->add_fd(fds[0], loopp::EventType::READ, [&](int, loopp::EventType) { order.emplace_back("io"); }));
+
+    std::thread loop_thread([&]() { loop->start(); });
+    loop_thread.join();
+
+    REQUIRE(order == std::vector<std::string>{"io", "first", "io", "second"});
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST_CASE("Options can be changed while the loop is running", "[options]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    std::thread loop_thread([&]() { loop->start(); });
+    while (!loop->is_running()) {
+        std::this_thread::yield();
+    }
+
+    // A time budget still lets one callback run per iteration
+    REQUIRE(loop->set_options({.max_events = 1, .callback_budget = std::chrono::nanoseconds(1)}));
+
+    std::array<int, 2> fds{};
+    REQUIRE(pipe(fds.data()) == 0);
+    REQUIRE(write(fds[1], "x", 1) == 1);
+
+    int calls = 0;
+    REQUIRE(loop->add_fd(fds[0], loopp::EventType::READ, [&](int fd, loopp::EventType type) {
+        loop->remove_fd(fd, type);
+        ++calls;
+        loop->stop();
+    }));
+    loop_thread.join();
+
+    REQUIRE(calls == 1);
+    REQUIRE(loop->options().max_events == 1);
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST_CASE("Busy polling picks up wakeups without blocking", "[options]") {
+    auto loop = loopp::EventLoop::create({.busy_poll = std::chrono::seconds(10)});
+    REQUIRE(loop != nullptr);
+
+    std::array<int, 2> fds{};
+    REQUIRE(pipe(fds.data()) == 0);
+    REQUIRE(loop->add_fd(fds[0], loopp::EventType::READ, [&](int, loopp::EventType) { loop->stop(); }));
+
+    std::thread loop_thread([&]() { loop->start(); });
+    while (!loop->is_running()) {
+        std::this_thread::yield();
+    }
+
+    // The loop keeps polling meanwhile, as the window is far from elapsed
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    REQUIRE(write(fds[1], "x", 1) == 1);
+    loop_thread.join();
+
+    loopp::BusyPollStats stats = loop->busy_poll_stats();
+    REQUIRE(stats.spins > 0);
+    REQUIRE(stats.spin_hits >= 1);
+    REQUIRE(stats.spin_hits <= stats.spins);
+    REQUIRE(stats.blocking_waits == 0);
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST_CASE("Loops block right away without busy polling", "[options]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    std::thread loop_thread([&]() { loop->start(); });
+    while (!loop->is_running()) {
+        std::this_thread::yield();
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    REQUIRE(loop->post([&]() { loop->stop(); }));
+    loop_thread.join();
+
+    loopp::BusyPollStats stats = loop->busy_poll_stats();
+    REQUIRE(stats.spins == 0);
+    REQUIRE(stats.blocking_waits > 0);
+}
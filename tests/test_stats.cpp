@@ -0,0 +1,103 @@
+#include <unistd.h>
+
+#include <array>
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+#include <thread>
+
+#include "loopp/event_loop.hpp"
+#include "loopp/stats.hpp"
+
+TEST_CASE("Histogram buckets keep values within their precision", "[stats]") {
+    using loopp::Histogram;
+
+    // Small values are exact
+    for (uint64_t value = 0; value < Histogram::SUB_BUCKET_COUNT; ++value) {
+        REQUIRE(Histogram::bucket_value(Histogram::bucket_index(value)) == value);
+    }
+
+    // Larger ones are reported as the top of their bucket, within 1/16 of them
+    for (uint64_t value : {16ULL, 17ULL, 100ULL, 1'000ULL, 123'456ULL, 10'000'000'000ULL}) {
+        uint64_t reported = Histogram::bucket_value(Histogram::bucket_index(value));
+        REQUIRE(reported >= value);
+        REQUIRE(reported - value <= value / Histogram::SUB_BUCKET_COUNT);
+    }
+
+    // Buckets are contiguous and ordered
+    for (size_t i = 1; i < Histogram::BUCKET_COUNT; ++i) {
+        REQUIRE(Histogram::bucket_index(Histogram::bucket_value(i - 1) + 1) == i);
+    }
+    REQUIRE(Histogram::bucket_index(UINT64_MAX) == Histogram::BUCKET_COUNT - 1);
+}
+
+TEST_CASE("Histogram percentiles", "[stats]") {
+    loopp::Histogram histogram;
+    REQUIRE(histogram.percentile(50) == 0);
+    REQUIRE(histogram.max() == 0);
+
+    for (uint64_t value = 1; value <= 100; ++value) {
+        histogram.record(value);
+    }
+    REQUIRE(histogram.count() == 100);
+    REQUIRE(histogram.percentile(0) == 1);
+    REQUIRE(histogram.percentile(50) >= 50);
+    REQUIRE(histogram.percentile(50) <= 53);
+    REQUIRE(histogram.percentile(100) == histogram.max());
+    REQUIRE(histogram.max() >= 100);
+}
+
+TEST_CASE("Loop statistics are collected when enabled", "[stats]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    std::array<int, 2> fds{};
+    REQUIRE(pipe(fds.data()) == 0);
+    REQUIRE(write(fds[1], "x", 1) == 1);
+
+    int calls = 0;
+    REQUIRE(loop->add_fd(fds[0], loopp::EventType::READ, [&](int, loopp::EventType) {
+        if (++calls == 3) loop->stop();
+    }));
+
+    std::thread loop_thread([&]() { loop->start(); });
+    loop_thread.join();
+
+    loopp::LoopStats stats = loop->stats();
+    if (!stats.is_enabled) {
+        REQUIRE(stats.iterations == 0);
+        REQUIRE(stats.callback_time_ns.count() == 0);
+    } else {
+        REQUIRE(stats.iterations >= 3);
+        REQUIRE(stats.waits >= 3);
+        REQUIRE(stats.events_per_wait.count() == stats.waits);
+        REQUIRE(stats.callback_time_ns.count() == 3);
+    }
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST_CASE("Wakeups from other threads are counted", "[stats]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    std::thread loop_thread([&]() { loop->start(); });
+    while (!loop->is_running()) {
+        std::this_thread::yield();
+    }
+
+    constexpr int POST_COUNT = 100;
+    for (int i = 0; i < POST_COUNT; ++i) {
+        REQUIRE(loop->post([]() {}));
+    }
+    REQUIRE(loop->post([&]() { loop->stop(); }));
+    loop_thread.join();
+
+    loopp::LoopStats stats = loop->stats();
+    if (stats.is_enabled) {
+        REQUIRE(stats.wakeups_issued >= 1);
+        REQUIRE(stats.wakeups_issued + stats.wakeups_coalesced >= POST_COUNT + 1);
+    } else {
+        REQUIRE(stats.wakeups_issued == 0);
+    }
+}
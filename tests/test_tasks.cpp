@@ -0,0 +1,177 @@
+#include <unistd.h>
+
+#include <array>
+#include <atomic>
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "loopp/event_loop.hpp"
+
+TEST_CASE("Posted tasks run on the loop thread", "[tasks]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    // Start the loop with nothing to wait for
+    std::thread::id loop_thread_id;
+    std::thread loop_thread([&]() {
+        loop_thread_id = std::this_thread::get_id();
+        loop->start();
+    });
+    while (!loop->is_running()) {
+        std::this_thread::yield();
+    }
+
+    std::thread::id task_thread_id;
+    REQUIRE(loop->post([&]() {
+        task_thread_id = std::this_thread::get_id();
+        loop->stop();
+    }));
+
+    // Wait for the loop to stop
+    loop_thread.join();
+
+    REQUIRE(task_thread_id == loop_thread_id);
+}
+
+TEST_CASE("Tasks posted before start run once the loop starts", "[tasks]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    std::vector<int> order;
+    REQUIRE(loop->post([&]() { order.push_back(1); }));
+    REQUIRE(loop->post([&]() { order.push_back(2); }));
+    REQUIRE(loop->post([&]() {
+        order.push_back(3);
+        loop->stop();
+    }));
+
+    // Wait for the loop to stop
+    std::thread loop_thread([&]() { loop->start(); });
+    loop_thread.join();
+
+    REQUIRE(order == std::vector<int>{1, 2, 3});
+}
+
+TEST_CASE("Tasks posted from the loop thread don't block the loop", "[tasks]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    // Create a pipe, readable once
+    std::array<int, 2> pipe_fds{};
+    REQUIRE(pipe(pipe_fds.data()) == 0);
+    [[maybe_unused]] auto _ = write(pipe_fds[1], "test", 4);
+
+    // The READ callback posts a task that posts another one, nothing else wakes the loop
+    std::atomic<bool> is_task_invoked{false};
+    auto callback = [&](int fd, loopp::EventType /*type*/) {
+        char buffer[4];
+        [[maybe_unused]] auto bytes_read = read(fd, buffer, sizeof(buffer));
+
+        loop->post([&]() {
+            loop->post([&]() {
+                is_task_invoked = true;
+                loop->stop();
+            });
+        });
+    };
+    REQUIRE(loop->add_fd(pipe_fds[0], loopp::EventType::READ, callback));
+
+    // Wait for the loop to stop
+    std::thread loop_thread([&]() { loop->start(); });
+    loop_thread.join();
+
+    REQUIRE(is_task_invoked);
+
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+}
+
+TEST_CASE("Tasks posted from many threads all run in per-thread order", "[tasks]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    std::thread loop_thread([&]() { loop->start(); });
+    while (!loop->is_running()) {
+        std::this_thread::yield();
+    }
+
+    // Each producer posts an increasing sequence, only the loop thread touches the results
+    constexpr int PRODUCER_COUNT = 4;
+    constexpr int TASK_COUNT = 10000;
+    std::array<int, PRODUCER_COUNT> last_seen{};
+    std::atomic<bool> is_in_order{true};
+    std::atomic<int> remaining{PRODUCER_COUNT * TASK_COUNT};
+
+    std::vector<std::thread> producers;
+    for (int producer = 0; producer < PRODUCER_COUNT; ++producer) {
+        producers.emplace_back([&, producer]() {
+            for (int i = 1; i <= TASK_COUNT; ++i) {
+                REQUIRE(loop->post([&, producer, i]() {
+                    if (last_seen[static_cast<size_t>(producer)] != i - 1) is_in_order = false;
+                    last_seen[static_cast<size_t>(producer)] = i;
+                    if (--remaining == 0) loop->stop();
+                }));
+            }
+        });
+    }
+    for (auto& producer : producers) producer.join();
+
+    // Wait for the loop to stop
+    loop_thread.join();
+
+    REQUIRE(remaining == 0);
+    REQUIRE(is_in_order);
+}
+
+TEST_CASE("Tasks posted from many threads to a sleeping loop all run", "[tasks]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    // Writing to the pipe stops the loop, even one that missed a wakeup
+    std::array<int, 2> pipe_fds{};
+    REQUIRE(pipe(pipe_fds.data()) == 0);
+    REQUIRE(loop->add_fd(pipe_fds[0], loopp::EventType::READ, [&](int, loopp::EventType) { loop->stop(); }));
+
+    std::thread loop_thread([&]() { loop->start(); });
+    while (!loop->is_running()) {
+        std::this_thread::yield();
+    }
+
+    // Each producer waits for its task before posting the next, so most posts find the loop asleep
+    constexpr int PRODUCER_COUNT = 4;
+    constexpr int TASK_COUNT = 20000;
+    std::array<std::atomic<int>, PRODUCER_COUNT> ran{};
+    std::atomic<bool> is_lost{false};
+
+    std::vector<std::thread> producers;
+    for (int producer = 0; producer < PRODUCER_COUNT; ++producer) {
+        producers.emplace_back([&, producer]() {
+            std::atomic<int>& count = ran[static_cast<size_t>(producer)];
+            for (int i = 1; i <= TASK_COUNT && !is_lost; ++i) {
+                REQUIRE(loop->post([&count]() { ++count; }));
+
+                auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+                while (count.load() != i) {
+                    if (std::chrono::steady_clock::now() > deadline) {
+                        is_lost = true;
+                        break;
+                    }
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (auto& producer : producers) producer.join();
+
+    // Wait for the loop to stop
+    REQUIRE(write(pipe_fds[1], "x", 1) == 1);
+    loop_thread.join();
+
+    REQUIRE_FALSE(is_lost);
+    for (const auto& count : ran) REQUIRE(count == TASK_COUNT);
+
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+}
@@ -0,0 +1,129 @@
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "loopp/detail/timer_wheel.hpp"
+
+namespace {
+
+/*
+ * Advance the wheel tick by tick, recording the tick each timer fired at.
+ */
+void run_until(loopp::detail::TimerWheel& wheel, uint64_t last_tick, std::vector<uint64_t>& fired_at) {
+    std::vector<uint32_t> expired;
+    for (uint64_t tick = 0; tick <= last_tick; ++tick) {
+        wheel.advance(tick, expired);
+        for (uint32_t index : expired) {
+            if (const auto* callback = wheel.begin_fire(index)) {
+                fired_at.push_back(tick);
+                (*callback)();
+                wheel.end_fire(index);
+            }
+        }
+        expired.clear();
+    }
+}
+
+}  // namespace
+
+TEST_CASE("TimerWheel fires timers at their expiry across levels", "[timer_wheel]") {
+    loopp::detail::TimerWheel wheel;
+
+    // Expiries spanning the first three levels, including window boundaries
+    std::vector<uint64_t> expiries{0, 1, 63, 64, 65, 127, 128, 4095, 4096, 4097, 70000};
+    std::vector<uint64_t> actual;
+    for (uint64_t expiry : expiries) {
+        wheel.add(expiry, [&actual, expiry]() { actual.push_back(expiry); });
+    }
+
+    std::vector<uint64_t> fired_at;
+    run_until(wheel, 70000, fired_at);
+
+    REQUIRE(actual == expiries);
+    REQUIRE(fired_at == expiries);
+    REQUIRE(wheel.size() == 0);
+}
+
+TEST_CASE("TimerWheel handles random expiries with large jumps", "[timer_wheel]") {
+    loopp::detail::TimerWheel wheel;
+
+    std::mt19937_64 rng(7);
+    std::uniform_int_distribution<uint64_t> dist(0, uint64_t{1} << 20);
+
+    // Jump straight to each deadline, as the loop does after sleeping
+    size_t early = 0;
+    size_t fired = 0;
+    uint64_t now = 0;
+    for (int i = 0; i < 2000; ++i) {
+        uint64_t expiry = dist(rng);
+        wheel.add(expiry, [&, expiry]() {
+            if (now < expiry) ++early;
+            ++fired;
+        });
+    }
+
+    std::vector<uint32_t> expired;
+    while (auto next = wheel.next_expiry()) {
+        now = *next;
+        wheel.advance(now, expired);
+        for (uint32_t index : expired) {
+            if (const auto* callback = wheel.begin_fire(index)) {
+                (*callback)();
+                wheel.end_fire(index);
+            }
+        }
+        expired.clear();
+    }
+
+    REQUIRE(fired == 2000);
+    REQUIRE(early == 0);
+}
+
+TEST_CASE("TimerWheel clamps timers beyond the top level", "[timer_wheel]") {
+    loopp::detail::TimerWheel wheel;
+
+    // Past the 2^30 tick span of the wheel
+    uint64_t expiry = (uint64_t{1} << 31) + 12345;
+    uint64_t fired_at = 0;
+    wheel.add(expiry, [&]() { fired_at = expiry; });
+
+    std::vector<uint32_t> expired;
+    uint64_t now = 0;
+    while (auto next = wheel.next_expiry()) {
+        now = *next;
+        wheel.advance(now, expired);
+        for (uint32_t index : expired) {
+            if (const auto* callback = wheel.begin_fire(index)) {
+                REQUIRE(now >= expiry);
+                (*callback)();
+                wheel.end_fire(index);
+            }
+        }
+        expired.clear();
+    }
+
+    REQUIRE(fired_at == expiry);
+}
+
+TEST_CASE("TimerWheel cancels and resets timers", "[timer_wheel]") {
+    loopp::detail::TimerWheel wheel;
+
+    int invocations = 0;
+    auto cancelled = wheel.add(10, [&]() { ++invocations; });
+    auto moved = wheel.add(10, [&]() { ++invocations; });
+    REQUIRE(wheel.cancel(cancelled));
+    REQUIRE_FALSE(wheel.cancel(cancelled));
+    REQUIRE(wheel.reset(moved, 200));
+    REQUIRE(wheel.size() == 1);
+
+    std::vector<uint64_t> fired_at;
+    run_until(wheel, 300, fired_at);
+
+    REQUIRE(invocations == 1);
+    REQUIRE(fired_at == std::vector<uint64_t>{200});
+
+    // Fired timers can't be cancelled or reset
+    REQUIRE_FALSE(wheel.cancel(moved));
+    REQUIRE_FALSE(wheel.reset(moved, 400));
+}
@@ -0,0 +1,149 @@
+#include <atomic>
+#include <catch2/catch_test_macros.hpp>
+#include <cerrno>
+#include <chrono>
+#include <thread>
+
+#include "loopp/event_loop.hpp"
+
+using namespace std::chrono_literals;
+
+TEST_CASE("Timers fire after their delay", "[timers]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    // Set up callback
+    auto armed_at = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point fired_at;
+    auto callback = [&]() {
+        fired_at = std::chrono::steady_clock::now();
+        loop->stop();
+    };
+
+    // Arm the timer and start the loop in a separate thread
+    REQUIRE(loop->add_timer(20ms, callback) != 0);
+    std::thread loop_thread([&]() { loop->start(); });
+
+    // Wait for the loop to stop
+    loop_thread.join();
+
+    REQUIRE(fired_at - armed_at >= 20ms);
+}
+
+TEST_CASE("Timers fire in deadline order", "[timers]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    // Arm out of order, including one beyond the lowest wheel level
+    std::atomic<int> order{0};
+    std::atomic<int> first{0};
+    std::atomic<int> second{0};
+    std::atomic<int> third{0};
+    REQUIRE(loop->add_timer(90ms, [&]() { third = ++order; loop->stop(); }) != 0);
+    REQUIRE(loop->add_timer(10ms, [&]() { first = ++order; }) != 0);
+    REQUIRE(loop->add_timer(30ms, [&]() { second = ++order; }) != 0);
+
+    // Wait for the loop to stop
+    std::thread loop_thread([&]() { loop->start(); });
+    loop_thread.join();
+
+    REQUIRE(first == 1);
+    REQUIRE(second == 2);
+    REQUIRE(third == 3);
+}
+
+TEST_CASE("Cancelled timers don't fire", "[timers]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    std::atomic<bool> is_cancelled_invoked{false};
+    loopp::TimerId id = loop->add_timer(10ms, [&]() { is_cancelled_invoked = true; });
+    REQUIRE(id != 0);
+    REQUIRE(loop->add_timer(40ms, [&]() { loop->stop(); }) != 0);
+
+    // Cancelling twice only succeeds once
+    REQUIRE(loop->cancel_timer(id));
+    REQUIRE_FALSE(loop->cancel_timer(id));
+
+    // Wait for the loop to stop
+    std::thread loop_thread([&]() { loop->start(); });
+    loop_thread.join();
+
+    REQUIRE_FALSE(is_cancelled_invoked);
+
+    // Resetting a cancelled timer fails
+    REQUIRE_FALSE(loop->reset_timer(id, 10ms));
+    REQUIRE(errno == ENOENT);
+}
+
+TEST_CASE("Timers can be cancelled by other timers due at the same time", "[timers]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    // Whichever fires first cancels the other one
+    std::atomic<int> invocations{0};
+    loopp::TimerId first_id = 0;
+    loopp::TimerId second_id = 0;
+    auto callback = [&]() {
+        ++invocations;
+        loop->cancel_timer(first_id);
+        loop->cancel_timer(second_id);
+    };
+    first_id = loop->add_timer(10ms, callback);
+    second_id = loop->add_timer(10ms, callback);
+    REQUIRE(loop->add_timer(40ms, [&]() { loop->stop(); }) != 0);
+
+    // Wait for the loop to stop
+    std::thread loop_thread([&]() { loop->start(); });
+    loop_thread.join();
+
+    REQUIRE(invocations == 1);
+}
+
+TEST_CASE("Timers can re-arm themselves", "[timers]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    // Periodic timer, re-armed from its own callback
+    std::atomic<int> invocations{0};
+    loopp::TimerId id = 0;
+    id = loop->add_timer(5ms, [&]() {
+        if (++invocations < 3) {
+            REQUIRE(loop->reset_timer(id, 5ms));
+        } else {
+            loop->stop();
+        }
+    });
+    REQUIRE(id != 0);
+
+    // Wait for the loop to stop
+    std::thread loop_thread([&]() { loop->start(); });
+    loop_thread.join();
+
+    REQUIRE(invocations == 3);
+
+    // Fired for the last time without re-arming, so it's gone
+    REQUIRE_FALSE(loop->cancel_timer(id));
+}
+
+TEST_CASE("Timers armed from another thread wake up the loop", "[timers]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    // Start the loop with nothing to wait for
+    std::thread loop_thread([&]() { loop->start(); });
+    while (!loop->is_running()) {
+        std::this_thread::yield();
+    }
+
+    std::atomic<bool> is_callback_invoked{false};
+    REQUIRE(loop->add_timer(10ms, [&]() {
+        is_callback_invoked = true;
+        loop->stop();
+    }) != 0);
+
+    // Wait for the loop to stop
+    loop_thread.join();
+
+    REQUIRE(is_callback_invoked);
+}
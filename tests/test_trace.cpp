@@ -0,0 +1,181 @@
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <catch2/catch_test_macros.hpp>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "loopp/event_loop.hpp"
+#include "loopp/trace.hpp"
+
+namespace {
+
+/*
+ * Read back everything written to a temporary file.
+ */
+std::string read_file(std::FILE* file) {
+    std::rewind(file);
+    std::string content;
+    std::array<char, 4096> buffer{};
+    size_t size = 0;
+    while ((size = std::fread(buffer.data(), 1, buffer.size(), file)) > 0) {
+        content.append(buffer.data(), size);
+    }
+    return content;
+}
+
+size_t count_of(const std::string& text, const std::string& pattern) {
+    size_t count = 0;
+    for (size_t position = text.find(pattern); position != std::string::npos; position = text.find(pattern, position + 1)) {
+        ++count;
+    }
+    return count;
+}
+
+}  // namespace
+
+TEST_CASE("Trace buffer keeps the newest records", "[trace]") {
+    loopp::TraceBuffer buffer(5);
+    REQUIRE(buffer.capacity() == 8);
+    REQUIRE(buffer.snapshot().empty());
+
+    for (uint32_t i = 0; i < 20; ++i) {
+        buffer.record(loopp::TraceKind::WAKEUP, static_cast<int>(i), i);
+    }
+    REQUIRE(buffer.recorded() == 20);
+
+    auto records = buffer.snapshot();
+    REQUIRE(records.size() == 8);
+    for (size_t i = 0; i < records.size(); ++i) {
+        REQUIRE(records[i].kind == loopp::TraceKind::WAKEUP);
+        REQUIRE(records[i].value == 12 + i);
+        REQUIRE(records[i].fd == static_cast<int>(12 + i));
+        REQUIRE(records[i].thread == records[0].thread);
+    }
+    REQUIRE(std::is_sorted(records.begin(), records.end(), [](const auto& a, const auto& b) { return a.timestamp_ns < b.timestamp_ns; }));
+}
+
+TEST_CASE("Trace buffer snapshots skip records being overwritten", "[trace]") {
+    loopp::TraceBuffer buffer(1024);
+
+    std::vector<std::thread> writers;
+    for (int thread = 0; thread < 4; ++thread) {
+        writers.emplace_back([&buffer, thread] {
+            for (uint32_t i = 0; i < 20000; ++i) {
+                buffer.record(loopp::TraceKind::REGISTRATION, thread, i, static_cast<uint8_t>(thread));
+            }
+        });
+    }
+
+    // Records are never torn, the fields written together are read together
+    for (int round = 0; round < 50; ++round) {
+        for (const auto& record : buffer.snapshot()) {
+            REQUIRE(record.kind == loopp::TraceKind::REGISTRATION);
+            REQUIRE(record.fd == record.type);
+        }
+    }
+    for (auto& writer : writers) {
+        writer.join();
+    }
+
+    // Records dropped by lapped writers leave older ones in their slots, which are skipped
+    REQUIRE(buffer.recorded() == 80000);
+    size_t kept = buffer.snapshot().size();
+    REQUIRE(kept <= 1024);
+    REQUIRE(kept + buffer.dropped() >= 1024);
+}
+
+TEST_CASE("Loops trace waits and callbacks while enabled", "[trace]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+    REQUIRE(loop->trace() == nullptr);
+
+    std::array<int, 2> fds{};
+    REQUIRE(pipe(fds.data()) == 0);
+    REQUIRE(loop->add_fd(fds[0], loopp::EventType::READ, [&](int, loopp::EventType) { loop->stop(); }));
+    REQUIRE(write(fds[1], "x", 1) == 1);
+
+    REQUIRE(loop->set_tracing(true));
+    loop->start();
+    REQUIRE(loop->set_tracing(false));
+
+    const loopp::TraceBuffer* buffer = loop->trace();
+    REQUIRE(buffer != nullptr);
+    auto records = buffer->snapshot();
+
+    auto find = [&](loopp::TraceKind kind) {
+        return std::find_if(records.begin(), records.end(), [&](const auto& record) { return record.kind == kind; });
+    };
+    auto wait_end = find(loopp::TraceKind::WAIT_END);
+    REQUIRE(find(loopp::TraceKind::WAIT_BEGIN) < wait_end);
+    REQUIRE(wait_end->value >= 1);
+
+    auto callback_begin = find(loopp::TraceKind::CALLBACK_BEGIN);
+    auto callback_end = find(loopp::TraceKind::CALLBACK_END);
+    REQUIRE(wait_end < callback_begin);
+    REQUIRE(callback_begin < callback_end);
+    REQUIRE(callback_begin->fd == fds[0]);
+    REQUIRE(callback_begin->type == static_cast<uint8_t>(loopp::EventType::READ));
+    REQUIRE(callback_end->timestamp_ns >= callback_begin->timestamp_ns);
+
+    // Disabled, nothing more is recorded but the records stay
+    uint64_t recorded = buffer->recorded();
+    REQUIRE(loop->add_fd(fds[0], loopp::EventType::READ, [&](int, loopp::EventType) { loop->stop(); }));
+    loop->start();
+    REQUIRE(buffer->recorded() == recorded);
+    REQUIRE(loop->trace() == buffer);
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST_CASE("Trace dumps convert to Chrome trace events", "[trace]") {
+    // An end whose begin was overwritten, then a complete wait and a wakeup
+    std::vector<loopp::TraceRecord> records(4);
+    records[0] = {.timestamp_ns = 1'000, .fd = 5, .thread = 1, .kind = loopp::TraceKind::CALLBACK_END};
+    records[1] = {.timestamp_ns = 2'000, .thread = 1, .kind = loopp::TraceKind::WAIT_BEGIN};
+    records[2] = {.timestamp_ns = 4'500, .value = 3, .thread = 1, .kind = loopp::TraceKind::WAIT_END};
+    records[3] = {.timestamp_ns = 5'000, .thread = 2, .kind = loopp::TraceKind::WAKEUP};
+
+    std::FILE* dump = std::tmpfile();
+    REQUIRE(dump != nullptr);
+    REQUIRE(loopp::write_trace(dump, records));
+    std::rewind(dump);
+    std::vector<loopp::TraceRecord> read;
+    REQUIRE(loopp::read_trace(dump, read));
+    REQUIRE(read.size() == records.size());
+    for (size_t i = 0; i < read.size(); ++i) {
+        REQUIRE(read[i].timestamp_ns == records[i].timestamp_ns);
+        REQUIRE(read[i].kind == records[i].kind);
+        REQUIRE(read[i].value == records[i].value);
+    }
+    std::fclose(dump);
+
+    std::FILE* json = std::tmpfile();
+    REQUIRE(json != nullptr);
+    REQUIRE(loopp::write_chrome_trace(json, read));
+    std::string content = read_file(json);
+    std::fclose(json);
+
+    REQUIRE(content.starts_with("{\"traceEvents\":["));
+    REQUIRE(count_of(content, "\"ph\":\"B\"") == 1);
+    REQUIRE(count_of(content, "\"ph\":\"E\"") == 1);
+    REQUIRE(count_of(content, "\"ph\":\"i\"") == 1);
+    REQUIRE(content.find("\"name\":\"wait\",\"cat\":\"loopp\",\"ph\":\"B\",\"ts\":1.000") != std::string::npos);
+    REQUIRE(content.find("\"ts\":3.500,\"pid\":1,\"tid\":1,\"args\":{\"events\":3}") != std::string::npos);
+    REQUIRE(content.find("\"tid\":2,\"s\":\"t\"") != std::string::npos);
+
+    // Anything else is refused
+    std::FILE* other = std::tmpfile();
+    REQUIRE(other != nullptr);
+    std::fputs("not a trace dump at all", other);
+    std::rewind(other);
+    REQUIRE_FALSE(loopp::read_trace(other, read));
+    REQUIRE(errno == EINVAL);
+    std::fclose(other);
+}
@@ -0,0 +1,234 @@
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <catch2/catch_test_macros.hpp>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <span>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "loopp/event_loop.hpp"
+#include "loopp/transfer.hpp"
+
+namespace {
+
+/*
+ * Create a socket pair, the first end non-blocking for the loop, the second blocking for a test thread.
+ */
+std::array<int, 2> make_socket_pair() {
+    std::array<int, 2> fds{};
+    REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds.data()) == 0);
+    REQUIRE(fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK) == 0);
+    return fds;
+}
+
+/*
+ * Generate a recognizable payload, so reordered or lost bytes show up.
+ */
+std::vector<std::byte> make_payload(size_t size) {
+    std::vector<std::byte> payload(size);
+    for (size_t i = 0; i < size; ++i) {
+        payload[i] = static_cast<std::byte>((i * 31 + i / 4096) & 0xff);
+    }
+    return payload;
+}
+
+/*
+ * Read from a blocking file descriptor until end of file, pausing now and then to apply backpressure.
+ */
+std::vector<std::byte> read_all(int fd, bool is_slow = false) {
+    std::vector<std::byte> data;
+    std::array<std::byte, 16384> buffer{};
+    while (true) {
+        ssize_t result = read(fd, buffer.data(), buffer.size());
+        if (result <= 0) break;
+        data.insert(data.end(), buffer.begin(), buffer.begin() + result);
+        if (is_slow && data.size() % 8 == 0) std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+    return data;
+}
+
+/*
+ * Write everything to a blocking file descriptor.
+ */
+void write_all(int fd, const std::vector<std::byte>& data) {
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t result = write(fd, data.data() + written, data.size() - written);
+        if (result <= 0) break;
+        written += static_cast<size_t>(result);
+    }
+}
+
+}  // namespace
+
+TEST_CASE("Splice transfer moves data until end of file", "[transfer]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    auto source = make_socket_pair();
+    auto destination = make_socket_pair();
+    auto payload = make_payload(4 << 20);
+
+    loopp::SpliceTransfer transfer(*loop);
+    int64_t transfer_result = 0;
+    REQUIRE(transfer.start(source[0], destination[0], [&](int64_t result) {
+        transfer_result = result;
+        loop->stop();
+    }));
+    REQUIRE(transfer.is_running());
+
+    // A second transfer waits for the first one
+    REQUIRE_FALSE(transfer.start(source[0], destination[0], [](int64_t) {}));
+    REQUIRE(errno == EBUSY);
+
+    // The reader is slower than the writer, so the destination fills up
+    std::thread writer([&] {
+        write_all(source[1], payload);
+        shutdown(source[1], SHUT_WR);
+    });
+    std::vector<std::byte> received;
+    std::thread reader([&] { received = read_all(destination[1], true); });
+
+    loop->start();
+    shutdown(destination[0], SHUT_WR);
+    writer.join();
+    reader.join();
+
+    REQUIRE(transfer_result == static_cast<int64_t>(payload.size()));
+    REQUIRE_FALSE(transfer.is_running());
+    REQUIRE(received == payload);
+
+    for (int fd : {source[0], source[1], destination[0], destination[1]}) {
+        close(fd);
+    }
+}
+
+TEST_CASE("Splice transfer stops when cancelled", "[transfer]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    auto source = make_socket_pair();
+    auto destination = make_socket_pair();
+
+    loopp::SpliceTransfer transfer(*loop);
+    bool is_called = false;
+    REQUIRE(transfer.start(source[0], destination[0], [&](int64_t) { is_called = true; }));
+    REQUIRE(transfer.cancel());
+    REQUIRE_FALSE(transfer.is_running());
+
+    // Nothing is registered anymore, the source can be registered again
+    REQUIRE(write(source[1], "x", 1) == 1);
+    REQUIRE(loop->add_fd(source[0], loopp::EventType::READ, [&](int, loopp::EventType) { loop->stop(); }));
+    loop->start();
+    REQUIRE_FALSE(is_called);
+
+    for (int fd : {source[0], source[1], destination[0], destination[1]}) {
+        close(fd);
+    }
+}
+
+TEST_CASE("File transfer sends a range of a file", "[transfer]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    std::FILE* file = std::tmpfile();
+    REQUIRE(file != nullptr);
+    int file_fd = fileno(file);
+    auto payload = make_payload(3 << 20);
+    write_all(file_fd, payload);
+
+    auto destination = make_socket_pair();
+    constexpr size_t OFFSET = 1000;
+    constexpr size_t COUNT = 2 << 20;
+
+    loopp::FileTransfer transfer(*loop);
+    int64_t transfer_result = 0;
+    REQUIRE(transfer.start(file_fd, OFFSET, COUNT, destination[0], [&](int64_t result) {
+        transfer_result = result;
+        loop->stop();
+    }));
+
+    std::vector<std::byte> received;
+    std::thread reader([&] { received = read_all(destination[1], true); });
+
+    loop->start();
+    shutdown(destination[0], SHUT_WR);
+    reader.join();
+
+    REQUIRE(transfer_result == static_cast<int64_t>(COUNT));
+    REQUIRE(received.size() == COUNT);
+    REQUIRE(std::equal(received.begin(), received.end(), payload.begin() + OFFSET));
+
+    // The file's own offset is untouched
+    REQUIRE(lseek(file_fd, 0, SEEK_CUR) == static_cast<off_t>(payload.size()));
+
+    close(destination[0]);
+    close(destination[1]);
+    std::fclose(file);
+}
+
+TEST_CASE("Zero-copy sender completes buffers in order", "[transfer]") {
+    auto loop = loopp::EventLoop::create();
+    REQUIRE(loop != nullptr);
+
+    // Zero-copy needs TCP, connect over loopback
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    REQUIRE(listener != -1);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addr_size = sizeof(addr);
+    REQUIRE(bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0);
+    REQUIRE(listen(listener, 1) == 0);
+    REQUIRE(getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &addr_size) == 0);
+
+    int sender_fd = socket(AF_INET, SOCK_STREAM, 0);
+    REQUIRE(connect(sender_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0);
+    int receiver_fd = accept(listener, nullptr, nullptr);
+    REQUIRE(receiver_fd != -1);
+    REQUIRE(fcntl(sender_fd, F_SETFL, fcntl(sender_fd, F_GETFL) | O_NONBLOCK) == 0);
+
+    // Large buffers go without copying where supported, the small one is copied
+    std::array<std::vector<std::byte>, 3> buffers{make_payload(1 << 20), make_payload(100), make_payload(2 << 20)};
+    loopp::ZeroCopySender sender(*loop, sender_fd);
+    std::vector<std::pair<size_t, int64_t>> completions;
+    for (size_t i = 0; i < buffers.size(); ++i) {
+        REQUIRE(sender.send(std::as_bytes(std::span(buffers[i])), [&, i](int64_t result) {
+            completions.emplace_back(i, result);
+            if (completions.size() == buffers.size()) loop->stop();
+        }));
+    }
+    REQUIRE(sender.pending() == 3);
+
+    std::vector<std::byte> received;
+    std::thread reader([&] { received = read_all(receiver_fd); });
+
+    // Give up rather than hang if completions never arrive
+    loop->add_timer(std::chrono::seconds(10), [&] { loop->stop(); });
+    loop->start();
+    shutdown(sender_fd, SHUT_WR);
+    reader.join();
+
+    REQUIRE(completions.size() == 3);
+    for (size_t i = 0; i < completions.size(); ++i) {
+        REQUIRE(completions[i].first == i);
+        REQUIRE(completions[i].second == static_cast<int64_t>(buffers[i].size()));
+    }
+    REQUIRE(sender.pending() == 0);
+    REQUIRE(received.size() == buffers[0].size() + buffers[1].size() + buffers[2].size());
+
+    close(sender_fd);
+    close(receiver_fd);
+    close(listener);
+}
@@ -0,0 +1,70 @@
+#include <atomic>
+#include <catch2/catch_test_macros.hpp>
+#include <thread>
+#include <vector>
+
+#include "work_deque.hpp"
+
+TEST_CASE("WorkDeque pops newest first and steals oldest first", "[work_deque]") {
+    loopp::detail::WorkDeque<int> deque(2);
+    std::vector<int> items{1, 2, 3, 4, 5};
+
+    // Pushing past the initial capacity grows the buffer
+    for (int& item : items) {
+        deque.push(&item);
+    }
+    REQUIRE(deque.size() == 5);
+
+    REQUIRE(deque.steal() == &items[0]);
+    REQUIRE(deque.pop() == &items[4]);
+    REQUIRE(deque.steal() == &items[1]);
+    REQUIRE(deque.pop() == &items[3]);
+    REQUIRE(deque.pop() == &items[2]);
+    REQUIRE(deque.pop() == nullptr);
+    REQUIRE(deque.steal() == nullptr);
+    REQUIRE(deque.size() == 0);
+}
+
+TEST_CASE("WorkDeque hands every item out exactly once under contention", "[work_deque]") {
+    constexpr int ITEM_COUNT = 20000;
+    constexpr int THIEF_COUNT = 3;
+
+    loopp::detail::WorkDeque<int> deque(16);
+    std::vector<int> items(ITEM_COUNT);
+    std::vector<std::atomic<int>> taken(ITEM_COUNT);
+    for (int i = 0; i < ITEM_COUNT; ++i) {
+        items[static_cast<size_t>(i)] = i;
+    }
+
+    std::atomic<bool> is_done{false};
+    auto take = [&](int* item) { ++taken[static_cast<size_t>(*item)]; };
+
+    // Thieves steal while the owner pushes and pops
+    std::vector<std::thread> thieves;
+    for (int i = 0; i < THIEF_COUNT; ++i) {
+        thieves.emplace_back([&] {
+            while (!is_done.load()) {
+                if (int* item = deque.steal()) take(item);
+            }
+        });
+    }
+
+    for (int i = 0; i < ITEM_COUNT; ++i) {
+        deque.push(&items[static_cast<size_t>(i)]);
+        if (i % 3 == 0) {
+            if (int* item = deque.pop()) take(item);
+        }
+    }
+    while (int* item = deque.pop()) {
+        take(item);
+    }
+
+    is_done.store(true);
+    for (std::thread& thief : thieves) {
+        thief.join();
+    }
+
+    for (const auto& count : taken) {
+        REQUIRE(count.load() == 1);
+    }
+}
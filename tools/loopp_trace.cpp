@@ -0,0 +1,43 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "loopp/trace.hpp"
+
+/*
+ * Convert a binary trace dump, written with loopp::write_trace(), to Chrome trace event JSON.
+ * Reads the dump from the file given, or standard input, and writes the JSON to standard output.
+ * Open the result with https://ui.perfetto.dev or chrome://tracing.
+ */
+int main(int argc, char** argv) {
+    if (argc > 2) {
+        std::fprintf(stderr, "Usage: %s [dump] > trace.json\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::FILE* input = stdin;
+    if (argc == 2 && std::strcmp(argv[1], "-") != 0) {
+        input = std::fopen(argv[1], "rb");
+        if (input == nullptr) {
+            std::fprintf(stderr, "Failed to open %s: %s\n", argv[1], std::strerror(errno));
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::vector<loopp::TraceRecord> records;
+    bool is_read = loopp::read_trace(input, records);
+    int error = errno;
+    if (input != stdin) std::fclose(input);
+    if (!is_read) {
+        std::fprintf(stderr, "Failed to read the dump: %s\n", std::strerror(error));
+        return EXIT_FAILURE;
+    }
+
+    if (!loopp::write_chrome_trace(stdout, records)) {
+        std::fprintf(stderr, "Failed to write the trace: %s\n", std::strerror(errno));
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}